@@ -67,6 +67,13 @@ hyperclient_destroy(struct hyperclient* client)
     delete client;
 }
 
+void
+hyperclient_set_read_consistency(struct hyperclient* client,
+                                 enum hyperclient_read_consistency rc)
+{
+    client->set_read_consistency(rc);
+}
+
 enum hyperclient_returncode
 hyperclient_add_space(struct hyperclient* client, const char* description)
 {
@@ -113,6 +120,29 @@ hyperclient_rm_space(struct hyperclient* client, const char* space)
     }
 }
 
+enum hyperclient_returncode
+hyperclient_add_index(struct hyperclient* client, const char* space, const char* attr)
+{
+    try
+    {
+        return client->add_index(space, attr);
+    }
+    catch (po6::error& e)
+    {
+        errno = e;
+        return HYPERCLIENT_EXCEPTION;
+    }
+    catch (std::bad_alloc& ba)
+    {
+        errno = ENOMEM;
+        return HYPERCLIENT_EXCEPTION;
+    }
+    catch (...)
+    {
+        return HYPERCLIENT_EXCEPTION;
+    }
+}
+
 int64_t
 hyperclient_get(struct hyperclient* client, const char* space, const char* key,
                 size_t key_sz, hyperclient_returncode* status,
@@ -121,6 +151,37 @@ hyperclient_get(struct hyperclient* client, const char* space, const char* key,
     C_WRAP_EXCEPT(client->get(space, key, key_sz, status, attrs, attrs_sz));
 }
 
+int64_t
+hyperclient_get_partial(struct hyperclient* client, const char* space,
+                        const char* key, size_t key_sz,
+                        const char* const* attrnames, size_t attrnames_sz,
+                        hyperclient_returncode* status,
+                        struct hyperclient_attribute** attrs, size_t* attrs_sz)
+{
+    C_WRAP_EXCEPT(client->get_partial(space, key, key_sz, attrnames, attrnames_sz, status, attrs, attrs_sz));
+}
+
+int64_t
+hyperclient_multi_get(struct hyperclient* client, const char* space,
+                      const char* const* keys, const size_t* keys_sz, size_t num_keys,
+                      hyperclient_returncode* status,
+                      hyperclient_returncode* statuses,
+                      struct hyperclient_attribute** attrs, size_t* attrs_sz)
+{
+    C_WRAP_EXCEPT(client->multi_get(space, keys, keys_sz, num_keys, status, statuses, attrs, attrs_sz));
+}
+
+int64_t
+hyperclient_multi_put(struct hyperclient* client, const char* space,
+                      const char* const* keys, const size_t* keys_sz,
+                      const struct hyperclient_attribute* const* attrs,
+                      const size_t* attrs_sz, size_t num_keys,
+                      hyperclient_returncode* status,
+                      hyperclient_returncode* statuses)
+{
+    C_WRAP_EXCEPT(client->multi_put(space, keys, keys_sz, attrs, attrs_sz, num_keys, status, statuses));
+}
+
 int64_t
 hyperclient_cond_put(struct hyperclient* client, const char* space,
                      const char* key, size_t key_sz,
@@ -147,6 +208,16 @@ hyperclient_search(struct hyperclient* client, const char* space,
     C_WRAP_EXCEPT(client->search(space, checks, checks_sz, status, attrs, attrs_sz));
 }
 
+int64_t
+hyperclient_search_partial(struct hyperclient* client, const char* space,
+                           const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                           const char* const* attrnames, size_t attrnames_sz,
+                           enum hyperclient_returncode* status,
+                           struct hyperclient_attribute** attrs, size_t* attrs_sz)
+{
+    C_WRAP_EXCEPT(client->search_partial(space, checks, checks_sz, attrnames, attrnames_sz, status, attrs, attrs_sz));
+}
+
 int64_t
 hyperclient_search_describe(struct hyperclient* client, const char* space,
                             const struct hyperclient_attribute_check* checks, size_t checks_sz,
@@ -166,6 +237,18 @@ hyperclient_sorted_search(struct hyperclient* client, const char* space,
     C_WRAP_EXCEPT(client->sorted_search(space, checks, checks_sz, sort_by, limit, maximize != 0, status, attrs, attrs_sz));
 }
 
+int64_t
+hyperclient_sorted_search_partial(struct hyperclient* client, const char* space,
+                                  const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                  const char* sort_by, uint64_t limit, int maximize,
+                                  const char* const* attrnames, size_t attrnames_sz,
+                                  enum hyperclient_returncode* status,
+                                  struct hyperclient_attribute** attrs, size_t* attrs_sz)
+{
+    C_WRAP_EXCEPT(client->sorted_search_partial(space, checks, checks_sz, sort_by, limit, maximize != 0,
+                                                attrnames, attrnames_sz, status, attrs, attrs_sz));
+}
+
 int64_t
 hyperclient_group_del(struct hyperclient* client, const char* space,
                       const struct hyperclient_attribute_check* checks, size_t checks_sz,
@@ -182,6 +265,25 @@ hyperclient_count(struct hyperclient* client, const char* space,
     C_WRAP_EXCEPT(client->count(space, checks, checks_sz, status, result));
 }
 
+int64_t
+hyperclient_approximate_count(struct hyperclient* client, const char* space,
+                              const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                              enum hyperclient_returncode* status, uint64_t* result)
+{
+    C_WRAP_EXCEPT(client->approximate_count(space, checks, checks_sz, status, result));
+}
+
+int64_t
+hyperclient_aggregate(struct hyperclient* client, const char* space,
+                      const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                      const char* group_by,
+                      struct hyperclient_aggregation* aggs, size_t aggs_sz,
+                      enum hyperclient_returncode* status,
+                      struct hyperclient_attribute** group, size_t* group_sz)
+{
+    C_WRAP_EXCEPT(client->aggregate(space, checks, checks_sz, group_by, aggs, aggs_sz, status, group, group_sz));
+}
+
 int64_t
 hyperclient_loop(struct hyperclient* client, int timeout, hyperclient_returncode* status)
 {
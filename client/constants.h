@@ -42,4 +42,8 @@
                                       + sizeof(uint64_t) /*vidt*/ \
                                       + sizeof(uint64_t) /*nonce*/)
 
+// The most objects/bytes a search asks each server for in one round trip.
+#define HYPERCLIENT_SEARCH_BATCH_OBJECTS 1024
+#define HYPERCLIENT_SEARCH_BATCH_BYTES (1024 * 1024)
+
 #endif // hyperdex_client_constants_h_
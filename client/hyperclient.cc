@@ -54,9 +54,11 @@
 #include "common/ids.h"
 #include "common/macros.h"
 #include "common/mapper.h"
+#include "common/projection.h"
 #include "common/schema.h"
 #include "common/serialization.h"
 #include "datatypes/coercion.h"
+#include "datatypes/elements.h"
 #include "datatypes/validate.h"
 #include "client/complete.h"
 #include "client/constants.h"
@@ -65,9 +67,12 @@
 #include "client/hyperclient.h"
 #include "client/keyop_info.h"
 #include "client/pending.h"
+#include "client/pending_aggregate.h"
 #include "client/pending_count.h"
 #include "client/pending_get.h"
 #include "client/pending_group_del.h"
+#include "client/pending_multi_get.h"
+#include "client/pending_multi_put.h"
 #include "client/pending_search.h"
 #include "client/pending_search_description.h"
 #include "client/pending_sorted_search.h"
@@ -106,10 +111,12 @@ hyperclient :: hyperclient(const char* coordinator, uint16_t port)
     , m_coord(new hyperdex::coordinator_link(po6::net::hostname(coordinator, port)))
     , m_incomplete()
     , m_complete_succeeded()
+    , m_complete_buffered()
     , m_complete_failed()
     , m_server_nonce(1)
     , m_client_id(1)
     , m_have_seen_config(false)
+    , m_read_consistency(HYPERCLIENT_READ_STRONG)
 {
 }
 
@@ -242,19 +249,350 @@ hyperclient :: rm_space(const char* space)
     return status;
 }
 
+hyperclient_returncode
+hyperclient :: add_index(const char* space, const char* attr)
+{
+    hyperclient_returncode status;
+    std::vector<char> msg;
+    msg.insert(msg.end(), space, space + strlen(space) + 1);
+    msg.insert(msg.end(), attr, attr + strlen(attr) + 1);
+    const char* output;
+    size_t output_sz;
+
+    if (!m_coord->make_rpc("add-index", &msg.front(), msg.size(),
+                           &status, &output, &output_sz))
+    {
+        return status;
+    }
+
+    status = HYPERCLIENT_SUCCESS;
+
+    if (output_sz >= 2)
+    {
+        uint16_t x;
+        e::unpack16be(output, &x);
+        coordinator_returncode rc = static_cast<coordinator_returncode>(x);
+
+        switch (rc)
+        {
+            case hyperdex::COORD_SUCCESS:
+                status = HYPERCLIENT_SUCCESS;
+                break;
+            case hyperdex::COORD_MALFORMED:
+                status = HYPERCLIENT_INTERNAL;
+                break;
+            case hyperdex::COORD_DUPLICATE:
+                status = HYPERCLIENT_DUPLICATE;
+                break;
+            case hyperdex::COORD_NOT_FOUND:
+                status = HYPERCLIENT_NOTFOUND;
+                break;
+            case hyperdex::COORD_INITIALIZED:
+                status = HYPERCLIENT_COORDFAIL;
+                break;
+            case hyperdex::COORD_UNINITIALIZED:
+                status = HYPERCLIENT_COORDFAIL;
+                break;
+            case hyperdex::COORD_TRANSFER_IN_PROGRESS:
+                status = HYPERCLIENT_INTERNAL;
+                break;
+            default:
+                status = HYPERCLIENT_INTERNAL;
+                break;
+        }
+    }
+
+    if (output)
+    {
+        replicant_destroy_output(output, output_sz);
+    }
+
+    return status;
+}
+
+void
+hyperclient :: set_read_consistency(hyperclient_read_consistency rc)
+{
+    m_read_consistency = rc;
+}
+
 int64_t
 hyperclient :: get(const char* space, const char* key, size_t key_sz,
                    hyperclient_returncode* status,
                    struct hyperclient_attribute** attrs, size_t* attrs_sz)
+{
+    return perform_get(space, key, key_sz, NULL, 0, false, status, attrs, attrs_sz);
+}
+
+int64_t
+hyperclient :: get_partial(const char* space, const char* key, size_t key_sz,
+                           const char* const* attrnames, size_t attrnames_sz,
+                           hyperclient_returncode* status,
+                           struct hyperclient_attribute** attrs, size_t* attrs_sz)
+{
+    return perform_get(space, key, key_sz, attrnames, attrnames_sz, true, status, attrs, attrs_sz);
+}
+
+int64_t
+hyperclient :: perform_get(const char* space, const char* key, size_t key_sz,
+                           const char* const* attrnames, size_t attrnames_sz,
+                           bool restricted,
+                           hyperclient_returncode* status,
+                           struct hyperclient_attribute** attrs, size_t* attrs_sz)
 {
     MAINTAIN_COORD_CONNECTION(status)
     const hyperdex::schema* sc = m_config->get_schema(space);
     VALIDATE_KEY(sc, key, key_sz) // Checks sc
-    e::intrusive_ptr<pending> op = new pending_get(status, attrs, attrs_sz);
-    size_t sz = HYPERCLIENT_HEADER_SIZE_REQ + sizeof(uint32_t) + key_sz;
+    hyperdex::projection proj;
+
+    if (restricted)
+    {
+        size_t num_attrs = prepare_projection(sc, attrnames, attrnames_sz, status, &proj);
+
+        if (num_attrs != attrnames_sz)
+        {
+            return -1 - num_attrs;
+        }
+    }
+
+    e::intrusive_ptr<pending> op = new pending_get(status, proj, attrs, attrs_sz);
+    size_t sz = HYPERCLIENT_HEADER_SIZE_REQ + sizeof(uint32_t) + key_sz + pack_size(proj);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << e::slice(key, key_sz);
-    return add_keyop(space, key, key_sz, msg, op);
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << e::slice(key, key_sz) << proj;
+    return add_keyop(read_target(space, key, key_sz), msg, op);
+}
+
+int64_t
+hyperclient :: multi_get(const char* space,
+                         const char* const* keys, const size_t* keys_sz, size_t num_keys,
+                         hyperclient_returncode* status,
+                         hyperclient_returncode* statuses,
+                         struct hyperclient_attribute** attrs, size_t* attrs_sz)
+{
+    MAINTAIN_COORD_CONNECTION(status)
+    const hyperdex::schema* sc = m_config->get_schema(space);
+
+    if (!sc)
+    {
+        *status = HYPERCLIENT_UNKNOWNSPACE;
+        return -1;
+    }
+
+    std::vector<virtual_server_id> targets(num_keys);
+    std::map<server_id, std::vector<size_t> > by_server;
+
+    for (size_t i = 0; i < num_keys; ++i)
+    {
+        if (!validate_as_type(e::slice(keys[i], keys_sz[i]), sc->attrs[0].type))
+        {
+            statuses[i] = HYPERCLIENT_WRONGTYPE;
+            *status = HYPERCLIENT_WRONGTYPE;
+            return -1;
+        }
+
+        targets[i] = read_target(space, keys[i], keys_sz[i]);
+
+        if (targets[i] == virtual_server_id())
+        {
+            statuses[i] = HYPERCLIENT_RECONFIGURE;
+            *status = HYPERCLIENT_RECONFIGURE;
+            return -1;
+        }
+
+        statuses[i] = HYPERCLIENT_RECONFIGURE;
+        attrs[i] = NULL;
+        attrs_sz[i] = 0;
+        by_server[m_config->get_server_id(targets[i])].push_back(i);
+    }
+
+    int64_t multi_id = m_client_id;
+    ++m_client_id;
+
+    if (by_server.empty())
+    {
+#ifdef _MSC_VER
+        m_complete_failed.push(std::shared_ptr<complete>(new complete(multi_id, status, HYPERCLIENT_SUCCESS, 0)));
+#else
+        m_complete_failed.push(complete(multi_id, status, HYPERCLIENT_SUCCESS, 0));
+#endif
+        return multi_id;
+    }
+
+    e::intrusive_ptr<refcount> ref(new refcount());
+
+    for (std::map<server_id, std::vector<size_t> >::iterator it = by_server.begin();
+            it != by_server.end(); ++it)
+    {
+        const std::vector<size_t>& idxs(it->second);
+        size_t sz = HYPERCLIENT_HEADER_SIZE_REQ + sizeof(uint64_t);
+
+        for (size_t i = 0; i < idxs.size(); ++i)
+        {
+            sz += sizeof(uint64_t) + sizeof(uint32_t) + keys_sz[idxs[i]];
+        }
+
+        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        e::buffer::packer pa = msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ);
+        pa = pa << static_cast<uint64_t>(idxs.size());
+
+        for (size_t i = 0; i < idxs.size(); ++i)
+        {
+            pa = pa << targets[idxs[i]].get() << e::slice(keys[idxs[i]], keys_sz[idxs[i]]);
+        }
+
+        e::intrusive_ptr<pending> op = new pending_multi_get(multi_id, ref, status, idxs,
+                                                             statuses, attrs, attrs_sz);
+        op->set_server_visible_nonce(m_server_nonce);
+        ++m_server_nonce;
+        op->set_sent_to(targets[idxs[0]]);
+        m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
+        // on failure, send has already failed this op through killall
+        send(op, msg);
+    }
+
+    return multi_id;
+}
+
+int64_t
+hyperclient :: multi_put(const char* space,
+                         const char* const* keys, const size_t* keys_sz,
+                         const struct hyperclient_attribute* const* attrs,
+                         const size_t* attrs_sz, size_t num_keys,
+                         hyperclient_returncode* status,
+                         hyperclient_returncode* statuses)
+{
+    MAINTAIN_COORD_CONNECTION(status)
+    const hyperdex::schema* sc = m_config->get_schema(space);
+
+    if (!sc)
+    {
+        *status = HYPERCLIENT_UNKNOWNSPACE;
+        return -1;
+    }
+
+    const hyperclient_keyop_info* opinfo;
+    opinfo = hyperclient_keyop_info_lookup("put", 3);
+    std::vector<std::vector<funcall> > ops(num_keys);
+    std::vector<virtual_server_id> targets(num_keys);
+    std::map<server_id, std::vector<size_t> > by_server;
+    bool failed = false;
+
+    // Validate every key before sending anything so that a bad key never
+    // leaves the batch half-applied.
+    for (size_t i = 0; i < num_keys; ++i)
+    {
+        statuses[i] = HYPERCLIENT_SUCCESS;
+
+        if (!validate_as_type(e::slice(keys[i], keys_sz[i]), sc->attrs[0].type))
+        {
+            statuses[i] = HYPERCLIENT_WRONGTYPE;
+            failed = true;
+            continue;
+        }
+
+        if (prepare_ops(sc, opinfo, attrs[i], attrs_sz[i], statuses + i, &ops[i]) < attrs_sz[i])
+        {
+            failed = true;
+            continue;
+        }
+
+        targets[i] = m_config->point_leader(space, e::slice(keys[i], keys_sz[i]));
+
+        if (targets[i] == virtual_server_id())
+        {
+            statuses[i] = HYPERCLIENT_RECONFIGURE;
+            failed = true;
+            continue;
+        }
+
+        std::sort(ops[i].begin(), ops[i].end());
+        by_server[m_config->get_server_id(targets[i])].push_back(i);
+    }
+
+    if (failed)
+    {
+        for (size_t i = 0; i < num_keys; ++i)
+        {
+            if (statuses[i] != HYPERCLIENT_SUCCESS)
+            {
+                *status = statuses[i];
+                break;
+            }
+        }
+
+        return -1;
+    }
+
+    int64_t multi_id = m_client_id;
+    ++m_client_id;
+
+    if (by_server.empty())
+    {
+#ifdef _MSC_VER
+        m_complete_failed.push(std::shared_ptr<complete>(new complete(multi_id, status, HYPERCLIENT_SUCCESS, 0)));
+#else
+        m_complete_failed.push(complete(multi_id, status, HYPERCLIENT_SUCCESS, 0));
+#endif
+        return multi_id;
+    }
+
+    uint8_t flags = (opinfo->fail_if_not_exist ? 1 : 0)
+                  | (opinfo->fail_if_exist ? 2 : 0)
+                  | (opinfo->has_funcalls ? 128 : 0);
+    std::vector<attribute_check> chks;
+    e::intrusive_ptr<refcount> ref(new refcount());
+
+    for (std::map<server_id, std::vector<size_t> >::iterator it = by_server.begin();
+            it != by_server.end(); ++it)
+    {
+        const std::vector<size_t>& idxs(it->second);
+        size_t sz = HYPERCLIENT_HEADER_SIZE_REQ + sizeof(uint64_t);
+
+        for (size_t i = 0; i < idxs.size(); ++i)
+        {
+            sz += 2 * sizeof(uint64_t)
+                + sizeof(uint32_t) + keys_sz[idxs[i]]
+                + sizeof(uint8_t)
+                + sizeof(uint32_t) + sizeof(uint32_t);
+
+            for (size_t j = 0; j < ops[idxs[i]].size(); ++j)
+            {
+                sz += pack_size(ops[idxs[i]][j]);
+            }
+        }
+
+        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        e::buffer::packer pa = msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ);
+        pa = pa << static_cast<uint64_t>(idxs.size());
+        e::intrusive_ptr<pending> first;
+
+        for (size_t i = 0; i < idxs.size(); ++i)
+        {
+            e::intrusive_ptr<pending> op = new pending_multi_put(multi_id, ref, status, statuses + idxs[i]);
+            op->set_server_visible_nonce(m_server_nonce);
+            ++m_server_nonce;
+            op->set_sent_to(targets[idxs[i]]);
+            m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
+            pa = pa << op->sent_to().get() << op->server_visible_nonce();
+
+            if (!first)
+            {
+                first = op;
+            }
+        }
+
+        for (size_t i = 0; i < idxs.size(); ++i)
+        {
+            pa = pa << e::slice(keys[idxs[i]], keys_sz[idxs[i]]) << flags << chks << ops[idxs[i]];
+        }
+
+        // The header carries the first key's nonce; the daemon answers each
+        // key under its own.  On failure send has already failed every key
+        // bound for this server through killall.
+        send(first, msg);
+    }
+
+    return multi_id;
 }
 
 int64_t
@@ -386,6 +724,27 @@ hyperclient :: search(const char* space,
                       const struct hyperclient_attribute_check* checks, size_t checks_sz,
                       enum hyperclient_returncode* status,
                       struct hyperclient_attribute** attrs, size_t* attrs_sz)
+{
+    return perform_search(space, checks, checks_sz, NULL, 0, false, status, attrs, attrs_sz);
+}
+
+int64_t
+hyperclient :: search_partial(const char* space,
+                              const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                              const char* const* attrnames, size_t attrnames_sz,
+                              enum hyperclient_returncode* status,
+                              struct hyperclient_attribute** attrs, size_t* attrs_sz)
+{
+    return perform_search(space, checks, checks_sz, attrnames, attrnames_sz, true, status, attrs, attrs_sz);
+}
+
+int64_t
+hyperclient :: perform_search(const char* space,
+                              const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                              const char* const* attrnames, size_t attrnames_sz,
+                              bool restricted,
+                              enum hyperclient_returncode* status,
+                              struct hyperclient_attribute** attrs, size_t* attrs_sz)
 {
     MAINTAIN_COORD_CONNECTION(status)
     std::vector<hyperdex::attribute_check> chks;
@@ -397,18 +756,35 @@ hyperclient :: search(const char* space,
         return ret;
     }
 
+    hyperdex::projection proj;
+
+    if (restricted)
+    {
+        size_t num_attrs = prepare_projection(m_config->get_schema(space), attrnames, attrnames_sz, status, &proj);
+
+        if (num_attrs != attrnames_sz)
+        {
+            return -1 - checks_sz - num_attrs;
+        }
+    }
+
     int64_t search_id = m_client_id;
     ++m_client_id;
+    uint64_t batch_objects = HYPERCLIENT_SEARCH_BATCH_OBJECTS;
+    uint64_t batch_bytes = HYPERCLIENT_SEARCH_BATCH_BYTES;
     size_t sz = HYPERCLIENT_HEADER_SIZE_REQ
               + sizeof(int64_t)
-              + pack_size(chks);
+              + pack_size(chks)
+              + sizeof(batch_objects)
+              + sizeof(batch_bytes)
+              + pack_size(proj);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << search_id << chks;
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << search_id << chks << batch_objects << batch_bytes << proj;
     e::intrusive_ptr<refcount> ref(new refcount());
 
     for (size_t i = 0; i < servers.size(); ++i)
     {
-        e::intrusive_ptr<pending> op = new pending_search(search_id, ref, status, attrs, attrs_sz);
+        e::intrusive_ptr<pending> op = new pending_search(search_id, ref, status, proj, attrs, attrs_sz);
         op->set_server_visible_nonce(m_server_nonce);
         ++m_server_nonce;
         op->set_sent_to(servers[i]);
@@ -491,6 +867,35 @@ hyperclient :: sorted_search(const char* space,
                              bool maximize,
                              enum hyperclient_returncode* status,
                              struct hyperclient_attribute** attrs, size_t* attrs_sz)
+{
+    return perform_sorted_search(space, checks, checks_sz, sort_by, limit, maximize,
+                                 NULL, 0, false, status, attrs, attrs_sz);
+}
+
+int64_t
+hyperclient :: sorted_search_partial(const char* space,
+                                     const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                     const char* sort_by,
+                                     uint64_t limit,
+                                     bool maximize,
+                                     const char* const* attrnames, size_t attrnames_sz,
+                                     enum hyperclient_returncode* status,
+                                     struct hyperclient_attribute** attrs, size_t* attrs_sz)
+{
+    return perform_sorted_search(space, checks, checks_sz, sort_by, limit, maximize,
+                                 attrnames, attrnames_sz, true, status, attrs, attrs_sz);
+}
+
+int64_t
+hyperclient :: perform_sorted_search(const char* space,
+                                     const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                     const char* sort_by,
+                                     uint64_t limit,
+                                     bool maximize,
+                                     const char* const* attrnames, size_t attrnames_sz,
+                                     bool restricted,
+                                     enum hyperclient_returncode* status,
+                                     struct hyperclient_attribute** attrs, size_t* attrs_sz)
 {
     MAINTAIN_COORD_CONNECTION(status)
     std::vector<hyperdex::attribute_check> chks;
@@ -512,6 +917,35 @@ hyperclient :: sorted_search(const char* space,
         return -1 - checks_sz;
     }
 
+    hyperdex::projection proj;
+    size_t sort_idx = sort_by_no > 0 ? sort_by_no - 1 : 0;
+
+    if (restricted)
+    {
+        size_t num_attrs = prepare_projection(m_config->get_schema(space), attrnames, attrnames_sz, status, &proj);
+
+        if (num_attrs != attrnames_sz)
+        {
+            return -2 - checks_sz - num_attrs;
+        }
+    }
+
+    // The client merges the results of every server by the sort attribute,
+    // so the servers must send it even if the application did not ask.
+    hyperdex::projection wire(proj);
+
+    if (restricted && sort_by_no > 0)
+    {
+        std::vector<uint16_t>::iterator it;
+        it = std::find(wire.attrs.begin(), wire.attrs.end(), sort_by_no);
+        sort_idx = it - wire.attrs.begin();
+
+        if (it == wire.attrs.end())
+        {
+            wire.attrs.push_back(sort_by_no);
+        }
+    }
+
     int64_t search_id = m_client_id;
     ++m_client_id;
     int8_t max = maximize ? 1 : 0;
@@ -519,13 +953,14 @@ hyperclient :: sorted_search(const char* space,
               + pack_size(chks)
               + sizeof(limit)
               + sizeof(sort_by_no)
-              + sizeof(max);
+              + sizeof(max)
+              + pack_size(wire);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << chks << limit << sort_by_no << max;
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << chks << limit << sort_by_no << max << wire;
     std::auto_ptr<e::buffer>* backings = new std::auto_ptr<e::buffer>[servers.size()];
     e::guard g = e::makeguard(delete_bracket_auto_ptr, backings);
     e::intrusive_ptr<pending_sorted_search::state> state;
-    state = new pending_sorted_search::state(backings, limit, sort_by_no, sort_by_type, maximize);
+    state = new pending_sorted_search::state(backings, limit, sort_by_no, sort_by_type, maximize, proj, sort_idx);
     g.dismiss();
 
     for (size_t i = 0; i < servers.size(); ++i)
@@ -602,6 +1037,25 @@ hyperclient :: count(const char* space,
                      const struct hyperclient_attribute_check* checks, size_t checks_sz,
                      enum hyperclient_returncode* status,
                      uint64_t* result)
+{
+    return perform_count(space, checks, checks_sz, false, status, result);
+}
+
+int64_t
+hyperclient :: approximate_count(const char* space,
+                                 const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                 enum hyperclient_returncode* status,
+                                 uint64_t* result)
+{
+    return perform_count(space, checks, checks_sz, true, status, result);
+}
+
+int64_t
+hyperclient :: perform_count(const char* space,
+                             const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                             bool approximate,
+                             enum hyperclient_returncode* status,
+                             uint64_t* result)
 {
     MAINTAIN_COORD_CONNECTION(status)
     std::vector<hyperdex::attribute_check> chks;
@@ -615,10 +1069,12 @@ hyperclient :: count(const char* space,
 
     int64_t search_id = m_client_id;
     ++m_client_id;
+    uint8_t flags = approximate ? 0x1 : 0;
     size_t sz = HYPERCLIENT_HEADER_SIZE_REQ
-              + pack_size(chks);
+              + pack_size(chks)
+              + sizeof(uint8_t);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << chks;
+    msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << chks << flags;
     e::intrusive_ptr<refcount> ref(new refcount());
 
     for (size_t i = 0; i < servers.size(); ++i)
@@ -644,11 +1100,146 @@ hyperclient :: count(const char* space,
     return search_id;
 }
 
+int64_t
+hyperclient :: aggregate(const char* space,
+                         const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                         const char* group_by,
+                         struct hyperclient_aggregation* aggs, size_t aggs_sz,
+                         enum hyperclient_returncode* status,
+                         struct hyperclient_attribute** group, size_t* group_sz)
+{
+    MAINTAIN_COORD_CONNECTION(status)
+    std::vector<hyperdex::attribute_check> chks;
+    std::vector<hyperdex::virtual_server_id> servers;
+    int64_t ret = prepare_searchop(space, checks, checks_sz, status, &chks, &servers);
+
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    const hyperdex::schema* sc = m_config->get_schema(space);
+    assert(sc);
+    std::vector<uint16_t> attrs;
+    std::vector<hyperdatatype> types;
+    std::vector<size_t> stats(aggs_sz, 0);
+
+    for (size_t i = 0; i < aggs_sz; ++i)
+    {
+        switch (aggs[i].function)
+        {
+            case HYPERCLIENT_AGGREGATE_COUNT:
+                continue;
+            case HYPERCLIENT_AGGREGATE_SUM:
+            case HYPERCLIENT_AGGREGATE_MIN:
+            case HYPERCLIENT_AGGREGATE_MAX:
+            case HYPERCLIENT_AGGREGATE_AVG:
+                break;
+            default:
+                *status = HYPERCLIENT_WRONGTYPE;
+                return -1 - checks_sz - i;
+        }
+
+        uint16_t attrnum = sc->lookup_attr(aggs[i].attr);
+
+        if (attrnum == sc->attrs_sz)
+        {
+            *status = HYPERCLIENT_UNKNOWNATTR;
+            return -1 - checks_sz - i;
+        }
+
+        if (attrnum == 0 ||
+            (sc->attrs[attrnum].type != HYPERDATATYPE_INT64 &&
+             sc->attrs[attrnum].type != HYPERDATATYPE_FLOAT))
+        {
+            *status = HYPERCLIENT_WRONGTYPE;
+            return -1 - checks_sz - i;
+        }
+
+        std::vector<uint16_t>::iterator it = std::find(attrs.begin(), attrs.end(), attrnum);
+        stats[i] = it - attrs.begin();
+
+        if (it == attrs.end())
+        {
+            attrs.push_back(attrnum);
+            types.push_back(sc->attrs[attrnum].type);
+        }
+    }
+
+    uint8_t flags = group_by ? 1 : 0;
+    uint16_t group_by_no = 0;
+    hyperdatatype group_by_type = HYPERDATATYPE_GARBAGE;
+
+    if (group_by)
+    {
+        group_by_no = sc->lookup_attr(group_by);
+
+        if (group_by_no == sc->attrs_sz)
+        {
+            *status = HYPERCLIENT_UNKNOWNATTR;
+            return -1 - checks_sz - aggs_sz;
+        }
+
+        group_by_type = sc->attrs[group_by_no].type;
+
+        if (group_by_type != HYPERDATATYPE_STRING &&
+            group_by_type != HYPERDATATYPE_INT64 &&
+            group_by_type != HYPERDATATYPE_FLOAT)
+        {
+            *status = HYPERCLIENT_WRONGTYPE;
+            return -1 - checks_sz - aggs_sz;
+        }
+    }
+
+    int64_t aggregate_id = m_client_id;
+    ++m_client_id;
+    uint16_t num_attrs = attrs.size();
+    size_t sz = HYPERCLIENT_HEADER_SIZE_REQ
+              + pack_size(chks)
+              + sizeof(flags)
+              + sizeof(group_by_no)
+              + sizeof(num_attrs)
+              + attrs.size() * sizeof(uint16_t);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    e::buffer::packer pa = msg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ);
+    pa = pa << chks << flags << group_by_no << num_attrs;
+
+    for (size_t i = 0; i < attrs.size(); ++i)
+    {
+        pa = pa << attrs[i];
+    }
+
+    e::intrusive_ptr<pending_aggregate::state> state;
+    state = new pending_aggregate::state(group_by != NULL, group_by, group_by_type, stats, types);
+
+    for (size_t i = 0; i < servers.size(); ++i)
+    {
+        e::intrusive_ptr<pending> op = new pending_aggregate(aggregate_id, state, status, aggs, aggs_sz, group, group_sz);
+        op->set_server_visible_nonce(m_server_nonce);
+        ++m_server_nonce;
+        op->set_sent_to(servers[i]);
+        m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
+        std::auto_ptr<e::buffer> tosend(msg->copy());
+
+        if (send(op, tosend) < 0)
+        {
+#ifdef _MSC_VER
+            m_complete_failed.push(std::shared_ptr<complete>(new complete(aggregate_id, status, HYPERCLIENT_RECONFIGURE, 0)));
+#else
+            m_complete_failed.push(complete(aggregate_id, status, HYPERCLIENT_RECONFIGURE, 0));
+#endif
+            m_incomplete.erase(op->server_visible_nonce());
+        }
+    }
+
+    return aggregate_id;
+}
+
 int64_t
 hyperclient :: loop(int timeout, hyperclient_returncode* status)
 {
     while (!m_incomplete.empty() && m_complete_failed.empty() &&
-           m_complete_succeeded.empty())
+           m_complete_succeeded.empty() && m_complete_buffered.empty())
     {
         if (maintain_coord_connection(status) < 0)
         {
@@ -718,6 +1309,15 @@ hyperclient :: loop(int timeout, hyperclient_returncode* status)
             return op->client_visible_id();
         }
 
+        // the server is overloaded; unlike a reconfiguration, retrying right
+        // away will not help
+        if (msg_type == hyperdex::SERVERBUSY)
+        {
+            op->set_status(HYPERCLIENT_SERVERERROR);
+            m_incomplete.erase(it);
+            return op->client_visible_id();
+        }
+
         if (m_config->get_server_id(virtual_server_id(vfrom)) == id)
         {
             // Handle response will either successfully finish one event and
@@ -740,18 +1340,33 @@ hyperclient :: loop(int timeout, hyperclient_returncode* status)
         }
     }
 
-    if (!m_complete_succeeded.empty())
+    while (!m_complete_succeeded.empty())
     {
         int64_t nonce = m_complete_succeeded.front();
         m_complete_succeeded.pop();
         incomplete_map_t::iterator it = m_incomplete.find(nonce);
-        assert(it != m_incomplete.end());
+
+        // The op may have been killed after queueing its results, in which
+        // case killall already reported the failure.
+        if (it == m_incomplete.end())
+        {
+            continue;
+        }
+
         e::intrusive_ptr<pending> op = it->second;
         m_incomplete.erase(it);
         *status = HYPERCLIENT_SUCCESS;
         return op->return_one(this, status);
     }
 
+    if (!m_complete_buffered.empty())
+    {
+        e::intrusive_ptr<pending> op = m_complete_buffered.front();
+        m_complete_buffered.pop();
+        *status = HYPERCLIENT_SUCCESS;
+        return op->return_one(this, status);
+    }
+
     if (!m_complete_failed.empty())
     {
 #ifdef _MSC_VER
@@ -1357,11 +1972,41 @@ validate_check(const hyperdex::schema* sc,
         case HYPERPREDICATE_CONTAINS_LESS_THAN:
             return validate_as_type(e::slice(chk->value, chk->value_sz), chk->datatype) &&
                    chk->datatype == HYPERDATATYPE_INT64;
+        case HYPERPREDICATE_CONTAINS:
+            return validate_as_type(e::slice(chk->value, chk->value_sz), chk->datatype) &&
+                   !IS_PRIMITIVE(sc->attrs[attrnum].type) &&
+                   container_element_type(sc->attrs[attrnum].type) == chk->datatype;
         default:
             return false;
     }
 }
 
+size_t
+hyperclient :: prepare_projection(const hyperdex::schema* sc,
+                                  const char* const* attrnames, size_t attrnames_sz,
+                                  hyperclient_returncode* status,
+                                  hyperdex::projection* proj)
+{
+    proj->restricted = true;
+    proj->attrs.clear();
+
+    for (size_t i = 0; i < attrnames_sz; ++i)
+    {
+        uint16_t attrnum = sc->lookup_attr(attrnames[i]);
+
+        // the key always comes back, so naming it is an error
+        if (attrnum == sc->attrs_sz || attrnum == 0)
+        {
+            *status = HYPERCLIENT_UNKNOWNATTR;
+            return i;
+        }
+
+        proj->attrs.push_back(attrnum);
+    }
+
+    return attrnames_sz;
+}
+
 size_t
 hyperclient :: prepare_checks(const hyperdex::schema* sc,
                               const hyperclient_attribute_check* checks, size_t checks_sz,
@@ -1498,7 +2143,14 @@ hyperclient :: add_keyop(const char* space, const char* key, size_t key_sz,
     }
 
     hyperdex::virtual_server_id vsi = m_config->point_leader(space, e::slice(key, key_sz));
+    return add_keyop(vsi, msg, op);
+}
 
+int64_t
+hyperclient :: add_keyop(const hyperdex::virtual_server_id& vsi,
+                         std::auto_ptr<e::buffer> msg,
+                         e::intrusive_ptr<pending> op)
+{
     if (vsi == hyperdex::virtual_server_id())
     {
         op->set_status(HYPERCLIENT_RECONFIGURE);
@@ -1524,6 +2176,21 @@ hyperclient :: add_keyop(const char* space, const char* key, size_t key_sz,
     }
 }
 
+hyperdex::virtual_server_id
+hyperclient :: read_target(const char* space, const char* key, size_t key_sz)
+{
+    hyperdex::region_id ri = m_config->point_region(space, e::slice(key, key_sz));
+
+    switch (m_read_consistency)
+    {
+        case HYPERCLIENT_READ_RELAXED:
+            return m_config->replica_of_region(ri, m_server_nonce);
+        case HYPERCLIENT_READ_STRONG:
+        default:
+            return m_config->tail_of_region(ri);
+    }
+}
+
 int64_t
 hyperclient :: send(e::intrusive_ptr<pending> op,
                     std::auto_ptr<e::buffer> msg)
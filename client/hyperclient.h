@@ -71,6 +71,24 @@ struct hyperclient_attribute_check
     enum hyperpredicate predicate;
 };
 
+/* Aggregates computed by hyperclient_aggregate.  COUNT ignores attr; the rest
+ * require an int64 or float attribute. */
+enum hyperclient_aggregate_function
+{
+    HYPERCLIENT_AGGREGATE_COUNT = 0,
+    HYPERCLIENT_AGGREGATE_SUM   = 1,
+    HYPERCLIENT_AGGREGATE_MIN   = 2,
+    HYPERCLIENT_AGGREGATE_MAX   = 3,
+    HYPERCLIENT_AGGREGATE_AVG   = 4
+};
+
+struct hyperclient_aggregation
+{
+    const char* attr; /* NULL-terminated */
+    enum hyperclient_aggregate_function function;
+    double result;
+};
+
 /* HyperClient returncode occupies [8448, 8576) */
 enum hyperclient_returncode
 {
@@ -107,17 +125,40 @@ enum hyperclient_returncode
     HYPERCLIENT_GARBAGE      = 8575
 };
 
+/* Which replicas serve gets.
+ *
+ * STRONG reads from the tail of the key's chain, which sees every write before
+ * any other replica does, so a get always observes every completed write.
+ * RELAXED spreads gets across every replica of the key.  A get still observes
+ * every completed write, but may observe a write that is in flight and a later
+ * get served by a different replica may not.
+ */
+enum hyperclient_read_consistency
+{
+    HYPERCLIENT_READ_STRONG  = 0,
+    HYPERCLIENT_READ_RELAXED = 1
+};
+
 struct hyperclient*
 hyperclient_create(const char* coordinator, uint16_t port);
 void
 hyperclient_destroy(struct hyperclient* client);
 
+/* Change where subsequent gets are routed; the default is STRONG */
+void
+hyperclient_set_read_consistency(struct hyperclient* client,
+                                 enum hyperclient_read_consistency rc);
+
 enum hyperclient_returncode
 hyperclient_add_space(struct hyperclient* client, const char* description);
 
 enum hyperclient_returncode
 hyperclient_rm_space(struct hyperclient* client, const char* space);
 
+/* Index attr throughout space; existing objects are indexed in the background */
+enum hyperclient_returncode
+hyperclient_add_index(struct hyperclient* client, const char* space, const char* attr);
+
 /* All values return a 64-bit integer, which uniquely identifies the request
  * until its completion.  Positive values indicate valid identifiers.  Negative
  * values indicate that the request fails immediately for the reason stored in
@@ -143,6 +184,20 @@ hyperclient_get(struct hyperclient* client, const char* space, const char* key,
                 size_t key_sz, enum hyperclient_returncode* status,
                 struct hyperclient_attribute** attrs, size_t* attrs_sz);
 
+/* As hyperclient_get, but retrieve only the attributes named in "attrnames",
+ * in that order.  The servers send nothing else.  With attrnames_sz == 0 no
+ * attributes are returned and the call only checks that the key exists.
+ *
+ * If this returns a value < 0 and *status == HYPERCLIENT_UNKNOWNATTR, then
+ * abs(returned value) - 1 is the index into attrnames of the bad name.
+ */
+int64_t
+hyperclient_get_partial(struct hyperclient* client, const char* space,
+                        const char* key, size_t key_sz,
+                        const char* const* attrnames, size_t attrnames_sz,
+                        enum hyperclient_returncode* status,
+                        struct hyperclient_attribute** attrs, size_t* attrs_sz);
+
 /* Store the secondary attributes under "key" in "space".
  * If this returns a value < 0 and *status == HYPERCLIENT_UNKNOWNATTR, then
  * abs(returned value) - 1 == the attribute which caused the error.
@@ -160,6 +215,46 @@ hyperclient_put(struct hyperclient* client, const char* space, const char* key,
                 size_t key_sz, const struct hyperclient_attribute* attrs,
                 size_t attrs_sz, enum hyperclient_returncode* status);
 
+/* Retrieve num_keys keys from "space" with one request per server.
+ *
+ * When hyperclient_loop returns the identifier, statuses[i], attrs[i], and
+ * attrs_sz[i] hold what hyperclient_get would have returned for keys[i].  Keys
+ * whose server could not be reached are left as HYPERCLIENT_RECONFIGURE and
+ * the identifier may be returned once more for each such server.
+ *
+ * - space, keys, keys_sz must point to memory that exists for the duration of
+ *   this call
+ * - client, status, statuses, attrs, attrs_sz must point to memory that exists
+ *   until the request is considered complete
+ */
+int64_t
+hyperclient_multi_get(struct hyperclient* client, const char* space,
+                      const char* const* keys, const size_t* keys_sz, size_t num_keys,
+                      enum hyperclient_returncode* status,
+                      enum hyperclient_returncode* statuses,
+                      struct hyperclient_attribute** attrs, size_t* attrs_sz);
+
+/* Store attrs[i] under keys[i] for every i < num_keys, as hyperclient_put
+ * would, with one request per server.
+ *
+ * statuses[i] holds the outcome of keys[i].  hyperclient_loop returns the
+ * identifier when every key has completed, and once more for each key that
+ * fails because its server could not be reached.  If this returns a value < 0,
+ * nothing was sent and the keys at fault have their error in statuses.
+ *
+ * - space, keys, keys_sz, attrs, attrs_sz must point to memory that exists for
+ *   the duration of this call
+ * - client, status, statuses must point to memory that exists until the
+ *   request is considered complete
+ */
+int64_t
+hyperclient_multi_put(struct hyperclient* client, const char* space,
+                      const char* const* keys, const size_t* keys_sz,
+                      const struct hyperclient_attribute* const* attrs,
+                      const size_t* attrs_sz, size_t num_keys,
+                      enum hyperclient_returncode* status,
+                      enum hyperclient_returncode* statuses);
+
 int64_t
 hyperclient_put_if_not_exist(struct hyperclient* client, const char* space, const char* key,
                              size_t key_sz, const struct hyperclient_attribute* attrs,
@@ -591,6 +686,22 @@ hyperclient_search(struct hyperclient* client, const char* space,
                    enum hyperclient_returncode* status,
                    struct hyperclient_attribute** attrs, size_t* attrs_sz);
 
+/* As hyperclient_search, but return each object's key followed by only the
+ * attributes named in "attrnames".  With attrnames_sz == 0 only keys are
+ * returned, and servers may answer from their indices without reading the
+ * objects.
+ *
+ * If this returns a value < 0 and *status == HYPERCLIENT_UNKNOWNATTR, then
+ * abs(returned value) - 1 - checks_sz is the index into attrnames of the bad
+ * name.
+ */
+int64_t
+hyperclient_search_partial(struct hyperclient* client, const char* space,
+                           const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                           const char* const* attrnames, size_t attrnames_sz,
+                           enum hyperclient_returncode* status,
+                           struct hyperclient_attribute** attrs, size_t* attrs_sz);
+
 /* Perform a search, and build a string describing the costs of the search.
  */
 int64_t
@@ -622,6 +733,21 @@ hyperclient_sorted_search(struct hyperclient* client, const char* space,
                           enum hyperclient_returncode* status,
                           struct hyperclient_attribute** attrs, size_t* attrs_sz);
 
+/* As hyperclient_sorted_search, but return each object's key followed by only
+ * the attributes named in "attrnames" (none if attrnames_sz == 0).
+ *
+ * If this returns a value < 0 and *status == HYPERCLIENT_UNKNOWNATTR, then
+ * abs(returned value) - 2 - checks_sz is the index into attrnames of the bad
+ * name.
+ */
+int64_t
+hyperclient_sorted_search_partial(struct hyperclient* client, const char* space,
+                                  const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                  const char* sort_by, uint64_t limit, int maximize,
+                                  const char* const* attrnames, size_t attrnames_sz,
+                                  enum hyperclient_returncode* status,
+                                  struct hyperclient_attribute** attrs, size_t* attrs_sz);
+
 /* Delete objects which mach "eq" and "rn".
  *
  * The remote servers will perform a search as if this were a call to
@@ -642,6 +768,41 @@ hyperclient_count(struct hyperclient* client, const char* space,
                   const struct hyperclient_attribute_check* checks, size_t checks_sz,
                   enum hyperclient_returncode* status, uint64_t* result);
 
+/* Estimate the number of objects which match "checks".
+ *
+ * Each server samples the leading entries of the index range it would scan and
+ * extrapolates from the on-disk size of that range, so the result is cheap to
+ * compute but may be off by a wide margin for small or skewed spaces.  Ranges
+ * that fit within the sample are counted exactly.
+ */
+int64_t
+hyperclient_approximate_count(struct hyperclient* client, const char* space,
+                              const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                              enum hyperclient_returncode* status, uint64_t* result);
+
+/* Compute aggregates over the objects which match "checks".  Every server
+ * aggregates its own objects, so only partial results cross the network.
+ *
+ * If group_by is NULL, hyperclient_loop returns the identifier once with the
+ * result of each aggregate in aggs[i].result, and sets *group to NULL.
+ * Otherwise, it returns the identifier once for each distinct value of
+ * group_by, in ascending order, with *group pointing to a single attribute
+ * holding the value (free it with hyperclient_destroy_attrs) and aggs holding
+ * that group's results.  The final return has *status ==
+ * HYPERCLIENT_SEARCHDONE.
+ *
+ * If this returns a value < 0 and *status == HYPERCLIENT_UNKNOWNATTR or
+ * HYPERCLIENT_WRONGTYPE, then abs(returned value) - 1 - checks_sz is the index
+ * of the aggregate which caused the error, or aggs_sz for group_by.
+ */
+int64_t
+hyperclient_aggregate(struct hyperclient* client, const char* space,
+                      const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                      const char* group_by,
+                      struct hyperclient_aggregation* aggs, size_t aggs_sz,
+                      enum hyperclient_returncode* status,
+                      struct hyperclient_attribute** group, size_t* group_sz);
+
 /* Handle I/O until at least one event is complete (either a key-op finishes, or
  * a search returns one item).
  *
@@ -697,8 +858,10 @@ class configuration;
 class coordinator_link;
 class funcall;
 class mapper;
+class projection;
 class schema;
 class server_id;
+class test_wrapper;
 class tool_wrapper;
 class virtual_server_id;
 } //namespace hyperdex
@@ -718,14 +881,31 @@ class hyperclient
     public:
         hyperclient_returncode add_space(const char* description);
         hyperclient_returncode rm_space(const char* space);
+        hyperclient_returncode add_index(const char* space, const char* attr);
+        void set_read_consistency(hyperclient_read_consistency rc);
 
     public:
         int64_t get(const char* space, const char* key, size_t key_sz,
                     hyperclient_returncode* status,
                     struct hyperclient_attribute** attrs, size_t* attrs_sz);
+        int64_t get_partial(const char* space, const char* key, size_t key_sz,
+                            const char* const* attrnames, size_t attrnames_sz,
+                            hyperclient_returncode* status,
+                            struct hyperclient_attribute** attrs, size_t* attrs_sz);
         int64_t put(const char* space, const char* key, size_t key_sz,
                     const struct hyperclient_attribute* attrs, size_t attrs_sz,
                     hyperclient_returncode* status);
+        int64_t multi_get(const char* space,
+                          const char* const* keys, const size_t* keys_sz, size_t num_keys,
+                          hyperclient_returncode* status,
+                          hyperclient_returncode* statuses,
+                          struct hyperclient_attribute** attrs, size_t* attrs_sz);
+        int64_t multi_put(const char* space,
+                          const char* const* keys, const size_t* keys_sz,
+                          const struct hyperclient_attribute* const* attrs,
+                          const size_t* attrs_sz, size_t num_keys,
+                          hyperclient_returncode* status,
+                          hyperclient_returncode* statuses);
         int64_t put_if_not_exist(const char* space, const char* key, size_t key_sz,
                                  const struct hyperclient_attribute* attrs, size_t attrs_sz,
                                  hyperclient_returncode* status);
@@ -827,6 +1007,11 @@ class hyperclient
                        const struct hyperclient_attribute_check* checks, size_t checks_sz,
                        enum hyperclient_returncode* status,
                        struct hyperclient_attribute** attrs, size_t* attrs_sz);
+        int64_t search_partial(const char* space,
+                               const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                               const char* const* attrnames, size_t attrnames_sz,
+                               enum hyperclient_returncode* status,
+                               struct hyperclient_attribute** attrs, size_t* attrs_sz);
         int64_t search_describe(const char* space,
                                 const struct hyperclient_attribute_check* checks, size_t checks_sz,
                                 enum hyperclient_returncode* status, const char** description);
@@ -837,12 +1022,29 @@ class hyperclient
                               bool maximize,
                               enum hyperclient_returncode* status,
                               struct hyperclient_attribute** attrs, size_t* attrs_sz);
+        int64_t sorted_search_partial(const char* space,
+                                      const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                      const char* sort_by,
+                                      uint64_t limit,
+                                      bool maximize,
+                                      const char* const* attrnames, size_t attrnames_sz,
+                                      enum hyperclient_returncode* status,
+                                      struct hyperclient_attribute** attrs, size_t* attrs_sz);
         int64_t group_del(const char* space,
                           const struct hyperclient_attribute_check* checks, size_t checks_sz,
                           enum hyperclient_returncode* status);
         int64_t count(const char* space,
                       const struct hyperclient_attribute_check* checks, size_t checks_sz,
                       enum hyperclient_returncode* status, uint64_t* result);
+        int64_t approximate_count(const char* space,
+                                  const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                  enum hyperclient_returncode* status, uint64_t* result);
+        int64_t aggregate(const char* space,
+                          const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                          const char* group_by,
+                          struct hyperclient_aggregation* aggs, size_t aggs_sz,
+                          enum hyperclient_returncode* status,
+                          struct hyperclient_attribute** group, size_t* group_sz);
         int64_t loop(int timeout, hyperclient_returncode* status);
         // Introspect things
         hyperdatatype attribute_type(const char* space, const char* name,
@@ -852,15 +1054,19 @@ class hyperclient
         class complete;
         class description;
         class pending;
+        class pending_aggregate;
         class pending_count;
         class pending_get;
         class pending_group_del;
+        class pending_multi_get;
+        class pending_multi_put;
         class pending_search;
         class pending_search_description;
         class pending_sorted_search;
         class pending_statusonly;
         class refcount;
         typedef std::map<int64_t, e::intrusive_ptr<pending> > incomplete_map_t;
+        friend class hyperdex::test_wrapper;
         friend class hyperdex::tool_wrapper;
 
     // these are the only private things that tool_wrapper should touch
@@ -872,6 +1078,31 @@ class hyperclient
 
     private:
         int64_t maintain_coord_connection(hyperclient_returncode* status);
+        // restricted selects between attrnames and every attribute
+        int64_t perform_get(const char* space, const char* key, size_t key_sz,
+                            const char* const* attrnames, size_t attrnames_sz,
+                            bool restricted,
+                            hyperclient_returncode* status,
+                            struct hyperclient_attribute** attrs, size_t* attrs_sz);
+        int64_t perform_search(const char* space,
+                               const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                               const char* const* attrnames, size_t attrnames_sz,
+                               bool restricted,
+                               enum hyperclient_returncode* status,
+                               struct hyperclient_attribute** attrs, size_t* attrs_sz);
+        int64_t perform_sorted_search(const char* space,
+                                      const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                                      const char* sort_by,
+                                      uint64_t limit,
+                                      bool maximize,
+                                      const char* const* attrnames, size_t attrnames_sz,
+                                      bool restricted,
+                                      enum hyperclient_returncode* status,
+                                      struct hyperclient_attribute** attrs, size_t* attrs_sz);
+        int64_t perform_count(const char* space,
+                              const struct hyperclient_attribute_check* checks, size_t checks_sz,
+                              bool approximate,
+                              enum hyperclient_returncode* status, uint64_t* result);
         int64_t perform_funcall1(const struct hyperclient_keyop_info* opinfo,
                                  const char* space, const char* key, size_t key_sz,
                                  const struct hyperclient_attribute_check* checks, size_t checks_sz,
@@ -895,6 +1126,10 @@ class hyperclient
                                  std::vector<hyperdex::virtual_server_id>* servers,
                                  uint16_t* aux_attrno,
                                  hyperdatatype* aux_attrtype);
+        size_t prepare_projection(const hyperdex::schema* sc,
+                                  const char* const* attrnames, size_t attrnames_sz,
+                                  hyperclient_returncode* status,
+                                  hyperdex::projection* proj);
         size_t prepare_checks(const hyperdex::schema* sc,
                               const hyperclient_attribute_check* checks, size_t checks_sz,
                               hyperclient_returncode* status,
@@ -914,6 +1149,10 @@ class hyperclient
                           size_t key_sz,
                           std::auto_ptr<e::buffer> msg,
                           e::intrusive_ptr<pending> op);
+        int64_t add_keyop(const hyperdex::virtual_server_id& vsi,
+                          std::auto_ptr<e::buffer> msg,
+                          e::intrusive_ptr<pending> op);
+        hyperdex::virtual_server_id read_target(const char* space, const char* key, size_t key_sz);
         int64_t send(e::intrusive_ptr<pending> op,
                      std::auto_ptr<e::buffer> msg);
         void killall(const hyperdex::server_id& id, hyperclient_returncode status);
@@ -925,6 +1164,9 @@ class hyperclient
         const std::auto_ptr<hyperdex::coordinator_link> m_coord;
         incomplete_map_t m_incomplete;
         std::queue<int64_t> m_complete_succeeded;
+        // Ops holding results already received from the server.  An op is
+        // queued once, and return_one requeues it while it has more.
+        std::queue<e::intrusive_ptr<pending> > m_complete_buffered;
 #ifdef _MSC_VER
         std::queue<std::shared_ptr<complete>> m_complete_failed;
 #else
@@ -933,6 +1175,7 @@ class hyperclient
         int64_t m_server_nonce;
         int64_t m_client_id;
         bool m_have_seen_config;
+        hyperclient_read_consistency m_read_consistency;
 };
 
 std::ostream&
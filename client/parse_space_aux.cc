@@ -141,6 +141,11 @@ hyperparse_free(struct hyperparse_space* s)
     {
         free_subspace_list(s->subspaces);
     }
+
+    if (s->indices)
+    {
+        free_identifier_list(s->indices);
+    }
 }
 
 struct hyperparse_space*
@@ -149,7 +154,8 @@ hyperparse_create_space(char* name,
                         struct hyperparse_attribute_list* attrs,
                         uint64_t fault_tolerance,
                         uint64_t partitioning,
-                        struct hyperparse_subspace_list* subspaces)
+                        struct hyperparse_subspace_list* subspaces,
+                        struct hyperparse_identifier_list* indices)
 {
     struct hyperparse_space* s = reinterpret_cast<struct hyperparse_space*>(malloc(sizeof(struct hyperparse_space)));
     s->name = name;
@@ -158,6 +164,7 @@ hyperparse_create_space(char* name,
     s->fault_tolerance = fault_tolerance;
     s->partitioning = partitioning;
     s->subspaces = subspaces;
+    s->indices = indices;
     return s;
 }
 
@@ -259,3 +266,23 @@ hyperparse_create_identifier_list(char* name, struct hyperparse_identifier_list*
 }
 
 } // extern "C"
+
+struct hyperparse_identifier_list*
+hyperparse_concat_identifier_list(struct hyperparse_identifier_list* head,
+                                  struct hyperparse_identifier_list* tail)
+{
+    struct hyperparse_identifier_list* tmp = head;
+
+    if (!head)
+    {
+        return tail;
+    }
+
+    while (tmp->next)
+    {
+        tmp = tmp->next;
+    }
+
+    tmp->next = tail;
+    return head;
+}
@@ -54,6 +54,7 @@ struct hyperparse_space
     uint64_t fault_tolerance;
     uint64_t partitioning;
     struct hyperparse_subspace_list* subspaces;
+    struct hyperparse_identifier_list* indices;
 };
 
 struct hyperparse_subspace_list
@@ -96,7 +97,8 @@ hyperparse_create_space(char* name,
                         struct hyperparse_attribute_list* attrs,
                         uint64_t fault_tolerance,
                         uint64_t partitioning,
-                        struct hyperparse_subspace_list* subspaces);
+                        struct hyperparse_subspace_list* subspaces,
+                        struct hyperparse_identifier_list* indices);
 
 struct hyperparse_attribute_list*
 hyperparse_create_attribute_list(struct hyperparse_attribute* attr,
@@ -115,6 +117,10 @@ hyperparse_create_subspace(struct hyperparse_identifier_list* attrs);
 struct hyperparse_identifier_list*
 hyperparse_create_identifier_list(char* name, struct hyperparse_identifier_list* list);
 
+struct hyperparse_identifier_list*
+hyperparse_concat_identifier_list(struct hyperparse_identifier_list* head,
+                                  struct hyperparse_identifier_list* tail);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif /* __cplusplus */
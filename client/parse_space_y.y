@@ -58,6 +58,7 @@ void yyerror(char* s);
 %token CREATE
 %token PARTITIONS
 %token SUBSPACE
+%token INDEX
 %token COLON
 %token COMMA
 %token OP
@@ -79,15 +80,16 @@ void yyerror(char* s);
 %type <num> partitions
 %type <subspaces> subspace_list
 %type <subspace> subspace
+%type <identifiers> index_list
 %type <identifiers> identifier_list;
 
 %%
 
 space : SPACE IDENTIFIER KEY attribute ATTRIBUTES attribute_list
-        subspace_list partitions fault_tolerance
-        { hyperparsed_space = hyperparse_create_space($2, $4, $6, $9, $8, $7); }
+        subspace_list index_list partitions fault_tolerance
+        { hyperparsed_space = hyperparse_create_space($2, $4, $6, $10, $9, $7, $8); }
       | SPACE IDENTIFIER KEY attribute partitions fault_tolerance
-        { hyperparsed_space = hyperparse_create_space($2, $4, NULL, $6, $5, NULL); };
+        { hyperparsed_space = hyperparse_create_space($2, $4, NULL, $6, $5, NULL, NULL); };
 
 fault_tolerance :                          { $$ = 2; }
                 | TOLERATE NUMBER FAILURES { $$ = $2; };
@@ -98,6 +100,9 @@ partitions :                          { $$ = 256; }
 subspace_list :                                 { $$ = NULL; }
               | subspace_list SUBSPACE subspace { $$ = hyperparse_create_subspace_list($3, $1); };
 
+index_list :                              { $$ = NULL; }
+           | index_list INDEX identifier_list { $$ = hyperparse_concat_identifier_list($1, $3); };
+
 subspace : identifier_list { $$ = hyperparse_create_subspace($1); } /*XXX*/
 
 attribute_list : attribute                      { $$ = hyperparse_create_attribute_list($1, NULL); }
@@ -0,0 +1,303 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <cstdlib>
+#include <cstring>
+
+// STL
+#include <algorithm>
+
+// HyperDex
+#include "datatypes/compare.h"
+#include "client/constants.h"
+#include "client/complete.h"
+#include "client/pending_aggregate.h"
+
+class hyperclient::pending_aggregate::state::group_less
+{
+    public:
+        group_less(hyperdatatype type) : m_type(type) {}
+
+    public:
+        bool operator () (const group_map_t::const_iterator& lhs,
+                          const group_map_t::const_iterator& rhs) const
+        {
+            e::slice l(lhs->first.data(), lhs->first.size());
+            e::slice r(rhs->first.data(), rhs->first.size());
+            return compare_as_type(l, r, m_type) < 0;
+        }
+
+    private:
+        hyperdatatype m_type;
+};
+
+hyperclient :: pending_aggregate :: pending_aggregate(int64_t aggregate_id,
+                                                      e::intrusive_ptr<state> st,
+                                                      hyperclient_returncode* status,
+                                                      hyperclient_aggregation* aggs,
+                                                      size_t aggs_sz,
+                                                      hyperclient_attribute** group,
+                                                      size_t* group_sz)
+    : pending(status)
+    , m_state(st)
+    , m_aggs(aggs)
+    , m_aggs_sz(aggs_sz)
+    , m_group(group)
+    , m_group_sz(group_sz)
+{
+    this->set_client_visible_id(aggregate_id);
+}
+
+hyperclient :: pending_aggregate :: ~pending_aggregate() throw ()
+{
+}
+
+hyperdex::network_msgtype
+hyperclient :: pending_aggregate :: request_type()
+{
+    return hyperdex::REQ_AGGREGATE;
+}
+
+int64_t
+hyperclient :: pending_aggregate :: handle_response(hyperclient* cl,
+                                                    const server_id& sender,
+                                                    std::auto_ptr<e::buffer> msg,
+                                                    hyperdex::network_msgtype type,
+                                                    hyperclient_returncode* status)
+{
+    assert(m_state->m_ref > 0);
+    *status = HYPERCLIENT_SUCCESS;
+
+    if (type != hyperdex::RESP_AGGREGATE)
+    {
+        cl->killall(sender, HYPERCLIENT_SERVERERROR);
+        return 0;
+    }
+
+    e::unpacker up = msg->unpack_from(HYPERCLIENT_HEADER_SIZE_RESP);
+    uint64_t num_groups = 0;
+    up = up >> num_groups;
+
+    if (up.error())
+    {
+        cl->killall(sender, HYPERCLIENT_SERVERERROR);
+        return 0;
+    }
+
+    if (num_groups == UINT64_MAX)
+    {
+        m_state->m_failed = true;
+        num_groups = 0;
+    }
+
+    for (uint64_t i = 0; i < num_groups; ++i)
+    {
+        e::slice group;
+        uint64_t count = 0;
+        std::vector<hyperdex::aggregate_stat> stats(m_state->m_types.size());
+        up = up >> group >> count;
+
+        for (size_t j = 0; j < stats.size(); ++j)
+        {
+            up = up >> stats[j];
+        }
+
+        if (up.error())
+        {
+            cl->killall(sender, HYPERCLIENT_SERVERERROR);
+            return 0;
+        }
+
+        std::pair<uint64_t, std::vector<hyperdex::aggregate_stat> >& grp
+            (m_state->m_groups[std::string(reinterpret_cast<const char*>(group.data()), group.size())]);
+        grp.first += count;
+        grp.second.resize(stats.size());
+
+        for (size_t j = 0; j < stats.size(); ++j)
+        {
+            grp.second[j].merge(stats[j]);
+        }
+    }
+
+    if (m_state->m_ref == 1)
+    {
+        if (m_state->m_failed)
+        {
+#ifdef _MSC_VER
+            cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SERVERERROR, 0)));
+#else
+            cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SERVERERROR, 0));
+#endif
+            return 0;
+        }
+
+        // An ungrouped aggregate over nothing still has one (empty) answer.
+        if (!m_state->m_grouped && m_state->m_groups.empty())
+        {
+            m_state->m_groups[std::string()].second.resize(m_state->m_types.size());
+        }
+
+        for (state::group_map_t::const_iterator it = m_state->m_groups.begin();
+                it != m_state->m_groups.end(); ++it)
+        {
+            m_state->m_results.push_back(it);
+        }
+
+        if (m_state->m_grouped)
+        {
+            std::sort(m_state->m_results.begin(), m_state->m_results.end(),
+                      state::group_less(m_state->m_group_type));
+        }
+
+        for (size_t i = 0; i < m_state->m_results.size(); ++i)
+        {
+            int64_t nonce = cl->m_server_nonce;
+            cl->m_incomplete.insert(std::make_pair(nonce, this));
+            cl->m_complete_succeeded.push(nonce);
+            ++cl->m_server_nonce;
+        }
+
+        if (m_state->m_results.empty())
+        {
+#ifdef _MSC_VER
+            cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+            cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
+        }
+    }
+
+    return 0;
+}
+
+int64_t
+hyperclient :: pending_aggregate :: return_one(hyperclient* cl,
+                                               hyperclient_returncode* status)
+{
+    assert(m_state->m_returned < m_state->m_results.size());
+    *status = HYPERCLIENT_SUCCESS;
+    state::group_map_t::const_iterator grp(m_state->m_results[m_state->m_returned]);
+    uint64_t count = grp->second.first;
+    const std::vector<hyperdex::aggregate_stat>& stats(grp->second.second);
+    *m_group = NULL;
+    *m_group_sz = 0;
+
+    for (size_t i = 0; i < m_aggs_sz; ++i)
+    {
+        size_t idx = m_state->m_stats[i];
+
+        switch (m_aggs[i].function)
+        {
+            case HYPERCLIENT_AGGREGATE_COUNT:
+                m_aggs[i].result = count;
+                break;
+            case HYPERCLIENT_AGGREGATE_SUM:
+                m_aggs[i].result = stats[idx].sum(m_state->m_types[idx]);
+                break;
+            case HYPERCLIENT_AGGREGATE_MIN:
+                m_aggs[i].result = stats[idx].min(m_state->m_types[idx]);
+                break;
+            case HYPERCLIENT_AGGREGATE_MAX:
+                m_aggs[i].result = stats[idx].max(m_state->m_types[idx]);
+                break;
+            case HYPERCLIENT_AGGREGATE_AVG:
+                m_aggs[i].result = stats[idx].count > 0
+                                 ? stats[idx].sum(m_state->m_types[idx]) / stats[idx].count
+                                 : 0;
+                break;
+            default:
+                abort();
+        }
+    }
+
+    set_status(HYPERCLIENT_SUCCESS);
+
+    if (m_state->m_grouped)
+    {
+        size_t name_sz = m_state->m_group_name.size() + 1;
+        size_t sz = sizeof(hyperclient_attribute) + name_sz + grp->first.size();
+        char* ret = static_cast<char*>(malloc(sz));
+
+        if (ret)
+        {
+            hyperclient_attribute ha;
+            char* data = ret + sizeof(hyperclient_attribute);
+            ha.attr = data;
+            memmove(data, m_state->m_group_name.c_str(), name_sz);
+            data += name_sz;
+            ha.value = data;
+            memmove(data, grp->first.data(), grp->first.size());
+            ha.value_sz = grp->first.size();
+            ha.datatype = m_state->m_group_type;
+            memmove(ret, &ha, sizeof(hyperclient_attribute));
+            *m_group = reinterpret_cast<hyperclient_attribute*>(ret);
+            *m_group_sz = 1;
+        }
+        else
+        {
+            *status = HYPERCLIENT_NOMEM;
+        }
+    }
+
+    ++m_state->m_returned;
+
+    if (m_state->m_returned == m_state->m_results.size())
+    {
+#ifdef _MSC_VER
+        cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+        cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
+    }
+
+    return client_visible_id();
+}
+
+hyperclient :: pending_aggregate :: state :: state(bool grouped,
+                                                   const char* group_name,
+                                                   hyperdatatype group_type,
+                                                   const std::vector<size_t>& stats,
+                                                   const std::vector<hyperdatatype>& types)
+    : m_ref(0)
+    , m_grouped(grouped)
+    , m_group_name(group_name ? group_name : "")
+    , m_group_type(group_type)
+    , m_stats(stats)
+    , m_types(types)
+    , m_groups()
+    , m_failed(false)
+    , m_results()
+    , m_returned(0)
+{
+}
+
+hyperclient :: pending_aggregate :: state :: ~state() throw ()
+{
+}
@@ -0,0 +1,121 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_client_pending_aggregate_h_
+#define hyperdex_client_pending_aggregate_h_
+
+// STL
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// HyperDex
+#include "common/aggregate.h"
+#include "client/pending.h"
+
+class hyperclient::pending_aggregate : public hyperclient::pending
+{
+    public:
+        class state;
+
+    public:
+        pending_aggregate(int64_t aggregate_id,
+                          e::intrusive_ptr<state> st,
+                          hyperclient_returncode* status,
+                          hyperclient_aggregation* aggs,
+                          size_t aggs_sz,
+                          hyperclient_attribute** group,
+                          size_t* group_sz);
+        virtual ~pending_aggregate() throw ();
+
+    public:
+        virtual hyperdex::network_msgtype request_type();
+        virtual int64_t handle_response(hyperclient* cl,
+                                        const server_id& id,
+                                        std::auto_ptr<e::buffer> msg,
+                                        hyperdex::network_msgtype type,
+                                        hyperclient_returncode* status);
+        virtual int64_t return_one(hyperclient* cl,
+                                   hyperclient_returncode* status);
+
+    private:
+        pending_aggregate(const pending_aggregate& other);
+
+    private:
+        pending_aggregate& operator = (const pending_aggregate& rhs);
+
+    private:
+        e::intrusive_ptr<state> m_state;
+        hyperclient_aggregation* m_aggs;
+        size_t m_aggs_sz;
+        hyperclient_attribute** m_group;
+        size_t* m_group_sz;
+};
+
+class hyperclient::pending_aggregate::state
+{
+    public:
+        // stats[i] is the position of the i'th aggregate's attribute among
+        // those sent to the daemons; types[j] is the type of the j'th one.
+        state(bool grouped,
+              const char* group_name,
+              hyperdatatype group_type,
+              const std::vector<size_t>& stats,
+              const std::vector<hyperdatatype>& types);
+        ~state() throw ();
+
+    private:
+        friend class e::intrusive_ptr<hyperclient::pending_aggregate::state>;
+        friend class hyperclient::pending_aggregate;
+        typedef std::map<std::string, std::pair<uint64_t, std::vector<hyperdex::aggregate_stat> > > group_map_t;
+        class group_less;
+
+    private:
+        state(const state&);
+
+    private:
+        void inc() { ++m_ref; }
+        void dec() { if (--m_ref == 0) delete this; }
+
+    private:
+        state& operator = (const state&);
+
+    private:
+        size_t m_ref;
+        const bool m_grouped;
+        const std::string m_group_name;
+        const hyperdatatype m_group_type;
+        const std::vector<size_t> m_stats;
+        const std::vector<hyperdatatype> m_types;
+        group_map_t m_groups;
+        bool m_failed;
+        std::vector<group_map_t::const_iterator> m_results;
+        size_t m_returned;
+};
+
+#endif // hyperdex_client_pending_aggregate_h_
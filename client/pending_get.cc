@@ -32,9 +32,11 @@
 #include "client/util.h"
 
 hyperclient :: pending_get :: pending_get(hyperclient_returncode* status,
+                                          const hyperdex::projection& proj,
                                           struct hyperclient_attribute** attrs,
                                           size_t* attrs_sz)
     : pending(status)
+    , m_proj(proj)
     , m_attrs(attrs)
     , m_attrs_sz(attrs_sz)
 {
@@ -112,7 +114,7 @@ hyperclient :: pending_get :: handle_response(hyperclient* cl,
     hyperclient_returncode op_status;
 
     if (!value_to_attributes(*cl->m_config, this->sent_to(), NULL, 0,
-                             value, status, &op_status, m_attrs, m_attrs_sz))
+                             value, &m_proj, status, &op_status, m_attrs, m_attrs_sz))
     {
         set_status(op_status);
         return client_visible_id();
@@ -29,12 +29,14 @@
 #define hyperdex_client_pending_get_h_
 
 // HyperDex
+#include "common/projection.h"
 #include "client/pending.h"
 
 class hyperclient::pending_get : public hyperclient::pending
 {
     public:
         pending_get(hyperclient_returncode* status,
+                    const hyperdex::projection& proj,
                     struct hyperclient_attribute** attrs,
                     size_t* attrs_sz);
         virtual ~pending_get() throw ();
@@ -54,6 +56,7 @@ class hyperclient::pending_get : public hyperclient::pending
         pending_get& operator = (const pending_get& rhs);
 
     private:
+        const hyperdex::projection m_proj;
         hyperclient_attribute** m_attrs;
         size_t* m_attrs_sz;
 };
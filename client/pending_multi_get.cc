@@ -0,0 +1,144 @@
+// Copyright (c) 2011-2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// HyperClient
+#include "common/network_returncode.h"
+#include "client/constants.h"
+#include "client/pending_multi_get.h"
+#include "client/util.h"
+
+hyperclient :: pending_multi_get :: pending_multi_get(int64_t multi_id,
+                                                      e::intrusive_ptr<refcount> ref,
+                                                      hyperclient_returncode* status,
+                                                      const std::vector<size_t>& indices,
+                                                      hyperclient_returncode* statuses,
+                                                      struct hyperclient_attribute** attrs,
+                                                      size_t* attrs_sz)
+    : pending(status)
+    , m_ref(ref)
+    , m_indices(indices)
+    , m_statuses(statuses)
+    , m_attrs(attrs)
+    , m_attrs_sz(attrs_sz)
+{
+    this->set_client_visible_id(multi_id);
+}
+
+hyperclient :: pending_multi_get :: ~pending_multi_get() throw ()
+{
+}
+
+hyperdex::network_msgtype
+hyperclient :: pending_multi_get :: request_type()
+{
+    return hyperdex::REQ_GET_BATCH;
+}
+
+int64_t
+hyperclient :: pending_multi_get :: handle_response(hyperclient* cl,
+                                                    const server_id& id,
+                                                    std::auto_ptr<e::buffer> msg,
+                                                    hyperdex::network_msgtype type,
+                                                    hyperclient_returncode* status)
+{
+    *status = HYPERCLIENT_SUCCESS;
+
+    if (type != hyperdex::RESP_GET_BATCH)
+    {
+        cl->killall(id, HYPERCLIENT_SERVERERROR);
+        return 0;
+    }
+
+    e::unpacker up = msg->unpack_from(HYPERCLIENT_HEADER_SIZE_RESP);
+    uint64_t count;
+    up = up >> count;
+
+    if (up.error() || count != m_indices.size())
+    {
+        cl->killall(id, HYPERCLIENT_SERVERERROR);
+        return 0;
+    }
+
+    for (size_t i = 0; i < m_indices.size(); ++i)
+    {
+        size_t idx = m_indices[i];
+        uint16_t response;
+        std::vector<e::slice> value;
+        up = up >> response >> value;
+
+        if (up.error())
+        {
+            cl->killall(id, HYPERCLIENT_SERVERERROR);
+            return 0;
+        }
+
+        switch (static_cast<hyperdex::network_returncode>(response))
+        {
+            case hyperdex::NET_SUCCESS:
+                break;
+            case hyperdex::NET_NOTFOUND:
+                m_statuses[idx] = HYPERCLIENT_NOTFOUND;
+                continue;
+            case hyperdex::NET_NOTUS:
+                m_statuses[idx] = HYPERCLIENT_RECONFIGURE;
+                continue;
+            case hyperdex::NET_READONLY:
+                m_statuses[idx] = HYPERCLIENT_READONLY;
+                continue;
+            case hyperdex::NET_BADDIMSPEC:
+            case hyperdex::NET_SERVERERROR:
+            case hyperdex::NET_CMPFAIL:
+            case hyperdex::NET_BADMICROS:
+            case hyperdex::NET_OVERFLOW:
+            default:
+                m_statuses[idx] = HYPERCLIENT_SERVERERROR;
+                continue;
+        }
+
+        hyperclient_returncode op_status;
+
+        if (!value_to_attributes(*cl->m_config, this->sent_to(), NULL, 0,
+                                 value, status, &op_status,
+                                 m_attrs + idx, m_attrs_sz + idx))
+        {
+            m_statuses[idx] = op_status;
+            continue;
+        }
+
+        m_statuses[idx] = HYPERCLIENT_SUCCESS;
+    }
+
+    if (m_ref->last_reference())
+    {
+        set_status(HYPERCLIENT_SUCCESS);
+        return client_visible_id();
+    }
+    else
+    {
+        return 0;
+    }
+}
@@ -25,32 +25,56 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
-// e
-#include <e/guard.h>
-
 // HyperDex
 #include "client/constants.h"
 #include "client/complete.h"
 #include "client/pending_search.h"
 #include "client/util.h"
 
+class hyperclient::pending_search::item
+{
+    public:
+        item(const e::slice& key,
+             const std::vector<e::slice>& value);
+        item(const item&);
+        ~item() throw ();
+
+    public:
+        item& operator = (const item&);
+
+    public:
+        e::slice key;
+        std::vector<e::slice> value;
+};
+
 hyperclient :: pending_search :: pending_search(int64_t searchid,
                                                 e::intrusive_ptr<refcount> ref,
                                                 hyperclient_returncode* status,
+                                                const hyperdex::projection& proj,
                                                 hyperclient_attribute** attrs,
                                                 size_t* attrs_sz)
     : pending(status)
     , m_searchid(searchid)
     , m_reqtype(hyperdex::REQ_SEARCH_START)
     , m_ref(ref)
+    , m_proj(proj)
     , m_attrs(attrs)
     , m_attrs_sz(attrs_sz)
+    , m_batches()
+    , m_items()
+    , m_outstanding(true)
+    , m_done(false)
 {
     this->set_client_visible_id(searchid);
 }
 
 hyperclient :: pending_search :: ~pending_search() throw ()
 {
+    for (std::list<batch>::iterator it = m_batches.begin();
+            it != m_batches.end(); ++it)
+    {
+        delete it->first;
+    }
 }
 
 hyperdex::network_msgtype
@@ -67,66 +91,114 @@ hyperclient :: pending_search :: handle_response(hyperclient* cl,
                                                  hyperclient_returncode* status)
 {
     *status = HYPERCLIENT_SUCCESS;
+    m_outstanding = false;
 
     if (type != hyperdex::RESP_SEARCH_ITEM && type != hyperdex::RESP_SEARCH_DONE)
     {
         cl->killall(sender, HYPERCLIENT_SERVERERROR);
+        fail(cl, HYPERCLIENT_SERVERERROR);
         return 0;
     }
 
-    // If it is a SEARCH_DONE message.
+    // If it is a SEARCH_DONE message.  Items from this or other servers may
+    // still be queued, so the SEARCHDONE goes to the back of the line.
     if (type == hyperdex::RESP_SEARCH_DONE)
     {
-        if (m_ref->last_reference())
+        bool last = m_ref->last_reference();
+        m_ref = NULL;
+        m_done = true;
+
+        if (last)
         {
-            set_status(HYPERCLIENT_SEARCHDONE);
-            return client_visible_id();
+#ifdef _MSC_VER
+            cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+#else
+            cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+#endif
         }
 
-        // Silently remove this operation
         return 0;
     }
 
-    // Otheriwise it is a SEARCH_ITEM message.
-    e::slice key;
-    std::vector<e::slice> value;
+    // Otheriwise it is a batch of SEARCH_ITEMs.
+    e::unpacker up = msg->unpack_from(HYPERCLIENT_HEADER_SIZE_RESP);
+    uint64_t num_results = 0;
+    up = up >> num_results;
+    std::list<item> items;
+
+    for (uint64_t i = 0; !up.error() && i < num_results; ++i)
+    {
+        e::slice key;
+        std::vector<e::slice> value;
+        up = up >> key >> value;
+        items.push_back(item(key, value));
+    }
 
-    if ((msg->unpack_from(HYPERCLIENT_HEADER_SIZE_RESP) >> key >> value).error())
+    if (up.error())
     {
         cl->killall(sender, HYPERCLIENT_SERVERERROR);
+        fail(cl, HYPERCLIENT_SERVERERROR);
+        return 0;
+    }
 
-        if (m_ref->last_reference())
+    // The items are handed out from m_items; only the outstanding NEXT is
+    // registered with the client, so a failed server reports this op once.
+    if (num_results > 0)
+    {
+        if (m_items.empty())
         {
-#ifdef _MSC_VER
-            cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
-#else
-            cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
-#endif
+            cl->m_complete_buffered.push(this);
         }
 
-        return 0;
+        m_batches.push_back(batch(msg.get(), num_results));
+        msg.release();
+        m_items.splice(m_items.end(), items);
     }
 
+    maybe_send_next(cl);
+    return 0;
+}
+
+int64_t
+hyperclient :: pending_search :: return_one(hyperclient* cl,
+                                            hyperclient_returncode* status)
+{
+    assert(!m_items.empty());
+    assert(!m_batches.empty());
     hyperclient_returncode op_status;
+    const item& i(m_items.front());
 
-    if (!value_to_attributes(*cl->m_config, this->sent_to(), key.data(), key.size(),
-                             value, status, &op_status, m_attrs, m_attrs_sz))
+    if (value_to_attributes(*cl->m_config, this->sent_to(), i.key.data(), i.key.size(),
+                            i.value, &m_proj, status, &op_status, m_attrs, m_attrs_sz))
+    {
+        set_status(HYPERCLIENT_SUCCESS);
+    }
+    else
     {
         set_status(op_status);
+    }
 
-        if (m_ref->last_reference())
-        {
-#ifdef _MSC_VER
-            cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
-#else
-            cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
-#endif
-        }
+    m_items.pop_front();
+    --m_batches.front().second;
 
-        return client_visible_id();
+    if (m_batches.front().second == 0)
+    {
+        delete m_batches.front().first;
+        m_batches.pop_front();
     }
 
-    e::guard g = e::makeguard(hyperclient_destroy_attrs, *m_attrs, *m_attrs_sz);
+    if (!m_items.empty())
+    {
+        cl->m_complete_buffered.push(this);
+    }
+
+    maybe_send_next(cl);
+    return client_visible_id();
+}
+
+bool
+hyperclient :: pending_search :: send_next(hyperclient* cl)
+{
     std::auto_ptr<e::buffer> smsg(e::buffer::create(HYPERCLIENT_HEADER_SIZE_REQ + sizeof(uint64_t)));
     smsg->pack_at(HYPERCLIENT_HEADER_SIZE_REQ) << static_cast<uint64_t>(m_searchid);
 
@@ -136,22 +208,73 @@ hyperclient :: pending_search :: handle_response(hyperclient* cl,
 
     if (cl->send(this, smsg) < 0)
     {
-        cl->killall(sender, HYPERCLIENT_RECONFIGURE);
+        return false;
+    }
+
+    cl->m_incomplete.insert(std::make_pair(server_visible_nonce(), this));
+    m_outstanding = true;
+    return true;
+}
+
+void
+hyperclient :: pending_search :: maybe_send_next(hyperclient* cl)
+{
+    // Keep at most one batch in flight, and fetch it as soon as the
+    // application starts draining the last batch we have buffered.  This
+    // overlaps the round trip with the application's own work while bounding
+    // the client's memory to roughly two batches per server.
+    if (m_done || m_outstanding || m_batches.size() > 1)
+    {
+        return;
+    }
+
+    if (!send_next(cl))
+    {
+        cl->killall(cl->m_config->get_server_id(sent_to()), HYPERCLIENT_RECONFIGURE);
+        fail(cl, HYPERCLIENT_RECONFIGURE);
+    }
+}
+
+// Report the failure once, after any items already buffered.  This op is
+// unregistered at this point, so killall will not report it again.
+void
+hyperclient :: pending_search :: fail(hyperclient* cl, hyperclient_returncode why)
+{
+    if (m_done)
+    {
+        return;
+    }
 
-        if (m_ref->last_reference())
-        {
 #ifdef _MSC_VER
-            cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0)));
+    cl->m_complete_failed.push(std::shared_ptr<complete>(new complete(client_visible_id(), status_ptr(), why, 0)));
 #else
-            cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), HYPERCLIENT_SEARCHDONE, 0));
+    cl->m_complete_failed.push(complete(client_visible_id(), status_ptr(), why, 0));
 #endif
-        }
+    m_ref = NULL;
+    m_done = true;
+}
 
-        return 0;
-    }
+hyperclient :: pending_search :: item :: item(const e::slice& _key,
+                                              const std::vector<e::slice>& _value)
+    : key(_key)
+    , value(_value)
+{
+}
 
-    cl->m_incomplete.insert(std::make_pair(server_visible_nonce(), this));
-    set_status(HYPERCLIENT_SUCCESS);
-    g.dismiss();
-    return client_visible_id();
+hyperclient :: pending_search :: item :: item(const item& other)
+    : key(other.key)
+    , value(other.value)
+{
+}
+
+hyperclient :: pending_search :: item :: ~item() throw ()
+{
+}
+
+hyperclient::pending_search::item&
+hyperclient :: pending_search :: item :: operator = (const item& other)
+{
+    key = other.key;
+    value = other.value;
+    return *this;
 }
@@ -29,6 +29,7 @@
 #define hyperdex_client_pending_search_h_
 
 // STL
+#include <list>
 #ifdef _MSC_VER
 #include <memory>
 #else
@@ -36,6 +37,7 @@
 #endif
 
 // HyperDex
+#include "common/projection.h"
 #include "client/pending.h"
 #include "client/refcount.h"
 
@@ -45,6 +47,7 @@ class hyperclient::pending_search : public hyperclient::pending
         pending_search(int64_t searchid,
                        e::intrusive_ptr<refcount> ref,
                        hyperclient_returncode* status,
+                       const hyperdex::projection& proj,
                        hyperclient_attribute** attrs,
                        size_t* attrs_sz);
         virtual ~pending_search() throw ();
@@ -56,6 +59,12 @@ class hyperclient::pending_search : public hyperclient::pending
                                         std::auto_ptr<e::buffer> msg,
                                         hyperdex::network_msgtype type,
                                         hyperclient_returncode* status);
+        virtual int64_t return_one(hyperclient* cl,
+                                   hyperclient_returncode* status);
+
+    private:
+        class item;
+        typedef std::pair<e::buffer*, uint64_t> batch;
 
     private:
         pending_search(const pending_search& other);
@@ -63,12 +72,24 @@ class hyperclient::pending_search : public hyperclient::pending
     private:
         pending_search& operator = (const pending_search& rhs);
 
+    private:
+        bool send_next(hyperclient* cl);
+        void maybe_send_next(hyperclient* cl);
+        void fail(hyperclient* cl, hyperclient_returncode why);
+
     private:
         int64_t m_searchid;
         hyperdex::network_msgtype m_reqtype;
         e::intrusive_ptr<refcount> m_ref;
+        const hyperdex::projection m_proj;
         hyperclient_attribute** m_attrs;
         size_t* m_attrs_sz;
+        // Each batch is a RESP_SEARCH_ITEM message and the number of its
+        // items not yet returned to the application.
+        std::list<batch> m_batches;
+        std::list<item> m_items;
+        bool m_outstanding;
+        bool m_done;
 };
 
 #endif // hyperdex_client_pending_search_h_
@@ -117,7 +117,7 @@ hyperclient :: pending_sorted_search :: handle_response(hyperclient* cl,
         std::vector<e::slice> value;
         up = up >> key >> value;
 
-        if (up.error())
+        if (up.error() || (m_state->m_sort_by != 0 && value.size() <= m_state->m_sort_idx))
         {
             cl->killall(sender, HYPERCLIENT_SERVERERROR);
             return 0;
@@ -171,7 +171,7 @@ hyperclient :: pending_sorted_search :: return_one(hyperclient* cl,
     std::vector<e::slice>& value(m_state->m_results[m_state->m_returned].value);
 
     if (value_to_attributes(*cl->m_config, this->sent_to(), key.data(), key.size(),
-                            value, status, &op_status, m_attrs, m_attrs_sz))
+                            value, &m_state->m_proj, status, &op_status, m_attrs, m_attrs_sz))
     {
         set_status(HYPERCLIENT_SUCCESS);
     }
@@ -243,8 +243,8 @@ hyperclient :: pending_sorted_search :: state :: item :: operator < (const item&
     }
     else
     {
-        cmp = compare_as_type(lhs.value[st->m_sort_by - 1],
-                              rhs.value[st->m_sort_by - 1],
+        cmp = compare_as_type(lhs.value[st->m_sort_idx],
+                              rhs.value[st->m_sort_idx],
                               st->m_sort_type);
     }
 
@@ -271,8 +271,8 @@ hyperclient :: pending_sorted_search :: state :: item :: operator > (const item&
     }
     else
     {
-        cmp = compare_as_type(lhs.value[st->m_sort_by - 1],
-                              rhs.value[st->m_sort_by - 1],
+        cmp = compare_as_type(lhs.value[st->m_sort_idx],
+                              rhs.value[st->m_sort_idx],
                               st->m_sort_type);
     }
 
@@ -290,12 +290,16 @@ hyperclient :: pending_sorted_search :: state :: state(std::auto_ptr<e::buffer>*
                                                        uint64_t _limit,
                                                        uint16_t _sort_by,
                                                        hyperdatatype type,
-                                                       bool maximize)
+                                                       bool maximize,
+                                                       const hyperdex::projection& proj,
+                                                       size_t sort_idx)
     : m_ref(0)
     , m_limit(_limit)
     , m_sort_by(_sort_by)
     , m_sort_type(type)
     , m_maximize(maximize)
+    , m_proj(proj)
+    , m_sort_idx(sort_idx)
     , m_results()
     , m_backings(backings)
     , m_backing_idx(0)
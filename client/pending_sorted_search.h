@@ -36,6 +36,7 @@
 #endif
 
 // HyperDex
+#include "common/projection.h"
 #include "client/pending.h"
 
 class hyperclient::pending_sorted_search : public hyperclient::pending
@@ -76,9 +77,13 @@ class hyperclient::pending_sorted_search : public hyperclient::pending
 class hyperclient::pending_sorted_search::state
 {
     public:
+        // results hold the attributes of proj, then the sort attribute at
+        // sort_idx if proj does not include it
         state(std::auto_ptr<e::buffer>* backings,
               uint64_t limit, uint16_t sort_by,
-              hyperdatatype type, bool maximize);
+              hyperdatatype type, bool maximize,
+              const hyperdex::projection& proj,
+              size_t sort_idx);
         ~state() throw ();
 
     private:
@@ -102,6 +107,8 @@ class hyperclient::pending_sorted_search::state
         const uint16_t m_sort_by;
         hyperdatatype m_sort_type;
         bool m_maximize;
+        const hyperdex::projection m_proj;
+        const size_t m_sort_idx;
         std::vector<item> m_results;
         std::auto_ptr<e::buffer>* m_backings;
         size_t m_backing_idx;
@@ -82,6 +82,7 @@ cdef extern from "../../hyperdex.h":
         HYPERPREDICATE_EQUALS        = 9729
         HYPERPREDICATE_LESS_EQUAL    = 9730
         HYPERPREDICATE_GREATER_EQUAL = 9731
+        HYPERPREDICATE_CONTAINS      = 9733
 
 cdef extern from "../hyperclient.h":
 
@@ -142,6 +143,7 @@ cdef extern from "../hyperclient.h":
     void hyperclient_destroy(hyperclient* client)
     hyperclient_returncode hyperclient_add_space(hyperclient* client, char* space)
     hyperclient_returncode hyperclient_rm_space(hyperclient* client, char* space)
+    hyperclient_returncode hyperclient_add_index(hyperclient* client, char* space, char* attr)
     int64_t hyperclient_get(hyperclient* client, char* space, char* key, size_t key_sz, hyperclient_returncode* status, hyperclient_attribute** attrs, size_t* attrs_sz)
     int64_t hyperclient_put(hyperclient* client, char* space, char* key, size_t key_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
     int64_t hyperclient_put_if_not_exist(hyperclient* client, char* space, char* key, size_t key_sz, hyperclient_attribute* attrs, size_t attrs_sz, hyperclient_returncode* status)
@@ -1204,6 +1206,14 @@ cdef class GreaterEqual(Predicate):
         Predicate.__init__(self, [(HYPERPREDICATE_GREATER_EQUAL, lower)])
 
 
+cdef class Contains(Predicate):
+
+    def __init__(self, elem):
+        if type(elem) not in (bytes, int, long, float):
+            raise AttributeError("Contains must be a byte, int, or float")
+        Predicate.__init__(self, [(HYPERPREDICATE_CONTAINS, elem)])
+
+
 cdef class Client:
     cdef hyperclient* _client
     cdef dict _ops
@@ -1226,6 +1236,11 @@ cdef class Client:
         if rc != HYPERCLIENT_SUCCESS:
             raise HyperClientException(rc)
 
+    def add_index(self, bytes space, bytes attr):
+        cdef hyperclient_returncode rc = hyperclient_add_index(self._client, space, attr)
+        if rc != HYPERCLIENT_SUCCESS:
+            raise HyperClientException(rc)
+
     def get(self, bytes space, key):
         async = self.async_get(space, key)
         return async.wait()
@@ -110,6 +110,18 @@ hyperdex :: space_description_to_space(const char* description, space* ret)
         }
     }
 
+    for (hyperparse_identifier_list* i = parsed->indices; i; i = i->next)
+    {
+        uint16_t attr = sc.lookup_attr(i->name);
+
+        if (attr == sc.attrs_sz)
+        {
+            return false;
+        }
+
+        sp.indices.push_back(attr);
+    }
+
     sp.fault_tolerance = parsed->fault_tolerance;
 
     if (!sp.validate())
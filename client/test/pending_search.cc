@@ -0,0 +1,275 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// STL
+#include <memory>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// po6
+#include <po6/net/location.h>
+
+// e
+#include <e/buffer.h>
+
+// HyperDex
+#include "common/configuration.h"
+#include "common/hyperspace.h"
+#include "common/network_msgtype.h"
+#include "common/serialization.h"
+#include "client/constants.h"
+#include "client/hyperclient.h"
+#include "client/pending_search.h"
+#include "client/refcount.h"
+
+#pragma GCC diagnostic ignored "-Wswitch-default"
+
+using hyperdex::configuration;
+using hyperdex::region;
+using hyperdex::region_id;
+using hyperdex::replica;
+using hyperdex::schema;
+using hyperdex::server_id;
+using hyperdex::space;
+using hyperdex::subspace_id;
+using hyperdex::virtual_server_id;
+using hyperdex::operator <<;
+using hyperdex::pack_size;
+
+namespace hyperdex
+{
+
+// Reaches into the client the way a search's responses would.  The server has
+// no address, so every send to it fails.
+class test_wrapper
+{
+    public:
+        test_wrapper(hyperclient* h) : m_h(h), m_ops() {}
+        ~test_wrapper() throw () {}
+
+    public:
+        bool configure();
+        // start a search, as if its first request were in flight
+        size_t search(int64_t searchid,
+                      hyperclient_returncode* status,
+                      hyperclient_attribute** attrs,
+                      size_t* attrs_sz);
+        // what hyperclient::loop does with a response to the search
+        int64_t respond(size_t op, std::auto_ptr<e::buffer> msg);
+        void release() { m_ops.clear(); }
+        void killall(hyperclient_returncode status)
+        { m_h->killall(server_id(1), status); }
+
+    private:
+        test_wrapper(const test_wrapper&);
+        test_wrapper& operator = (const test_wrapper&);
+
+    private:
+        hyperclient* m_h;
+        std::vector<e::intrusive_ptr<hyperclient::pending> > m_ops;
+};
+
+} // namespace hyperdex
+
+using hyperdex::test_wrapper;
+
+bool
+test_wrapper :: configure()
+{
+    hyperdex::attribute attrs[3];
+    attrs[0] = hyperdex::attribute("k", HYPERDATATYPE_STRING);
+    attrs[1] = hyperdex::attribute("a", HYPERDATATYPE_STRING);
+    attrs[2] = hyperdex::attribute("b", HYPERDATATYPE_STRING);
+    schema sc;
+    sc.attrs_sz = 3;
+    sc.attrs = attrs;
+    space s("kv", sc);
+    s.id = hyperdex::space_id(1);
+    s.subspaces.resize(1);
+    s.subspaces[0].id = subspace_id(2);
+    s.subspaces[0].attrs.push_back(0);
+    s.subspaces[0].regions.resize(1);
+    s.subspaces[0].regions[0].id = region_id(3);
+    s.subspaces[0].regions[0].lower_coord.push_back(0);
+    s.subspaces[0].regions[0].upper_coord.push_back(UINT64_MAX);
+    s.subspaces[0].regions[0].replicas.push_back(replica(server_id(1), virtual_server_id(4)));
+
+    size_t sz = 6 * sizeof(uint64_t)
+              + sizeof(uint64_t) + pack_size(po6::net::location())
+              + pack_size(s);
+    std::auto_ptr<e::buffer> buf(e::buffer::create(sz));
+    e::buffer::packer pa = buf->pack_at(0);
+    pa = pa << uint64_t(1) << uint64_t(1)
+            << uint64_t(1) << uint64_t(1)
+            << uint64_t(0) << uint64_t(0)
+            << uint64_t(1) << po6::net::location()
+            << s;
+    e::unpacker up = buf->unpack_from(0);
+    up = up >> *m_h->m_config;
+    return !up.error();
+}
+
+size_t
+test_wrapper :: search(int64_t searchid,
+                       hyperclient_returncode* status,
+                       hyperclient_attribute** attrs,
+                       size_t* attrs_sz)
+{
+    e::intrusive_ptr<hyperclient::refcount> ref(new hyperclient::refcount());
+    e::intrusive_ptr<hyperclient::pending> op;
+    op = new hyperclient::pending_search(searchid, ref, status, hyperdex::projection(), attrs, attrs_sz);
+    op->set_sent_to(virtual_server_id(4));
+    op->set_server_visible_nonce(m_h->m_server_nonce);
+    ++m_h->m_server_nonce;
+    m_h->m_incomplete.insert(std::make_pair(op->server_visible_nonce(), op));
+    m_ops.push_back(op);
+    return m_ops.size() - 1;
+}
+
+int64_t
+test_wrapper :: respond(size_t idx, std::auto_ptr<e::buffer> msg)
+{
+    e::intrusive_ptr<hyperclient::pending> op = m_ops[idx];
+    hyperclient_returncode status;
+    m_h->m_incomplete.erase(op->server_visible_nonce());
+    return op->handle_response(m_h, server_id(1), msg, hyperdex::RESP_SEARCH_ITEM, &status);
+}
+
+namespace
+{
+
+std::auto_ptr<e::buffer>
+batch(uint64_t num_results)
+{
+    e::slice key("key", 3);
+    std::vector<e::slice> value(2, e::slice("value", 5));
+    size_t sz = HYPERCLIENT_HEADER_SIZE_RESP
+              + sizeof(uint64_t)
+              + num_results * (pack_size(key) + pack_size(value));
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    e::buffer::packer pa = msg->pack_at(HYPERCLIENT_HEADER_SIZE_RESP);
+    pa = pa << num_results;
+
+    for (uint64_t i = 0; i < num_results; ++i)
+    {
+        pa = pa << key << value;
+    }
+
+    return msg;
+}
+
+// Drain the client, counting the search's items and its failures.
+void
+drain(hyperclient* h, int64_t searchid,
+      hyperclient_returncode* status,
+      hyperclient_attribute** attrs,
+      size_t* attrs_sz,
+      size_t* items,
+      size_t* failures)
+{
+    *items = 0;
+    *failures = 0;
+
+    while (true)
+    {
+        hyperclient_returncode lstatus;
+        int64_t id = h->loop(-1, &lstatus);
+
+        if (id < 0)
+        {
+            ASSERT_EQ(HYPERCLIENT_NONEPENDING, lstatus);
+            return;
+        }
+
+        ASSERT_EQ(searchid, id);
+
+        if (*status == HYPERCLIENT_SUCCESS)
+        {
+            ASSERT_EQ(3U, *attrs_sz);
+            hyperclient_destroy_attrs(*attrs, *attrs_sz);
+            ++*items;
+        }
+        else
+        {
+            ++*failures;
+        }
+    }
+}
+
+// The NEXT that follows the batch cannot be sent.  The buffered items are
+// still returned, followed by exactly one failure for the search.
+TEST(PendingSearch, SendFailsWhileBuffered)
+{
+    hyperclient h("127.0.0.1", 1982);
+    test_wrapper t(&h);
+    ASSERT_TRUE(t.configure());
+    hyperclient_returncode status;
+    hyperclient_attribute* attrs = NULL;
+    size_t attrs_sz = 0;
+    size_t op = t.search(42, &status, &attrs, &attrs_sz);
+    ASSERT_EQ(0, t.respond(op, batch(5)));
+    t.release();
+    t.killall(HYPERCLIENT_RECONFIGURE);
+    size_t items;
+    size_t failures;
+    drain(&h, 42, &status, &attrs, &attrs_sz, &items, &failures);
+    ASSERT_EQ(5U, items);
+    ASSERT_EQ(1U, failures);
+}
+
+// A malformed batch fails the search once, and a second search on the same
+// server is failed once by the killall.
+TEST(PendingSearch, BadBatch)
+{
+    hyperclient h("127.0.0.1", 1982);
+    test_wrapper t(&h);
+    ASSERT_TRUE(t.configure());
+    hyperclient_returncode status1;
+    hyperclient_returncode status2;
+    hyperclient_attribute* attrs = NULL;
+    size_t attrs_sz = 0;
+    size_t op = t.search(42, &status1, &attrs, &attrs_sz);
+    t.search(43, &status2, &attrs, &attrs_sz);
+    std::auto_ptr<e::buffer> msg(batch(3));
+    msg->resize(msg->size() - 1);
+    ASSERT_EQ(0, t.respond(op, msg));
+    t.release();
+
+    hyperclient_returncode lstatus;
+    ASSERT_EQ(43, h.loop(-1, &lstatus));
+    ASSERT_EQ(HYPERCLIENT_SERVERERROR, status2);
+    ASSERT_EQ(42, h.loop(-1, &lstatus));
+    ASSERT_EQ(HYPERCLIENT_SERVERERROR, status1);
+    ASSERT_EQ(-1, h.loop(-1, &lstatus));
+    ASSERT_EQ(HYPERCLIENT_NONEPENDING, lstatus);
+}
+
+} // namespace
@@ -43,26 +43,63 @@ value_to_attributes(const hyperdex::configuration& config,
                     hyperclient_returncode* op_status,
                     hyperclient_attribute** attrs,
                     size_t* attrs_sz)
+{
+    return value_to_attributes(config, id, key, key_sz, value, NULL,
+                               loop_status, op_status, attrs, attrs_sz);
+}
+
+bool
+value_to_attributes(const hyperdex::configuration& config,
+                    const hyperdex::virtual_server_id& id,
+                    const uint8_t* key,
+                    size_t key_sz,
+                    const std::vector<e::slice>& value,
+                    const hyperdex::projection* proj,
+                    hyperclient_returncode* loop_status,
+                    hyperclient_returncode* op_status,
+                    hyperclient_attribute** attrs,
+                    size_t* attrs_sz)
 {
     *loop_status = HYPERCLIENT_SUCCESS;
     const hyperdex::schema* sc = config.get_schema(config.get_region_id(id));
+    // the attribute number of each of value's entries that is returned
+    std::vector<uint16_t> nums;
 
-    if (value.size() + 1 != sc->attrs_sz)
+    if (proj && proj->restricted)
     {
-        *op_status = HYPERCLIENT_SERVERERROR;
-        return false;
+        if (value.size() < proj->attrs.size() || !proj->validate(*sc))
+        {
+            *op_status = HYPERCLIENT_SERVERERROR;
+            return false;
+        }
+
+        nums = proj->attrs;
+    }
+    else
+    {
+        if (value.size() + 1 != sc->attrs_sz)
+        {
+            *op_status = HYPERCLIENT_SERVERERROR;
+            return false;
+        }
+
+        for (size_t i = 0; i < value.size(); ++i)
+        {
+            nums.push_back(i + 1);
+        }
     }
 
-    size_t sz = sizeof(hyperclient_attribute) * sc->attrs_sz + key_sz
+    size_t num_attrs = nums.size() + (key ? 1 : 0);
+    size_t sz = sizeof(hyperclient_attribute) * num_attrs + key_sz
               + strlen(sc->attrs[0].name) + 1;
 
-    for (size_t i = 0; i < value.size(); ++i)
+    for (size_t i = 0; i < nums.size(); ++i)
     {
-        sz += strlen(sc->attrs[i + 1].name) + 1 + value[i].size();
+        sz += strlen(sc->attrs[nums[i]].name) + 1 + value[i].size();
     }
 
     std::vector<hyperclient_attribute> ha;
-    ha.reserve(sc->attrs_sz);
+    ha.reserve(num_attrs);
     char* ret = static_cast<char*>(malloc(sz));
 
     if (!ret)
@@ -72,11 +109,10 @@ value_to_attributes(const hyperdex::configuration& config,
     }
 
     e::guard g = e::makeguard(free, ret);
-    char* data = ret + sizeof(hyperclient_attribute) * value.size();
+    char* data = ret + sizeof(hyperclient_attribute) * num_attrs;
 
     if (key)
     {
-        data += sizeof(hyperclient_attribute);
         ha.push_back(hyperclient_attribute());
         size_t attr_sz = strlen(sc->attrs[0].name) + 1;
         ha.back().attr = data;
@@ -89,21 +125,25 @@ value_to_attributes(const hyperdex::configuration& config,
         ha.back().datatype = sc->attrs[0].type;
     }
 
-    for (size_t i = 0; i < value.size(); ++i)
+    for (size_t i = 0; i < nums.size(); ++i)
     {
         ha.push_back(hyperclient_attribute());
-        size_t attr_sz = strlen(sc->attrs[i + 1].name) + 1;
+        size_t attr_sz = strlen(sc->attrs[nums[i]].name) + 1;
         ha.back().attr = data;
-        memmove(data, sc->attrs[i + 1].name, attr_sz);
+        memmove(data, sc->attrs[nums[i]].name, attr_sz);
         data += attr_sz;
         ha.back().value = data;
         memmove(data, value[i].data(), value[i].size());
         data += value[i].size();
         ha.back().value_sz = value[i].size();
-        ha.back().datatype = sc->attrs[i + 1].type;
+        ha.back().datatype = sc->attrs[nums[i]].type;
+    }
+
+    if (!ha.empty())
+    {
+        memmove(ret, &ha.front(), sizeof(hyperclient_attribute) * ha.size());
     }
 
-    memmove(ret, &ha.front(), sizeof(hyperclient_attribute) * ha.size());
     *op_status = HYPERCLIENT_SUCCESS;
     *attrs = reinterpret_cast<hyperclient_attribute*>(ret);
     *attrs_sz = ha.size();
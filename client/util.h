@@ -31,6 +31,7 @@
 // HyperDex
 #include "common/configuration.h"
 #include "common/ids.h"
+#include "common/projection.h"
 #include "client/hyperclient.h"
 
 // Convert the key and value vector returned by entity to an array of
@@ -45,5 +46,18 @@ value_to_attributes(const hyperdex::configuration& config,
                     hyperclient_returncode* op_status,
                     hyperclient_attribute** attrs,
                     size_t* attrs_sz);
+// As above, but value holds the attributes of proj (and perhaps more after
+// them, which are ignored) if proj is restricted.
+bool
+value_to_attributes(const hyperdex::configuration& config,
+                    const hyperdex::virtual_server_id& id,
+                    const uint8_t* key,
+                    size_t key_sz,
+                    const std::vector<e::slice>& value,
+                    const hyperdex::projection* proj,
+                    hyperclient_returncode* loop_status,
+                    hyperclient_returncode* op_status,
+                    hyperclient_attribute** attrs,
+                    size_t* attrs_sz);
 
 #endif // hyperdex_client_util_h_
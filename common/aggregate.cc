@@ -0,0 +1,229 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <math.h>
+#include <string.h>
+
+// STL
+#include <algorithm>
+
+// e
+#include <e/endian.h>
+
+// HyperDex
+#include "common/aggregate.h"
+
+using hyperdex::aggregate_stat;
+
+aggregate_stat :: aggregate_stat()
+    : count(0)
+    , int_sum_lo(0)
+    , int_sum_hi(0)
+    , int_min(0)
+    , int_max(0)
+    , float_sum(0)
+    , float_min(0)
+    , float_max(0)
+{
+}
+
+aggregate_stat :: aggregate_stat(const aggregate_stat& other)
+    : count(other.count)
+    , int_sum_lo(other.int_sum_lo)
+    , int_sum_hi(other.int_sum_hi)
+    , int_min(other.int_min)
+    , int_max(other.int_max)
+    , float_sum(other.float_sum)
+    , float_min(other.float_min)
+    , float_max(other.float_max)
+{
+}
+
+aggregate_stat :: ~aggregate_stat() throw ()
+{
+}
+
+// (*hi:*lo) += (xhi:xlo), wrapping as unsigned so the high word never hits
+// signed overflow
+static void
+add128(uint64_t* lo, int64_t* hi, uint64_t xlo, int64_t xhi)
+{
+    uint64_t sum = *lo + xlo;
+    uint64_t carry = sum < xlo ? 1 : 0;
+    *lo = sum;
+    *hi = static_cast<int64_t>(static_cast<uint64_t>(*hi) + static_cast<uint64_t>(xhi) + carry);
+}
+
+void
+aggregate_stat :: add(hyperdatatype type, const e::slice& value)
+{
+    if (type == HYPERDATATYPE_INT64)
+    {
+        int64_t x = 0;
+
+        if (value.size() == sizeof(int64_t))
+        {
+            e::unpack64le(value.data(), &x);
+        }
+
+        add128(&int_sum_lo, &int_sum_hi, static_cast<uint64_t>(x), x < 0 ? -1 : 0);
+        int_min = count == 0 ? x : std::min(int_min, x);
+        int_max = count == 0 ? x : std::max(int_max, x);
+    }
+    else if (type == HYPERDATATYPE_FLOAT)
+    {
+        double x = 0;
+
+        if (value.size() == sizeof(double))
+        {
+            e::unpackdoublele(value.data(), &x);
+        }
+
+        float_sum += x;
+        float_min = count == 0 ? x : std::min(float_min, x);
+        float_max = count == 0 ? x : std::max(float_max, x);
+    }
+
+    ++count;
+}
+
+void
+aggregate_stat :: merge(const aggregate_stat& other)
+{
+    if (other.count == 0)
+    {
+        return;
+    }
+
+    if (count == 0)
+    {
+        *this = other;
+        return;
+    }
+
+    count += other.count;
+    add128(&int_sum_lo, &int_sum_hi, other.int_sum_lo, other.int_sum_hi);
+    int_min = std::min(int_min, other.int_min);
+    int_max = std::max(int_max, other.int_max);
+    float_sum += other.float_sum;
+    float_min = std::min(float_min, other.float_min);
+    float_max = std::max(float_max, other.float_max);
+}
+
+double
+aggregate_stat :: sum(hyperdatatype type) const
+{
+    if (type != HYPERDATATYPE_INT64)
+    {
+        return float_sum;
+    }
+
+    int64_t lo = static_cast<int64_t>(int_sum_lo);
+
+    // the common case fits in 64 bits; adding the words separately would
+    // round small negative sums to zero
+    if (int_sum_hi == (lo < 0 ? -1 : 0))
+    {
+        return static_cast<double>(lo);
+    }
+
+    return ldexp(static_cast<double>(int_sum_hi), 64) + static_cast<double>(int_sum_lo);
+}
+
+double
+aggregate_stat :: min(hyperdatatype type) const
+{
+    return type == HYPERDATATYPE_INT64 ? int_min : float_min;
+}
+
+double
+aggregate_stat :: max(hyperdatatype type) const
+{
+    return type == HYPERDATATYPE_INT64 ? int_max : float_max;
+}
+
+aggregate_stat&
+aggregate_stat :: operator = (const aggregate_stat& rhs)
+{
+    count = rhs.count;
+    int_sum_lo = rhs.int_sum_lo;
+    int_sum_hi = rhs.int_sum_hi;
+    int_min = rhs.int_min;
+    int_max = rhs.int_max;
+    float_sum = rhs.float_sum;
+    float_min = rhs.float_min;
+    float_max = rhs.float_max;
+    return *this;
+}
+
+static uint64_t
+double_bits(double d)
+{
+    uint64_t x;
+    memmove(&x, &d, sizeof(x));
+    return x;
+}
+
+static double
+bits_double(uint64_t x)
+{
+    double d;
+    memmove(&d, &x, sizeof(d));
+    return d;
+}
+
+e::buffer::packer
+hyperdex :: operator << (e::buffer::packer pa, const aggregate_stat& as)
+{
+    return pa << as.count << as.int_sum_lo << as.int_sum_hi
+              << as.int_min << as.int_max
+              << double_bits(as.float_sum)
+              << double_bits(as.float_min)
+              << double_bits(as.float_max);
+}
+
+e::unpacker
+hyperdex :: operator >> (e::unpacker up, aggregate_stat& as)
+{
+    uint64_t fsum;
+    uint64_t fmin;
+    uint64_t fmax;
+    up = up >> as.count >> as.int_sum_lo >> as.int_sum_hi
+            >> as.int_min >> as.int_max
+            >> fsum >> fmin >> fmax;
+    as.float_sum = bits_double(fsum);
+    as.float_min = bits_double(fmin);
+    as.float_max = bits_double(fmax);
+    return up;
+}
+
+size_t
+hyperdex :: pack_size(const aggregate_stat&)
+{
+    return 8 * sizeof(uint64_t);
+}
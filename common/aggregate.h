@@ -0,0 +1,83 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_common_aggregate_h_
+#define hyperdex_common_aggregate_h_
+
+// e
+#include <e/buffer.h>
+#include <e/slice.h>
+
+// HyperDex
+#include "hyperdex.h"
+
+namespace hyperdex
+{
+
+// The count, sum, min and max of an int64 or float attribute over a set of
+// objects.  Daemons build one per attribute and group from the objects of a
+// region; clients merge those of every region.  Integer sums are kept as
+// 128-bit two's complement (int_sum_hi:int_sum_lo), so they cannot wrap and
+// stay exact until they are read out as doubles.
+class aggregate_stat
+{
+    public:
+        aggregate_stat();
+        aggregate_stat(const aggregate_stat&);
+        ~aggregate_stat() throw ();
+
+    public:
+        void add(hyperdatatype type, const e::slice& value);
+        void merge(const aggregate_stat& other);
+        double sum(hyperdatatype type) const;
+        double min(hyperdatatype type) const;
+        double max(hyperdatatype type) const;
+
+    public:
+        aggregate_stat& operator = (const aggregate_stat&);
+
+    public:
+        uint64_t count;
+        uint64_t int_sum_lo;
+        int64_t int_sum_hi;
+        int64_t int_min;
+        int64_t int_max;
+        double float_sum;
+        double float_min;
+        double float_max;
+};
+
+e::buffer::packer
+operator << (e::buffer::packer, const aggregate_stat& as);
+e::unpacker
+operator >> (e::unpacker, aggregate_stat& as);
+size_t
+pack_size(const aggregate_stat& as);
+
+} // namespace hyperdex
+
+#endif // hyperdex_common_aggregate_h_
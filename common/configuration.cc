@@ -39,6 +39,7 @@
 
 using hyperdex::capture_id;
 using hyperdex::configuration;
+using hyperdex::region;
 using hyperdex::region_id;
 using hyperdex::schema;
 using hyperdex::server_id;
@@ -46,6 +47,13 @@ using hyperdex::subspace;
 using hyperdex::subspace_id;
 using hyperdex::virtual_server_id;
 
+static bool
+compare_space_names(const std::pair<const char*, const hyperdex::space*>& lhs,
+                    const std::pair<const char*, const hyperdex::space*>& rhs)
+{
+    return strcmp(lhs.first, rhs.first) < 0;
+}
+
 configuration :: configuration()
     : m_cluster(0)
     , m_version(0)
@@ -61,6 +69,14 @@ configuration :: configuration()
     , m_tails_by_region()
     , m_next_by_virtual()
     , m_point_leaders_by_virtual()
+    , m_spaces_by_name()
+    , m_spaces_by_region()
+    , m_regions_by_id()
+    , m_subspaces_by_id()
+    , m_virtuals_by_region_server()
+    , m_point_leaders_by_coord()
+    , m_bounds_by_dimension()
+    , m_regions_by_coord()
     , m_spaces()
     , m_captures()
     , m_transfers()
@@ -83,6 +99,14 @@ configuration :: configuration(const configuration& other)
     , m_tails_by_region(other.m_tails_by_region)
     , m_next_by_virtual(other.m_next_by_virtual)
     , m_point_leaders_by_virtual(other.m_point_leaders_by_virtual)
+    , m_spaces_by_name()
+    , m_spaces_by_region()
+    , m_regions_by_id()
+    , m_subspaces_by_id()
+    , m_virtuals_by_region_server()
+    , m_point_leaders_by_coord()
+    , m_bounds_by_dimension()
+    , m_regions_by_coord()
     , m_spaces(other.m_spaces)
     , m_captures(other.m_captures)
     , m_transfers(other.m_transfers)
@@ -107,7 +131,7 @@ configuration :: version() const
 }
 
 void
-configuration :: get_all_addresses(std::vector<std::pair<server_id, po6::net::location> >* addrs)
+configuration :: get_all_addresses(std::vector<std::pair<server_id, po6::net::location> >* addrs) const
 {
     addrs->resize(m_addresses_by_server_id.size());
 
@@ -169,15 +193,8 @@ configuration :: get_server_id(const virtual_server_id& id) const
 const schema*
 configuration :: get_schema(const char* sname) const
 {
-    for (size_t s = 0; s < m_spaces.size(); ++s)
-    {
-        if (strcmp(sname, m_spaces[s].name) == 0)
-        {
-            return &m_spaces[s].sc;
-        }
-    }
-
-    return NULL;
+    const space* s = lookup_space(sname);
+    return s ? &s->sc : NULL;
 }
 
 const schema*
@@ -212,37 +229,57 @@ configuration :: get_subspace(const region_id& ri) const
     return NULL;
 }
 
-virtual_server_id
-configuration :: get_virtual(const region_id& ri, const server_id& si) const
+void
+configuration :: index_attrs(const region_id& ri, std::vector<uint16_t>* attrs) const
 {
-    for (size_t w = 0; w < m_spaces.size(); ++w)
+    const space* s = lookup_space(ri);
+    const subspace* su = get_subspace(ri);
+    attrs->clear();
+
+    if (!s || !su)
     {
-        const space& s(m_spaces[w]);
+        return;
+    }
 
-        for (size_t x = 0; x < s.subspaces.size(); ++x)
+    *attrs = su->attrs;
+
+    for (size_t i = 0; i < s->indices.size(); ++i)
+    {
+        if (std::find(attrs->begin(), attrs->end(), s->indices[i]) == attrs->end())
         {
-            const subspace& ss(s.subspaces[x]);
+            attrs->push_back(s->indices[i]);
+        }
+    }
+}
 
-            for (size_t y = 0; y < ss.regions.size(); ++y)
-            {
-                const region& r(ss.regions[y]);
+const region*
+configuration :: get_region(const region_id& ri) const
+{
+    std::vector<uint64_region_t>::const_iterator it;
+    it = std::lower_bound(m_regions_by_id.begin(),
+                          m_regions_by_id.end(),
+                          uint64_region_t(ri.get(), NULL));
 
-                if (r.id != ri)
-                {
-                    continue;
-                }
+    if (it != m_regions_by_id.end() && it->first == ri.get())
+    {
+        return it->second;
+    }
 
-                for (size_t z = 0; z < r.replicas.size(); ++z)
-                {
-                    if (r.replicas[z].si == si)
-                    {
-                        return r.replicas[z].vsi;
-                    }
-                }
+    return NULL;
+}
 
-                return virtual_server_id();
-            }
-        }
+virtual_server_id
+configuration :: get_virtual(const region_id& ri, const server_id& si) const
+{
+    std::vector<region_server_virtual_t>::const_iterator it;
+    it = std::lower_bound(m_virtuals_by_region_server.begin(),
+                          m_virtuals_by_region_server.end(),
+                          region_server_virtual_t(pair_uint64_t(ri.get(), si.get()), 0));
+
+    if (it != m_virtuals_by_region_server.end() &&
+        it->first.first == ri.get() && it->first.second == si.get())
+    {
+        return virtual_server_id(it->second);
     }
 
     return virtual_server_id();
@@ -363,6 +400,30 @@ configuration :: point_leaders(const server_id& si, std::vector<region_id>* serv
     }
 }
 
+void
+configuration :: regions_of(const server_id& si, std::vector<region_id>* regions) const
+{
+    for (size_t s = 0; s < m_spaces.size(); ++s)
+    {
+        for (size_t ss = 0; ss < m_spaces[s].subspaces.size(); ++ss)
+        {
+            for (size_t r = 0; r < m_spaces[s].subspaces[ss].regions.size(); ++r)
+            {
+                const region& reg(m_spaces[s].subspaces[ss].regions[r]);
+
+                for (size_t i = 0; i < reg.replicas.size(); ++i)
+                {
+                    if (reg.replicas[i].si == si)
+                    {
+                        regions->push_back(reg.id);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
 bool
 configuration :: is_point_leader(const virtual_server_id& e) const
 {
@@ -372,67 +433,76 @@ configuration :: is_point_leader(const virtual_server_id& e) const
 }
 
 virtual_server_id
-configuration :: point_leader(const char* sname, const e::slice& key)
+configuration :: point_leader(const char* sname, const e::slice& key) const
 {
-    for (size_t s = 0; s < m_spaces.size(); ++s)
+    const space* s = lookup_space(sname);
+
+    if (!s)
     {
-        if (strcmp(sname, m_spaces[s].name) != 0)
-        {
-            continue;
-        }
+        return virtual_server_id();
+    }
 
-        uint64_t h;
-        hash(m_spaces[s].sc, key, &h);
+    virtual_server_id vsi = head_of_region(lookup_point_region(s, key));
+    assert(vsi != virtual_server_id());
+    return vsi;
+}
 
-        for (size_t pl = 0; pl < m_spaces[s].subspaces[0].regions.size(); ++pl)
-        {
-            if (m_spaces[s].subspaces[0].regions[pl].lower_coord[0] <= h &&
-                h <= m_spaces[s].subspaces[0].regions[pl].upper_coord[0])
-            {
-                assert(!m_spaces[s].subspaces[0].regions[pl].replicas.empty());
-                return m_spaces[s].subspaces[0].regions[pl].replicas[0].vsi;
-            }
-        }
+virtual_server_id
+configuration :: point_leader(const region_id& rid, const e::slice& key) const
+{
+    const space* s = lookup_space(rid);
 
-        abort();
+    if (!s)
+    {
+        return virtual_server_id();
     }
 
-    return virtual_server_id();
+    virtual_server_id vsi = head_of_region(lookup_point_region(s, key));
+    assert(vsi != virtual_server_id());
+    return vsi;
 }
 
-virtual_server_id
-configuration :: point_leader(const region_id& rid, const e::slice& key)
+region_id
+configuration :: point_region(const char* sname, const e::slice& key) const
 {
-    for (size_t s = 0; s < m_spaces.size(); ++s)
+    const space* s = lookup_space(sname);
+
+    if (!s)
     {
-        for (size_t ss = 0; ss < m_spaces[s].subspaces.size(); ++ss)
-        {
-            for (size_t r = 0; r < m_spaces[s].subspaces[ss].regions.size(); ++r)
-            {
-                if (m_spaces[s].subspaces[ss].regions[r].id != rid)
-                {
-                    continue;
-                }
+        return region_id();
+    }
 
-                uint64_t h;
-                hash(m_spaces[s].sc, key, &h);
+    return lookup_point_region(s, key);
+}
 
-                for (size_t pl = 0; pl < m_spaces[s].subspaces[0].regions.size(); ++pl)
-                {
-                    if (m_spaces[s].subspaces[0].regions[pl].lower_coord[0] <= h &&
-                        h <= m_spaces[s].subspaces[0].regions[pl].upper_coord[0])
-                    {
-                        assert(!m_spaces[s].subspaces[0].regions[pl].replicas.empty());
-                        return m_spaces[s].subspaces[0].regions[pl].replicas[0].vsi;
-                    }
-                }
+region_id
+configuration :: point_region(const region_id& rid, const e::slice& key) const
+{
+    const space* s = lookup_space(rid);
 
-                abort();
-            }
-        }
+    if (!s)
+    {
+        return region_id();
     }
 
-    return virtual_server_id();
+    return lookup_point_region(s, key);
+}
+
+virtual_server_id
+configuration :: replica_of_region(const region_id& ri, uint64_t idx) const
+{
+    std::vector<uint64_region_t>::const_iterator it;
+    it = std::lower_bound(m_regions_by_id.begin(),
+                          m_regions_by_id.end(),
+                          uint64_region_t(ri.get(), NULL));
+
+    if (it == m_regions_by_id.end() || it->first != ri.get() ||
+        it->second->replicas.empty())
+    {
+        return virtual_server_id();
+    }
+
+    return it->second->replicas[idx % it->second->replicas.size()].vsi;
 }
 
 bool
@@ -549,34 +619,79 @@ configuration :: lookup_region(const subspace_id& ssid,
                                const std::vector<uint64_t>& hashes,
                                region_id* rid) const
 {
-    for (size_t s = 0; s < m_spaces.size(); ++s)
+    std::vector<uint64_subspace_t>::const_iterator sit;
+    sit = std::lower_bound(m_subspaces_by_id.begin(),
+                           m_subspaces_by_id.end(),
+                           uint64_subspace_t(ssid.get(), NULL));
+
+    if (sit == m_subspaces_by_id.end() || sit->first != ssid.get())
     {
-        for (size_t ss = 0; ss < m_spaces[s].subspaces.size(); ++ss)
+        *rid = region_id();
+        return;
+    }
+
+    const subspace& ss(*sit->second);
+    std::pair<uint64_t, std::vector<uint64_t> > coord(ssid.get(), std::vector<uint64_t>(ss.attrs.size()));
+
+    // Snap each hash down to the lower bound of the interval containing it in
+    // that dimension.  Because regions tile the subspace, a region whose lower
+    // corner is exactly the snapped coordinate must hold the point; this holds
+    // for the generated grid and for regions the coordinator later splits.
+    for (size_t a = 0; a < ss.attrs.size(); ++a)
+    {
+        assert(ss.attrs[a] < hashes.size());
+        uint64_t h = hashes[ss.attrs[a]];
+        std::pair<uint64_t, uint16_t> dim(ssid.get(), uint16_t(a));
+        std::vector<dimension_bound_t>::const_iterator it;
+        it = std::upper_bound(m_bounds_by_dimension.begin(),
+                              m_bounds_by_dimension.end(),
+                              dimension_bound_t(dim, h));
+
+        if (it == m_bounds_by_dimension.begin() || (it - 1)->first != dim)
         {
-            if (m_spaces[s].subspaces[ss].id != ssid)
-            {
-                continue;
-            }
+            break;
+        }
 
-            assert(m_spaces[s].sc.attrs_sz == hashes.size());
+        coord.second[a] = (it - 1)->second;
+    }
 
-            for (size_t r = 0; r < m_spaces[s].subspaces[ss].regions.size(); ++r)
-            {
-                bool matches = true;
+    std::vector<region_by_coord_t>::const_iterator it;
+    it = std::lower_bound(m_regions_by_coord.begin(),
+                          m_regions_by_coord.end(),
+                          region_by_coord_t(coord, NULL));
 
-                for (size_t a = 0; matches && a < m_spaces[s].subspaces[ss].attrs.size(); ++a)
-                {
-                    assert(a < m_spaces[s].sc.attrs_sz);
-                    matches &= m_spaces[s].subspaces[ss].regions[r].lower_coord[a] <= hashes[m_spaces[s].subspaces[ss].attrs[a]] &&
-                               hashes[m_spaces[s].subspaces[ss].attrs[a]] <= m_spaces[s].subspaces[ss].regions[r].upper_coord[a];
-                }
+    if (it != m_regions_by_coord.end() && it->first == coord)
+    {
+        const region& r(*it->second);
+        bool matches = true;
 
-                if (matches)
-                {
-                    *rid = m_spaces[s].subspaces[ss].regions[r].id;
-                    return;
-                }
-            }
+        for (size_t a = 0; matches && a < ss.attrs.size(); ++a)
+        {
+            matches = hashes[ss.attrs[a]] <= r.upper_coord[a];
+        }
+
+        if (matches)
+        {
+            *rid = r.id;
+            return;
+        }
+    }
+
+    // The regions of this subspace do not form a grid; fall back to a scan.
+    for (size_t r = 0; r < ss.regions.size(); ++r)
+    {
+        bool matches = true;
+
+        for (size_t a = 0; matches && a < ss.attrs.size(); ++a)
+        {
+            matches &= ss.regions[r].lower_coord[a] <= hashes[ss.attrs[a]] &&
+                       hashes[ss.attrs[a]] <= ss.regions[r].upper_coord[a];
+        }
+
+        if (matches)
+        {
+            *rid = ss.regions[r].id;
+            return;
         }
     }
 
@@ -588,16 +703,7 @@ configuration :: lookup_search(const char* space_name,
                                const std::vector<hyperdex::attribute_check>& chks,
                                std::vector<virtual_server_id>* servers) const
 {
-    const space* s = NULL;
-
-    for (size_t i = 0; i < m_spaces.size(); ++i)
-    {
-        if (strcmp(space_name, m_spaces[i].name) == 0)
-        {
-            s = &m_spaces[i];
-            break;
-        }
-    }
+    const space* s = lookup_space(space_name);
 
     if (!s)
     {
@@ -640,6 +746,12 @@ configuration :: lookup_search(const char* space_name,
                 assert(reg.lower_coord.size() == reg.upper_coord.size());
                 uint16_t attr = UINT16_MAX;
 
+                // the attribute's hash says nothing about its elements
+                if (ranges[k].elements)
+                {
+                    continue;
+                }
+
                 for (size_t l = 0; l < s->subspaces[i].attrs.size(); ++l)
                 {
                     if (s->subspaces[i].attrs[l] == ranges[k].attr)
@@ -741,6 +853,18 @@ configuration :: debug_dump(std::ostream& out)
                       << " type=" << s.sc.attrs[i].type << std::endl;
         }
 
+        if (!s.indices.empty())
+        {
+            out << "  indices";
+
+            for (size_t i = 0; i < s.indices.size(); ++i)
+            {
+                out << " " << s.sc.attrs[s.indices[i]].name;
+            }
+
+            out << std::endl;
+        }
+
         for (size_t x = 0; x < s.subspaces.size(); ++x)
         {
             subspace& ss(s.subspaces[x]);
@@ -844,14 +968,24 @@ configuration :: refill_cache()
     m_tails_by_region.clear();
     m_next_by_virtual.clear();
     m_point_leaders_by_virtual.clear();
+    m_spaces_by_name.clear();
+    m_spaces_by_region.clear();
+    m_regions_by_id.clear();
+    m_subspaces_by_id.clear();
+    m_virtuals_by_region_server.clear();
+    m_point_leaders_by_coord.clear();
+    m_bounds_by_dimension.clear();
+    m_regions_by_coord.clear();
 
     for (size_t w = 0; w < m_spaces.size(); ++w)
     {
         space& s(m_spaces[w]);
+        m_spaces_by_name.push_back(std::make_pair(s.name, &s));
 
         for (size_t x = 0; x < s.subspaces.size(); ++x)
         {
             subspace& ss(s.subspaces[x]);
+            m_subspaces_by_id.push_back(std::make_pair(ss.id.get(), &ss));
 
             if (x > 0)
             {
@@ -871,6 +1005,22 @@ configuration :: refill_cache()
                 m_schemas_by_region.push_back(std::make_pair(r.id.get(), &s.sc));
                 m_subspaces_by_region.push_back(std::make_pair(r.id.get(), &ss));
                 m_subspace_ids_by_region.push_back(std::make_pair(r.id.get(), ss.id.get()));
+                m_spaces_by_region.push_back(std::make_pair(r.id.get(), &s));
+                m_regions_by_coord.push_back(std::make_pair(std::make_pair(ss.id.get(), r.lower_coord), &r));
+
+                for (size_t a = 0; a < r.lower_coord.size(); ++a)
+                {
+                    m_bounds_by_dimension.push_back(std::make_pair(std::make_pair(ss.id.get(), uint16_t(a)),
+                                                                   r.lower_coord[a]));
+                }
+
+                m_regions_by_id.push_back(std::make_pair(r.id.get(), &r));
+
+                if (x == 0 && !r.lower_coord.empty())
+                {
+                    m_point_leaders_by_coord.push_back(std::make_pair(std::make_pair(s.id.get(), r.lower_coord[0]),
+                                                                      std::make_pair(r.upper_coord[0], r.id.get())));
+                }
 
                 if (r.replicas.empty())
                 {
@@ -893,6 +1043,9 @@ configuration :: refill_cache()
                                                                      r.id.get()));
                     m_server_ids_by_virtual.push_back(std::make_pair(r.replicas[z].vsi.get(),
                                                                      r.replicas[z].si.get()));
+                    m_virtuals_by_region_server.push_back(std::make_pair(std::make_pair(r.id.get(),
+                                                                                        r.replicas[z].si.get()),
+                                                                         r.replicas[z].vsi.get()));
 
                     if (z + 1 < r.replicas.size())
                     {
@@ -923,6 +1076,72 @@ configuration :: refill_cache()
     std::sort(m_tails_by_region.begin(), m_tails_by_region.end());
     std::sort(m_next_by_virtual.begin(), m_next_by_virtual.end());
     std::sort(m_point_leaders_by_virtual.begin(), m_point_leaders_by_virtual.end());
+    std::sort(m_spaces_by_name.begin(), m_spaces_by_name.end(), compare_space_names);
+    std::sort(m_spaces_by_region.begin(), m_spaces_by_region.end());
+    std::sort(m_regions_by_id.begin(), m_regions_by_id.end());
+    std::sort(m_subspaces_by_id.begin(), m_subspaces_by_id.end());
+    std::sort(m_virtuals_by_region_server.begin(), m_virtuals_by_region_server.end());
+    std::sort(m_point_leaders_by_coord.begin(), m_point_leaders_by_coord.end());
+    std::sort(m_bounds_by_dimension.begin(), m_bounds_by_dimension.end());
+    m_bounds_by_dimension.erase(std::unique(m_bounds_by_dimension.begin(),
+                                            m_bounds_by_dimension.end()),
+                                m_bounds_by_dimension.end());
+    std::sort(m_regions_by_coord.begin(), m_regions_by_coord.end());
+}
+
+const hyperdex::space*
+configuration :: lookup_space(const char* sname) const
+{
+    std::vector<name_space_t>::const_iterator it;
+    it = std::lower_bound(m_spaces_by_name.begin(),
+                          m_spaces_by_name.end(),
+                          name_space_t(sname, NULL),
+                          compare_space_names);
+
+    if (it != m_spaces_by_name.end() && strcmp(it->first, sname) == 0)
+    {
+        return it->second;
+    }
+
+    return NULL;
+}
+
+const hyperdex::space*
+configuration :: lookup_space(const region_id& ri) const
+{
+    std::vector<uint64_space_t>::const_iterator it;
+    it = std::lower_bound(m_spaces_by_region.begin(),
+                          m_spaces_by_region.end(),
+                          uint64_space_t(ri.get(), NULL));
+
+    if (it != m_spaces_by_region.end() && it->first == ri.get())
+    {
+        return it->second;
+    }
+
+    return NULL;
+}
+
+region_id
+configuration :: lookup_point_region(const space* s, const e::slice& key) const
+{
+    uint64_t h;
+    hash(s->sc, key, &h);
+    std::vector<interval_t>::const_iterator it;
+    it = std::upper_bound(m_point_leaders_by_coord.begin(),
+                          m_point_leaders_by_coord.end(),
+                          interval_t(pair_uint64_t(s->id.get(), h),
+                                     pair_uint64_t(UINT64_MAX, UINT64_MAX)));
+
+    if (it == m_point_leaders_by_coord.begin() ||
+        (it - 1)->first.first != s->id.get() ||
+        (it - 1)->second.first < h)
+    {
+        abort();
+    }
+
+    --it;
+    return region_id(it->second.second);
 }
 
 e::unpacker
@@ -64,7 +64,7 @@ class configuration
 
     // membership metadata
     public:
-        void get_all_addresses(std::vector<std::pair<server_id, po6::net::location> >* addrs);
+        void get_all_addresses(std::vector<std::pair<server_id, po6::net::location> >* addrs) const;
         po6::net::location get_address(const server_id& id) const;
         region_id get_region_id(const virtual_server_id& id) const;
         server_id get_server_id(const virtual_server_id& id) const;
@@ -74,6 +74,10 @@ class configuration
         const schema* get_schema(const char* space) const;
         const schema* get_schema(const region_id& ri) const;
         const subspace* get_subspace(const region_id& ri) const;
+        // attributes with index entries in ri: those of its subspace, plus
+        // those indexed throughout its space
+        void index_attrs(const region_id& ri, std::vector<uint16_t>* attrs) const;
+        const region* get_region(const region_id& ri) const;
         virtual_server_id get_virtual(const region_id& ri, const server_id& si) const;
         subspace_id subspace_of(const region_id& ri) const;
         subspace_id subspace_prev(const subspace_id& ss) const;
@@ -82,10 +86,19 @@ class configuration
         virtual_server_id tail_of_region(const region_id& ri) const;
         virtual_server_id next_in_region(const virtual_server_id& vsi) const;
         void point_leaders(const server_id& s, std::vector<region_id>* servers) const;
+        // every region, in any subspace, for which s is a replica
+        void regions_of(const server_id& s, std::vector<region_id>* regions) const;
         bool is_point_leader(const virtual_server_id& e) const;
-        virtual_server_id point_leader(const char* space, const e::slice& key);
+        virtual_server_id point_leader(const char* space, const e::slice& key) const;
         // point leader for this key in the same space as ri
-        virtual_server_id point_leader(const region_id& ri, const e::slice& key);
+        virtual_server_id point_leader(const region_id& ri, const e::slice& key) const;
+        // the region of the key subspace that holds this key
+        region_id point_region(const char* space, const e::slice& key) const;
+        // the region of the key subspace that holds this key in the same
+        // space as ri
+        region_id point_region(const region_id& ri, const e::slice& key) const;
+        // replica idx of ri, wrapping around the chain
+        virtual_server_id replica_of_region(const region_id& ri, uint64_t idx) const;
         // lhs and rhs are in adjacent subspaces such that lhs sends CHAIN_PUT
         // to rhs and rhs sends CHAIN_ACK to lhs
         bool subspace_adjacent(const virtual_server_id& lhs, const virtual_server_id& rhs) const;
@@ -120,6 +133,9 @@ class configuration
 
     private:
         void refill_cache();
+        const space* lookup_space(const char* sname) const;
+        const space* lookup_space(const region_id& ri) const;
+        region_id lookup_point_region(const space* s, const e::slice& key) const;
         friend size_t pack_size(const configuration&);
         friend e::buffer::packer operator << (e::buffer::packer, const configuration& s);
         friend e::unpacker operator >> (e::unpacker, configuration& s);
@@ -129,6 +145,17 @@ class configuration
         typedef std::pair<uint64_t, schema*> uint64_schema_t;
         typedef std::pair<uint64_t, subspace*> uint64_subspace_t;
         typedef std::pair<uint64_t, po6::net::location> uint64_location_t;
+        typedef std::pair<const char*, const space*> name_space_t;
+        typedef std::pair<uint64_t, const space*> uint64_space_t;
+        typedef std::pair<uint64_t, const region*> uint64_region_t;
+        // (region, server) -> virtual server
+        typedef std::pair<pair_uint64_t, uint64_t> region_server_virtual_t;
+        // (space, lower) -> (upper, region)
+        typedef std::pair<pair_uint64_t, pair_uint64_t> interval_t;
+        // (subspace, dimension) -> distinct lower bound in that dimension
+        typedef std::pair<std::pair<uint64_t, uint16_t>, uint64_t> dimension_bound_t;
+        // (subspace, lower_coord) -> region
+        typedef std::pair<std::pair<uint64_t, std::vector<uint64_t> >, const region*> region_by_coord_t;
 
     private:
         uint64_t m_cluster;
@@ -145,6 +172,14 @@ class configuration
         std::vector<pair_uint64_t> m_tails_by_region;
         std::vector<pair_uint64_t> m_next_by_virtual;
         std::vector<uint64_t> m_point_leaders_by_virtual;
+        std::vector<name_space_t> m_spaces_by_name;
+        std::vector<uint64_space_t> m_spaces_by_region;
+        std::vector<uint64_region_t> m_regions_by_id;
+        std::vector<uint64_subspace_t> m_subspaces_by_id;
+        std::vector<region_server_virtual_t> m_virtuals_by_region_server;
+        std::vector<interval_t> m_point_leaders_by_coord;
+        std::vector<dimension_bound_t> m_bounds_by_dimension;
+        std::vector<region_by_coord_t> m_regions_by_coord;
         std::vector<space> m_spaces;
         std::vector<capture> m_captures;
         std::vector<transfer> m_transfers;
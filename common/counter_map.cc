@@ -103,6 +103,13 @@ counter_map :: lookup(const region_id& ri, uint64_t* count)
     return true;
 }
 
+bool
+counter_map :: increment(const region_id& ri)
+{
+    uint64_t count;
+    return lookup(ri, &count);
+}
+
 bool
 counter_map :: take_max(const region_id& ri, uint64_t count)
 {
@@ -36,8 +36,8 @@
 // HyperDex
 #include "common/ids.h"
 
-// The only thread-safe call is "lookup".  "adopt", "peek", and "take_max" all
-// require external synchronization.
+// The only thread-safe calls are "lookup" and "increment".  "adopt", "peek",
+// and "take_max" all require external synchronization.
 
 namespace hyperdex
 {
@@ -52,6 +52,8 @@ class counter_map
         void adopt(const std::vector<region_id>& ris);
         void peek(std::map<region_id, uint64_t>* ris);
         bool lookup(const region_id& ri, uint64_t* count);
+        // "lookup" without the result, for counters only read via "peek"
+        bool increment(const region_id& ri);
         bool take_max(const region_id& ri, uint64_t count);
 
     private:
@@ -39,6 +39,7 @@ space :: space()
     , fault_tolerance()
     , sc()
     , subspaces()
+    , indices()
     , m_c_strs()
     , m_attrs()
 {
@@ -50,6 +51,7 @@ space :: space(const char* new_name, const hyperdex::schema& _sc)
     , fault_tolerance()
     , sc(_sc)
     , subspaces()
+    , indices()
     , m_c_strs()
     , m_attrs()
 {
@@ -62,6 +64,7 @@ space :: space(const space& other)
     , fault_tolerance(other.fault_tolerance)
     , sc(other.sc)
     , subspaces(other.subspaces)
+    , indices(other.indices)
     , m_c_strs()
     , m_attrs()
 {
@@ -116,9 +119,40 @@ space :: validate() const
         }
     }
 
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        // The key is never indexed; it is always found by hashing
+        if (indices[i] == 0 || indices[i] >= sc.attrs_sz)
+        {
+            return false;
+        }
+
+        for (size_t j = i + 1; j < indices.size(); ++j)
+        {
+            if (indices[i] == indices[j])
+            {
+                return false;
+            }
+        }
+    }
+
     return true;
 }
 
+bool
+space :: is_indexed(uint16_t attr) const
+{
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        if (indices[i] == attr)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 space&
 space :: operator = (const space& rhs)
 {
@@ -127,6 +161,7 @@ space :: operator = (const space& rhs)
     fault_tolerance = rhs.fault_tolerance;
     sc = rhs.sc;
     subspaces = rhs.subspaces;
+    indices = rhs.indices;
     reestablish_backing();
     return *this;
 }
@@ -182,6 +217,13 @@ hyperdex :: operator << (e::buffer::packer pa, const space& s)
         pa = pa << s.subspaces[i];
     }
 
+    pa = pa << static_cast<uint16_t>(s.indices.size());
+
+    for (size_t i = 0; i < s.indices.size(); ++i)
+    {
+        pa = pa << s.indices[i];
+    }
+
     return pa;
 }
 
@@ -235,6 +277,18 @@ hyperdex :: operator >> (e::unpacker up, space& s)
         up = up >> s.subspaces[i];
     }
 
+    // Unpack indices
+    uint16_t num_indices = 0;
+    up = up >> num_indices;
+    s.indices.clear();
+
+    for (size_t i = 0; !up.error() && i < num_indices; ++i)
+    {
+        uint16_t attr;
+        up = up >> attr;
+        s.indices.push_back(attr);
+    }
+
     return up;
 }
 
@@ -258,6 +312,8 @@ hyperdex :: pack_size(const space& s)
         sz += pack_size(s.subspaces[i]);
     }
 
+    sz += sizeof(uint16_t) /* num indices */
+        + sizeof(uint16_t) * s.indices.size();
     return sz;
 }
 
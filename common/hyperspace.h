@@ -56,6 +56,7 @@ class space
 
     public:
         bool validate() const;
+        bool is_indexed(uint16_t attr) const;
 
     public:
         space& operator = (const space&);
@@ -66,6 +67,8 @@ class space
         uint64_t fault_tolerance;
         hyperdex::schema sc;
         std::vector<subspace> subspaces;
+        // Attributes indexed in every region, regardless of subspace
+        std::vector<uint16_t> indices;
 
     private:
         friend e::buffer::packer operator << (e::buffer::packer, const space& s);
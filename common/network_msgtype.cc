@@ -36,8 +36,11 @@ hyperdex :: operator << (std::ostream& lhs, const network_msgtype& rhs)
     {
         STRINGIFY(REQ_GET);
         STRINGIFY(RESP_GET);
+        STRINGIFY(REQ_GET_BATCH);
+        STRINGIFY(RESP_GET_BATCH);
         STRINGIFY(REQ_ATOMIC);
         STRINGIFY(RESP_ATOMIC);
+        STRINGIFY(REQ_ATOMIC_BATCH);
         STRINGIFY(REQ_SEARCH_START);
         STRINGIFY(REQ_SEARCH_NEXT);
         STRINGIFY(REQ_SEARCH_STOP);
@@ -51,12 +54,17 @@ hyperdex :: operator << (std::ostream& lhs, const network_msgtype& rhs)
         STRINGIFY(RESP_COUNT);
         STRINGIFY(REQ_SEARCH_DESCRIBE);
         STRINGIFY(RESP_SEARCH_DESCRIBE);
+        STRINGIFY(REQ_AGGREGATE);
+        STRINGIFY(RESP_AGGREGATE);
         STRINGIFY(CHAIN_OP);
         STRINGIFY(CHAIN_SUBSPACE);
         STRINGIFY(CHAIN_ACK);
         STRINGIFY(CHAIN_GC);
+        STRINGIFY(CHAIN_BATCH);
         STRINGIFY(XFER_OP);
         STRINGIFY(XFER_ACK);
+        STRINGIFY(XFER_TREE);
+        STRINGIFY(SERVERBUSY);
         STRINGIFY(CONFIGMISMATCH);
         STRINGIFY(PACKET_NOP);
         default:
@@ -38,9 +38,12 @@ enum network_msgtype
 {
     REQ_GET         = 8,
     RESP_GET        = 9,
+    REQ_GET_BATCH   = 10,
+    RESP_GET_BATCH  = 11,
 
     REQ_ATOMIC      = 16,
     RESP_ATOMIC     = 17,
+    REQ_ATOMIC_BATCH = 18,
 
     REQ_SEARCH_START    = 32,
     REQ_SEARCH_NEXT     = 33,
@@ -60,14 +63,20 @@ enum network_msgtype
     REQ_SEARCH_DESCRIBE  = 52,
     RESP_SEARCH_DESCRIBE = 53,
 
+    REQ_AGGREGATE   = 54,
+    RESP_AGGREGATE  = 55,
+
     CHAIN_OP        = 64,
     CHAIN_SUBSPACE  = 65,
     CHAIN_ACK       = 66,
     CHAIN_GC        = 67,
+    CHAIN_BATCH     = 68,
 
-    XFER_OP  = 80,
-    XFER_ACK = 81,
+    XFER_OP   = 80,
+    XFER_ACK  = 81,
+    XFER_TREE = 82,
 
+    SERVERBUSY      = 253,
     CONFIGMISMATCH  = 254,
     PACKET_NOP      = 255
 };
@@ -0,0 +1,131 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <cassert>
+
+// HyperDex
+#include "common/projection.h"
+
+using hyperdex::projection;
+
+projection :: projection()
+    : restricted(false)
+    , attrs()
+{
+}
+
+projection :: projection(const projection& other)
+    : restricted(other.restricted)
+    , attrs(other.attrs)
+{
+}
+
+projection :: ~projection() throw ()
+{
+}
+
+bool
+projection :: validate(const schema& sc) const
+{
+    for (size_t i = 0; i < attrs.size(); ++i)
+    {
+        if (attrs[i] == 0 || attrs[i] >= sc.attrs_sz)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+projection :: apply(const std::vector<e::slice>& value,
+                    std::vector<e::slice>* out) const
+{
+    if (!restricted)
+    {
+        *out = value;
+        return;
+    }
+
+    out->resize(attrs.size());
+
+    for (size_t i = 0; i < attrs.size(); ++i)
+    {
+        assert(attrs[i] > 0 && attrs[i] <= value.size());
+        (*out)[i] = value[attrs[i] - 1];
+    }
+}
+
+projection&
+projection :: operator = (const projection& rhs)
+{
+    restricted = rhs.restricted;
+    attrs = rhs.attrs;
+    return *this;
+}
+
+e::buffer::packer
+hyperdex :: operator << (e::buffer::packer pa, const projection& p)
+{
+    uint8_t restricted = p.restricted ? 1 : 0;
+    uint16_t num_attrs = p.attrs.size();
+    pa = pa << restricted << num_attrs;
+
+    for (size_t i = 0; i < p.attrs.size(); ++i)
+    {
+        pa = pa << p.attrs[i];
+    }
+
+    return pa;
+}
+
+e::unpacker
+hyperdex :: operator >> (e::unpacker up, projection& p)
+{
+    uint8_t restricted = 0;
+    uint16_t num_attrs = 0;
+    up = up >> restricted >> num_attrs;
+    p.restricted = restricted != 0;
+    p.attrs.clear();
+
+    for (size_t i = 0; !up.error() && i < num_attrs; ++i)
+    {
+        uint16_t attr;
+        up = up >> attr;
+        p.attrs.push_back(attr);
+    }
+
+    return up;
+}
+
+size_t
+hyperdex :: pack_size(const projection& p)
+{
+    return sizeof(uint8_t) + sizeof(uint16_t) + p.attrs.size() * sizeof(uint16_t);
+}
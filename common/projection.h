@@ -0,0 +1,78 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_common_projection_h_
+#define hyperdex_common_projection_h_
+
+// STL
+#include <vector>
+
+// e
+#include <e/buffer.h>
+#include <e/slice.h>
+
+// HyperDex
+#include "common/schema.h"
+
+namespace hyperdex
+{
+
+// The attributes a read sends back.  By default every attribute is sent.  A
+// restricted projection sends only the listed attributes, in the listed
+// order; with none listed, only keys are sent.  The key is never listed.
+class projection
+{
+    public:
+        projection();
+        projection(const projection&);
+        ~projection() throw ();
+
+    public:
+        bool keys_only() const { return restricted && attrs.empty(); }
+        bool validate(const schema& sc) const;
+        // value holds every attribute but the key; out gets the projected ones
+        void apply(const std::vector<e::slice>& value,
+                   std::vector<e::slice>* out) const;
+
+    public:
+        projection& operator = (const projection&);
+
+    public:
+        bool restricted;
+        std::vector<uint16_t> attrs;
+};
+
+e::buffer::packer
+operator << (e::buffer::packer, const projection& p);
+e::unpacker
+operator >> (e::unpacker, projection& p);
+size_t
+pack_size(const projection& p);
+
+} // namespace hyperdex
+
+#endif // hyperdex_common_projection_h_
@@ -42,6 +42,7 @@ range :: range()
     , has_start(false)
     , has_end(false)
     , invalid(true)
+    , elements(false)
 {
 }
 
@@ -53,6 +54,7 @@ range :: range(const range& other)
     , has_start(other.has_start)
     , has_end(other.has_end)
     , invalid(other.invalid)
+    , elements(other.elements)
 {
 }
 
@@ -70,6 +72,7 @@ range :: operator = (const range& rhs)
     has_start = rhs.has_start;
     has_end = rhs.has_end;
     invalid = rhs.invalid;
+    elements = rhs.elements;
     return *this;
 }
 
@@ -122,6 +125,7 @@ range_search(const attribute_check* ptr,
                 }
                 break;
             case HYPERPREDICATE_CONTAINS_LESS_THAN:
+            case HYPERPREDICATE_CONTAINS:
                 break;
             case HYPERPREDICATE_FAIL:
             default:
@@ -164,10 +168,30 @@ hyperdex :: range_searches(const std::vector<attribute_check>& checks,
     while (check_ptr < check_end)
     {
         const attribute_check* tmp = check_ptr;
+        const attribute_check* first = NULL;
 
+        // CONTAINS checks are typed by the element, not the attribute, so
+        // they are left out of the attribute's own range
         while (tmp < check_end && check_ptr->attr == tmp->attr)
         {
-            if (check_ptr->datatype != tmp->datatype)
+            if (tmp->predicate == HYPERPREDICATE_CONTAINS)
+            {
+                ranges->push_back(range());
+                range& r(ranges->back());
+                r.attr = tmp->attr;
+                r.type = tmp->datatype;
+                r.start = tmp->value;
+                r.end = tmp->value;
+                r.has_start = true;
+                r.has_end = true;
+                r.invalid = false;
+                r.elements = true;
+            }
+            else if (!first)
+            {
+                first = tmp;
+            }
+            else if (first->datatype != tmp->datatype)
             {
                 return false;
             }
@@ -177,8 +201,13 @@ hyperdex :: range_searches(const std::vector<attribute_check>& checks,
 
         // assert that the input of checks is sorted
         assert(tmp == check_end || check_ptr->attr < tmp->attr);
-        ranges->push_back(range());
-        range_search(check_ptr, tmp, &ranges->back());
+
+        if (first)
+        {
+            ranges->push_back(range());
+            range_search(first, tmp, &ranges->back());
+        }
+
         check_ptr = tmp;
     }
 
@@ -37,7 +37,8 @@
 namespace hyperdex
 {
 
-// a range is inclusive
+// a range is inclusive.  An "elements" range covers the elements (or map keys)
+// of the container attribute "attr", and "type" is their primitive type.
 class range
 {
     public:
@@ -56,6 +57,7 @@ class range
         bool has_start;
         bool has_end;
         bool invalid;
+        bool elements;
 };
 
 bool
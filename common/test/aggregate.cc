@@ -0,0 +1,125 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdint.h>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// e
+#include <e/endian.h>
+
+// HyperDex
+#include "common/aggregate.h"
+
+#pragma GCC diagnostic ignored "-Wswitch-default"
+
+using hyperdex::aggregate_stat;
+
+namespace
+{
+
+void
+add_int(aggregate_stat* as, int64_t x)
+{
+    uint8_t buf[sizeof(int64_t)];
+    e::pack64le(x, buf);
+    as->add(HYPERDATATYPE_INT64, e::slice(buf, sizeof(buf)));
+}
+
+TEST(AggregateStat, IntSumSmall)
+{
+    aggregate_stat as;
+    add_int(&as, 5);
+    add_int(&as, -7);
+    add_int(&as, 12);
+    ASSERT_EQ(3U, as.count);
+    ASSERT_EQ(10.0, as.sum(HYPERDATATYPE_INT64));
+    ASSERT_EQ(-7.0, as.min(HYPERDATATYPE_INT64));
+    ASSERT_EQ(12.0, as.max(HYPERDATATYPE_INT64));
+}
+
+TEST(AggregateStat, IntSumDoesNotWrap)
+{
+    aggregate_stat as;
+    add_int(&as, INT64_MAX);
+    add_int(&as, INT64_MAX);
+    add_int(&as, 2);
+    // 2 * (2^63 - 1) + 2 == 2^64
+    ASSERT_EQ(1, as.int_sum_hi);
+    ASSERT_EQ(0U, as.int_sum_lo);
+    ASSERT_EQ(18446744073709551616.0, as.sum(HYPERDATATYPE_INT64));
+}
+
+TEST(AggregateStat, IntSumNegativeDoesNotWrap)
+{
+    aggregate_stat as;
+    add_int(&as, INT64_MIN);
+    add_int(&as, INT64_MIN);
+    ASSERT_EQ(-18446744073709551616.0, as.sum(HYPERDATATYPE_INT64));
+    // and back across zero
+    add_int(&as, INT64_MAX);
+    add_int(&as, INT64_MAX);
+    add_int(&as, 2);
+    ASSERT_EQ(0, as.int_sum_hi);
+    ASSERT_EQ(0U, as.int_sum_lo);
+    ASSERT_EQ(0.0, as.sum(HYPERDATATYPE_INT64));
+}
+
+TEST(AggregateStat, MergeDoesNotWrap)
+{
+    aggregate_stat a;
+    aggregate_stat b;
+    add_int(&a, INT64_MAX);
+    add_int(&a, 1);
+    add_int(&b, INT64_MAX);
+    add_int(&b, -3);
+    a.merge(b);
+    ASSERT_EQ(4U, a.count);
+    // 2^63 + 2^63 - 4 == 2^64 - 4
+    ASSERT_EQ(0, a.int_sum_hi);
+    ASSERT_EQ(UINT64_MAX - 3, a.int_sum_lo);
+    ASSERT_EQ(-3.0, a.min(HYPERDATATYPE_INT64));
+    ASSERT_EQ(static_cast<double>(INT64_MAX), a.max(HYPERDATATYPE_INT64));
+}
+
+TEST(AggregateStat, MergeEmpty)
+{
+    aggregate_stat a;
+    aggregate_stat b;
+    add_int(&b, -4);
+    a.merge(b);
+    a.merge(aggregate_stat());
+    ASSERT_EQ(1U, a.count);
+    ASSERT_EQ(-4.0, a.sum(HYPERDATATYPE_INT64));
+    ASSERT_EQ(-4.0, a.min(HYPERDATATYPE_INT64));
+}
+
+} // namespace
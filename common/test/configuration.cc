@@ -0,0 +1,314 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// STL
+#include <memory>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// e
+#include <e/buffer.h>
+
+// HyperDex
+#include "client/partition.h"
+#include "common/configuration.h"
+#include "common/hyperspace.h"
+#include "common/serialization.h"
+
+#pragma GCC diagnostic ignored "-Wswitch-default"
+
+using hyperdex::configuration;
+using hyperdex::region;
+using hyperdex::region_id;
+using hyperdex::replica;
+using hyperdex::schema;
+using hyperdex::server_id;
+using hyperdex::space;
+using hyperdex::subspace;
+using hyperdex::subspace_id;
+using hyperdex::virtual_server_id;
+using hyperdex::operator <<;
+using hyperdex::pack_size;
+
+#define NUM_SERVERS 8
+
+namespace
+{
+
+// Assign ids to the regions of s and two replicas to each, then round-trip s
+// through the wire format the coordinator uses.
+bool
+build(space* s, configuration* config)
+{
+    uint64_t next_id = 100;
+
+    for (size_t x = 0; x < s->subspaces.size(); ++x)
+    {
+        for (size_t y = 0; y < s->subspaces[x].regions.size(); ++y)
+        {
+            region& r(s->subspaces[x].regions[y]);
+            r.id = region_id(next_id);
+            ++next_id;
+
+            for (size_t z = 0; z < 2; ++z)
+            {
+                server_id si(1 + (y + z) % NUM_SERVERS);
+                r.replicas.push_back(replica(si, virtual_server_id(next_id)));
+                ++next_id;
+            }
+        }
+    }
+
+    size_t sz = 6 * sizeof(uint64_t)
+              + NUM_SERVERS * (sizeof(uint64_t) + pack_size(po6::net::location()))
+              + pack_size(*s);
+    std::auto_ptr<e::buffer> buf(e::buffer::create(sz));
+    e::buffer::packer pa = buf->pack_at(0);
+    pa = pa << uint64_t(1) << uint64_t(1)
+            << uint64_t(NUM_SERVERS) << uint64_t(1)
+            << uint64_t(0) << uint64_t(0);
+
+    for (uint64_t i = 0; i < NUM_SERVERS; ++i)
+    {
+        pa = pa << uint64_t(1 + i) << po6::net::location();
+    }
+
+    pa = pa << *s;
+    e::unpacker up = buf->unpack_from(0);
+    up = up >> *config;
+    return !up.error();
+}
+
+// One space of three attributes:  a key subspace of 16 regions and a 2-D
+// grid of 64 regions over the other two attributes.
+void
+grid_space(hyperdex::attribute* attrs, space* s)
+{
+    attrs[0] = hyperdex::attribute("k", HYPERDATATYPE_STRING);
+    attrs[1] = hyperdex::attribute("a", HYPERDATATYPE_STRING);
+    attrs[2] = hyperdex::attribute("b", HYPERDATATYPE_STRING);
+    schema sc;
+    sc.attrs_sz = 3;
+    sc.attrs = attrs;
+    *s = space("kv", sc);
+    s->id = hyperdex::space_id(1);
+    s->fault_tolerance = 1;
+    s->subspaces.resize(2);
+    s->subspaces[0].id = subspace_id(2);
+    s->subspaces[0].attrs.push_back(0);
+    hyperdex::partition(1, 16, &s->subspaces[0].regions);
+    s->subspaces[1].id = subspace_id(3);
+    s->subspaces[1].attrs.push_back(1);
+    s->subspaces[1].attrs.push_back(2);
+    hyperdex::partition(2, 64, &s->subspaces[1].regions);
+}
+
+// the answer the sorted tables must agree with
+region_id
+scan_region(const subspace& ss, const std::vector<uint64_t>& hashes)
+{
+    for (size_t r = 0; r < ss.regions.size(); ++r)
+    {
+        bool matches = true;
+
+        for (size_t a = 0; matches && a < ss.attrs.size(); ++a)
+        {
+            matches = ss.regions[r].lower_coord[a] <= hashes[ss.attrs[a]] &&
+                      hashes[ss.attrs[a]] <= ss.regions[r].upper_coord[a];
+        }
+
+        if (matches)
+        {
+            return ss.regions[r].id;
+        }
+    }
+
+    return region_id();
+}
+
+uint64_t
+next_random(uint64_t* state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+TEST(Configuration, RegionAndReplicaTables)
+{
+    hyperdex::attribute attrs[3];
+    space s;
+    grid_space(attrs, &s);
+    configuration config;
+    ASSERT_TRUE(build(&s, &config));
+    ASSERT_TRUE(config.get_schema("kv") != NULL);
+    ASSERT_TRUE(config.get_schema("k") == NULL);
+    ASSERT_TRUE(config.get_schema("kvx") == NULL);
+
+    for (size_t x = 0; x < s.subspaces.size(); ++x)
+    {
+        for (size_t y = 0; y < s.subspaces[x].regions.size(); ++y)
+        {
+            const region& r(s.subspaces[x].regions[y]);
+            ASSERT_EQ(config.get_schema("kv"), config.get_schema(r.id));
+            ASSERT_TRUE(config.get_region(r.id) != NULL);
+            ASSERT_EQ(r.id, config.get_region(r.id)->id);
+            ASSERT_TRUE(config.get_subspace(r.id) != NULL);
+            ASSERT_EQ(s.subspaces[x].id, config.get_subspace(r.id)->id);
+            ASSERT_EQ(s.subspaces[x].id, config.subspace_of(r.id));
+
+            for (size_t z = 0; z < r.replicas.size(); ++z)
+            {
+                ASSERT_EQ(r.replicas[z].vsi, config.get_virtual(r.id, r.replicas[z].si));
+                ASSERT_EQ(r.id, config.get_region_id(r.replicas[z].vsi));
+                ASSERT_EQ(r.replicas[z].si, config.get_server_id(r.replicas[z].vsi));
+            }
+
+            ASSERT_EQ(r.replicas.front().vsi, config.head_of_region(r.id));
+            ASSERT_EQ(virtual_server_id(), config.get_virtual(r.id, server_id(NUM_SERVERS + 1)));
+        }
+    }
+
+    ASSERT_TRUE(config.get_schema(region_id(1)) == NULL);
+    ASSERT_TRUE(config.get_region(region_id(1)) == NULL);
+    ASSERT_EQ(virtual_server_id(), config.get_virtual(region_id(1), server_id(1)));
+}
+
+TEST(Configuration, LookupRegionOnAGrid)
+{
+    hyperdex::attribute attrs[3];
+    space s;
+    grid_space(attrs, &s);
+    configuration config;
+    ASSERT_TRUE(build(&s, &config));
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+
+    for (size_t i = 0; i < 10000; ++i)
+    {
+        std::vector<uint64_t> hashes(3);
+        hashes[0] = next_random(&state);
+        hashes[1] = next_random(&state);
+        hashes[2] = next_random(&state);
+
+        for (size_t x = 0; x < s.subspaces.size(); ++x)
+        {
+            region_id ri;
+            config.lookup_region(s.subspaces[x].id, hashes, &ri);
+            ASSERT_EQ(scan_region(s.subspaces[x], hashes), ri);
+        }
+    }
+
+    // the corners of every region map back to it
+    const subspace& ss(s.subspaces[1]);
+
+    for (size_t r = 0; r < ss.regions.size(); ++r)
+    {
+        std::vector<uint64_t> lower(3, 0);
+        std::vector<uint64_t> upper(3, 0);
+        lower[1] = ss.regions[r].lower_coord[0];
+        lower[2] = ss.regions[r].lower_coord[1];
+        upper[1] = ss.regions[r].upper_coord[0];
+        upper[2] = ss.regions[r].upper_coord[1];
+        region_id ri;
+        config.lookup_region(ss.id, lower, &ri);
+        ASSERT_EQ(ss.regions[r].id, ri);
+        config.lookup_region(ss.id, upper, &ri);
+        ASSERT_EQ(ss.regions[r].id, ri);
+    }
+
+    region_id ri(1);
+    config.lookup_region(subspace_id(99), std::vector<uint64_t>(3, 0), &ri);
+    ASSERT_EQ(region_id(), ri);
+}
+
+TEST(Configuration, LookupRegionOffTheGrid)
+{
+    // Split the upper half of the first dimension in two along the second, so
+    // the regions are no longer a grid:  snapping (low, high) lands on a
+    // lower corner that no region has.
+    hyperdex::attribute attrs[3];
+    space s;
+    grid_space(attrs, &s);
+    std::vector<region>& regions(s.subspaces[1].regions);
+    regions.resize(3);
+    const uint64_t half = UINT64_MAX / 2;
+
+    for (size_t r = 0; r < regions.size(); ++r)
+    {
+        regions[r].lower_coord.assign(2, 0);
+        regions[r].upper_coord.assign(2, UINT64_MAX);
+    }
+
+    regions[0].upper_coord[0] = half;
+    regions[1].lower_coord[0] = half + 1;
+    regions[1].upper_coord[1] = half;
+    regions[2].lower_coord[0] = half + 1;
+    regions[2].lower_coord[1] = half + 1;
+    configuration config;
+    ASSERT_TRUE(build(&s, &config));
+    uint64_t state = 0x2545f4914f6cdd1dULL;
+
+    for (size_t i = 0; i < 10000; ++i)
+    {
+        std::vector<uint64_t> hashes(3);
+        hashes[0] = next_random(&state);
+        hashes[1] = next_random(&state);
+        hashes[2] = next_random(&state);
+        region_id ri;
+        config.lookup_region(s.subspaces[1].id, hashes, &ri);
+        ASSERT_EQ(scan_region(s.subspaces[1], hashes), ri);
+    }
+}
+
+TEST(Configuration, PointLeaderIsHeadOfPointRegion)
+{
+    hyperdex::attribute attrs[3];
+    space s;
+    grid_space(attrs, &s);
+    configuration config;
+    ASSERT_TRUE(build(&s, &config));
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        uint64_t k = next_random(&state);
+        e::slice key(reinterpret_cast<const char*>(&k), sizeof(k));
+        region_id ri(config.point_region("kv", key));
+        ASSERT_NE(region_id(), ri);
+        ASSERT_EQ(s.subspaces[0].id, config.subspace_of(ri));
+        ASSERT_EQ(config.head_of_region(ri), config.point_leader("kv", key));
+        ASSERT_EQ(config.head_of_region(ri), config.point_leader(ri, key));
+        ASSERT_TRUE(config.is_point_leader(config.point_leader("kv", key)));
+    }
+}
+
+} // namespace
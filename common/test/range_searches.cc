@@ -0,0 +1,121 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <string.h>
+
+// STL
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// HyperDex
+#include "common/range_searches.h"
+
+#pragma GCC diagnostic ignored "-Wswitch-default"
+
+using hyperdex::attribute_check;
+using hyperdex::range;
+using hyperdex::range_searches;
+
+namespace
+{
+
+attribute_check
+check(uint16_t attr, const char* value, hyperdatatype type, hyperpredicate pred)
+{
+    attribute_check c;
+    c.attr = attr;
+    c.value = e::slice(value, strlen(value));
+    c.datatype = type;
+    c.predicate = pred;
+    return c;
+}
+
+TEST(RangeSearches, Contains)
+{
+    std::vector<attribute_check> checks;
+    checks.push_back(check(1, "x", HYPERDATATYPE_STRING, HYPERPREDICATE_CONTAINS));
+    std::vector<range> ranges;
+    ASSERT_TRUE(range_searches(checks, &ranges));
+    ASSERT_EQ(1U, ranges.size());
+    ASSERT_EQ(1U, ranges[0].attr);
+    ASSERT_EQ(HYPERDATATYPE_STRING, ranges[0].type);
+    ASSERT_TRUE(ranges[0].elements);
+    ASSERT_FALSE(ranges[0].invalid);
+    ASSERT_TRUE(ranges[0].has_start);
+    ASSERT_TRUE(ranges[0].has_end);
+    ASSERT_TRUE(ranges[0].start == e::slice("x", 1));
+    ASSERT_TRUE(ranges[0].end == e::slice("x", 1));
+}
+
+// each CONTAINS check gets its own range, typed by the element
+TEST(RangeSearches, ContainsTwice)
+{
+    std::vector<attribute_check> checks;
+    checks.push_back(check(1, "x", HYPERDATATYPE_STRING, HYPERPREDICATE_CONTAINS));
+    checks.push_back(check(1, "y", HYPERDATATYPE_STRING, HYPERPREDICATE_CONTAINS));
+    std::vector<range> ranges;
+    ASSERT_TRUE(range_searches(checks, &ranges));
+    ASSERT_EQ(2U, ranges.size());
+    ASSERT_TRUE(ranges[0].elements);
+    ASSERT_TRUE(ranges[1].elements);
+    ASSERT_TRUE(ranges[0].start == e::slice("x", 1));
+    ASSERT_TRUE(ranges[1].start == e::slice("y", 1));
+}
+
+// a CONTAINS check does not conflict with a whole-value check on the same
+// container attribute, even though their datatypes differ
+TEST(RangeSearches, ContainsAndEquals)
+{
+    std::vector<attribute_check> checks;
+    checks.push_back(check(1, "x", HYPERDATATYPE_STRING, HYPERPREDICATE_CONTAINS));
+    checks.push_back(check(1, "", HYPERDATATYPE_SET_STRING, HYPERPREDICATE_EQUALS));
+    checks.push_back(check(2, "a", HYPERDATATYPE_STRING, HYPERPREDICATE_EQUALS));
+    std::vector<range> ranges;
+    ASSERT_TRUE(range_searches(checks, &ranges));
+    ASSERT_EQ(3U, ranges.size());
+    ASSERT_TRUE(ranges[0].elements);
+    ASSERT_EQ(HYPERDATATYPE_STRING, ranges[0].type);
+    ASSERT_FALSE(ranges[1].elements);
+    ASSERT_EQ(1U, ranges[1].attr);
+    ASSERT_EQ(HYPERDATATYPE_SET_STRING, ranges[1].type);
+    ASSERT_FALSE(ranges[2].elements);
+    ASSERT_EQ(2U, ranges[2].attr);
+}
+
+TEST(RangeSearches, MismatchedTypes)
+{
+    std::vector<attribute_check> checks;
+    checks.push_back(check(1, "a", HYPERDATATYPE_STRING, HYPERPREDICATE_EQUALS));
+    checks.push_back(check(1, "b", HYPERDATATYPE_INT64, HYPERPREDICATE_LESS_EQUAL));
+    std::vector<range> ranges;
+    ASSERT_FALSE(range_searches(checks, &ranges));
+}
+
+} // namespace
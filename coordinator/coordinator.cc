@@ -27,6 +27,9 @@
 
 #define __STDC_LIMIT_MACROS
 
+// C
+#include <string.h>
+
 // C++
 #include <sstream>
 
@@ -44,6 +47,14 @@
 #include "coordinator/server_state.h"
 #include "coordinator/transitions.h"
 
+// Split a region that serves more than this many operations per second...
+#define REGION_SPLIT_OPS 20000
+// ...or that holds more than this many bytes
+#define REGION_SPLIT_BYTES (4ULL * 1024ULL * 1024ULL * 1024ULL)
+// Merge a split region back once it and its sibling together serve fewer
+// operations per second than this
+#define REGION_MERGE_OPS 2000
+
 //////////////////////////// C Transition Functions ////////////////////////////
 
 using namespace hyperdex;
@@ -228,6 +239,24 @@ hyperdex_coordinator_rm_space(struct replicant_state_machine_context* ctx,
     c->rm_space(ctx, data);
 }
 
+void
+hyperdex_coordinator_add_index(struct replicant_state_machine_context* ctx,
+                               void* obj, const char* data, size_t data_sz)
+{
+    PROTECT_UNINITIALIZED;
+    FILE* log = replicant_state_machine_log_stream(ctx);
+    coordinator* c = static_cast<coordinator*>(obj);
+    const char* attr = data + strnlen(data, data_sz) + 1;
+
+    if (data_sz == 0 || data[data_sz - 1] != '\0' || attr >= data + data_sz)
+    {
+        fprintf(log, "received malformed \"add_index\" message\n");
+        return generate_response(ctx, COORD_MALFORMED);
+    }
+
+    c->add_index(ctx, data, attr);
+}
+
 void
 hyperdex_coordinator_get_config(struct replicant_state_machine_context* ctx,
                                 void* obj, const char* data, size_t data_sz)
@@ -381,6 +410,33 @@ hyperdex_coordinator_xfer_complete(struct replicant_state_machine_context* ctx,
     c->xfer_complete(ctx, xid);
 }
 
+void
+hyperdex_coordinator_report_load(struct replicant_state_machine_context* ctx,
+                                 void* obj, const char* data, size_t data_sz)
+{
+    PROTECT_UNINITIALIZED;
+    FILE* log = replicant_state_machine_log_stream(ctx);
+    coordinator* c = static_cast<coordinator*>(obj);
+    uint64_t _sid;
+    uint64_t count;
+    e::unpacker up(data, data_sz);
+    up = up >> _sid >> count;
+    server_id sid(_sid);
+    std::vector<region_load> loads;
+
+    for (uint64_t i = 0; !up.error() && i < count; ++i)
+    {
+        uint64_t _rid;
+        uint64_t ops;
+        uint64_t bytes;
+        up = up >> _rid >> ops >> bytes;
+        loads.push_back(region_load(region_id(_rid), sid, ops, bytes));
+    }
+
+    CHECK_UNPACK(report_load);
+    c->report_load(ctx, sid, loads);
+}
+
 } // extern "C"
 
 /////////////////////////////// Coordinator Class //////////////////////////////
@@ -398,6 +454,9 @@ coordinator :: coordinator()
     , m_capture_server_references()
     , m_capture_transfer_references()
     , m_region_server_references()
+    , m_region_loads()
+    , m_region_splits()
+    , m_region_departures()
     , m_latest_config()
     , m_resp()
     , m_seed()
@@ -501,6 +560,50 @@ coordinator :: rm_space(replicant_state_machine_context* ctx, const char* name)
     }
 }
 
+void
+coordinator :: add_index(replicant_state_machine_context* ctx,
+                         const char* name, const char* attr)
+{
+    FILE* log = replicant_state_machine_log_stream(ctx);
+    std::map<std::string, std::tr1::shared_ptr<space> >::iterator it;
+    it = m_spaces.find(std::string(name));
+
+    if (it == m_spaces.end())
+    {
+        fprintf(log, "could not index \"%s\" because space \"%s\" doesn't exist\n", attr, name);
+        return generate_response(ctx, COORD_NOT_FOUND);
+    }
+
+    space* s = it->second.get();
+    uint16_t attrnum = s->sc.lookup_attr(attr);
+
+    if (attrnum == s->sc.attrs_sz)
+    {
+        fprintf(log, "could not index \"%s\" because space \"%s\" has no such attribute\n", attr, name);
+        return generate_response(ctx, COORD_NOT_FOUND);
+    }
+
+    if (s->is_indexed(attrnum))
+    {
+        fprintf(log, "could not index \"%s\" of space \"%s\" because it is already indexed\n", attr, name);
+        return generate_response(ctx, COORD_DUPLICATE);
+    }
+
+    s->indices.push_back(attrnum);
+
+    if (!s->validate())
+    {
+        s->indices.pop_back();
+        fprintf(log, "could not index \"%s\" of space \"%s\" because the space does not validate\n", attr, name);
+        return generate_response(ctx, COORD_MALFORMED);
+    }
+
+    // Every server backfills the new index for its regions in the background
+    fprintf(log, "successfully indexed \"%s\" of space \"%s\"\n", attr, name);
+    issue_new_config(ctx);
+    return generate_response(ctx, COORD_SUCCESS);
+}
+
 void
 coordinator :: get_config(replicant_state_machine_context* ctx)
 {
@@ -866,6 +969,19 @@ coordinator :: xfer_complete(replicant_state_machine_context* ctx,
         return generate_response(ctx, COORD_SUCCESS);
     }
 
+    for (size_t i = 0; i < m_region_departures.size(); ++i)
+    {
+        if (m_region_departures[i].first == xid &&
+            reg->replicas.size() > 1)
+        {
+            server_id departing = m_region_departures[i].second;
+            remove_replica(reg, departing);
+            fprintf(log, "server_id(%lu) leaves region_id(%lu) now that "
+                         "transfer_id(%lu) has migrated it\n",
+                         departing.get(), reg->id.get(), xid.get());
+        }
+    }
+
     del_transfer(xfer->id);
     fprintf(log, "transfer_id(%lu) is now complete\n", xid.get());
     issue_new_config(ctx);
@@ -873,6 +989,56 @@ coordinator :: xfer_complete(replicant_state_machine_context* ctx,
     return generate_response(ctx, COORD_SUCCESS);
 }
 
+void
+coordinator :: report_load(replicant_state_machine_context* ctx,
+                           const server_id& sid,
+                           const std::vector<region_load>& loads)
+{
+    FILE* log = replicant_state_machine_log_stream(ctx);
+
+    if (!is_registered(sid))
+    {
+        fprintf(log, "ignoring load report from server_id(%lu) because "
+                     "the server does not exist\n", sid.get());
+        return generate_response(ctx, COORD_NOT_FOUND);
+    }
+
+    size_t i = 0;
+
+    while (i < m_region_loads.size())
+    {
+        if (m_region_loads[i].sid == sid)
+        {
+            m_region_loads[i] = m_region_loads.back();
+            m_region_loads.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    for (i = 0; i < loads.size(); ++i)
+    {
+        if (get_region(loads[i].rid))
+        {
+            m_region_loads.push_back(loads[i]);
+        }
+    }
+
+    std::sort(m_region_loads.begin(), m_region_loads.end());
+
+    // Rebalance only while no transfer is in flight, so that restoring fault
+    // tolerance always takes precedence and at most one region moves at once.
+    if (m_transfers.empty() &&
+        (split_region(ctx) || merge_region(ctx)))
+    {
+        issue_new_config(ctx);
+    }
+
+    return generate_response(ctx, COORD_SUCCESS);
+}
+
 server_state*
 coordinator :: get_state(const server_id& sid)
 {
@@ -1023,6 +1189,16 @@ coordinator :: del_transfer(const transfer_id& xid)
         {
             release_capture_reference(m_transfers[i].id);
 
+            for (size_t j = 0; j < m_region_departures.size(); ++j)
+            {
+                if (m_region_departures[j].first == xid)
+                {
+                    m_region_departures[j] = m_region_departures.back();
+                    m_region_departures.pop_back();
+                    break;
+                }
+            }
+
             for (size_t j = i; j + 1 < m_transfers.size(); ++j)
             {
                 m_transfers[j] = m_transfers[j + 1];
@@ -1293,6 +1469,380 @@ coordinator :: remove_server(const server_id& sid, bool dry_run, bool shutdown,
     }
 }
 
+bool
+coordinator :: region_totals(const region_id& rid, uint64_t* ops, uint64_t* bytes)
+{
+    std::vector<region_load>::iterator it;
+    it = std::lower_bound(m_region_loads.begin(), m_region_loads.end(),
+                          region_load(rid, server_id(), 0, 0));
+    bool found = false;
+    *ops = 0;
+    *bytes = 0;
+
+    for (; it != m_region_loads.end() && it->rid == rid; ++it)
+    {
+        found = true;
+        *ops += it->ops;
+        *bytes = std::max(*bytes, it->bytes);
+    }
+
+    return found;
+}
+
+uint64_t
+coordinator :: server_ops(const server_id& sid)
+{
+    uint64_t ops = 0;
+
+    for (size_t i = 0; i < m_region_loads.size(); ++i)
+    {
+        if (m_region_loads[i].sid == sid)
+        {
+            ops += m_region_loads[i].ops;
+        }
+    }
+
+    return ops;
+}
+
+void
+coordinator :: forget_load(const region_id& rid)
+{
+    size_t i = 0;
+
+    while (i < m_region_loads.size())
+    {
+        if (m_region_loads[i].rid == rid)
+        {
+            m_region_loads[i] = m_region_loads.back();
+            m_region_loads.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    std::sort(m_region_loads.begin(), m_region_loads.end());
+}
+
+server_id
+coordinator :: select_cold_server_for(const std::vector<replica>& replicas)
+{
+    server_id coldest;
+    uint64_t coldest_ops = 0;
+
+    for (size_t i = 0; i < m_servers.size(); ++i)
+    {
+        if (m_servers[i].state != server_state::AVAILABLE)
+        {
+            continue;
+        }
+
+        bool found = false;
+
+        for (size_t x = 0; x < replicas.size(); ++x)
+        {
+            if (m_servers[i].id == replicas[x].si)
+            {
+                found = true;
+            }
+        }
+
+        uint64_t ops = server_ops(m_servers[i].id);
+
+        if (!found && (coldest == server_id() || ops < coldest_ops))
+        {
+            coldest = m_servers[i].id;
+            coldest_ops = ops;
+        }
+    }
+
+    return coldest;
+}
+
+// Split the hottest region whose load exceeds the thresholds in half along
+// its widest dimension.  The new half starts on the same servers, which move
+// the affected objects locally, and is then migrated off the busiest of them.
+bool
+coordinator :: split_region(struct replicant_state_machine_context* ctx)
+{
+    FILE* log = replicant_state_machine_log_stream(ctx);
+    subspace* hot_ss = NULL;
+    region* hot = NULL;
+    uint64_t hot_ops = 0;
+    uint64_t hot_bytes = 0;
+
+    for (std::map<std::string, std::tr1::shared_ptr<space> >::iterator it = m_spaces.begin();
+            it != m_spaces.end(); ++it)
+    {
+        space& s(*it->second);
+
+        for (size_t i = 0; i < s.subspaces.size(); ++i)
+        {
+            subspace& ss(s.subspaces[i]);
+
+            for (size_t j = 0; j < ss.regions.size(); ++j)
+            {
+                region& reg(ss.regions[j]);
+                uint64_t ops;
+                uint64_t bytes;
+
+                if (reg.replicas.empty() ||
+                    !region_totals(reg.id, &ops, &bytes) ||
+                    (ops < REGION_SPLIT_OPS && bytes < REGION_SPLIT_BYTES) ||
+                    (hot && ops <= hot_ops))
+                {
+                    continue;
+                }
+
+                bool splittable = false;
+
+                for (size_t a = 0; a < reg.lower_coord.size(); ++a)
+                {
+                    splittable = splittable || reg.lower_coord[a] < reg.upper_coord[a];
+                }
+
+                if (splittable)
+                {
+                    hot_ss = &ss;
+                    hot = &reg;
+                    hot_ops = ops;
+                    hot_bytes = bytes;
+                }
+            }
+        }
+    }
+
+    if (!hot)
+    {
+        return false;
+    }
+
+    size_t dim = 0;
+    uint64_t width = 0;
+
+    for (size_t a = 0; a < hot->lower_coord.size(); ++a)
+    {
+        if (hot->upper_coord[a] - hot->lower_coord[a] > width)
+        {
+            dim = a;
+            width = hot->upper_coord[a] - hot->lower_coord[a];
+        }
+    }
+
+    uint64_t mid = hot->lower_coord[dim] + width / 2;
+    region child(*hot);
+    child.id = region_id(m_counter);
+    ++m_counter;
+    child.lower_coord[dim] = mid + 1;
+    hot->upper_coord[dim] = mid;
+
+    for (size_t i = 0; i < child.replicas.size(); ++i)
+    {
+        child.replicas[i].vsi = virtual_server_id(m_counter);
+        ++m_counter;
+    }
+
+    fprintf(log, "splitting region_id(%lu) into region_id(%lu) at %lu in "
+                 "dimension %lu because it serves %lu ops/s and holds %lu bytes\n",
+                 hot->id.get(), child.id.get(), mid, dim, hot_ops, hot_bytes);
+    forget_load(hot->id);
+    m_region_splits.push_back(std::make_pair(hot->id, child.id));
+    hot_ss->regions.push_back(child);
+    region* reg = &hot_ss->regions.back();
+    server_id busiest;
+    uint64_t busiest_ops = 0;
+
+    for (size_t i = 0; i < reg->replicas.size(); ++i)
+    {
+        uint64_t ops = server_ops(reg->replicas[i].si);
+
+        if (busiest == server_id() || ops > busiest_ops)
+        {
+            busiest = reg->replicas[i].si;
+            busiest_ops = ops;
+        }
+    }
+
+    server_id coldest = select_cold_server_for(reg->replicas);
+
+    if (coldest != server_id())
+    {
+        migrate_region(ctx, reg, coldest, busiest);
+    }
+
+    return true;
+}
+
+// Merge the most recent split back together once both halves are cold.  The
+// halves must be on the same servers to merge, so migrate the newer half onto
+// its sibling's servers first if they have diverged.
+bool
+coordinator :: merge_region(struct replicant_state_machine_context* ctx)
+{
+    FILE* log = replicant_state_machine_log_stream(ctx);
+
+    for (size_t i = m_region_splits.size(); i > 0; --i)
+    {
+        region* parent = get_region(m_region_splits[i - 1].first);
+        region* child = get_region(m_region_splits[i - 1].second);
+
+        if (!parent || !child)
+        {
+            m_region_splits.erase(m_region_splits.begin() + i - 1);
+            continue;
+        }
+
+        uint64_t parent_ops;
+        uint64_t parent_bytes;
+        uint64_t child_ops;
+        uint64_t child_bytes;
+
+        if (!region_totals(parent->id, &parent_ops, &parent_bytes) ||
+            !region_totals(child->id, &child_ops, &child_bytes) ||
+            parent_ops + child_ops >= REGION_MERGE_OPS ||
+            parent_bytes + child_bytes >= REGION_SPLIT_BYTES / 2 ||
+            get_capture(child->id))
+        {
+            continue;
+        }
+
+        // the halves must abut in exactly one dimension and match in the rest
+        size_t dim = parent->lower_coord.size();
+        bool adjacent = parent->lower_coord.size() == child->lower_coord.size();
+
+        for (size_t a = 0; adjacent && a < parent->lower_coord.size(); ++a)
+        {
+            if (parent->lower_coord[a] == child->lower_coord[a] &&
+                parent->upper_coord[a] == child->upper_coord[a])
+            {
+                continue;
+            }
+
+            adjacent = dim == parent->lower_coord.size() &&
+                       parent->upper_coord[a] < child->lower_coord[a] &&
+                       parent->upper_coord[a] + 1 == child->lower_coord[a];
+            dim = a;
+        }
+
+        if (!adjacent || dim == parent->lower_coord.size())
+        {
+            continue;
+        }
+
+        server_id to;
+        server_id from;
+
+        for (size_t x = 0; x < parent->replicas.size(); ++x)
+        {
+            bool found = false;
+
+            for (size_t y = 0; y < child->replicas.size(); ++y)
+            {
+                found = found || parent->replicas[x].si == child->replicas[y].si;
+            }
+
+            if (!found)
+            {
+                to = parent->replicas[x].si;
+            }
+        }
+
+        for (size_t y = 0; y < child->replicas.size(); ++y)
+        {
+            bool found = false;
+
+            for (size_t x = 0; x < parent->replicas.size(); ++x)
+            {
+                found = found || parent->replicas[x].si == child->replicas[y].si;
+            }
+
+            if (!found)
+            {
+                from = child->replicas[y].si;
+            }
+        }
+
+        if (to == server_id() && from == server_id() &&
+            parent->replicas.size() == child->replicas.size())
+        {
+            region_id parent_id = parent->id;
+            region_id child_id = child->id;
+            parent->upper_coord[dim] = child->upper_coord[dim];
+
+            for (std::map<std::string, std::tr1::shared_ptr<space> >::iterator it = m_spaces.begin();
+                    it != m_spaces.end(); ++it)
+            {
+                space& s(*it->second);
+
+                for (size_t j = 0; j < s.subspaces.size(); ++j)
+                {
+                    remove(&s.subspaces[j].regions, child_id);
+                }
+            }
+
+            forget_load(parent_id);
+            forget_load(child_id);
+            release_region_reference(child_id);
+            m_region_splits.erase(m_region_splits.begin() + i - 1);
+            fprintf(log, "merging region_id(%lu) back into region_id(%lu) "
+                         "because together they serve %lu ops/s\n",
+                         child_id.get(), parent_id.get(), parent_ops + child_ops);
+            return true;
+        }
+
+        server_state* state = get_state(to);
+
+        if (to != server_id() && from != server_id() &&
+            state && state->state == server_state::AVAILABLE)
+        {
+            migrate_region(ctx, child, to, from);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+coordinator :: migrate_region(struct replicant_state_machine_context* ctx,
+                              region* reg,
+                              const server_id& to,
+                              const server_id& from)
+{
+    FILE* log = replicant_state_machine_log_stream(ctx);
+    transfer* xfer = new_transfer(reg, to);
+    m_region_departures.push_back(std::make_pair(xfer->id, from));
+    fprintf(log, "migrating region_id(%lu) from server_id(%lu) to server_id(%lu) "
+                 "using transfer_id(%lu)/virtual_server_id(%lu)\n",
+                 reg->id.get(), from.get(), to.get(),
+                 xfer->id.get(), xfer->vdst.get());
+}
+
+void
+coordinator :: remove_replica(region* reg, const server_id& sid)
+{
+    size_t k = 0;
+
+    while (k < reg->replicas.size())
+    {
+        if (reg->replicas[k].si == sid)
+        {
+            for (size_t x = k; x + 1 < reg->replicas.size(); ++x)
+            {
+                reg->replicas[x] = reg->replicas[x + 1];
+            }
+
+            reg->replicas.pop_back();
+        }
+        else
+        {
+            ++k;
+        }
+    }
+}
+
 server_id
 coordinator :: select_new_server_for(const std::vector<replica>& replicas)
 {
@@ -50,6 +50,7 @@
 #include "common/ids.h"
 #include "common/transfer.h"
 #include "coordinator/missing_acks.h"
+#include "coordinator/region_load.h"
 #include "coordinator/server_state.h"
 
 namespace hyperdex
@@ -70,6 +71,8 @@ class coordinator
         // Manage spaces
         void add_space(replicant_state_machine_context* ctx, const space& s);
         void rm_space(replicant_state_machine_context* ctx, const char* name);
+        void add_index(replicant_state_machine_context* ctx,
+                       const char* space, const char* attr);
         // Issue configs
         void get_config(replicant_state_machine_context* ctx);
         void ack_config(replicant_state_machine_context* ctx, const server_id&, uint64_t version);
@@ -94,6 +97,10 @@ class coordinator
                           const transfer_id& xid);
         void xfer_complete(replicant_state_machine_context* ctx,
                            const transfer_id& xid);
+        // Load balancing
+        void report_load(replicant_state_machine_context* ctx,
+                         const server_id& sid,
+                         const std::vector<region_load>& loads);
 
     private:
         // servers
@@ -121,6 +128,16 @@ class coordinator
         server_id get_region_reference(const region_id& rid);
         void release_region_reference(const region_id& rid);
         void release_region_references(const server_id& sid);
+        // load balancing
+        bool region_totals(const region_id& rid, uint64_t* ops, uint64_t* bytes);
+        uint64_t server_ops(const server_id& sid);
+        void forget_load(const region_id& rid);
+        server_id select_cold_server_for(const std::vector<replica>& replicas);
+        bool split_region(struct replicant_state_machine_context* ctx);
+        bool merge_region(struct replicant_state_machine_context* ctx);
+        void migrate_region(struct replicant_state_machine_context* ctx,
+                            region* reg, const server_id& to, const server_id& from);
+        void remove_replica(region* reg, const server_id& sid);
         // other
         void remove_server(const server_id& sid, bool dry_run, bool shutdown,
                            std::vector<region_id>* rids,
@@ -144,6 +161,11 @@ class coordinator
         std::vector<std::pair<capture_id, server_id> > m_capture_server_references;
         std::vector<std::pair<capture_id, transfer_id> > m_capture_transfer_references;
         std::vector<std::pair<region_id, server_id> > m_region_server_references;
+        std::vector<region_load> m_region_loads;
+        // (parent, child) for each split that has not been merged back
+        std::vector<std::pair<region_id, region_id> > m_region_splits;
+        // the server to drop from a region once the transfer completes
+        std::vector<std::pair<transfer_id, server_id> > m_region_departures;
         std::auto_ptr<e::buffer> m_latest_config; // cached config
         std::auto_ptr<e::buffer> m_resp; // response space
 #ifdef __APPLE__
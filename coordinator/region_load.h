@@ -0,0 +1,96 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_coordinator_region_load_h_
+#define hyperdex_coordinator_region_load_h_
+
+// HyperDex
+#include "common/ids.h"
+
+namespace hyperdex
+{
+
+// The load one server most recently reported for one region
+class region_load
+{
+    public:
+        region_load();
+        region_load(const region_id& _rid,
+                    const server_id& _sid,
+                    uint64_t _ops,
+                    uint64_t _bytes);
+        ~region_load() throw ();
+
+    public:
+        region_id rid;
+        server_id sid;
+        // operations per second
+        uint64_t ops;
+        // approximate bytes on disk
+        uint64_t bytes;
+};
+
+inline
+region_load :: region_load()
+    : rid()
+    , sid()
+    , ops(0)
+    , bytes(0)
+{
+}
+
+inline
+region_load :: region_load(const region_id& _rid,
+                           const server_id& _sid,
+                           uint64_t _ops,
+                           uint64_t _bytes)
+    : rid(_rid)
+    , sid(_sid)
+    , ops(_ops)
+    , bytes(_bytes)
+{
+}
+
+inline
+region_load :: ~region_load() throw ()
+{
+}
+
+inline bool
+operator < (const region_load& lhs, const region_load& rhs)
+{
+    if (lhs.rid == rhs.rid)
+    {
+        return lhs.sid < rhs.sid;
+    }
+
+    return lhs.rid < rhs.rid;
+}
+
+} // namespace hyperdex
+
+#endif // hyperdex_coordinator_region_load_h_
@@ -42,6 +42,7 @@ struct replicant_state_machine rsm = {
      {"xfer-begin", hyperdex_coordinator_xfer_begin},
      {"xfer-go-live", hyperdex_coordinator_xfer_go_live},
      {"xfer-complete", hyperdex_coordinator_xfer_complete},
+     {"report-load", hyperdex_coordinator_report_load},
 
      {"server-register", hyperdex_coordinator_server_register},
      {"server-reregister", hyperdex_coordinator_server_reregister},
@@ -51,6 +52,7 @@ struct replicant_state_machine rsm = {
 
      {"add-space", hyperdex_coordinator_add_space},
      {"rm-space", hyperdex_coordinator_rm_space},
+     {"add-index", hyperdex_coordinator_add_index},
 
      {"initialize", hyperdex_coordinator_initialize},
      {NULL, NULL}}
@@ -59,6 +59,7 @@ TRANSITION(initialize);
 
 TRANSITION(add_space);
 TRANSITION(rm_space);
+TRANSITION(add_index);
 
 TRANSITION(get_config);
 TRANSITION(ack_config);
@@ -73,6 +74,8 @@ TRANSITION(xfer_begin);
 TRANSITION(xfer_complete);
 TRANSITION(xfer_go_live);
 
+TRANSITION(report_load);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif /* __cplusplus */
@@ -0,0 +1,244 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <algorithm>
+
+// HyperDex
+#include "daemon/acked_window.h"
+
+using hyperdex::acked_window;
+
+static uint64_t
+bit_of(uint64_t seq_id)
+{
+    return static_cast<uint64_t>(1) << (seq_id % 64);
+}
+
+acked_window :: acked_window()
+    : m_lock()
+    , m_windows()
+{
+}
+
+acked_window :: ~acked_window() throw ()
+{
+}
+
+bool
+acked_window :: check(const region_id& ri,
+                      const region_id& reg_id,
+                      uint64_t seq_id)
+{
+    po6::threads::mutex::hold hold(&m_lock);
+    window_map_t::iterator it = m_windows.find(window_key(reg_id, ri));
+
+    if (it == m_windows.end())
+    {
+        return false;
+    }
+
+    if (seq_id < it->second.done)
+    {
+        return true;
+    }
+
+    window::word_map_t::iterator w = it->second.words.find(seq_id / 64);
+    return w != it->second.words.end() && (w->second.acked & bit_of(seq_id));
+}
+
+bool
+acked_window :: stage(const region_id& ri,
+                      const region_id& reg_id,
+                      uint64_t seq_id,
+                      row* r)
+{
+    po6::threads::mutex::hold hold(&m_lock);
+    window* win = &m_windows[window_key(reg_id, ri)];
+
+    if (seq_id < win->done)
+    {
+        return false;
+    }
+
+    // Acks staged ahead of us reach the disk no later than we do, so the row
+    // may carry them too.  A failed write fails every write after it, so a
+    // row never lands carrying the bit of an operation that did not.
+    word* w = &win->words[seq_id / 64];
+    w->pending |= bit_of(seq_id);
+    *r = row(ri, reg_id, seq_id / 64, w->acked | w->pending);
+    return true;
+}
+
+void
+acked_window :: commit(const region_id& ri,
+                       const region_id& reg_id,
+                       uint64_t seq_id)
+{
+    po6::threads::mutex::hold hold(&m_lock);
+    window* win = &m_windows[window_key(reg_id, ri)];
+    word* w = &win->words[seq_id / 64];
+    w->acked |= bit_of(seq_id);
+    w->pending &= ~bit_of(seq_id);
+    win->max = std::max(win->max, seq_id);
+}
+
+void
+acked_window :: abort(const region_id& ri,
+                      const region_id& reg_id,
+                      uint64_t seq_id)
+{
+    po6::threads::mutex::hold hold(&m_lock);
+    window* win = &m_windows[window_key(reg_id, ri)];
+    window::word_map_t::iterator w = win->words.find(seq_id / 64);
+
+    if (w != win->words.end())
+    {
+        w->second.pending &= ~bit_of(seq_id);
+    }
+}
+
+void
+acked_window :: advance(const region_id& reg_id,
+                        uint64_t seq_id,
+                        std::vector<row>* dropped)
+{
+    po6::threads::mutex::hold hold(&m_lock);
+    window_map_t::iterator it = m_windows.lower_bound(window_key(reg_id, region_id()));
+
+    for (; it != m_windows.end() && it->first.first == reg_id; ++it)
+    {
+        window* win = &it->second;
+
+        if (seq_id <= win->done)
+        {
+            continue;
+        }
+
+        win->done = seq_id;
+        window::word_map_t::iterator w = win->words.begin();
+
+        // drop the words that lie wholly below the watermark
+        while (w != win->words.end() && (w->first + 1) * 64 <= win->done)
+        {
+            if (w->second.pending)
+            {
+                ++w;
+                continue;
+            }
+
+            dropped->push_back(row(it->first.second, reg_id, w->first, w->second.acked));
+            win->words.erase(w++);
+        }
+    }
+}
+
+uint64_t
+acked_window :: max_seq_id(const region_id& reg_id)
+{
+    po6::threads::mutex::hold hold(&m_lock);
+    window_map_t::iterator it = m_windows.find(window_key(reg_id, reg_id));
+    return it != m_windows.end() ? it->second.max : 0;
+}
+
+void
+acked_window :: restore(const row& r)
+{
+    po6::threads::mutex::hold hold(&m_lock);
+    window* win = &m_windows[window_key(r.reg_id, r.ri)];
+    win->words[r.index].acked |= r.bits;
+
+    for (int i = 63; i >= 0; --i)
+    {
+        if (r.bits & (static_cast<uint64_t>(1) << i))
+        {
+            win->max = std::max(win->max, r.index * 64 + i);
+            break;
+        }
+    }
+}
+
+void
+acked_window :: all_rows(std::vector<row>* rows)
+{
+    po6::threads::mutex::hold hold(&m_lock);
+
+    for (window_map_t::iterator it = m_windows.begin();
+            it != m_windows.end(); ++it)
+    {
+        for (window::word_map_t::iterator w = it->second.words.begin();
+                w != it->second.words.end(); ++w)
+        {
+            rows->push_back(row(it->first.second, it->first.first,
+                                w->first, w->second.acked));
+        }
+    }
+}
+
+acked_window :: row :: row()
+    : ri()
+    , reg_id()
+    , index(0)
+    , bits(0)
+{
+}
+
+acked_window :: row :: row(const region_id& r,
+                           const region_id& rid,
+                           uint64_t i,
+                           uint64_t b)
+    : ri(r)
+    , reg_id(rid)
+    , index(i)
+    , bits(b)
+{
+}
+
+acked_window :: row :: ~row() throw ()
+{
+}
+
+acked_window :: word :: word()
+    : acked(0)
+    , pending(0)
+{
+}
+
+acked_window :: word :: ~word() throw ()
+{
+}
+
+acked_window :: window :: window()
+    : done(0)
+    , max(0)
+    , words()
+{
+}
+
+acked_window :: window :: ~window() throw ()
+{
+}
@@ -0,0 +1,150 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_acked_window_h_
+#define hyperdex_daemon_acked_window_h_
+
+// STL
+#include <map>
+#include <utility>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// HyperDex
+#include "common/ids.h"
+
+namespace hyperdex
+{
+
+// Tracks, for each (region, point leader) pair, which seq_ids we have sent an
+// ACK for.  Every seq_id below a per-window watermark is acked; above it, one
+// 64-bit word per 64 seq_ids records the acks.  Each word is persisted as a
+// single row that the datalayer rewrites in the same WriteBatch as the
+// operation it acks, so 64 operations share a row instead of taking one each.
+class acked_window
+{
+    public:
+        class row;
+
+    public:
+        acked_window();
+        ~acked_window() throw ();
+
+    public:
+        // true only for acks whose write reached the disk
+        bool check(const region_id& ri,
+                   const region_id& reg_id,
+                   uint64_t seq_id);
+        // Mark seq_id in flight and fill in the row that records it, along
+        // with every ack staged before it.  Must be called in the order the
+        // rows reach the disk.  False if seq_id is below the watermark and
+        // needs no row.
+        bool stage(const region_id& ri,
+                   const region_id& reg_id,
+                   uint64_t seq_id,
+                   row* r);
+        // the write carrying a staged seq_id succeeded or failed
+        void commit(const region_id& ri,
+                    const region_id& reg_id,
+                    uint64_t seq_id);
+        void abort(const region_id& ri,
+                   const region_id& reg_id,
+                   uint64_t seq_id);
+        // Every seq_id below "seq_id" from "reg_id" is acked on every region.
+        // Fills in the rows that no longer need to be kept.
+        void advance(const region_id& reg_id,
+                     uint64_t seq_id,
+                     std::vector<row>* dropped);
+        // the largest seq_id reg_id acked to itself
+        uint64_t max_seq_id(const region_id& reg_id);
+        void restore(const row& r);
+        void all_rows(std::vector<row>* rows);
+
+    private:
+        class word;
+        class window;
+        // ordered by point leader first so "advance" walks one range
+        typedef std::pair<region_id, region_id> window_key;
+        typedef std::map<window_key, window> window_map_t;
+
+    private:
+        acked_window(const acked_window&);
+        acked_window& operator = (const acked_window&);
+
+    private:
+        po6::threads::mutex m_lock;
+        window_map_t m_windows;
+};
+
+class acked_window::row
+{
+    public:
+        row();
+        row(const region_id& ri, const region_id& reg_id,
+            uint64_t index, uint64_t bits);
+        ~row() throw ();
+
+    public:
+        region_id ri;
+        region_id reg_id;
+        // the row covers seq_ids [64 * index, 64 * index + 64)
+        uint64_t index;
+        uint64_t bits;
+};
+
+class acked_window::word
+{
+    public:
+        word();
+        ~word() throw ();
+
+    public:
+        uint64_t acked;
+        uint64_t pending;
+};
+
+class acked_window::window
+{
+    public:
+        typedef std::map<uint64_t, word> word_map_t;
+
+    public:
+        window();
+        ~window() throw ();
+
+    public:
+        // every seq_id below done is acked
+        uint64_t done;
+        uint64_t max;
+        word_map_t words;
+};
+
+} // namespace hyperdex
+
+#endif // hyperdex_daemon_acked_window_h_
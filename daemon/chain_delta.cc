@@ -0,0 +1,99 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <cstring>
+
+// HyperDex
+#include "common/serialization.h"
+#include "daemon/chain_delta.h"
+
+bool
+hyperdex :: chain_delta_diff(const std::vector<e::slice>& base,
+                             const std::vector<e::slice>& value,
+                             std::vector<uint16_t>* changed)
+{
+    changed->clear();
+
+    if (base.size() != value.size())
+    {
+        return false;
+    }
+
+    size_t delta_sz = sizeof(uint16_t);
+
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        if (base[i] != value[i])
+        {
+            changed->push_back(i);
+            delta_sz += sizeof(uint16_t) + pack_size(value[i]);
+        }
+    }
+
+    return delta_sz < pack_size(value);
+}
+
+bool
+hyperdex :: chain_delta_apply(const std::vector<e::slice>& base,
+                              const std::vector<std::pair<uint16_t, e::slice> >& delta,
+                              std::auto_ptr<e::buffer>* backing,
+                              std::vector<e::slice>* value)
+{
+    *value = base;
+
+    for (size_t i = 0; i < delta.size(); ++i)
+    {
+        if (delta[i].first >= value->size())
+        {
+            return false;
+        }
+
+        (*value)[delta[i].first] = delta[i].second;
+    }
+
+    // copy the value out of the old version's buffers and the message
+    size_t sz = 0;
+
+    for (size_t i = 0; i < value->size(); ++i)
+    {
+        sz += (*value)[i].size();
+    }
+
+    backing->reset(e::buffer::create(sz));
+    (*backing)->resize(sz);
+    uint8_t* ptr = (*backing)->data();
+
+    for (size_t i = 0; i < value->size(); ++i)
+    {
+        memmove(ptr, (*value)[i].data(), (*value)[i].size());
+        (*value)[i] = e::slice(ptr, (*value)[i].size());
+        ptr += (*value)[i].size();
+    }
+
+    return true;
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_chain_delta_h_
+#define hyperdex_daemon_chain_delta_h_
+
+// STL
+#include <memory>
+#include <utility>
+#include <vector>
+
+// e
+#include <e/buffer.h>
+#include <e/slice.h>
+
+namespace hyperdex
+{
+
+// A delta CHAIN_OP carries only the attributes that changed since version - 1,
+// as (attribute index, value) pairs.
+
+// Collect into "changed" the attributes of "value" that differ from "base".
+// True if sending just those is smaller than sending all of "value".
+bool
+chain_delta_diff(const std::vector<e::slice>& base,
+                 const std::vector<e::slice>& value,
+                 std::vector<uint16_t>* changed);
+
+// Rebuild the full value by applying "delta" to "base".  The result is copied
+// into "backing" so that it outlives both.  False if "delta" names an
+// attribute that "base" does not have.
+bool
+chain_delta_apply(const std::vector<e::slice>& base,
+                  const std::vector<std::pair<uint16_t, e::slice> >& delta,
+                  std::auto_ptr<e::buffer>* backing,
+                  std::vector<e::slice>* value);
+
+} // namespace hyperdex
+
+#endif // hyperdex_daemon_chain_delta_h_
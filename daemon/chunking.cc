@@ -0,0 +1,143 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <algorithm>
+#include <utility>
+
+// Google CityHash
+#include <city.h>
+
+// HyperDex
+#include "daemon/chunking.h"
+
+// Chunks average CHUNK_MASK + 1 bytes, but never fall outside
+// [CHUNK_MIN_BYTES, CHUNK_MAX_BYTES] except for the last one
+#define CHUNK_MIN_BYTES (4U * 1024U)
+#define CHUNK_MAX_BYTES (64U * 1024U)
+#define CHUNK_MASK 0x3fffULL
+
+static uint64_t
+gear(uint8_t b)
+{
+    uint64_t x = (b + 1ULL) * 0x9e3779b97f4a7c15ULL;
+    x ^= x >> 29;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 32;
+    return x;
+}
+
+void
+hyperdex :: chunk_boundaries(const e::slice& value,
+                             std::vector<size_t>* ends)
+{
+    const uint8_t* data = value.data();
+    size_t start = 0;
+    uint64_t h = 0;
+    ends->clear();
+
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        h = (h << 1) + gear(data[i]);
+        size_t len = i + 1 - start;
+
+        if ((len >= CHUNK_MIN_BYTES && (h & CHUNK_MASK) == 0) ||
+            len >= CHUNK_MAX_BYTES)
+        {
+            ends->push_back(i + 1);
+            start = i + 1;
+            h = 0;
+        }
+    }
+
+    if (start < value.size() || ends->empty())
+    {
+        ends->push_back(value.size());
+    }
+}
+
+void
+hyperdex :: chunk_hashes(const e::slice& value,
+                         const std::vector<size_t>& ends,
+                         std::vector<uint64_t>* hashes)
+{
+    size_t start = 0;
+    hashes->clear();
+
+    for (size_t i = 0; i < ends.size(); ++i)
+    {
+        const char* chunk = reinterpret_cast<const char*>(value.data()) + start;
+        hashes->push_back(CityHash64(chunk, ends[i] - start));
+        start = ends[i];
+    }
+}
+
+void
+hyperdex :: chunk_diff(const std::vector<uint64_t>& old_hashes,
+                       const std::vector<uint64_t>& new_hashes,
+                       std::vector<size_t>* put,
+                       std::vector<uint64_t>* del)
+{
+    std::vector<uint64_t> old_sorted(old_hashes);
+    std::sort(old_sorted.begin(), old_sorted.end());
+    std::vector<uint64_t> new_sorted(new_hashes);
+    std::sort(new_sorted.begin(), new_sorted.end());
+    // (hash, index) of every new chunk whose content is not yet stored
+    std::vector<std::pair<uint64_t, size_t> > fresh;
+    put->clear();
+    del->clear();
+
+    for (size_t i = 0; i < new_hashes.size(); ++i)
+    {
+        if (!std::binary_search(old_sorted.begin(), old_sorted.end(), new_hashes[i]))
+        {
+            fresh.push_back(std::make_pair(new_hashes[i], i));
+        }
+    }
+
+    // write each distinct chunk once
+    std::sort(fresh.begin(), fresh.end());
+
+    for (size_t i = 0; i < fresh.size(); ++i)
+    {
+        if (i == 0 || fresh[i - 1].first != fresh[i].first)
+        {
+            put->push_back(fresh[i].second);
+        }
+    }
+
+    std::sort(put->begin(), put->end());
+
+    for (size_t i = 0; i < old_sorted.size(); ++i)
+    {
+        if ((i == 0 || old_sorted[i - 1] != old_sorted[i]) &&
+            !std::binary_search(new_sorted.begin(), new_sorted.end(), old_sorted[i]))
+        {
+            del->push_back(old_sorted[i]);
+        }
+    }
+}
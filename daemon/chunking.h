@@ -0,0 +1,62 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_chunking_h_
+#define hyperdex_daemon_chunking_h_
+
+// STL
+#include <vector>
+
+// e
+#include <e/slice.h>
+
+namespace hyperdex
+{
+
+// Pick content-defined chunk boundaries, so that an insert or append only
+// changes the chunks around it; "ends" gets the end offset of each chunk
+void
+chunk_boundaries(const e::slice& value,
+                 std::vector<size_t>* ends);
+// The content hash of each chunk of "value" delimited by "ends"
+void
+chunk_hashes(const e::slice& value,
+             const std::vector<size_t>& ends,
+             std::vector<uint64_t>* hashes);
+// Chunk rows are keyed by content hash, so an attribute's rewrite touches
+// only the chunks whose content is new.  "put" gets the index of the first
+// chunk with each hash that "old_hashes" lacks, and "del" each hash of
+// "old_hashes" that "new_hashes" no longer uses.
+void
+chunk_diff(const std::vector<uint64_t>& old_hashes,
+           const std::vector<uint64_t>& new_hashes,
+           std::vector<size_t>* put,
+           std::vector<uint64_t>* del);
+
+} // namespace hyperdex
+
+#endif // hyperdex_daemon_chunking_h_
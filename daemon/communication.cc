@@ -31,9 +31,15 @@
 #include "config.h"
 #endif
 
+// C
+#include <cstring>
+
 // Google Log
 #include <glog/logging.h>
 
+// e
+#include <e/endian.h>
+
 // HyperDex
 #include "daemon/communication.h"
 #include "daemon/daemon.h"
@@ -41,6 +47,9 @@
 using hyperdex::communication;
 using hyperdex::reconfigure_returncode;
 
+// A CHAIN_BATCH is sent as soon as its entries take this many bytes
+#define CHAIN_BATCH_MAX_BYTES (64 * 1024)
+
 //////////////////////////////// Early Messages ////////////////////////////////
 
 class communication::early_message
@@ -77,13 +86,99 @@ communication :: early_message :: ~early_message() throw ()
 {
 }
 
+/////////////////////////////////// Batches //////////////////////////////////
+
+// Chain messages held for one (from, to) pair of virtual servers.  Each entry
+// is the message type followed by the message body (everything after the
+// header) packed as a slice.
+class communication::batch
+{
+    public:
+        batch(const virtual_server_id& from, const virtual_server_id& to);
+        ~batch() throw ();
+
+    public:
+        po6::threads::mutex lock;
+        const virtual_server_id from;
+        const virtual_server_id to;
+        uint64_t config_version;
+        uint32_t count;
+        std::vector<char> entries;
+
+    private:
+        friend class e::intrusive_ptr<batch>;
+
+    private:
+        void inc() { __sync_add_and_fetch(&m_ref, 1); }
+        void dec() { if (__sync_sub_and_fetch(&m_ref, 1) == 0) delete this; }
+
+    private:
+        size_t m_ref;
+};
+
+communication :: batch :: batch(const virtual_server_id& f,
+                                 const virtual_server_id& t)
+    : lock()
+    , from(f)
+    , to(t)
+    , config_version(0)
+    , count(0)
+    , entries()
+    , m_ref(0)
+{
+}
+
+communication :: batch :: ~batch() throw ()
+{
+}
+
+/////////////////////////////////// Mapper ///////////////////////////////////
+
+// Like the common mapper, but always resolves against the most recently
+// published configuration.
+class communication::config_mapper : public ::busybee_mapper
+{
+    public:
+        config_mapper(const rcu_configuration* config);
+        ~config_mapper() throw ();
+
+    public:
+        virtual bool lookup(uint64_t id, po6::net::location* addr);
+
+    private:
+        config_mapper(const config_mapper&);
+        config_mapper& operator = (const config_mapper&);
+
+    private:
+        const rcu_configuration* m_config;
+};
+
+communication :: config_mapper :: config_mapper(const rcu_configuration* config)
+    : m_config(config)
+{
+}
+
+communication :: config_mapper :: ~config_mapper() throw ()
+{
+}
+
+bool
+communication :: config_mapper :: lookup(uint64_t id, po6::net::location* addr)
+{
+    *addr = (*m_config)->get_address(server_id(id));
+    return *addr != po6::net::location();
+}
+
 ///////////////////////////////// Public Class /////////////////////////////////
 
 communication :: communication(daemon* d)
     : m_daemon(d)
-    , m_busybee_mapper(&m_daemon->m_config)
+    , m_busybee_mapper(new config_mapper(&m_daemon->m_config))
     , m_busybee()
     , m_early_messages()
+    , m_batches_lock()
+    , m_batches()
+    , m_dirty_batches()
 {
 }
 
@@ -95,7 +190,7 @@ bool
 communication :: setup(const po6::net::location& bind_to,
                        unsigned threads)
 {
-    m_busybee.reset(new busybee_mta(&m_busybee_mapper, bind_to, m_daemon->m_us.get(), threads));
+    m_busybee.reset(new busybee_mta(m_busybee_mapper.get(), bind_to, m_daemon->m_us.get(), threads));
     m_busybee->set_ignore_signals();
     return true;
 }
@@ -108,27 +203,30 @@ communication :: teardown()
 void
 communication :: reconfigure(const configuration&,
                              const configuration& new_config,
-                             const server_id&)
+                             const server_id& us)
 {
-    e::lockfree_fifo<early_message> ems;
-    early_message em;
+    deliver_early_messages(new_config.version());
 
-    while (m_early_messages.pop(&em))
+    // Forget batches between virtual servers that are no longer ours or no
+    // longer exist.  This runs alongside live workers on the fast path, so a
+    // sender may still hold one we erase; anything it adds is flushed from
+    // m_dirty_batches as usual, and flush_batch drops it if the destination
+    // is gone.
+    po6::threads::mutex::hold hold(&m_batches_lock);
+    batch_map_t::iterator it = m_batches.begin();
+
+    while (it != m_batches.end())
     {
-        if (em.config_version <= new_config.version())
+        if (new_config.get_server_id(it->first.first) != us ||
+            new_config.get_server_id(it->first.second) == server_id())
         {
-            m_busybee->deliver(em.id, em.msg);
+            m_batches.erase(it++);
         }
         else
         {
-            ems.push(em);
+            ++it;
         }
     }
-
-    while (ems.pop(&em))
-    {
-        m_early_messages.push(em);
-    }
 }
 
 bool
@@ -139,7 +237,7 @@ communication :: send_client(const virtual_server_id& from,
 {
     assert(msg->size() >= HYPERDEX_HEADER_SIZE_VC);
 
-    if (m_daemon->m_us != m_daemon->m_config.get_server_id(from))
+    if (m_daemon->m_us != m_daemon->m_config->get_server_id(from))
     {
         return false;
     }
@@ -187,9 +285,10 @@ communication :: send(const virtual_server_id& from,
                       network_msgtype msg_type,
                       std::auto_ptr<e::buffer> msg)
 {
+    const configuration* config = m_daemon->m_config.get();
     assert(msg->size() >= HYPERDEX_HEADER_SIZE_VV);
 
-    if (m_daemon->m_us != m_daemon->m_config.get_server_id(from))
+    if (m_daemon->m_us != config->get_server_id(from))
     {
         return false;
     }
@@ -197,7 +296,7 @@ communication :: send(const virtual_server_id& from,
     uint8_t mt = static_cast<uint8_t>(msg_type);
     uint8_t flags = 1;
     virtual_server_id vto(UINT64_MAX);
-    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config.version() << vto.get() << from.get();
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << config->version() << vto.get() << from.get();
 
     if (to == server_id())
     {
@@ -244,17 +343,18 @@ communication :: send(const virtual_server_id& from,
                       network_msgtype msg_type,
                       std::auto_ptr<e::buffer> msg)
 {
+    const configuration* config = m_daemon->m_config.get();
     assert(msg->size() >= HYPERDEX_HEADER_SIZE_VV);
 
-    if (m_daemon->m_us != m_daemon->m_config.get_server_id(from))
+    if (m_daemon->m_us != config->get_server_id(from))
     {
         return false;
     }
 
     uint8_t mt = static_cast<uint8_t>(msg_type);
     uint8_t flags = 1;
-    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config.version() << vto.get() << from.get();
-    server_id to = m_daemon->m_config.get_server_id(vto);
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << config->version() << vto.get() << from.get();
+    server_id to = config->get_server_id(vto);
 
     if (to == server_id())
     {
@@ -300,12 +400,13 @@ communication :: send(const virtual_server_id& vto,
                       network_msgtype msg_type,
                       std::auto_ptr<e::buffer> msg)
 {
+    const configuration* config = m_daemon->m_config.get();
     assert(msg->size() >= HYPERDEX_HEADER_SIZE_SV);
 
     uint8_t mt = static_cast<uint8_t>(msg_type);
     uint8_t flags = 0;
-    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config.version() << vto.get();
-    server_id to = m_daemon->m_config.get_server_id(vto);
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << config->version() << vto.get();
+    server_id to = config->get_server_id(vto);
 
     if (to == server_id())
     {
@@ -352,17 +453,18 @@ communication :: send_exact(const virtual_server_id& from,
                             network_msgtype msg_type,
                             std::auto_ptr<e::buffer> msg)
 {
+    const configuration* config = m_daemon->m_config.get();
     assert(msg->size() >= HYPERDEX_HEADER_SIZE_VV);
 
-    if (m_daemon->m_us != m_daemon->m_config.get_server_id(from))
+    if (m_daemon->m_us != config->get_server_id(from))
     {
         return false;
     }
 
     uint8_t mt = static_cast<uint8_t>(msg_type);
     uint8_t flags = 1 | 2;
-    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config.version() << vto.get() << from.get();
-    server_id to = m_daemon->m_config.get_server_id(vto);
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << config->version() << vto.get() << from.get();
+    server_id to = config->get_server_id(vto);
 
     if (to == server_id())
     {
@@ -403,6 +505,95 @@ communication :: send_exact(const virtual_server_id& from,
     return true;
 }
 
+bool
+communication :: send_batched(const virtual_server_id& from,
+                              const virtual_server_id& vto,
+                              network_msgtype msg_type,
+                              std::auto_ptr<e::buffer> msg)
+{
+    const configuration* config = m_daemon->m_config.get();
+    assert(msg->size() >= HYPERDEX_HEADER_SIZE_VV);
+
+    if (m_daemon->m_us != config->get_server_id(from) ||
+        config->get_server_id(vto) == server_id())
+    {
+        return false;
+    }
+
+    e::intrusive_ptr<batch> b;
+
+    {
+        po6::threads::mutex::hold hold(&m_batches_lock);
+        batch_map_t::iterator it = m_batches.find(batch_key_t(from, vto));
+
+        if (it == m_batches.end())
+        {
+            b = new batch(from, vto);
+            m_batches.insert(std::make_pair(batch_key_t(from, vto), b));
+        }
+        else
+        {
+            b = it->second;
+        }
+    }
+
+    po6::threads::mutex::hold hold(&b->lock);
+    uint64_t version = config->version();
+
+    // the receiver checks the batch against one version, so don't mix them
+    if (b->count > 0 && b->config_version != version)
+    {
+        flush_batch(b.get());
+    }
+
+    if (b->count == 0)
+    {
+        b->config_version = version;
+        po6::threads::mutex::hold holdd(&m_batches_lock);
+        m_dirty_batches.push_back(b);
+    }
+
+    uint8_t mt = static_cast<uint8_t>(msg_type);
+    uint32_t body_sz = msg->size() - HYPERDEX_HEADER_SIZE_VV;
+    size_t off = b->entries.size();
+    b->entries.resize(off + sizeof(uint8_t) + sizeof(uint32_t) + body_sz);
+    char* ptr = &b->entries[off];
+    ptr = e::pack8be(mt, ptr);
+    ptr = e::pack32be(body_sz, ptr);
+    memmove(ptr, msg->data() + HYPERDEX_HEADER_SIZE_VV, body_sz);
+    ++b->count;
+
+    if (b->entries.size() >= CHAIN_BATCH_MAX_BYTES)
+    {
+        flush_batch(b.get());
+    }
+
+    return true;
+}
+
+void
+communication :: flush_batches()
+{
+    std::vector<e::intrusive_ptr<batch> > dirty;
+
+    {
+        po6::threads::mutex::hold hold(&m_batches_lock);
+
+        if (m_dirty_batches.empty())
+        {
+            return;
+        }
+
+        dirty.swap(m_dirty_batches);
+    }
+
+    for (size_t i = 0; i < dirty.size(); ++i)
+    {
+        po6::threads::mutex::hold hold(&dirty[i]->lock);
+        flush_batch(dirty[i].get());
+    }
+}
+
 bool
 communication :: recv(server_id* from,
                       virtual_server_id* vfrom,
@@ -417,6 +608,11 @@ communication :: recv(server_id* from,
     //  - The virtual_server_id destination maps to us
     //  - If it comes from a virtual_server_id, that id maps to the sender
     //  - The message version is less than or equal to our current config
+    //
+    // The worker is done with whatever it last received, so send what it
+    // (and everyone else) held back while handling it.
+    flush_batches();
+
     while (true)
     {
         uint64_t id;
@@ -469,25 +665,37 @@ communication :: recv(server_id* from,
             continue;
         }
 
+        // Fetched after the blocking receive so it cannot be reclaimed under us
+        const configuration* config = m_daemon->m_config.get();
         bool from_valid = true;
-        bool to_valid = m_daemon->m_us == m_daemon->m_config.get_server_id(*vto) ||
+        bool to_valid = m_daemon->m_us == config->get_server_id(*vto) ||
                         *vto == virtual_server_id(UINT64_MAX);
 
         // If this is a virtual-virtual message
         if ((flags & 0x1))
         {
-            from_valid = *from == m_daemon->m_config.get_server_id(virtual_server_id(vidf));
+            from_valid = *from == config->get_server_id(virtual_server_id(vidf));
         }
 
         // No matter what, wait for the config the sender saw
-        if (version > m_daemon->m_config.version())
+        if (version > config->version())
         {
             early_message em(version, id, *msg);
             m_early_messages.push(em);
+
+            // reconfiguration does not stop this thread, so the config may
+            // have been published (and the queue drained) since we checked
+            uint64_t current = m_daemon->m_config->version();
+
+            if (version <= current)
+            {
+                deliver_early_messages(current);
+            }
+
             continue;
         }
 
-        if ((flags & 0x2) && version < m_daemon->m_config.version())
+        if ((flags & 0x2) && version < config->version())
         {
             continue;
         }
@@ -510,10 +718,94 @@ communication :: recv(server_id* from,
     }
 }
 
+// Call with b->lock held
+void
+communication :: flush_batch(batch* b)
+{
+    if (b->count == 0)
+    {
+        return;
+    }
+
+    e::slice entries(&b->entries[0], b->entries.size());
+    size_t sz = HYPERDEX_HEADER_SIZE_VV
+              + sizeof(uint32_t)
+              + sizeof(uint32_t)
+              + entries.size();
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << b->count << entries;
+    uint8_t mt = static_cast<uint8_t>(CHAIN_BATCH);
+    uint8_t flags = 1 | 2;
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << b->config_version << b->to.get() << b->from.get();
+    b->count = 0;
+    b->entries.clear();
+    server_id to = m_daemon->m_config->get_server_id(b->to);
+
+    if (to == server_id())
+    {
+        return;
+    }
+
+#ifdef HD_LOG_ALL_MESSAGES
+    LOG(INFO) << "SEND " << b->from << "->" << b->to << " " << CHAIN_BATCH << " " << msg->hex();
+#endif
+
+    if (to == m_daemon->m_us)
+    {
+        m_busybee->deliver(to.get(), msg);
+    }
+    else
+    {
+        busybee_returncode rc = m_busybee->send(to.get(), msg);
+
+        switch (rc)
+        {
+            case BUSYBEE_SUCCESS:
+                break;
+            case BUSYBEE_DISRUPTED:
+                handle_disruption(to.get());
+                break;
+            case BUSYBEE_SHUTDOWN:
+            case BUSYBEE_POLLFAILED:
+            case BUSYBEE_ADDFDFAIL:
+            case BUSYBEE_TIMEOUT:
+            case BUSYBEE_EXTERNAL:
+            case BUSYBEE_INTERRUPTED:
+            default:
+                LOG(ERROR) << "BusyBee unexpectedly returned " << rc;
+                break;
+        }
+    }
+}
+
+void
+communication :: deliver_early_messages(uint64_t version)
+{
+    e::lockfree_fifo<early_message> ems;
+    early_message em;
+
+    while (m_early_messages.pop(&em))
+    {
+        if (em.config_version <= version)
+        {
+            m_busybee->deliver(em.id, em.msg);
+        }
+        else
+        {
+            ems.push(em);
+        }
+    }
+
+    while (ems.pop(&em))
+    {
+        m_early_messages.push(em);
+    }
+}
+
 void
 communication :: handle_disruption(uint64_t id)
 {
-    if (m_daemon->m_config.get_address(server_id(id)) != po6::net::location())
+    if (m_daemon->m_config->get_address(server_id(id)) != po6::net::location())
     {
         m_daemon->m_coord.report_tcp_disconnect(server_id(id));
         // XXX If the above line changes, then we need to sometimes tell
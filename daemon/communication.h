@@ -29,7 +29,12 @@
 #define hyperdex_daemon_communication_h_
 
 // STL
+#include <map>
 #include <memory>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
 
 // BusyBee
 #include <busybee_constants.h>
@@ -37,12 +42,13 @@
 
 // e
 #include <e/buffer.h>
+#include <e/intrusive_ptr.h>
 #include <e/lockfree_fifo.h>
 
 // HyperDex
 #include "common/ids.h"
-#include "common/mapper.h"
 #include "common/network_msgtype.h"
+#include "daemon/rcu_configuration.h"
 #include "daemon/reconfigure_returncode.h"
 
 #define HYPERDEX_HEADER_SIZE_VC (BUSYBEE_HEADER_SIZE \
@@ -105,6 +111,15 @@ class communication
                         const virtual_server_id& to,
                         network_msgtype msg_type,
                         std::auto_ptr<e::buffer> msg);
+        // Like send_exact, but the message may be held and coalesced with
+        // others bound for the same virtual server into one CHAIN_BATCH.
+        // Held messages go out once enough of them accumulate, when a network
+        // worker returns to recv, or on flush_batches.
+        bool send_batched(const virtual_server_id& from,
+                          const virtual_server_id& to,
+                          network_msgtype msg_type,
+                          std::auto_ptr<e::buffer> msg);
+        void flush_batches();
         bool recv(server_id* from,
                   virtual_server_id* vfrom,
                   virtual_server_id* vto,
@@ -114,8 +129,14 @@ class communication
 
     private:
         class early_message;
+        class config_mapper;
+        class batch;
+        typedef std::pair<virtual_server_id, virtual_server_id> batch_key_t;
+        typedef std::map<batch_key_t, e::intrusive_ptr<batch> > batch_map_t;
 
     private:
+        void flush_batch(batch* b);
+        void deliver_early_messages(uint64_t version);
         void handle_disruption(uint64_t id);
 
     private:
@@ -124,9 +145,12 @@ class communication
 
     private:
         daemon* m_daemon;
-        mapper m_busybee_mapper;
+        const std::auto_ptr<config_mapper> m_busybee_mapper;
         std::auto_ptr<busybee_mta> m_busybee;
         e::lockfree_fifo<early_message> m_early_messages;
+        po6::threads::mutex m_batches_lock;
+        batch_map_t m_batches;
+        std::vector<e::intrusive_ptr<batch> > m_dirty_batches;
 };
 
 } // namespace hyperdex
@@ -33,6 +33,7 @@
 
 // e
 #include <e/endian.h>
+#include <e/time.h>
 
 // HyperDex
 #include "common/coordinator_returncode.h"
@@ -70,6 +71,9 @@ coordinator_link :: coordinator_link(daemon* d)
     , m_transfers_go_live()
     , m_transfers_complete()
     , m_tcp_disconnects()
+    , m_load_reports()
+    , m_load_ops()
+    , m_load_time(e::time())
     , m_transfers_go_live_seen()
     , m_transfers_complete_seen()
     , m_tcp_disconnects_seen()
@@ -431,6 +435,7 @@ coordinator_link :: wait_for_config(configuration* config)
             alarm(30);
             s_alarm = false;
             m_daemon->m_repl.trip_periodic();
+            initiate_report_load();
             need_to_backoff = false;
         }
 
@@ -677,11 +682,11 @@ coordinator_link :: wait_for_config(configuration* config)
                 continue;
             }
 
-            if (m_daemon->m_config.cluster() != 0 &&
-                m_daemon->m_config.cluster() != config->cluster())
+            if (m_daemon->m_config->cluster() != 0 &&
+                m_daemon->m_config->cluster() != config->cluster())
             {
                 LOG(ERROR) << "coordinator has changed the cluster identity from "
-                           << m_daemon->m_config.cluster() << " to "
+                           << m_daemon->m_config->cluster() << " to "
                            << config->cluster() << "; treating it as failed";
                 retry = 10000000000;
                 need_to_backoff = true;
@@ -795,6 +800,16 @@ coordinator_link :: wait_for_config(configuration* config)
 
             m_tcp_disconnects.erase(tcp_iter);
         }
+        else if ((ack_iter = m_load_reports.find(lid)) != m_load_reports.end())
+        {
+            if (*ack_iter->second.second != REPLICANT_SUCCESS)
+            {
+                LOG(ERROR) << "could not report load as of config " << ack_iter->second.first
+                           << " because " << *ack_iter->second.second;
+            }
+
+            m_load_reports.erase(ack_iter);
+        }
         else
         {
             LOG(ERROR) << "received event from replicant, but don't know where it came from";
@@ -966,7 +981,7 @@ bool
 coordinator_link :: initiate_wait_for_config()
 {
     m_wait_config_id = m_repl->wait("hyperdex", "config",
-                                    m_daemon->m_config.version(),
+                                    m_daemon->m_config->version(),
                                     &m_wait_config_status);
 
     if (m_wait_config_id < 0)
@@ -1069,7 +1084,7 @@ coordinator_link :: initiate_report_tcp_disconnect(const server_id& id)
 
     char buf[2 * sizeof(uint64_t)];
     e::pack64be(id.get(), buf);
-    e::pack64be(m_daemon->m_config.version(), buf + sizeof(uint64_t));
+    e::pack64be(m_daemon->m_config->version(), buf + sizeof(uint64_t));
     std::tr1::shared_ptr<replicant_returncode> ret(new replicant_returncode(REPLICANT_GARBAGE));
     int64_t req_id = m_repl->send("hyperdex", "server-suspect", buf, 2 * sizeof(uint64_t),
                                   ret.get(), NULL, NULL);
@@ -1083,3 +1098,54 @@ coordinator_link :: initiate_report_tcp_disconnect(const server_id& id)
         m_tcp_disconnects.insert(std::make_pair(req_id, std::make_pair(id, ret)));
     }
 }
+
+// Runs on the thread that reconfigures the daemon, so the set of regions in
+// m_region_ops cannot change underneath us.
+void
+coordinator_link :: initiate_report_load()
+{
+    uint64_t now = e::time();
+    uint64_t elapsed = now - m_load_time;
+    std::map<region_id, uint64_t> ops;
+    m_daemon->m_region_ops.peek(&ops);
+
+    if (elapsed == 0 || ops.empty())
+    {
+        m_load_ops.swap(ops);
+        m_load_time = now;
+        return;
+    }
+
+    size_t sz = 2 * sizeof(uint64_t) + ops.size() * 3 * sizeof(uint64_t);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    e::buffer::packer pa = msg->pack_at(0);
+    pa = pa << m_daemon->m_us.get() << static_cast<uint64_t>(ops.size());
+
+    for (std::map<region_id, uint64_t>::iterator it = ops.begin();
+            it != ops.end(); ++it)
+    {
+        // counters start at one when a region is adopted
+        std::map<region_id, uint64_t>::iterator last = m_load_ops.find(it->first);
+        uint64_t prev = last != m_load_ops.end() ? last->second : 1;
+        uint64_t count = it->second >= prev ? it->second - prev : 0;
+        uint64_t rate = static_cast<uint64_t>(count * 1000000000.0 / elapsed);
+        pa = pa << it->first.get() << rate
+                << m_daemon->m_data.approximate_size(it->first);
+    }
+
+    m_load_ops.swap(ops);
+    m_load_time = now;
+    std::tr1::shared_ptr<replicant_returncode> ret(new replicant_returncode(REPLICANT_GARBAGE));
+    int64_t req_id = m_repl->send("hyperdex", "report-load",
+                                  reinterpret_cast<const char*>(msg->data()), msg->size(),
+                                  ret.get(), NULL, NULL);
+
+    if (req_id < 0)
+    {
+        LOG(ERROR) << "could not report load to the coordinator";
+    }
+    else
+    {
+        m_load_reports.insert(std::make_pair(req_id, std::make_pair(m_daemon->m_config->version(), ret)));
+    }
+}
@@ -79,6 +79,7 @@ class coordinator_link
         void initiate_transfer_go_live(const transfer_id& id);
         void initiate_transfer_complete(const transfer_id& id);
         void initiate_report_tcp_disconnect(const server_id& id);
+        void initiate_report_load();
 
     private:
         daemon* m_daemon;
@@ -101,6 +102,10 @@ class coordinator_link
         std::map<int64_t, std::pair<transfer_id, std::tr1::shared_ptr<replicant_returncode> > > m_transfers_go_live;
         std::map<int64_t, std::pair<transfer_id, std::tr1::shared_ptr<replicant_returncode> > > m_transfers_complete;
         std::map<int64_t, std::pair<server_id, std::tr1::shared_ptr<replicant_returncode> > > m_tcp_disconnects;
+        std::map<int64_t, std::pair<uint64_t, std::tr1::shared_ptr<replicant_returncode> > > m_load_reports;
+        // per-region operation counts and the time as of the last load report
+        std::map<region_id, uint64_t> m_load_ops;
+        uint64_t m_load_time;
         std::set<transfer_id> m_transfers_go_live_seen;
         std::set<transfer_id> m_transfers_complete_seen;
         std::set<server_id> m_tcp_disconnects_seen;
@@ -28,7 +28,12 @@
 // POSIX
 #include <signal.h>
 
+// C
+#include <cstring>
+
 // STL
+#include <algorithm>
+#include <list>
 #include <sstream>
 
 // Google Log
@@ -40,14 +45,131 @@
 
 // HyperDex
 #include "common/coordinator_returncode.h"
+#include "common/projection.h"
 #include "common/serialization.h"
 #include "daemon/daemon.h"
 
+using hyperdex::configuration;
 using hyperdex::daemon;
+using hyperdex::network_returncode;
+using hyperdex::region;
+using hyperdex::region_id;
+using hyperdex::server_id;
+using hyperdex::transfer;
+
+// Reconfigurations that touch none of our regions do not stop the world.  The
+// configurations they replace are freed at the next full pause, which we force
+// once this many have accumulated.
+#define MAX_RETIRED_CONFIGS 16
 
 int s_interrupts = 0;
 bool s_alarm = false;
 
+typedef std::pair<std::pair<hyperdex::virtual_server_id, e::slice>, size_t> batch_item_t;
+
+// Orders (virtual server, key) batch items by server, then by key
+static bool
+compare_batch_items(const batch_item_t& lhs, const batch_item_t& rhs)
+{
+    if (lhs.first.first != rhs.first.first)
+    {
+        return lhs.first.first < rhs.first.first;
+    }
+
+    const e::slice& l(lhs.first.second);
+    const e::slice& r(rhs.first.second);
+    int cmp = memcmp(l.data(), r.data(), std::min(l.size(), r.size()));
+
+    if (cmp == 0)
+    {
+        return l.size() < r.size();
+    }
+
+    return cmp < 0;
+}
+
+static bool
+same_chain(const region& lhs, const region& rhs)
+{
+    if (lhs.lower_coord != rhs.lower_coord ||
+        lhs.upper_coord != rhs.upper_coord ||
+        lhs.replicas.size() != rhs.replicas.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < lhs.replicas.size(); ++i)
+    {
+        if (lhs.replicas[i].si != rhs.replicas[i].si ||
+            lhs.replicas[i].vsi != rhs.replicas[i].vsi)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Transfers into or out of us
+static void
+transfers_of(const configuration& config,
+             const server_id& us,
+             std::vector<transfer>* transfers)
+{
+    config.transfer_in_regions(us, transfers);
+    config.transfer_out_regions(us, transfers);
+    std::sort(transfers->begin(), transfers->end());
+}
+
+// Regions we hold or transfer in either configuration whose bounds, chain,
+// capture, transfers or indices differ between the two.
+static void
+affected_regions(const configuration& old_config,
+                 const configuration& new_config,
+                 const server_id& us,
+                 std::vector<region_id>* affected)
+{
+    std::vector<region_id> regions;
+    old_config.regions_of(us, &regions);
+    new_config.regions_of(us, &regions);
+    std::vector<transfer> old_xfers;
+    std::vector<transfer> new_xfers;
+    transfers_of(old_config, us, &old_xfers);
+    transfers_of(new_config, us, &new_xfers);
+    bool same_xfers = old_xfers.size() == new_xfers.size();
+
+    for (size_t i = 0; i < old_xfers.size(); ++i)
+    {
+        same_xfers = same_xfers && old_xfers[i].id == new_xfers[i].id;
+        regions.push_back(old_xfers[i].rid);
+    }
+
+    for (size_t i = 0; i < new_xfers.size(); ++i)
+    {
+        regions.push_back(new_xfers[i].rid);
+    }
+
+    std::sort(regions.begin(), regions.end());
+    regions.erase(std::unique(regions.begin(), regions.end()), regions.end());
+
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        const region* o = old_config.get_region(regions[i]);
+        const region* n = new_config.get_region(regions[i]);
+        std::vector<uint16_t> old_indexed;
+        std::vector<uint16_t> new_indexed;
+        old_config.index_attrs(regions[i], &old_indexed);
+        new_config.index_attrs(regions[i], &new_indexed);
+
+        if (!same_xfers || !o || !n || !same_chain(*o, *n) ||
+            old_config.capture_for(regions[i]) != new_config.capture_for(regions[i]) ||
+            old_indexed != new_indexed)
+        {
+            affected->push_back(regions[i]);
+        }
+    }
+}
+
 static void
 exit_on_signal(int /*signum*/)
 {
@@ -84,6 +206,7 @@ daemon :: daemon()
     , m_stm(this)
     , m_sm(this)
     , m_config()
+    , m_region_ops()
 {
 }
 
@@ -126,7 +249,9 @@ daemon :: run(bool daemonize,
               po6::net::location bind_to,
               bool set_coordinator,
               po6::net::hostname coordinator,
-              unsigned threads)
+              unsigned threads,
+              bool durable,
+              uint64_t cache_size)
 {
     if (!install_signal_handler(SIGHUP, exit_on_signal))
     {
@@ -206,7 +331,7 @@ daemon :: run(bool daemonize,
     po6::net::hostname saved_coordinator;
     LOG(INFO) << "initializing persistent storage";
 
-    if (!m_data.setup(data, &saved, &saved_us, &saved_bind_to, &saved_coordinator))
+    if (!m_data.setup(data, durable, cache_size, &saved, &saved_us, &saved_bind_to, &saved_coordinator))
     {
         return EXIT_FAILURE;
     }
@@ -283,7 +408,8 @@ daemon :: run(bool daemonize,
 
     while (!m_coord.exit_wait_loop())
     {
-        configuration old_config = m_config;
+        // stays valid until we reclaim it below
+        const configuration& old_config(*m_config);
         configuration new_config;
 
         if (!m_coord.wait_for_config(&new_config))
@@ -299,8 +425,36 @@ daemon :: run(bool daemonize,
             continue;
         }
 
+        std::vector<region_id> affected;
+        affected_regions(old_config, new_config, m_us, &affected);
+
+        if (affected.empty() && m_config.retired() < MAX_RETIRED_CONFIGS)
+        {
+            // Nothing we serve changed, so every subsystem's state is still
+            // valid and we swap configurations under live workers; there is
+            // no per-region quiesce.  Each handler takes one snapshot of
+            // m_config, so it sees one configuration throughout.  Facts
+            // about our own regions (bounds, chains, captures, transfers,
+            // indices) are identical in both.  Facts about other regions
+            // (next hops, point leaders) may come from either:  ops sent
+            // along an old chain are resent by the retransmitter, and the
+            // receiver drops messages from older configurations and holds
+            // back those from newer ones.  m_comm.reconfigure only drains
+            // the lock-free queue of held-back messages and prunes batches
+            // under their lock.
+            LOG(INFO) << "received new configuration version=" << new_config.version()
+                      << "; none of our regions changed, so we keep serving";
+            m_config.publish(new_config);
+            m_comm.reconfigure(old_config, new_config, m_us);
+            m_repl.trip_periodic();
+            m_coord.ack_config(new_config.version());
+            continue;
+        }
+
         LOG(INFO) << "received new configuration version=" << new_config.version()
+                  << " changing " << affected.size() << " of our regions"
                   << "; pausing all activity while we reconfigure";
+        m_sm.pause();
         m_stm.pause();
         m_repl.pause();
         m_data.pause();
@@ -310,11 +464,18 @@ daemon :: run(bool daemonize,
         m_repl.reconfigure(old_config, new_config, m_us);
         m_stm.reconfigure(old_config, new_config, m_us);
         m_sm.reconfigure(old_config, new_config, m_us);
-        m_config = new_config;
+        m_config.publish(new_config);
+        // every thread is paused, so none holds an old configuration
+        m_config.reclaim();
+        std::vector<region_id> regions;
+        m_config->regions_of(m_us, &regions);
+        std::sort(regions.begin(), regions.end());
+        m_region_ops.adopt(regions);
         m_comm.unpause();
         m_data.unpause();
         m_repl.unpause();
         m_stm.unpause();
+        m_sm.unpause();
         LOG(INFO) << "reconfiguration complete; resuming normal operation";
 
         // let the coordinator know we've moved to this config
@@ -401,9 +562,15 @@ daemon :: loop(size_t thread)
             case REQ_GET:
                 process_req_get(from, vfrom, vto, msg, up);
                 break;
+            case REQ_GET_BATCH:
+                process_req_get_batch(from, vfrom, vto, msg, up);
+                break;
             case REQ_ATOMIC:
                 process_req_atomic(from, vfrom, vto, msg, up);
                 break;
+            case REQ_ATOMIC_BATCH:
+                process_req_atomic_batch(from, vfrom, vto, msg, up);
+                break;
             case REQ_SEARCH_START:
                 process_req_search_start(from, vfrom, vto, msg, up);
                 break;
@@ -425,6 +592,9 @@ daemon :: loop(size_t thread)
             case REQ_SEARCH_DESCRIBE:
                 process_req_search_describe(from, vfrom, vto, msg, up);
                 break;
+            case REQ_AGGREGATE:
+                process_req_aggregate(from, vfrom, vto, msg, up);
+                break;
             case CHAIN_OP:
                 process_chain_op(from, vfrom, vto, msg, up);
                 break;
@@ -437,13 +607,20 @@ daemon :: loop(size_t thread)
             case CHAIN_GC:
                 process_chain_gc(from, vfrom, vto, msg, up);
                 break;
+            case CHAIN_BATCH:
+                process_chain_batch(from, vfrom, vto, msg, up);
+                break;
             case XFER_OP:
                 process_xfer_op(from, vfrom, vto, msg, up);
                 break;
             case XFER_ACK:
                 process_xfer_ack(from, vfrom, vto, msg, up);
                 break;
+            case XFER_TREE:
+                process_xfer_tree(from, vfrom, vto, msg, up);
+                break;
             case RESP_GET:
+            case RESP_GET_BATCH:
             case RESP_ATOMIC:
             case RESP_SEARCH_ITEM:
             case RESP_SEARCH_DONE:
@@ -451,6 +628,8 @@ daemon :: loop(size_t thread)
             case RESP_GROUP_DEL:
             case RESP_COUNT:
             case RESP_SEARCH_DESCRIBE:
+            case RESP_AGGREGATE:
+            case SERVERBUSY:
             case CONFIGMISMATCH:
             case PACKET_NOP:
             default:
@@ -462,6 +641,50 @@ daemon :: loop(size_t thread)
     LOG(INFO) << "network thread shutting down";
 }
 
+network_returncode
+daemon :: perform_get(const configuration* config,
+                      const virtual_server_id& vto,
+                      const e::slice& key,
+                      std::vector<e::slice>* value,
+                      datalayer::reference* ref)
+{
+    region_id ri(config->get_region_id(vto));
+
+    // Any replica of the key subspace may serve a GET because objects only
+    // reach the datalayer once acked by every server after it in the chain.
+    // Other subspaces hold the object under a region we cannot derive here.
+    if (config->subspace_prev(config->subspace_of(ri)) != subspace_id())
+    {
+        return NET_NOTUS;
+    }
+
+    // The key may have moved to another region if this one was split
+    if (config->point_region(ri, key) != ri)
+    {
+        return NET_NOTUS;
+    }
+
+    // count the read toward the region's load
+    m_region_ops.increment(ri);
+    uint64_t version;
+
+    switch (m_data.get(ri, key, value, &version, ref))
+    {
+        case datalayer::SUCCESS:
+            return NET_SUCCESS;
+        case datalayer::NOT_FOUND:
+            return NET_NOTFOUND;
+        case datalayer::BAD_ENCODING:
+        case datalayer::BAD_SEARCH:
+        case datalayer::CORRUPTION:
+        case datalayer::IO_ERROR:
+        case datalayer::LEVELDB_ERROR:
+        default:
+            LOG(ERROR) << "GET returned unacceptable error code.";
+            return NET_SERVERERROR;
+    }
+}
+
 void
 daemon :: process_req_get(server_id from,
                           virtual_server_id,
@@ -471,37 +694,35 @@ daemon :: process_req_get(server_id from,
 {
     uint64_t nonce;
     e::slice key;
+    projection proj;
 
-    if ((up >> nonce >> key).error())
+    if ((up >> nonce >> key >> proj).error())
     {
         LOG(WARNING) << "unpack of REQ_GET failed; here's some hex:  " << msg->hex();
         return;
     }
 
+    const configuration* config = m_config.get();
     std::vector<e::slice> value;
-    uint64_t version;
     datalayer::reference ref;
-    network_returncode result;
+    network_returncode result = perform_get(config, vto, key, &value, &ref);
 
-    switch (m_data.get(m_config.get_region_id(vto), key, &value, &version, &ref))
+    if (result == NET_SUCCESS)
     {
-        case datalayer::SUCCESS:
-            result = NET_SUCCESS;
-            break;
-        case datalayer::NOT_FOUND:
-            result = NET_NOTFOUND;
-            break;
-        case datalayer::BAD_ENCODING:
-        case datalayer::BAD_SEARCH:
-        case datalayer::CORRUPTION:
-        case datalayer::IO_ERROR:
-        case datalayer::LEVELDB_ERROR:
-        default:
-            LOG(ERROR) << "GET returned unacceptable error code.";
-            result = NET_SERVERERROR;
-            break;
-    }
+        const schema* sc = config->get_schema(config->get_region_id(vto));
 
+        if (sc && proj.validate(*sc))
+        {
+            std::vector<e::slice> tmp;
+            proj.apply(value, &tmp);
+            value.swap(tmp);
+        }
+        else
+        {
+            result = NET_BADDIMSPEC;
+            value.clear();
+        }
+    }
     size_t sz = HYPERDEX_HEADER_SIZE_VC
               + sizeof(uint64_t)
               + sizeof(uint16_t)
@@ -512,6 +733,74 @@ daemon :: process_req_get(server_id from,
     m_comm.send_client(vto, from, RESP_GET, msg);
 }
 
+void
+daemon :: process_req_get_batch(server_id from,
+                                virtual_server_id,
+                                virtual_server_id vto,
+                                std::auto_ptr<e::buffer> msg,
+                                e::unpacker up)
+{
+    uint64_t nonce;
+    uint64_t count;
+    up = up >> nonce >> count;
+    std::vector<batch_item_t> items;
+
+    for (uint64_t i = 0; !up.error() && i < count; ++i)
+    {
+        uint64_t vsi;
+        e::slice key;
+        up = up >> vsi >> key;
+        items.push_back(std::make_pair(std::make_pair(virtual_server_id(vsi), key), i));
+    }
+
+    if (up.error())
+    {
+        LOG(WARNING) << "unpack of REQ_GET_BATCH failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    // Visit the keys region by region and in key order so that the gets walk
+    // LevelDB front to back rather than seeking randomly.
+    std::sort(items.begin(), items.end(), compare_batch_items);
+    const configuration* config = m_config.get();
+    std::vector<network_returncode> results(items.size());
+    std::vector<std::vector<e::slice> > values(items.size());
+    std::list<datalayer::reference> refs;
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t)
+              + sizeof(uint64_t);
+
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        const virtual_server_id& vsi(items[i].first.first);
+        const e::slice& key(items[i].first.second);
+        size_t idx = items[i].second;
+        refs.push_back(datalayer::reference());
+
+        if (config->get_server_id(vsi) == m_us)
+        {
+            results[idx] = perform_get(config, vsi, key, &values[idx], &refs.back());
+        }
+        else
+        {
+            results[idx] = NET_NOTUS;
+        }
+
+        sz += sizeof(uint16_t) + pack_size(values[idx]);
+    }
+
+    msg.reset(e::buffer::create(sz));
+    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
+    pa = pa << nonce << count;
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        pa = pa << static_cast<uint16_t>(results[i]) << values[i];
+    }
+
+    m_comm.send_client(vto, from, RESP_GET_BATCH, msg);
+}
+
 void
 daemon :: process_req_atomic(server_id from,
                              virtual_server_id,
@@ -538,6 +827,69 @@ daemon :: process_req_atomic(server_id from,
     m_repl.client_atomic(from, vto, nonce, fail_if_not_found, fail_if_found, !has_funcalls, key, &checks, &funcs);
 }
 
+void
+daemon :: process_req_atomic_batch(server_id from,
+                                   virtual_server_id,
+                                   virtual_server_id vto,
+                                   std::auto_ptr<e::buffer> msg,
+                                   e::unpacker up)
+{
+    uint64_t nonce;
+    uint64_t count;
+    up = up >> nonce >> count;
+    std::vector<std::pair<uint64_t, uint64_t> > targets;
+
+    for (uint64_t i = 0; !up.error() && i < count; ++i)
+    {
+        uint64_t vsi;
+        uint64_t item_nonce;
+        up = up >> vsi >> item_nonce;
+        targets.push_back(std::make_pair(vsi, item_nonce));
+    }
+
+    // Each key is still ordered by its own point leader, so the batch becomes
+    // one client_atomic per key; every key gets its own RESP_ATOMIC.
+    const configuration* config = m_config.get();
+
+    for (size_t i = 0; !up.error() && i < targets.size(); ++i)
+    {
+        virtual_server_id vsi(targets[i].first);
+        uint64_t item_nonce = targets[i].second;
+        uint8_t flags;
+        e::slice key;
+        std::vector<attribute_check> checks;
+        std::vector<funcall> funcs;
+        up = up >> key >> flags >> checks >> funcs;
+
+        if (up.error())
+        {
+            break;
+        }
+
+        if (config->get_server_id(vsi) != m_us)
+        {
+            size_t sz = HYPERDEX_HEADER_SIZE_VC
+                      + sizeof(uint64_t)
+                      + sizeof(uint16_t);
+            std::auto_ptr<e::buffer> resp(e::buffer::create(sz));
+            resp->pack_at(HYPERDEX_HEADER_SIZE_VC) << item_nonce << static_cast<uint16_t>(NET_NOTUS);
+            m_comm.send_client(vto, from, RESP_ATOMIC, resp);
+            continue;
+        }
+
+        bool fail_if_not_found = flags & 1;
+        bool fail_if_found = flags & 2;
+        bool has_funcalls = flags & 128;
+        m_repl.client_atomic(from, vsi, item_nonce, fail_if_not_found, fail_if_found, !has_funcalls, key, &checks, &funcs);
+    }
+
+    if (up.error())
+    {
+        LOG(WARNING) << "unpack of REQ_ATOMIC_BATCH failed; here's some hex:  " << msg->hex();
+        return;
+    }
+}
+
 void
 daemon :: process_req_search_start(server_id from,
                                    virtual_server_id,
@@ -548,14 +900,17 @@ daemon :: process_req_search_start(server_id from,
     uint64_t nonce;
     uint64_t search_id;
     std::vector<attribute_check> checks;
+    uint64_t batch_objects;
+    uint64_t batch_bytes;
+    projection proj;
 
-    if ((up >> nonce >> search_id >> checks).error())
+    if ((up >> nonce >> search_id >> checks >> batch_objects >> batch_bytes >> proj).error())
     {
         LOG(WARNING) << "unpack of REQ_SEARCH_START failed; here's some hex:  " << msg->hex();
         return;
     }
 
-    m_sm.start(from, vto, msg, nonce, search_id, &checks);
+    m_sm.start(from, vto, msg, nonce, search_id, &checks, batch_objects, batch_bytes, proj);
 }
 
 void
@@ -608,14 +963,15 @@ daemon :: process_req_sorted_search(server_id from,
     uint64_t limit;
     uint16_t sort_by;
     uint8_t flags;
+    projection proj;
 
-    if ((up >> nonce >> checks >> limit >> sort_by >> flags).error())
+    if ((up >> nonce >> checks >> limit >> sort_by >> flags >> proj).error())
     {
         LOG(WARNING) << "unpack of REQ_SORTED_SEARCH failed; here's some hex:  " << msg->hex();
         return;
     }
 
-    m_sm.sorted_search(from, vto, nonce, &checks, limit, sort_by, flags & 0x1);
+    m_sm.sorted_search(from, vto, msg, nonce, &checks, limit, sort_by, flags & 0x1, proj);
 }
 
 void
@@ -635,7 +991,7 @@ daemon :: process_req_group_del(server_id from,
     }
 
     e::slice sl("\x01\x00\x00\x00\x00\x00\x00\x00\x00", 9);
-    m_sm.group_keyop(from, vto, nonce, &checks, REQ_ATOMIC, sl, RESP_GROUP_DEL);
+    m_sm.group_keyop(from, vto, msg, nonce, &checks, REQ_ATOMIC, sl, RESP_GROUP_DEL);
 }
 
 void
@@ -647,14 +1003,22 @@ daemon :: process_req_count(server_id from,
 {
     uint64_t nonce;
     std::vector<attribute_check> checks;
+    uint8_t flags = 0;
+    up = up >> nonce >> checks;
 
-    if ((up >> nonce >> checks).error())
+    // clients that predate the flags byte do not send it
+    if (!up.error() && up.remain() > 0)
+    {
+        up = up >> flags;
+    }
+
+    if (up.error())
     {
         LOG(WARNING) << "unpack of REQ_COUNT failed; here's some hex:  " << msg->hex();
         return;
     }
 
-    m_sm.count(from, vto, nonce, &checks);
+    m_sm.count(from, vto, msg, nonce, &checks, flags & 0x1);
 }
 
 void
@@ -673,7 +1037,38 @@ daemon :: process_req_search_describe(server_id from,
         return;
     }
 
-    m_sm.search_describe(from, vto, nonce, &checks);
+    m_sm.search_describe(from, vto, msg, nonce, &checks);
+}
+
+void
+daemon :: process_req_aggregate(server_id from,
+                                virtual_server_id,
+                                virtual_server_id vto,
+                                std::auto_ptr<e::buffer> msg,
+                                e::unpacker up)
+{
+    uint64_t nonce;
+    std::vector<attribute_check> checks;
+    uint8_t flags;
+    uint16_t group_by;
+    uint16_t num_attrs;
+    up = up >> nonce >> checks >> flags >> group_by >> num_attrs;
+    std::vector<uint16_t> attrs;
+
+    for (size_t i = 0; !up.error() && i < num_attrs; ++i)
+    {
+        uint16_t attr;
+        up = up >> attr;
+        attrs.push_back(attr);
+    }
+
+    if (up.error())
+    {
+        LOG(WARNING) << "unpack of REQ_AGGREGATE failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_sm.aggregate(from, vto, msg, nonce, &checks, flags & 0x1, group_by, &attrs);
 }
 
 void
@@ -690,7 +1085,38 @@ daemon :: process_chain_op(server_id,
     e::slice key;
     std::vector<e::slice> value;
 
-    if ((up >> flags >> reg_id >> seq_id >> version >> key >> value).error())
+    if ((up >> flags >> reg_id >> seq_id >> version >> key).error())
+    {
+        LOG(WARNING) << "unpack of CHAIN_OP failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    // only the attributes that changed since the previous version
+    if ((flags & 4))
+    {
+        uint16_t delta_sz;
+        up = up >> delta_sz;
+        std::vector<std::pair<uint16_t, e::slice> > delta;
+
+        for (uint16_t i = 0; !up.error() && i < delta_sz; ++i)
+        {
+            uint16_t idx;
+            e::slice attr;
+            up = up >> idx >> attr;
+            delta.push_back(std::make_pair(idx, attr));
+        }
+
+        if (up.error())
+        {
+            LOG(WARNING) << "unpack of CHAIN_OP failed; here's some hex:  " << msg->hex();
+            return;
+        }
+
+        m_repl.chain_delta(vfrom, vto, region_id(reg_id), seq_id, version, msg, key, delta);
+        return;
+    }
+
+    if ((up >> value).error())
     {
         LOG(WARNING) << "unpack of CHAIN_OP failed; here's some hex:  " << msg->hex();
         return;
@@ -728,22 +1154,44 @@ daemon :: process_chain_subspace(server_id,
 }
 
 void
-daemon :: process_chain_gc(server_id,
-                           virtual_server_id vfrom,
+daemon :: process_chain_gc(server_id from,
+                           virtual_server_id,
                            virtual_server_id,
                            std::auto_ptr<e::buffer> msg,
                            e::unpacker up)
 {
-    uint64_t seq_id;
+    uint32_t digest_sz;
+    up = up >> digest_sz;
+    std::vector<std::pair<region_id, uint64_t> > digest;
 
-    if ((up >> seq_id).error())
+    for (uint32_t i = 0; !up.error() && i < digest_sz; ++i)
+    {
+        uint64_t ri;
+        uint64_t seq_id;
+        up = up >> ri >> seq_id;
+        digest.push_back(std::make_pair(region_id(ri), seq_id));
+    }
+
+    if (up.error())
     {
         LOG(WARNING) << "unpack of CHAIN_GC failed; here's some hex:  " << msg->hex();
         return;
     }
 
-    region_id ri = m_config.get_region_id(vfrom);
-    m_repl.chain_gc(ri, seq_id);
+    const configuration* config = m_config.get();
+
+    for (size_t i = 0; i < digest.size(); ++i)
+    {
+        // only the point leader of a region may bound its acked records
+        virtual_server_id vsi = config->get_virtual(digest[i].first, from);
+
+        if (vsi == virtual_server_id() || !config->is_point_leader(vsi))
+        {
+            continue;
+        }
+
+        m_repl.chain_gc(digest[i].first, digest[i].second);
+    }
 }
 
 void
@@ -769,6 +1217,62 @@ daemon :: process_chain_ack(server_id,
     m_repl.chain_ack(vfrom, vto, retransmission, region_id(reg_id), seq_id, version, key);
 }
 
+void
+daemon :: process_chain_batch(server_id from,
+                              virtual_server_id vfrom,
+                              virtual_server_id vto,
+                              std::auto_ptr<e::buffer> msg,
+                              e::unpacker up)
+{
+    uint32_t count;
+    e::slice entries;
+
+    if ((up >> count >> entries).error())
+    {
+        LOG(WARNING) << "unpack of CHAIN_BATCH failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    e::unpacker eup(reinterpret_cast<const char*>(entries.data()), entries.size());
+
+    // Every entry shares the batch's header, so rebuild each one as the
+    // message it would have been on its own; the handlers keep the buffer as
+    // backing for the slices they unpack.
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint8_t mt;
+        e::slice body;
+
+        if ((eup >> mt >> body).error())
+        {
+            LOG(WARNING) << "unpack of CHAIN_BATCH failed; here's some hex:  " << msg->hex();
+            return;
+        }
+
+        size_t sz = HYPERDEX_HEADER_SIZE_VV + body.size();
+        std::auto_ptr<e::buffer> one(e::buffer::create(sz));
+        one->resize(sz);
+        memmove(one->data() + HYPERDEX_HEADER_SIZE_VV, body.data(), body.size());
+        e::unpacker oup = one->unpack_from(HYPERDEX_HEADER_SIZE_VV);
+
+        switch (static_cast<network_msgtype>(mt))
+        {
+            case CHAIN_OP:
+                process_chain_op(from, vfrom, vto, one, oup);
+                break;
+            case CHAIN_SUBSPACE:
+                process_chain_subspace(from, vfrom, vto, one, oup);
+                break;
+            case CHAIN_ACK:
+                process_chain_ack(from, vfrom, vto, one, oup);
+                break;
+            default:
+                LOG(WARNING) << "CHAIN_BATCH carries unexpected message type " << static_cast<network_msgtype>(mt);
+                break;
+        }
+    }
+}
+
 void
 daemon :: process_xfer_op(server_id,
                           virtual_server_id vfrom,
@@ -778,19 +1282,15 @@ daemon :: process_xfer_op(server_id,
 {
     uint8_t flags;
     uint64_t xid;
-    uint64_t seq_no;
-    uint64_t version;
-    e::slice key;
-    std::vector<e::slice> value;
+    uint64_t count;
 
-    if ((up >> flags >> xid >> seq_no >> version >> key >> value).error())
+    if ((up >> flags >> xid >> count).error())
     {
         LOG(WARNING) << "unpack of XFER_OP failed; here's some hex:  " << msg->hex();
         return;
     }
 
-    bool has_value = flags & 1;
-    m_stm.xfer_op(vfrom, transfer_id(xid), seq_no, has_value, version, msg, key, value);
+    m_stm.xfer_op(vfrom, transfer_id(xid), count, msg, up);
 }
 
 void
@@ -812,3 +1312,23 @@ daemon :: process_xfer_ack(server_id from,
 
     m_stm.xfer_ack(from, vto, transfer_id(xid), seq_no);
 }
+
+void
+daemon :: process_xfer_tree(server_id,
+                            virtual_server_id vfrom,
+                            virtual_server_id,
+                            std::auto_ptr<e::buffer> msg,
+                            e::unpacker up)
+{
+    uint8_t flags;
+    uint64_t xid;
+    std::vector<uint64_t> leaves;
+
+    if ((up >> flags >> xid >> leaves).error())
+    {
+        LOG(WARNING) << "unpack of XFER_TREE failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_stm.xfer_tree(vfrom, transfer_id(xid), leaves);
+}
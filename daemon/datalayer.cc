@@ -35,6 +35,7 @@
 #include <signal.h>
 
 // STL
+#include <algorithm>
 #include <sstream>
 #include <string>
 
@@ -49,13 +50,16 @@
 #include <e/endian.h>
 
 // HyperDex
+#include "common/hash.h"
 #include "common/macros.h"
 #include "common/range_searches.h"
 #include "common/serialization.h"
+#include "daemon/chunking.h"
 #include "daemon/daemon.h"
 #include "daemon/datalayer.h"
 #include "daemon/datalayer_encodings.h"
 #include "datatypes/apply.h"
+#include "datatypes/elements.h"
 #include "datatypes/microerror.h"
 
 // ASSUME:  all keys put into leveldb have a first byte without the high bit set
@@ -64,6 +68,39 @@ using std::tr1::placeholders::_1;
 using hyperdex::datalayer;
 using hyperdex::leveldb_snapshot_ptr;
 using hyperdex::reconfigure_returncode;
+using hyperdex::region_id;
+
+// The most writers a group commit will fold into one LevelDB write
+#define GROUP_COMMIT_MAX_WRITERS 128
+// The most objects an index backfill reads before yielding to writers
+#define BACKFILL_BATCH_SIZE 1024
+// The most objects a rehome moves in one write
+#define REHOME_BATCH_SIZE 1024
+// The entries an approximate count reads to estimate density and selectivity
+#define COUNT_SAMPLE_SIZE 256
+// The most legacy acked records restore_acked deletes in one WriteBatch
+#define ACKED_MIGRATE_BATCH_SIZE 1024
+
+// Replays the contents of one WriteBatch into another
+class batch_appender : public leveldb::WriteBatch::Handler
+{
+    public:
+        batch_appender(leveldb::WriteBatch* batch) : m_batch(batch) {}
+        virtual ~batch_appender() throw () {}
+
+    public:
+        virtual void Put(const leveldb::Slice& key, const leveldb::Slice& value)
+        { m_batch->Put(key, value); }
+        virtual void Delete(const leveldb::Slice& key)
+        { m_batch->Delete(key); }
+
+    private:
+        batch_appender(const batch_appender&);
+        batch_appender& operator = (const batch_appender&);
+
+    private:
+        leveldb::WriteBatch* m_batch;
+};
 
 datalayer :: datalayer(daemon* d)
     : m_daemon(d)
@@ -78,6 +115,15 @@ datalayer :: datalayer(daemon* d)
     , m_need_pause(false)
     , m_paused(false)
     , m_state_transfer_captures()
+    , m_backfills()
+    , m_rehomes()
+    , m_block_backfill()
+    , m_block_writers()
+    , m_wakeup_writers(&m_block_writers)
+    , m_writers()
+    , m_durable(false)
+    , m_cache()
+    , m_acked()
 {
 }
 
@@ -88,11 +134,15 @@ datalayer :: ~datalayer() throw ()
 
 bool
 datalayer :: setup(const po6::pathname& path,
+                   bool durable,
+                   uint64_t cache_size,
                    bool* saved,
                    server_id* saved_us,
                    po6::net::location* saved_bind_to,
                    po6::net::hostname* saved_coordinator)
 {
+    m_durable = durable;
+    m_cache.set_capacity(cache_size);
     leveldb::Options opts;
     opts.write_buffer_size = 64ULL * 1024ULL * 1024ULL;
     opts.create_if_missing = true;
@@ -199,6 +249,11 @@ datalayer :: setup(const po6::pathname& path,
         return false;
     }
 
+    if (!restore_acked())
+    {
+        return false;
+    }
+
     {
         po6::threads::mutex::hold hold(&m_block_cleaner);
         m_cleaner.start();
@@ -407,7 +462,7 @@ datalayer :: unpause()
 }
 
 void
-datalayer :: reconfigure(const configuration&,
+datalayer :: reconfigure(const configuration& old_config,
                          const configuration& new_config,
                          const server_id& us)
 {
@@ -436,6 +491,49 @@ datalayer :: reconfigure(const configuration&,
 
     std::sort(regions.begin(), regions.end());
     m_counters.adopt(regions);
+    plan_rehomes(old_config, new_config, us);
+    plan_backfills(old_config, new_config, us);
+
+    // regions may have moved; start the object cache over from the disk
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t bytes;
+    cache_stats(&hits, &misses, &bytes);
+    LOG(INFO) << "object cache: " << hits << " hits, " << misses
+              << " misses, " << bytes << " bytes cached";
+    m_cache.clear();
+}
+
+uint64_t
+datalayer :: approximate_size(const region_id& ri)
+{
+    // the region's objects, followed by the chunks of its large attributes
+    const char prefixes[] = {'o', 'c'};
+    char lbacking[2][sizeof(uint8_t) + sizeof(uint64_t)];
+    char ubacking[2][sizeof(uint8_t) + sizeof(uint64_t)];
+    leveldb::Range r[2];
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        char* ptr = lbacking[i];
+        ptr = e::pack8be(prefixes[i], ptr);
+        ptr = e::pack64be(ri.get(), ptr);
+        ptr = ubacking[i];
+        ptr = e::pack8be(prefixes[i], ptr);
+        ptr = e::pack64be(ri.get() + 1, ptr);
+        r[i] = leveldb::Range(leveldb::Slice(lbacking[i], sizeof(lbacking[i])),
+                              leveldb::Slice(ubacking[i], sizeof(ubacking[i])));
+    }
+
+    uint64_t sz[2] = {0, 0};
+    m_db->GetApproximateSizes(r, 2, sz);
+    return sz[0] + sz[1];
+}
+
+void
+datalayer :: cache_stats(uint64_t* hits, uint64_t* misses, uint64_t* bytes)
+{
+    m_cache.stats(hits, misses, bytes);
 }
 
 datalayer::returncode
@@ -445,18 +543,73 @@ datalayer :: get(const region_id& ri,
                  uint64_t* version,
                  reference* ref)
 {
+    object_cache::object_ptr cached;
+    uint64_t stamp;
+
+    if (m_cache.get(ri, key, &cached, &stamp))
+    {
+        *value = cached->value;
+        *version = cached->version;
+        ref->m_object = cached;
+        return SUCCESS;
+    }
+
     leveldb::ReadOptions opts;
     opts.fill_cache = true;
     opts.verify_checksums = true;
     std::vector<char> kbacking;
     leveldb::Slice lkey;
     encode_key(ri, key, &kbacking, &lkey);
-    leveldb::Status st = m_db->Get(opts, lkey, &ref->m_backing);
+    std::tr1::shared_ptr<object_cache::object> obj(new object_cache::object());
+    leveldb::Status st = m_db->Get(opts, lkey, &obj->backing);
+    region_id from = ri;
+
+    // A split or merge may not have moved the object here yet.  A key is
+    // stored in only one region of a subspace, so the first copy found is
+    // the only one.
+    if (st.IsNotFound())
+    {
+        std::vector<region_id> sources;
+        rehome_sources(ri, &sources);
+
+        for (size_t i = 0; st.IsNotFound() && i < sources.size(); ++i)
+        {
+            if (sources[i] == ri)
+            {
+                continue;
+            }
+
+            from = sources[i];
+            encode_key(from, key, &kbacking, &lkey);
+            st = m_db->Get(opts, lkey, &obj->backing);
+        }
+    }
 
     if (st.ok())
     {
-        e::slice v(ref->m_backing.data(), ref->m_backing.size());
-        return decode_value(v, value, version);
+        returncode rc = load_object(NULL, from, key, &obj->backing, &obj->chunks, &obj->value, &obj->version);
+
+        if (rc != SUCCESS)
+        {
+            return rc;
+        }
+
+        if (from != ri && home_of(*m_daemon->m_config, ri, key, obj->value) != ri)
+        {
+            return NOT_FOUND;
+        }
+
+        *value = obj->value;
+        *version = obj->version;
+        ref->m_object = obj;
+
+        // the copy in another region is about to move, so don't cache it
+        if (from == ri)
+        {
+            m_cache.insert(ri, key, stamp, obj);
+        }
+
+        return SUCCESS;
     }
     else if (st.IsNotFound())
     {
@@ -489,55 +642,31 @@ datalayer :: del(const region_id& ri,
                  const std::vector<e::slice>& old_value)
 {
     leveldb::WriteBatch updates;
-    std::vector<char> backing1;
-    std::vector<char> backing2;
+    const configuration* config = m_daemon->m_config.get();
+    const schema* sc = config->get_schema(ri);
+    std::vector<region_id> locs;
+    locations(*config, ri, key, old_value, &locs);
 
-    // peform the "del" of the object we want to store
-    leveldb::Slice lkey;
-    encode_key(ri, key, &backing1, &lkey);
-    updates.Delete(lkey);
-
-    // apply the index operations
-    const schema* sc = m_daemon->m_config.get_schema(ri);
-    const subspace* su = m_daemon->m_config.get_subspace(ri);
-    returncode rc = create_index_changes(sc, su, ri, key, &old_value, NULL, &updates);
-
-    if (rc != SUCCESS)
+    // peform the "del" of the object wherever a split or merge left it,
+    // along with its index entries
+    for (size_t i = 0; i < locs.size(); ++i)
     {
-        return rc;
-    }
+        returncode rc = stage_del(*config, sc, locs[i], key, old_value, &updates);
 
-    // Mark acked as part of this batch write
-    if (seq_id != 0)
-    {
-        char abacking[ACKED_BUF_SIZE];
-        seq_id = UINT64_MAX - seq_id;
-        encode_acked(ri, reg_id, seq_id, abacking);
-        leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
-        leveldb::Slice aval("", 0);
-        updates.Put(akey, aval);
+        if (rc != SUCCESS)
+        {
+            return rc;
+        }
     }
 
-    uint64_t count;
+    // Perform the write
+    leveldb::Status st = write(&updates, ri, reg_id, seq_id);
 
-    // If this is a captured region, then we must log this transfer
-    if (m_counters.lookup(ri, &count))
+    for (size_t i = 0; i < locs.size(); ++i)
     {
-        char tbacking[TRANSFER_BUF_SIZE];
-        capture_id cid = m_daemon->m_config.capture_for(ri);
-        assert(cid != capture_id());
-        leveldb::Slice tkey(tbacking, TRANSFER_BUF_SIZE);
-        leveldb::Slice tval;
-        encode_transfer(cid, count, tbacking);
-        encode_key_value(key, NULL, 0, &backing2, &tval);
-        updates.Put(tkey, tval);
+        m_cache.invalidate(locs[i], key);
     }
 
-    // Perform the write
-    leveldb::WriteOptions opts;
-    opts.sync = false;
-    leveldb::Status st = m_db->Write(opts, &updates);
-
     if (st.ok())
     {
         return SUCCESS;
@@ -574,59 +703,21 @@ datalayer :: put(const region_id& ri,
                  uint64_t version)
 {
     leveldb::WriteBatch updates;
-    std::vector<char> backing1;
-    std::vector<char> backing2;
-
-    // peform the "put" of the object we want to store
-    leveldb::Slice lkey;
-    leveldb::Slice lval;
-    encode_key(ri, key, &backing1, &lkey);
-    encode_value(new_value, version, &backing2, &lval);
-    updates.Put(lkey, lval);
-
-    // apply the index operations
-    const schema* sc = m_daemon->m_config.get_schema(ri);
-    const subspace* su = m_daemon->m_config.get_subspace(ri);
-    returncode rc = create_index_changes(sc, su, ri, key, NULL, &new_value, &updates);
+    // an op hashed before a split or merge belongs in the new region
+    region_id to = home_of(*m_daemon->m_config, ri, key, new_value);
+    returncode rc = bulk_put(to, key, new_value, version, &updates);
 
     if (rc != SUCCESS)
     {
         return rc;
     }
 
-    // Mark acked as part of this batch write
-    if (seq_id != 0)
-    {
-        char abacking[ACKED_BUF_SIZE];
-        seq_id = UINT64_MAX - seq_id;
-        encode_acked(ri, reg_id, seq_id, abacking);
-        leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
-        leveldb::Slice aval("", 0);
-        updates.Put(akey, aval);
-    }
-
-    uint64_t count;
-
-    // If this is a captured region, then we must log this transfer
-    if (m_counters.lookup(ri, &count))
-    {
-        char tbacking[TRANSFER_BUF_SIZE];
-        capture_id cid = m_daemon->m_config.capture_for(ri);
-        assert(cid != capture_id());
-        leveldb::Slice tkey(tbacking, TRANSFER_BUF_SIZE);
-        leveldb::Slice tval;
-        encode_transfer(cid, count, tbacking);
-        encode_key_value(key, &new_value, version, &backing2, &tval);
-        updates.Put(tkey, tval);
-    }
-
     // Perform the write
-    leveldb::WriteOptions opts;
-    opts.sync = false;
-    leveldb::Status st = m_db->Write(opts, &updates);
+    leveldb::Status st = write(&updates, ri, reg_id, seq_id);
 
     if (st.ok())
     {
+        update_cache(to, key, new_value, version);
         return SUCCESS;
     }
     else if (st.IsNotFound())
@@ -664,59 +755,77 @@ datalayer :: overput(const region_id& ri,
                      uint64_t version)
 {
     leveldb::WriteBatch updates;
-    std::vector<char> backing1;
     std::vector<char> backing2;
+    const configuration* config = m_daemon->m_config.get();
+    const schema* sc = config->get_schema(ri);
+    std::vector<region_id> locs;
+    locations(*config, ri, key, old_value, &locs);
+    region_id to = home_of(*config, ri, key, new_value);
 
-    // peform the "put" of the object we want to store
-    leveldb::Slice lkey;
-    leveldb::Slice lval;
-    encode_key(ri, key, &backing1, &lkey);
-    encode_value(new_value, version, &backing2, &lval);
-    updates.Put(lkey, lval);
+    // A split or merge moved the object, or will; rewrite it in full in its
+    // new region rather than diff it against the old.
+    if (locs.size() != 1 || locs[0] != ri || to != ri)
+    {
+        for (size_t i = 0; i < locs.size(); ++i)
+        {
+            returncode rc = stage_del(*config, sc, locs[i], key, old_value, &updates);
 
-    // apply the index operations
-    const schema* sc = m_daemon->m_config.get_schema(ri);
-    const subspace* su = m_daemon->m_config.get_subspace(ri);
-    returncode rc = create_index_changes(sc, su, ri, key, &old_value, &new_value, &updates);
+            if (rc != SUCCESS)
+            {
+                return rc;
+            }
+        }
 
-    if (rc != SUCCESS)
-    {
-        return rc;
-    }
+        returncode rc = bulk_put(to, key, new_value, version, &updates);
 
-    // Mark acked as part of this batch write
-    if (seq_id != 0)
-    {
-        char abacking[ACKED_BUF_SIZE];
-        seq_id = UINT64_MAX - seq_id;
-        encode_acked(ri, reg_id, seq_id, abacking);
-        leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
-        leveldb::Slice aval("", 0);
-        updates.Put(akey, aval);
+        if (rc != SUCCESS)
+        {
+            return rc;
+        }
     }
+    else
+    {
+        std::vector<uint16_t> indexed;
+        config->index_attrs(ri, &indexed);
 
-    uint64_t count;
+        // peform the "put" of the object we want to store
+        put_object(sc, ri, key, &old_value, new_value, version, &updates);
 
-    // If this is a captured region, then we must log this transfer
-    if (m_counters.lookup(ri, &count))
-    {
-        char tbacking[TRANSFER_BUF_SIZE];
-        capture_id cid = m_daemon->m_config.capture_for(ri);
-        assert(cid != capture_id());
-        leveldb::Slice tkey(tbacking, TRANSFER_BUF_SIZE);
-        leveldb::Slice tval;
-        encode_transfer(cid, count, tbacking);
-        encode_key_value(key, &new_value, version, &backing2, &tval);
-        updates.Put(tkey, tval);
+        // apply the index operations
+        returncode rc = create_index_changes(sc, indexed, ri, key, &old_value, &new_value, &updates);
+
+        if (rc != SUCCESS)
+        {
+            return rc;
+        }
+
+        uint64_t count;
+
+        // If this is a captured region, then we must log this transfer
+        if (m_counters.lookup(ri, &count))
+        {
+            char tbacking[TRANSFER_BUF_SIZE];
+            capture_id cid = config->capture_for(ri);
+            assert(cid != capture_id());
+            leveldb::Slice tkey(tbacking, TRANSFER_BUF_SIZE);
+            leveldb::Slice tval;
+            encode_transfer(cid, count, tbacking);
+            encode_key_value(key, &new_value, version, &backing2, &tval);
+            updates.Put(tkey, tval);
+        }
     }
 
     // Perform the write
-    leveldb::WriteOptions opts;
-    opts.sync = false;
-    leveldb::Status st = m_db->Write(opts, &updates);
+    leveldb::Status st = write(&updates, ri, reg_id, seq_id);
+
+    for (size_t i = 0; i < locs.size(); ++i)
+    {
+        m_cache.invalidate(locs[i], key);
+    }
 
     if (st.ok())
     {
+        update_cache(to, key, new_value, version);
         return SUCCESS;
     }
     else if (st.IsNotFound())
@@ -759,11 +868,11 @@ datalayer :: uncertain_del(const region_id& ri,
 
     if (st.ok())
     {
-        const schema* sc = m_daemon->m_config.get_schema(ri);
+        const schema* sc = m_daemon->m_config->get_schema(ri);
+        std::vector<std::string> chunks;
         std::vector<e::slice> old_value;
         uint64_t old_version;
-        returncode rc = decode_value(e::slice(ref.data(), ref.size()),
-                                     &old_value, &old_version);
+        returncode rc = load_object(NULL, ri, key, &ref, &chunks, &old_value, &old_version);
 
         if (rc != SUCCESS)
         {
@@ -817,11 +926,11 @@ datalayer :: uncertain_put(const region_id& ri,
 
     if (st.ok())
     {
-        const schema* sc = m_daemon->m_config.get_schema(ri);
+        const schema* sc = m_daemon->m_config->get_schema(ri);
+        std::vector<std::string> chunks;
         std::vector<e::slice> old_value;
         uint64_t old_version;
-        returncode rc = decode_value(e::slice(ref.data(), ref.size()),
-                                     &old_value, &old_version);
+        returncode rc = load_object(NULL, ri, key, &ref, &chunks, &old_value, &old_version);
 
         if (rc != SUCCESS)
         {
@@ -858,6 +967,105 @@ datalayer :: uncertain_put(const region_id& ri,
     }
 }
 
+datalayer::returncode
+datalayer :: bulk_put(const region_id& ri,
+                      const e::slice& key,
+                      const std::vector<e::slice>& new_value,
+                      uint64_t version,
+                      leveldb::WriteBatch* updates)
+{
+    const configuration* config = m_daemon->m_config.get();
+    std::vector<char> backing2;
+    const schema* sc = config->get_schema(ri);
+    std::vector<uint16_t> indexed;
+    config->index_attrs(ri, &indexed);
+
+    // peform the "put" of the object we want to store
+    put_object(sc, ri, key, NULL, new_value, version, updates);
+
+    // apply the index operations
+    returncode rc = create_index_changes(sc, indexed, ri, key, NULL, &new_value, updates);
+
+    if (rc != SUCCESS)
+    {
+        return rc;
+    }
+
+    uint64_t count;
+
+    // If this is a captured region, then we must log this transfer
+    if (m_counters.lookup(ri, &count))
+    {
+        char tbacking[TRANSFER_BUF_SIZE];
+        capture_id cid = config->capture_for(ri);
+        assert(cid != capture_id());
+        leveldb::Slice tkey(tbacking, TRANSFER_BUF_SIZE);
+        leveldb::Slice tval;
+        encode_transfer(cid, count, tbacking);
+        encode_key_value(key, &new_value, version, &backing2, &tval);
+        updates->Put(tkey, tval);
+    }
+
+    return SUCCESS;
+}
+
+datalayer::returncode
+datalayer :: bulk_write(leveldb::WriteBatch* updates)
+{
+    leveldb::Status st = write(updates);
+
+    if (st.ok())
+    {
+        return SUCCESS;
+    }
+    else if (st.IsNotFound())
+    {
+        LOG(ERROR) << "bulk write returned NOT_FOUND at the disk layer: desc=" << st.ToString();
+        return NOT_FOUND;
+    }
+    else if (st.IsCorruption())
+    {
+        LOG(ERROR) << "corruption at the disk layer: desc=" << st.ToString();
+        return CORRUPTION;
+    }
+    else if (st.IsIOError())
+    {
+        LOG(ERROR) << "IO error at the disk layer: desc=" << st.ToString();
+        return IO_ERROR;
+    }
+    else
+    {
+        LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
+        return LEVELDB_ERROR;
+    }
+}
+
+// True if every object in the index range "r" passes "checks", so that a scan
+// of r need not read objects to evaluate them.  String ranges are excluded
+// because the bumped end of a string range also admits longer strings.
+static bool
+covers(const hyperdex::range& r, const std::vector<hyperdex::attribute_check>& checks)
+{
+    if (r.invalid || r.elements ||
+        (r.type != HYPERDATATYPE_INT64 && r.type != HYPERDATATYPE_FLOAT))
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < checks.size(); ++i)
+    {
+        if (checks[i].attr != r.attr ||
+            (checks[i].predicate != HYPERPREDICATE_EQUALS &&
+             checks[i].predicate != HYPERPREDICATE_LESS_EQUAL &&
+             checks[i].predicate != HYPERPREDICATE_GREATER_EQUAL))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 datalayer::returncode
 datalayer :: make_snapshot(const region_id& ri,
                            const schema& sc,
@@ -869,6 +1077,7 @@ datalayer :: make_snapshot(const region_id& ri,
     snap->m_snap.reset(m_db, m_db->GetSnapshot());
     snap->m_checks = checks;
     snap->m_ri = ri;
+    snap->m_from = ri;
     snap->m_ostr = ostr;
     std::vector<range> ranges;
 
@@ -877,11 +1086,30 @@ datalayer :: make_snapshot(const region_id& ri,
         return BAD_SEARCH;
     }
 
+    // While a split or merge moves objects, neither this region's rows nor
+    // its indices are complete.  Scan every object here, then those of the
+    // regions still being moved, keeping the ones that belong here.
+    std::vector<region_id> sources;
+    rehome_sources(ri, &sources);
+    snap->m_rehoming = !sources.empty();
+
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        if (sources[i] != ri)
+        {
+            snap->m_strays.push_back(sources[i]);
+        }
+    }
+
     if (ostr) *ostr << " converted " << checks->size() << " checks to " << ranges.size() << " ranges\n";
 
     char* ptr;
     std::vector<leveldb::Range> level_ranges;
     std::vector<bool (*)(const leveldb::Slice& in, e::slice* out)> parsers;
+    // the entry of ranges behind each of level_ranges
+    std::vector<size_t> range_idxs;
+    std::vector<uint16_t> indexed;
+    m_daemon->m_config->index_attrs(ri, &indexed);
 
     // For each range, setup a leveldb range using encoded values
     for (size_t i = 0; i < ranges.size(); ++i)
@@ -891,8 +1119,17 @@ datalayer :: make_snapshot(const region_id& ri,
                         << (ranges[i].has_start ? "[" : "<") << "-" << (ranges[i].has_end ? "]" : ">")
                         << " " << (ranges[i].invalid ? "invalid" : "valid") << "\n";
 
-        if (ranges[i].attr >= sc.attrs_sz ||
-            sc.attrs[ranges[i].attr].type != ranges[i].type)
+        if (ranges[i].attr >= sc.attrs_sz)
+        {
+            return BAD_SEARCH;
+        }
+
+        hyperdatatype attr_type = sc.attrs[ranges[i].attr].type;
+
+        // element ranges are served by the per-element index of a container
+        if (ranges[i].elements
+            ? IS_PRIMITIVE(attr_type) || container_element_type(attr_type) != ranges[i].type
+            : attr_type != ranges[i].type)
         {
             return BAD_SEARCH;
         }
@@ -923,6 +1160,27 @@ datalayer :: make_snapshot(const region_id& ri,
             continue;
         }
 
+        // Only attributes in this region's subspace, or declared as indices
+        // of its space, are indexed here.  Using any other index, or one
+        // still being backfilled, would silently drop objects.
+        if (std::find(indexed.begin(), indexed.end(), ranges[i].attr) == indexed.end())
+        {
+            if (ostr) *ostr << " attr " << ranges[i].attr << " is not indexed in this region\n";
+            continue;
+        }
+
+        if (is_backfilling(ri, ranges[i].attr))
+        {
+            if (ostr) *ostr << " attr " << ranges[i].attr << " is still being backfilled\n";
+            continue;
+        }
+
+        if (snap->m_rehoming)
+        {
+            if (ostr) *ostr << " attr " << ranges[i].attr << " is incomplete while objects are rehomed\n";
+            continue;
+        }
+
         if (ranges[i].has_start)
         {
             snap->m_backing.push_back(std::vector<char>());
@@ -958,6 +1216,7 @@ datalayer :: make_snapshot(const region_id& ri,
         leveldb::Slice limit(&snap->m_backing.back()[0], snap->m_backing.back().size());
         level_ranges.push_back(leveldb::Range(start, limit));
         parsers.push_back(parse);
+        range_idxs.push_back(i);
     }
 
     // Add to level_ranges the size of the object range for the region itself
@@ -1038,6 +1297,7 @@ datalayer :: make_snapshot(const region_id& ri,
         if (ostr) *ostr << " choosing to just enumerate all objects\n";
         snap->m_range = object_range;
         snap->m_parse = &parse_object_key;
+        snap->m_covered = checks->empty() && !snap->m_rehoming;
     }
     else
     {
@@ -1045,26 +1305,261 @@ datalayer :: make_snapshot(const region_id& ri,
         if (ostr) *ostr << " choosing to use index " << tidx << " as the primary\n";
         snap->m_range = level_ranges[tidx];
         snap->m_parse = parsers[tidx];
+        snap->m_covered = idx == 1 && covers(ranges[range_idxs[tidx]], *checks);
     }
 
-    // Create iterator
+    if (ostr && snap->m_covered) *ostr << " the checks are answered by the range alone\n";
+
     leveldb::ReadOptions opts;
     opts.fill_cache = false;
     opts.verify_checksums = false;
     opts.snapshot = snap->m_snap.get();
+
+    // Pull the keys from the other low-cost indices into filters so that
+    // candidates from the primary index may be rejected without a Get.  Each
+    // filter is a sorted set of key hashes; a false positive is caught by the
+    // full check evaluation in snapshot::valid.
+    for (size_t j = 1; j < idx; ++j)
+    {
+        size_t fidx = size_idxs[j].second;
+        if (ostr) *ostr << " using index " << fidx << " as a filter\n";
+        index_filter filter;
+        leveldb_iterator_ptr fiter;
+        fiter.reset(snap->m_snap, m_db->NewIterator(opts));
+        fiter->Seek(level_ranges[fidx].start);
+        bool usable = true;
+
+        while (usable && fiter->Valid() &&
+               fiter->key().compare(level_ranges[fidx].limit) < 0)
+        {
+            e::slice key;
+            usable = (*parsers[fidx])(fiter->key(), &key);
+            filter.insert(key);
+            fiter->Next();
+        }
+
+        if (!usable || !fiter->status().ok())
+        {
+            if (ostr) *ostr << " could not read index " << fidx << "; not filtering on it\n";
+            continue;
+        }
+
+        filter.seal();
+        if (ostr) *ostr << " filter from index " << fidx << " holds " << filter.size() << " keys\n";
+        snap->m_filters.push_back(filter);
+    }
+
+    // Create iterator
     snap->m_iter.reset(snap->m_snap, m_db->NewIterator(opts));
     snap->m_iter->Seek(snap->m_range.start);
     return SUCCESS;
 }
 
-leveldb_snapshot_ptr
-datalayer :: make_raw_snapshot()
+datalayer::returncode
+datalayer :: approximate_count(const region_id& ri,
+                               const schema& sc,
+                               const std::vector<attribute_check>* checks,
+                               uint64_t* count)
 {
-    return leveldb_snapshot_ptr(m_db, m_db->GetSnapshot());
-}
+    snapshot snap;
+    returncode rc = make_snapshot(ri, sc, checks, &snap, NULL);
 
-void
-datalayer :: make_region_iterator(region_iterator* riter,
+    if (rc != SUCCESS)
+    {
+        return rc;
+    }
+
+    snap.keys_only();
+    *count = 0;
+
+    // Sample the raw entries at the front of the scanned range to learn how
+    // many bytes each takes on disk.
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    opts.verify_checksums = false;
+    opts.snapshot = snap.m_snap.get();
+    leveldb_iterator_ptr it;
+    it.reset(snap.m_snap, m_db->NewIterator(opts));
+    it->Seek(snap.m_range.start);
+    uint64_t sampled = 0;
+    uint64_t sampled_bytes = 0;
+
+    while (sampled < COUNT_SAMPLE_SIZE && it->Valid() &&
+           it->key().compare(snap.m_range.limit) < 0)
+    {
+        sampled_bytes += it->key().size() + it->value().size();
+        ++sampled;
+        it->Next();
+    }
+
+    if (!it->status().ok())
+    {
+        return LEVELDB_ERROR;
+    }
+
+    bool exhausted = sampled < COUNT_SAMPLE_SIZE;
+
+    // The sample holds the whole range, so count it exactly; the walk is no
+    // longer than the sample.
+    if (exhausted)
+    {
+        while (snap.valid())
+        {
+            ++*count;
+            snap.next();
+        }
+
+        return snap.m_error;
+    }
+
+    // Objects still in the memtable are invisible to GetApproximateSizes, so
+    // the range is at least as big as what was just read.
+    uint64_t range_bytes = 0;
+    m_db->GetApproximateSizes(&snap.m_range, 1, &range_bytes);
+    range_bytes = std::max(range_bytes, sampled_bytes);
+    double entries = static_cast<double>(range_bytes) * sampled / sampled_bytes;
+
+    // Unless the range alone answers the checks, scale by the fraction of
+    // the sampled candidates which pass them.
+    if (!snap.m_covered)
+    {
+        uint64_t matched = 0;
+        snap.m_budget = sampled;
+
+        while (snap.valid())
+        {
+            ++matched;
+            snap.next();
+        }
+
+        if (snap.m_error != SUCCESS)
+        {
+            return snap.m_error;
+        }
+
+        uint64_t examined = snap.m_num_gets + snap.m_num_filtered;
+        entries = examined > 0 ? entries * matched / examined : 0;
+    }
+
+    *count = static_cast<uint64_t>(entries + 0.5);
+    return SUCCESS;
+}
+
+datalayer::returncode
+datalayer :: make_sorted_snapshot(const region_id& ri,
+                                  const schema& sc,
+                                  const std::vector<attribute_check>* checks,
+                                  uint16_t sort_by,
+                                  bool maximize,
+                                  snapshot* snap)
+{
+    // String index entries append the key to the value, so they are not in
+    // value order; only the fixed-width encodings can be walked in order.
+    if (sort_by == 0 || sort_by >= sc.attrs_sz ||
+        (sc.attrs[sort_by].type != HYPERDATATYPE_INT64 &&
+         sc.attrs[sort_by].type != HYPERDATATYPE_FLOAT))
+    {
+        return NOT_FOUND;
+    }
+
+    std::vector<uint16_t> indexed;
+    m_daemon->m_config->index_attrs(ri, &indexed);
+
+    if (std::find(indexed.begin(), indexed.end(), sort_by) == indexed.end() ||
+        is_backfilling(ri, sort_by) || is_rehoming(ri))
+    {
+        return NOT_FOUND;
+    }
+
+    std::vector<range> ranges;
+
+    if (!range_searches(*checks, &ranges))
+    {
+        return BAD_SEARCH;
+    }
+
+    snap->m_dl = this;
+    snap->m_snap.reset(m_db, m_db->GetSnapshot());
+    snap->m_checks = checks;
+    snap->m_ri = ri;
+    snap->m_from = ri;
+    snap->m_ostr = NULL;
+    snap->m_parse = &parse_index_sizeof8;
+    snap->m_reverse = maximize;
+    hyperdatatype type = sc.attrs[sort_by].type;
+    const range* bound = NULL;
+
+    // narrow the walk to the checks on sort_by itself
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+        if (ranges[i].attr == sort_by && !ranges[i].elements && ranges[i].type == type)
+        {
+            bound = &ranges[i];
+            break;
+        }
+    }
+
+    snap->m_backing.push_back(std::vector<char>());
+
+    if (bound && bound->has_start)
+    {
+        encode_index(ri, sort_by, type, bound->start, &snap->m_backing.back());
+    }
+    else
+    {
+        encode_index(ri, sort_by, &snap->m_backing.back());
+    }
+
+    snap->m_range.start = leveldb::Slice(&snap->m_backing.back()[0], snap->m_backing.back().size());
+    snap->m_backing.push_back(std::vector<char>());
+
+    if (bound && bound->has_end)
+    {
+        encode_index(ri, sort_by, type, bound->end, &snap->m_backing.back());
+        bump_index(&snap->m_backing.back());
+    }
+    else
+    {
+        encode_index(ri, sort_by + 1, &snap->m_backing.back());
+    }
+
+    snap->m_range.limit = leveldb::Slice(&snap->m_backing.back()[0], snap->m_backing.back().size());
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    opts.verify_checksums = false;
+    opts.snapshot = snap->m_snap.get();
+    snap->m_iter.reset(snap->m_snap, m_db->NewIterator(opts));
+
+    if (maximize)
+    {
+        // position on the last entry before the limit
+        snap->m_iter->Seek(snap->m_range.limit);
+
+        if (snap->m_iter->Valid())
+        {
+            snap->m_iter->Prev();
+        }
+        else
+        {
+            snap->m_iter->SeekToLast();
+        }
+    }
+    else
+    {
+        snap->m_iter->Seek(snap->m_range.start);
+    }
+
+    return SUCCESS;
+}
+
+leveldb_snapshot_ptr
+datalayer :: make_raw_snapshot()
+{
+    return leveldb_snapshot_ptr(m_db, m_db->GetSnapshot());
+}
+
+void
+datalayer :: make_region_iterator(region_iterator* riter,
                                   leveldb_snapshot_ptr snap,
                                   const region_id& ri)
 {
@@ -1096,7 +1591,7 @@ datalayer :: get_transfer(const region_id& ri,
     opts.fill_cache = true;
     opts.verify_checksums = true;
     char tbacking[TRANSFER_BUF_SIZE];
-    capture_id cid = m_daemon->m_config.capture_for(ri);
+    capture_id cid = m_daemon->m_config->capture_for(ri);
     assert(cid != capture_id());
     leveldb::Slice lkey(tbacking, TRANSFER_BUF_SIZE);
     encode_transfer(cid, seq_no, tbacking);
@@ -1135,35 +1630,930 @@ datalayer :: check_acked(const region_id& ri,
                          const region_id& reg_id,
                          uint64_t seq_id)
 {
-    // make it so that increasing seq_ids are ordered in reverse in the KVS
-    seq_id = UINT64_MAX - seq_id;
-    leveldb::ReadOptions opts;
-    opts.fill_cache = true;
-    opts.verify_checksums = true;
-    char abacking[ACKED_BUF_SIZE];
-    encode_acked(ri, reg_id, seq_id, abacking);
-    leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
-    std::string val;
-    leveldb::Status st = m_db->Get(opts, akey, &val);
+    return m_acked.check(ri, reg_id, seq_id);
+}
+
+void
+datalayer :: mark_acked(const region_id& ri,
+                        const region_id& reg_id,
+                        uint64_t seq_id)
+{
+    leveldb::WriteBatch updates;
+    leveldb::Status st = write(&updates, ri, reg_id, seq_id);
+
+    if (st.ok())
+    {
+        // Yay!
+    }
+    else if (st.IsCorruption())
+    {
+        LOG(ERROR) << "corruption at the disk layer: region=" << reg_id
+                   << " seq_id=" << seq_id << " desc=" << st.ToString();
+    }
+    else if (st.IsIOError())
+    {
+        LOG(ERROR) << "IO error at the disk layer: region=" << reg_id
+                   << " seq_id=" << seq_id << " desc=" << st.ToString();
+    }
+    else
+    {
+        LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
+    }
+}
+
+void
+datalayer :: max_seq_id(const region_id& reg_id,
+                        uint64_t* seq_id)
+{
+    *seq_id = m_acked.max_seq_id(reg_id);
+}
+
+void
+datalayer :: clear_acked(const region_id& reg_id,
+                         uint64_t seq_id)
+{
+    if (seq_id == 0)
+    {
+        return;
+    }
+
+    std::vector<acked_window::row> dropped;
+    m_acked.advance(reg_id, seq_id, &dropped);
+    save_acked(dropped, true);
+}
+
+void
+datalayer :: request_wipe(const capture_id& cid)
+{
+    po6::threads::mutex::hold hold(&m_block_cleaner);
+    m_state_transfer_captures.insert(cid);
+    m_wakeup_cleaner.broadcast();
+}
+
+leveldb::Status
+datalayer :: write(leveldb::WriteBatch* updates)
+{
+    return write(updates, region_id(), region_id(), 0);
+}
+
+leveldb::Status
+datalayer :: write(leveldb::WriteBatch* updates,
+                   const region_id& ri,
+                   const region_id& reg_id,
+                   uint64_t seq_id)
+{
+    writer w(updates);
+    std::vector<writer*> group;
+    bool staged = false;
+
+    {
+        po6::threads::mutex::hold hold(&m_block_writers);
+
+        // Stage the ack while holding the queue, so that the words of the
+        // acked window reach the disk in the order they were staged.
+        acked_window::row r;
+
+        if (seq_id != 0 && m_acked.stage(ri, reg_id, seq_id, &r))
+        {
+            char kbacking[ACKED_WINDOW_BUF_SIZE];
+            char vbacking[ACKED_WINDOW_VAL_SIZE];
+            encode_acked_window(r, kbacking, vbacking);
+            updates->Put(leveldb::Slice(kbacking, ACKED_WINDOW_BUF_SIZE),
+                         leveldb::Slice(vbacking, ACKED_WINDOW_VAL_SIZE));
+            staged = true;
+        }
+
+        m_writers.push_back(&w);
+
+        while (!w.done && m_writers.front() != &w)
+        {
+            m_wakeup_writers.wait();
+        }
+
+        // We lead this group.  Everyone queued behind us stays blocked until
+        // we are done, and writers arriving meanwhile form the next group.
+        for (std::list<writer*>::iterator it = m_writers.begin();
+                !w.done && it != m_writers.end() &&
+                group.size() < GROUP_COMMIT_MAX_WRITERS; ++it)
+        {
+            group.push_back(*it);
+        }
+    }
+
+    if (!group.empty())
+    {
+        leveldb::WriteBatch merged;
+        leveldb::WriteBatch* batch = updates;
+
+        if (group.size() > 1)
+        {
+            batch_appender app(&merged);
+
+            for (size_t i = 0; i < group.size(); ++i)
+            {
+                group[i]->updates->Iterate(&app);
+            }
+
+            batch = &merged;
+        }
+
+        leveldb::WriteOptions opts;
+        opts.sync = m_durable;
+        leveldb::Status st;
+
+        {
+            po6::threads::mutex::hold hold(&m_block_backfill);
+            st = m_db->Write(opts, batch);
+        }
+
+        po6::threads::mutex::hold hold(&m_block_writers);
+
+        for (size_t i = 0; i < group.size(); ++i)
+        {
+            assert(m_writers.front() == group[i]);
+            m_writers.pop_front();
+            group[i]->status = st;
+            group[i]->done = true;
+        }
+
+        m_wakeup_writers.broadcast();
+    }
+
+    // Only now may a retransmission be told that we acked seq_id
+    if (staged && w.status.ok())
+    {
+        m_acked.commit(ri, reg_id, seq_id);
+    }
+    else if (staged)
+    {
+        m_acked.abort(ri, reg_id, seq_id);
+    }
+
+    return w.status;
+}
+
+region_id
+datalayer :: home_of(const configuration& config,
+                     const region_id& ri,
+                     const e::slice& key,
+                     const std::vector<e::slice>& value)
+{
+    const schema* sc = config.get_schema(ri);
+    subspace_id ssid = config.subspace_of(ri);
+
+    if (!sc || ssid == subspace_id() || value.size() + 1 != sc->attrs_sz)
+    {
+        return ri;
+    }
+
+    std::vector<uint64_t> hashes(sc->attrs_sz);
+    hyperdex::hash(*sc, key, value, &hashes.front());
+    region_id to;
+    config.lookup_region(ssid, hashes, &to);
+
+    if (to == region_id() || config.get_virtual(to, m_daemon->m_us) == virtual_server_id())
+    {
+        return ri;
+    }
+
+    return to;
+}
+
+void
+datalayer :: locations(const configuration& config,
+                       const region_id& ri,
+                       const e::slice& key,
+                       const std::vector<e::slice>& value,
+                       std::vector<region_id>* locs)
+{
+    locs->clear();
+    locs->push_back(ri);
+    locs->push_back(home_of(config, ri, key, value));
+    rehome_sources(ri, locs);
+    std::sort(locs->begin(), locs->end());
+    locs->erase(std::unique(locs->begin(), locs->end()), locs->end());
+}
+
+void
+datalayer :: rehome_sources(const region_id& ri,
+                            std::vector<region_id>* sources)
+{
+    subspace_id ssid = m_daemon->m_config->subspace_of(ri);
+    po6::threads::mutex::hold hold(&m_block_cleaner);
+
+    for (std::list<rehome>::iterator it = m_rehomes.begin();
+            it != m_rehomes.end(); ++it)
+    {
+        if (it->from == ri || (ssid != subspace_id() && it->ssid == ssid))
+        {
+            sources->push_back(it->from);
+        }
+    }
+}
+
+bool
+datalayer :: is_rehoming(const region_id& ri)
+{
+    std::vector<region_id> sources;
+    rehome_sources(ri, &sources);
+    return !sources.empty();
+}
+
+datalayer::returncode
+datalayer :: stage_del(const configuration& config,
+                       const schema* sc,
+                       const region_id& ri,
+                       const e::slice& key,
+                       const std::vector<e::slice>& old_value,
+                       leveldb::WriteBatch* updates)
+{
+    std::vector<uint16_t> indexed;
+
+    // a region no longer in the config may hold an entry for any attribute
+    if (config.get_region(ri))
+    {
+        config.index_attrs(ri, &indexed);
+    }
+    else
+    {
+        for (size_t i = 1; i < sc->attrs_sz; ++i)
+        {
+            indexed.push_back(i);
+        }
+    }
+
+    del_object(sc, ri, key, old_value, updates);
+    returncode rc = create_index_changes(sc, indexed, ri, key, &old_value, NULL, updates);
+
+    if (rc != SUCCESS)
+    {
+        return rc;
+    }
+
+    uint64_t count;
+
+    // If this is a captured region, then we must log this transfer
+    if (m_counters.lookup(ri, &count))
+    {
+        char tbacking[TRANSFER_BUF_SIZE];
+        std::vector<char> backing2;
+        capture_id cid = config.capture_for(ri);
+        assert(cid != capture_id());
+        leveldb::Slice tkey(tbacking, TRANSFER_BUF_SIZE);
+        leveldb::Slice tval;
+        encode_transfer(cid, count, tbacking);
+        encode_key_value(key, NULL, 0, &backing2, &tval);
+        updates->Put(tkey, tval);
+    }
+
+    return SUCCESS;
+}
+
+// Split and merged regions keep their objects on the same servers, but the
+// objects are stored under the id of the region that held them.  Queue a
+// rehome for every region we held that shrank or went away; the cleaner
+// moves its objects in batches once we unpause.  Until it is done, reads and
+// writes look for objects in both places, and no state transfer in the
+// subspace goes live.
+void
+datalayer :: plan_rehomes(const configuration& old_config,
+                          const configuration& new_config,
+                          const server_id& us)
+{
+    std::vector<region_id> ours;
+    new_config.regions_of(us, &ours);
+    std::list<rehome> planned;
+
+    // pick up the rehomes a restart interrupted
+    if (old_config.version() == 0)
+    {
+        leveldb::ReadOptions opts;
+        opts.fill_cache = false;
+        opts.verify_checksums = true;
+        std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
+        it->Seek(leveldb::Slice("r", 1));
+
+        while (it->Valid() && it->key().starts_with(leveldb::Slice("r", 1)))
+        {
+            rehome rh;
+            e::slice k(it->key().data(), it->key().size());
+            e::slice v(it->value().data(), it->value().size());
+
+            if (decode_rehome(k, v, &rh.from, &rh.via) == SUCCESS)
+            {
+                rh.ssid = new_config.subspace_of(rh.via);
+
+                if (rh.ssid == subspace_id())
+                {
+                    rh.ssid = new_config.subspace_of(rh.from);
+                }
+
+                planned.push_back(rh);
+            }
+            else
+            {
+                LOG(ERROR) << "could not decode a pending rehome";
+            }
+
+            it->Next();
+        }
+    }
+
+    std::vector<region_id> regions;
+    old_config.regions_of(us, &regions);
+
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        const region_id& ri(regions[i]);
+        const region* old_reg = old_config.get_region(ri);
+        const region* new_reg = new_config.get_region(ri);
+        assert(old_reg);
+
+        if (new_reg)
+        {
+            bool shrunk = false;
+
+            for (size_t j = 0; j < old_reg->lower_coord.size(); ++j)
+            {
+                shrunk = shrunk ||
+                         new_reg->lower_coord[j] > old_reg->lower_coord[j] ||
+                         new_reg->upper_coord[j] < old_reg->upper_coord[j];
+            }
+
+            if (!shrunk)
+            {
+                continue;
+            }
+        }
+
+        planned.push_back(rehome(ri, ri));
+        planned.back().ssid = old_config.subspace_of(ri);
+    }
+
+    po6::threads::mutex::hold hold(&m_block_cleaner);
+    m_rehomes.splice(m_rehomes.end(), planned);
+    std::list<rehome>::iterator it = m_rehomes.begin();
+
+    while (it != m_rehomes.end())
+    {
+        // a rehome that is planned again must look at every object again
+        bool dup = false;
+
+        for (std::list<rehome>::iterator jt = m_rehomes.begin(); jt != it; ++jt)
+        {
+            if (jt->from == it->from)
+            {
+                jt->next.clear();
+                dup = true;
+            }
+        }
+
+        // The destination regions are found through "via", so it must be a
+        // region of ours in the subspace.  When we hold none, the subspace's
+        // other servers have every object and ours are as stale as those of
+        // any region we left.
+        if (!dup && new_config.get_virtual(it->via, us) == virtual_server_id())
+        {
+            it->via = region_id();
+
+            for (size_t i = 0; i < ours.size(); ++i)
+            {
+                if (new_config.subspace_of(ours[i]) == it->ssid)
+                {
+                    it->via = ours[i];
+                    break;
+                }
+            }
+        }
+
+        if (dup)
+        {
+            it = m_rehomes.erase(it);
+        }
+        else if (it->via == region_id())
+        {
+            LOG(INFO) << "not moving the objects of " << it->from
+                      << " because we no longer serve its subspace";
+            save_rehome(*it, true);
+            it = m_rehomes.erase(it);
+        }
+        else
+        {
+            // if this cannot be saved, a restart leaves the objects where
+            // they are; reads still find them until then
+            save_rehome(*it, false);
+            LOG(INFO) << "moving the objects of " << it->from
+                      << " to the regions that split or merged it in the background";
+            ++it;
+        }
+    }
+}
+
+bool
+datalayer :: save_rehome(const rehome& rh, bool erase)
+{
+    char kbacking[REHOME_BUF_SIZE];
+    char vbacking[REHOME_VAL_SIZE];
+    encode_rehome(rh.from, rh.via, kbacking, vbacking);
+    leveldb::Slice k(kbacking, REHOME_BUF_SIZE);
+    leveldb::Slice v(vbacking, REHOME_VAL_SIZE);
+    leveldb::WriteOptions wopts;
+    wopts.sync = m_durable;
+    leveldb::Status st = erase ? m_db->Delete(wopts, k) : m_db->Put(wopts, k, v);
+
+    if (st.ok())
+    {
+        return true;
+    }
+    else if (st.IsCorruption())
+    {
+        LOG(ERROR) << "corruption at the disk layer: could not save the rehome of "
+                   << rh.from << ": desc=" << st.ToString();
+        return false;
+    }
+    else if (st.IsIOError())
+    {
+        LOG(ERROR) << "IO error at the disk layer: could not save the rehome of "
+                   << rh.from << ": desc=" << st.ToString();
+        return false;
+    }
+    else
+    {
+        LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
+        return false;
+    }
+}
+
+bool
+datalayer :: rehome_batch(rehome* rh)
+{
+    const configuration* config = m_daemon->m_config.get();
+    const schema* sc = config->get_schema(rh->via);
+
+    if (!sc)
+    {
+        return false;
+    }
+
+    char backing[sizeof(uint8_t) + sizeof(uint64_t)];
+    char* ptr = backing;
+    ptr = e::pack8be('o', ptr);
+    ptr = e::pack64be(rh->from.get(), ptr);
+    leveldb::Slice prefix(backing, sizeof(uint8_t) + sizeof(uint64_t));
+    leveldb::WriteBatch updates;
+    std::vector<std::pair<region_id, std::string> > touched;
+    uint64_t moved = 0;
+    uint64_t dropped = 0;
+    size_t objects = 0;
+
+    // As with a backfill, no write may come between reading an object and
+    // moving it, or the move could resurrect a deleted or stale value.
+    po6::threads::mutex::hold hold(&m_block_backfill);
+    leveldb_snapshot_ptr snap = make_raw_snapshot();
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    opts.verify_checksums = true;
+    opts.snapshot = snap.get();
+    std::auto_ptr<leveldb::Iterator> it;
+    it.reset(m_db->NewIterator(opts));
+    it->Seek(rh->next.empty() ? prefix : leveldb::Slice(rh->next));
+
+    while (it->Valid() && it->key().starts_with(prefix) &&
+           objects < REHOME_BATCH_SIZE)
+    {
+        e::slice key;
+        std::vector<e::slice> value;
+        uint64_t version;
+        std::string row(it->value().data(), it->value().size());
+        std::vector<std::string> chunks;
+        ++objects;
+
+        if (!parse_object_key(it->key(), &key) ||
+            load_object(snap.get(), rh->from, key, &row, &chunks, &value, &version) != SUCCESS ||
+            value.size() + 1 != sc->attrs_sz)
+        {
+            LOG(ERROR) << "cannot rehome a corrupt object in " << rh->from;
+            it->Next();
+            continue;
+        }
+
+        std::vector<uint64_t> hashes(sc->attrs_sz);
+        hyperdex::hash(*sc, key, value, &hashes.front());
+        region_id to;
+        config->lookup_region(rh->ssid, hashes, &to);
+
+        if (to == rh->from)
+        {
+            it->Next();
+            continue;
+        }
+
+        if (to == region_id())
+        {
+            LOG(ERROR) << "cannot find the region for key=0x" << key.hex()
+                       << " of " << rh->from << "; leaving it in place";
+            it->Next();
+            continue;
+        }
+
+        // The split or merge left the destination with the same servers as
+        // its source, so it can only be held elsewhere once the coordinator
+        // took us out of it; its remaining servers moved their own copies.
+        bool ours = config->get_virtual(to, m_daemon->m_us) != virtual_server_id();
+        leveldb::WriteBatch one;
+        returncode rc = stage_del(*config, sc, rh->from, key, value, &one);
+
+        if (rc == SUCCESS && ours)
+        {
+            rc = bulk_put(to, key, value, version, &one);
+        }
+
+        if (rc != SUCCESS)
+        {
+            LOG(ERROR) << "could not move key=0x" << key.hex() << " out of "
+                       << rh->from << ": " << rc;
+            it->Next();
+            continue;
+        }
+
+        batch_appender app(&updates);
+        one.Iterate(&app);
+        moved += ours ? 1 : 0;
+        dropped += ours ? 0 : 1;
+        touched.push_back(std::make_pair(to, std::string(reinterpret_cast<const char*>(key.data()), key.size())));
+        it->Next();
+    }
+
+    bool more = it->Valid() && it->key().starts_with(prefix);
+    char kbacking[REHOME_BUF_SIZE];
+    char vbacking[REHOME_VAL_SIZE];
+
+    if (!more)
+    {
+        encode_rehome(rh->from, rh->via, kbacking, vbacking);
+        updates.Delete(leveldb::Slice(kbacking, REHOME_BUF_SIZE));
+    }
+
+    leveldb::WriteOptions wopts;
+    wopts.sync = m_durable;
+    leveldb::Status st = m_db->Write(wopts, &updates);
+
+    for (size_t i = 0; i < touched.size(); ++i)
+    {
+        e::slice k(touched[i].second.data(), touched[i].second.size());
+        m_cache.invalidate(rh->from, k);
+        m_cache.invalidate(touched[i].first, k);
+    }
+
+    // retry the same batch rather than strand its objects
+    if (!st.ok())
+    {
+        LOG(ERROR) << "could not move objects out of " << rh->from
+                   << ": " << st.ToString();
+        return true;
+    }
+
+    if (more)
+    {
+        rh->next = it->key().ToString();
+    }
+
+    rh->moved += moved;
+    rh->dropped += dropped;
+    return more;
+}
+
+void
+datalayer :: plan_backfills(const configuration& old_config,
+                            const configuration& new_config,
+                            const server_id& us)
+{
+    std::vector<region_id> regions;
+    new_config.regions_of(us, &regions);
+    std::sort(regions.begin(), regions.end());
+    po6::threads::mutex::hold hold(&m_block_cleaner);
+    std::list<backfill>::iterator it = m_backfills.begin();
+
+    // forget indexes we no longer need to fill
+    while (it != m_backfills.end())
+    {
+        std::vector<uint16_t> indexed;
+        new_config.index_attrs(it->ri, &indexed);
+
+        if (!std::binary_search(regions.begin(), regions.end(), it->ri) ||
+            std::find(indexed.begin(), indexed.end(), it->attr) == indexed.end())
+        {
+            it = m_backfills.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        // a region new to this config only holds objects written through it,
+        // and those already carry every index
+        if (!old_config.get_region(regions[i]))
+        {
+            continue;
+        }
+
+        std::vector<uint16_t> old_indexed;
+        std::vector<uint16_t> new_indexed;
+        old_config.index_attrs(regions[i], &old_indexed);
+        new_config.index_attrs(regions[i], &new_indexed);
+
+        for (size_t j = 0; j < new_indexed.size(); ++j)
+        {
+            if (new_indexed[j] == 0 ||
+                std::find(old_indexed.begin(), old_indexed.end(), new_indexed[j]) != old_indexed.end())
+            {
+                continue;
+            }
+
+            LOG(INFO) << "indexing attribute " << new_indexed[j] << " of " << regions[i]
+                      << " in the background";
+            m_backfills.push_back(backfill(regions[i], new_indexed[j]));
+        }
+    }
+}
+
+bool
+datalayer :: backfill_batch(backfill* bf)
+{
+    const schema* sc = m_daemon->m_config->get_schema(bf->ri);
+
+    if (!sc)
+    {
+        return false;
+    }
+
+    std::vector<uint16_t> attrs(1, bf->attr);
+    char backing[sizeof(uint8_t) + sizeof(uint64_t)];
+    char* ptr = backing;
+    ptr = e::pack8be('o', ptr);
+    ptr = e::pack64be(bf->ri.get(), ptr);
+    leveldb::Slice prefix(backing, sizeof(uint8_t) + sizeof(uint64_t));
+    leveldb::WriteBatch updates;
+    size_t objects = 0;
+
+    // Reading the objects and writing their index entries must not be split
+    // by another write, or an object could be left indexed under a value it
+    // no longer holds.
+    po6::threads::mutex::hold hold(&m_block_backfill);
+    leveldb_snapshot_ptr snap = make_raw_snapshot();
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    opts.verify_checksums = true;
+    opts.snapshot = snap.get();
+    std::auto_ptr<leveldb::Iterator> it;
+    it.reset(m_db->NewIterator(opts));
+    it->Seek(bf->next.empty() ? prefix : leveldb::Slice(bf->next));
+
+    while (it->Valid() && it->key().starts_with(prefix) &&
+           objects < BACKFILL_BATCH_SIZE)
+    {
+        e::slice key;
+        std::vector<e::slice> value;
+        uint64_t version;
+        std::string row(it->value().data(), it->value().size());
+        std::vector<std::string> chunks;
+
+        if (!parse_object_key(it->key(), &key) ||
+            load_object(snap.get(), bf->ri, key, &row, &chunks, &value, &version) != SUCCESS ||
+            value.size() + 1 != sc->attrs_sz ||
+            create_index_changes(sc, attrs, bf->ri, key, NULL, &value, &updates) != SUCCESS)
+        {
+            LOG(ERROR) << "could not index attribute " << bf->attr
+                       << " of a corrupt object in " << bf->ri;
+        }
+
+        ++objects;
+        it->Next();
+    }
+
+    bool more = it->Valid() && it->key().starts_with(prefix);
+
+    if (more)
+    {
+        bf->next = it->key().ToString();
+    }
+
+    bf->indexed += objects;
+    leveldb::WriteOptions wopts;
+    wopts.sync = m_durable;
+    leveldb::Status st = m_db->Write(wopts, &updates);
+
+    if (!st.ok())
+    {
+        LOG(ERROR) << "could not write index entries for attribute " << bf->attr
+                   << " of " << bf->ri << ": " << st.ToString();
+    }
+
+    return more;
+}
+
+bool
+datalayer :: is_backfilling(const region_id& ri, uint16_t attr)
+{
+    po6::threads::mutex::hold hold(&m_block_cleaner);
+
+    for (std::list<backfill>::iterator it = m_backfills.begin();
+            it != m_backfills.end(); ++it)
+    {
+        if (it->ri == ri && it->attr == attr)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+datalayer :: update_cache(const region_id& ri,
+                          const e::slice& key,
+                          const std::vector<e::slice>& new_value,
+                          uint64_t version)
+{
+    std::vector<char> backing;
+    leveldb::Slice lval;
+    encode_value(new_value, version, &backing, &lval);
+    std::tr1::shared_ptr<object_cache::object> obj(new object_cache::object());
+    obj->backing.assign(lval.data(), lval.size());
+    e::slice v(obj->backing.data(), obj->backing.size());
+
+    if (decode_value(v, &obj->value, &obj->version) != SUCCESS)
+    {
+        m_cache.invalidate(ri, key);
+        return;
+    }
+
+    m_cache.update(ri, key, obj);
+}
+
+bool
+datalayer :: restore_acked()
+{
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    opts.verify_checksums = true;
+    opts.snapshot = NULL;
+    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
+    it->Seek(leveldb::Slice("w", 1));
+
+    while (it->Valid() && it->key().starts_with(leveldb::Slice("w", 1)))
+    {
+        acked_window::row r;
+        e::slice k(it->key().data(), it->key().size());
+        e::slice v(it->value().data(), it->value().size());
+
+        if (decode_acked_window(k, v, &r) != SUCCESS)
+        {
+            LOG(ERROR) << "could not decode a word of an acked window";
+            return false;
+        }
+
+        m_acked.restore(r);
+        it->Next();
+    }
+
+    // Older versions kept one record per acked operation.  Fold them into
+    // the windows and write those out before deleting the records, so that
+    // a crash part way through loses no acks.
+    uint64_t legacy = 0;
+    it->Seek(leveldb::Slice("a", 1));
+
+    while (it->Valid() && it->key().starts_with(leveldb::Slice("a", 1)))
+    {
+        region_id ri;
+        region_id reg_id;
+        uint64_t seq_id;
+        e::slice k(it->key().data(), it->key().size());
+
+        if (decode_acked(k, &ri, &reg_id, &seq_id) == SUCCESS)
+        {
+            seq_id = UINT64_MAX - seq_id;
+            m_acked.restore(acked_window::row(ri, reg_id, seq_id / 64,
+                                              static_cast<uint64_t>(1) << (seq_id % 64)));
+        }
+
+        ++legacy;
+        it->Next();
+    }
+
+    if (legacy == 0)
+    {
+        return true;
+    }
+
+    LOG(INFO) << "migrating " << legacy << " acked records to acked windows";
+    std::vector<acked_window::row> rows;
+    m_acked.all_rows(&rows);
+
+    if (!save_acked(rows, false))
+    {
+        return false;
+    }
+
+    leveldb::WriteBatch updates;
+    size_t pending = 0;
+    it->Seek(leveldb::Slice("a", 1));
+
+    while (true)
+    {
+        bool done = !it->Valid() || !it->key().starts_with(leveldb::Slice("a", 1));
+
+        if (!done)
+        {
+            updates.Delete(it->key());
+            ++pending;
+            it->Next();
+        }
+
+        if (pending > 0 && (done || pending >= ACKED_MIGRATE_BATCH_SIZE))
+        {
+            leveldb::Status st = write(&updates);
+            updates.Clear();
+            pending = 0;
+
+            if (st.ok())
+            {
+                // WOOT!
+            }
+            else if (st.IsCorruption())
+            {
+                LOG(ERROR) << "corruption at the disk layer: could not delete "
+                           << "acked records: desc=" << st.ToString();
+                return false;
+            }
+            else if (st.IsIOError())
+            {
+                LOG(ERROR) << "IO error at the disk layer: could not delete "
+                           << "acked records: desc=" << st.ToString();
+                return false;
+            }
+            else
+            {
+                LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
+                return false;
+            }
+        }
+
+        if (done)
+        {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool
+datalayer :: save_acked(const std::vector<acked_window::row>& rows, bool erase)
+{
+    if (rows.empty())
+    {
+        return true;
+    }
+
+    leveldb::WriteBatch updates;
+
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        char kbacking[ACKED_WINDOW_BUF_SIZE];
+        char vbacking[ACKED_WINDOW_VAL_SIZE];
+        encode_acked_window(rows[i], kbacking, vbacking);
+        leveldb::Slice key(kbacking, ACKED_WINDOW_BUF_SIZE);
+
+        if (erase)
+        {
+            updates.Delete(key);
+        }
+        else
+        {
+            updates.Put(key, leveldb::Slice(vbacking, ACKED_WINDOW_VAL_SIZE));
+        }
+    }
+
+    leveldb::Status st = write(&updates);
 
     if (st.ok())
     {
         return true;
     }
-    else if (st.IsNotFound())
-    {
-        return false;
-    }
     else if (st.IsCorruption())
     {
-        LOG(ERROR) << "corruption at the disk layer: region=" << reg_id
-                   << " seq_id=" << seq_id << " desc=" << st.ToString();
+        LOG(ERROR) << "corruption at the disk layer: could not write "
+                   << rows.size() << " acked words: desc=" << st.ToString();
         return false;
     }
     else if (st.IsIOError())
     {
-        LOG(ERROR) << "IO error at the disk layer: region=" << reg_id
-                   << " seq_id=" << seq_id << " desc=" << st.ToString();
+        LOG(ERROR) << "IO error at the disk layer: could not write "
+                   << rows.size() << " acked words: desc=" << st.ToString();
         return false;
     }
     else
@@ -1174,144 +2564,211 @@ datalayer :: check_acked(const region_id& ri,
 }
 
 void
-datalayer :: mark_acked(const region_id& ri,
-                        const region_id& reg_id,
-                        uint64_t seq_id)
+datalayer :: put_object(const schema* sc,
+                        const region_id& ri,
+                        const e::slice& key,
+                        const std::vector<e::slice>* old_value,
+                        const std::vector<e::slice>& new_value,
+                        uint64_t version,
+                        leveldb::WriteBatch* updates)
 {
-    // make it so that increasing seq_ids are ordered in reverse in the KVS
-    seq_id = UINT64_MAX - seq_id;
-    leveldb::WriteOptions opts;
-    opts.sync = false;
-    char abacking[ACKED_BUF_SIZE];
-    encode_acked(ri, reg_id, seq_id, abacking);
-    leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
-    leveldb::Slice val("", 0);
-    leveldb::Status st = m_db->Put(opts, akey, val);
+    std::vector<char> backing1;
+    std::vector<char> backing2;
+    std::vector<std::vector<char> > stubs(new_value.size());
+    std::vector<e::slice> attrs(new_value);
+    std::vector<bool> chunked(new_value.size(), false);
+    std::vector<size_t> old_ends;
+    std::vector<size_t> new_ends;
+    std::vector<uint64_t> old_hashes;
+    std::vector<uint64_t> new_hashes;
+    std::vector<size_t> put;
+    std::vector<uint64_t> del;
+    leveldb::Slice lkey;
+    leveldb::Slice lval;
 
-    if (st.ok())
-    {
-        // Yay!
-    }
-    else if (st.IsNotFound())
-    {
-        LOG(ERROR) << "mark_acked returned NOT_FOUND at the disk layer: region=" << reg_id
-                   << " seq_id=" << seq_id << " desc=" << st.ToString();
-    }
-    else if (st.IsCorruption())
-    {
-        LOG(ERROR) << "corruption at the disk layer: region=" << reg_id
-                   << " seq_id=" << seq_id << " desc=" << st.ToString();
-    }
-    else if (st.IsIOError())
-    {
-        LOG(ERROR) << "IO error at the disk layer: region=" << reg_id
-                   << " seq_id=" << seq_id << " desc=" << st.ToString();
-    }
-    else
+    for (size_t i = 0; i < new_value.size(); ++i)
     {
-        LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
+        hyperdatatype type = i + 1 < sc->attrs_sz ? sc->attrs[i + 1].type : HYPERDATATYPE_GENERIC;
+        old_ends.clear();
+        new_ends.clear();
+        old_hashes.clear();
+        new_hashes.clear();
+
+        if (old_value && i < old_value->size() &&
+            is_chunked_attr(type, (*old_value)[i]))
+        {
+            chunk_boundaries((*old_value)[i], &old_ends);
+            chunk_hashes((*old_value)[i], old_ends, &old_hashes);
+        }
+
+        if (is_chunked_attr(type, new_value[i]))
+        {
+            chunk_boundaries(new_value[i], &new_ends);
+            chunk_hashes(new_value[i], new_ends, &new_hashes);
+            encode_chunk_stub(new_value[i].size(), new_hashes, &stubs[i]);
+            attrs[i] = e::slice(&stubs[i].front(), stubs[i].size());
+            chunked[i] = true;
+        }
+
+        // chunks are keyed by content, so those the change did not touch
+        // stay where they are no matter how far they moved
+        chunk_diff(old_hashes, new_hashes, &put, &del);
+
+        for (size_t j = 0; j < del.size(); ++j)
+        {
+            encode_chunk_key(ri, key, i, del[j], &backing1, &lkey);
+            updates->Delete(lkey);
+        }
+
+        for (size_t j = 0; j < put.size(); ++j)
+        {
+            size_t start = put[j] > 0 ? new_ends[put[j] - 1] : 0;
+            const char* chunk = reinterpret_cast<const char*>(new_value[i].data()) + start;
+            encode_chunk_key(ri, key, i, new_hashes[put[j]], &backing1, &lkey);
+            updates->Put(lkey, leveldb::Slice(chunk, new_ends[put[j]] - start));
+        }
     }
+
+    encode_key(ri, key, &backing1, &lkey);
+    encode_value(attrs, chunked, version, &backing2, &lval);
+    updates->Put(lkey, lval);
 }
 
 void
-datalayer :: max_seq_id(const region_id& reg_id,
-                        uint64_t* seq_id)
+datalayer :: del_object(const schema* sc,
+                        const region_id& ri,
+                        const e::slice& key,
+                        const std::vector<e::slice>& old_value,
+                        leveldb::WriteBatch* updates)
 {
-    leveldb::ReadOptions opts;
-    opts.fill_cache = false;
-    opts.verify_checksums = true;
-    opts.snapshot = NULL;
-    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
-    char abacking[ACKED_BUF_SIZE];
-    encode_acked(reg_id, reg_id, 0, abacking);
-    leveldb::Slice key(abacking, ACKED_BUF_SIZE);
-    it->Seek(key);
+    std::vector<char> backing;
+    std::vector<size_t> ends;
+    std::vector<uint64_t> hashes;
+    leveldb::Slice lkey;
+    encode_key(ri, key, &backing, &lkey);
+    updates->Delete(lkey);
 
-    if (!it->Valid())
+    for (size_t i = 0; i < old_value.size(); ++i)
     {
-        *seq_id = 0;
-        return;
-    }
+        hyperdatatype type = i + 1 < sc->attrs_sz ? sc->attrs[i + 1].type : HYPERDATATYPE_GENERIC;
+
+        if (!is_chunked_attr(type, old_value[i]))
+        {
+            continue;
+        }
 
-    key = it->key();
-    region_id tmp_ri;
-    region_id tmp_reg_id;
-    uint64_t tmp_seq_id;
-    datalayer::returncode rc = decode_acked(e::slice(key.data(), key.size()),
-                                            &tmp_ri, &tmp_reg_id, &tmp_seq_id);
+        chunk_boundaries(old_value[i], &ends);
+        chunk_hashes(old_value[i], ends, &hashes);
 
-    if (rc != SUCCESS || tmp_ri != reg_id || tmp_reg_id != reg_id)
-    {
-        *seq_id = 0;
-        return;
+        for (size_t j = 0; j < hashes.size(); ++j)
+        {
+            encode_chunk_key(ri, key, i, hashes[j], &backing, &lkey);
+            updates->Delete(lkey);
+        }
     }
-
-    *seq_id = UINT64_MAX - tmp_seq_id;
 }
 
-void
-datalayer :: clear_acked(const region_id& reg_id,
-                         uint64_t seq_id)
+datalayer::returncode
+datalayer :: load_object(const leveldb::Snapshot* snap,
+                         const region_id& ri,
+                         const e::slice& key,
+                         std::string* row,
+                         std::vector<std::string>* chunks,
+                         std::vector<e::slice>* value,
+                         uint64_t* version)
 {
+    std::vector<bool> chunked;
+    returncode rc = decode_value(e::slice(row->data(), row->size()), value, &chunked, version);
+
+    if (rc != SUCCESS ||
+        std::find(chunked.begin(), chunked.end(), true) == chunked.end())
+    {
+        return rc;
+    }
+
+    leveldb_snapshot_ptr fresh;
     leveldb::ReadOptions opts;
-    opts.fill_cache = false;
+    opts.fill_cache = true;
     opts.verify_checksums = true;
-    opts.snapshot = NULL;
+    opts.snapshot = snap;
+    std::vector<char> kbacking;
+    leveldb::Slice lkey;
+
+    // The row was read outside of any snapshot, so read it again within one
+    // to be sure it agrees with the chunks read below.
+    if (!snap)
+    {
+        fresh = make_raw_snapshot();
+        opts.snapshot = fresh.get();
+        encode_key(ri, key, &kbacking, &lkey);
+        leveldb::Status st = m_db->Get(opts, lkey, row);
+
+        if (st.IsNotFound())
+        {
+            return NOT_FOUND;
+        }
+        else if (!st.ok())
+        {
+            LOG(ERROR) << "could not reread chunked object: region=" << ri
+                       << " key=0x" << key.hex() << " desc=" << st.ToString();
+            return st.IsIOError() ? IO_ERROR : CORRUPTION;
+        }
+
+        rc = decode_value(e::slice(row->data(), row->size()), value, &chunked, version);
+
+        if (rc != SUCCESS)
+        {
+            return rc;
+        }
+    }
+
+    std::vector<std::string> whole(value->size());
     std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
-    char abacking[ACKED_BUF_SIZE];
-    encode_acked(region_id(0), reg_id, 0, abacking);
-    it->Seek(leveldb::Slice(abacking, ACKED_BUF_SIZE));
-    encode_acked(region_id(0), region_id(reg_id.get() + 1), 0, abacking);
-    leveldb::Slice upper_bound(abacking, ACKED_BUF_SIZE);
-
-    while (it->Valid() &&
-           it->key().compare(upper_bound) < 0)
-    {
-        region_id tmp_ri;
-        region_id tmp_reg_id;
-        uint64_t tmp_seq_id;
-        datalayer::returncode rc = decode_acked(e::slice(it->key().data(), it->key().size()),
-                                                &tmp_ri, &tmp_reg_id, &tmp_seq_id);
-        tmp_seq_id = UINT64_MAX - tmp_seq_id;
-
-        if (rc == SUCCESS &&
-            tmp_reg_id == reg_id &&
-            tmp_seq_id < seq_id)
-        {
-            leveldb::WriteOptions wopts;
-            wopts.sync = false;
-            leveldb::Status st = m_db->Delete(wopts, it->key());
-
-            if (st.ok() || st.IsNotFound())
-            {
-                // WOOT!
-            }
-            else if (st.IsCorruption())
-            {
-                LOG(ERROR) << "corruption at the disk layer: could not delete "
-                           << reg_id << " " << seq_id << ": desc=" << st.ToString();
-            }
-            else if (st.IsIOError())
-            {
-                LOG(ERROR) << "IO error at the disk layer: could not delete "
-                           << reg_id << " " << seq_id << ": desc=" << st.ToString();
-            }
-            else
+
+    for (size_t i = 0; i < value->size(); ++i)
+    {
+        if (!chunked[i])
+        {
+            continue;
+        }
+
+        uint32_t size;
+        std::vector<uint64_t> hashes;
+        rc = decode_chunk_stub((*value)[i], &size, &hashes);
+
+        if (rc != SUCCESS)
+        {
+            return rc;
+        }
+
+        whole[i].reserve(size);
+
+        for (size_t j = 0; j < hashes.size(); ++j)
+        {
+            encode_chunk_key(ri, key, i, hashes[j], &kbacking, &lkey);
+            it->Seek(lkey);
+
+            if (!it->Valid() || it->key().compare(lkey) != 0)
             {
-                LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
+                LOG(ERROR) << "chunk " << j << " of attribute " << i + 1
+                           << " is missing: region=" << ri << " key=0x" << key.hex();
+                return CORRUPTION;
             }
+
+            whole[i].append(it->value().data(), it->value().size());
         }
 
-        it->Next();
+        if (whole[i].size() != size)
+        {
+            return CORRUPTION;
+        }
+
+        (*value)[i] = e::slice(whole[i].data(), whole[i].size());
     }
-}
 
-void
-datalayer :: request_wipe(const capture_id& cid)
-{
-    po6::threads::mutex::hold hold(&m_block_cleaner);
-    m_state_transfer_captures.insert(cid);
-    m_wakeup_cleaner.broadcast();
+    // swapping leaves each string's buffer, and so the value, in place
+    chunks->swap(whole);
+    return SUCCESS;
 }
 
 void
@@ -1341,6 +2798,8 @@ datalayer :: cleaner()
 
             while ((!m_need_cleaning &&
                     m_state_transfer_captures.empty() &&
+                    m_backfills.empty() &&
+                    m_rehomes.empty() &&
                     !m_shutdown) || m_need_pause)
             {
                 m_paused = true;
@@ -1415,7 +2874,7 @@ datalayer :: cleaner()
 
             m_daemon->m_stm.report_wiped(cached_cid);
 
-            if (!m_daemon->m_config.is_captured_region(capture_id(cid)))
+            if (!m_daemon->m_config->is_captured_region(capture_id(cid)))
             {
                 cached_cid = capture_id(cid);
                 continue;
@@ -1439,6 +2898,79 @@ datalayer :: cleaner()
             m_daemon->m_stm.report_wiped(*state_transfer_captures.begin());
             state_transfer_captures.erase(state_transfer_captures.begin());
         }
+
+        // Move one batch of objects out of a split or merged region.  Objects
+        // must reach their regions before those regions are indexed anew.
+        rehome rh;
+        bool rehoming = false;
+
+        {
+            po6::threads::mutex::hold hold(&m_block_cleaner);
+
+            if (!m_rehomes.empty())
+            {
+                rh = m_rehomes.front();
+                rehoming = true;
+            }
+        }
+
+        if (rehoming)
+        {
+            bool more = rehome_batch(&rh);
+
+            {
+                po6::threads::mutex::hold hold(&m_block_cleaner);
+
+                if (more)
+                {
+                    m_rehomes.front() = rh;
+                }
+                else
+                {
+                    LOG(INFO) << "finished moving the objects of " << rh.from << ": "
+                              << rh.moved << " moved, " << rh.dropped
+                              << " dropped because their regions are held elsewhere";
+                    m_rehomes.pop_front();
+                }
+            }
+
+            // moved objects may need to go out with a state transfer
+            m_daemon->m_stm.report_rehomed();
+            continue;
+        }
+
+        // Fill in one batch of a pending index, then go around again so that
+        // wipes and pauses are never stuck behind a large region.  The list
+        // only changes in "reconfigure", which waits for us to pause.
+        backfill bf;
+
+        {
+            po6::threads::mutex::hold hold(&m_block_cleaner);
+
+            if (m_backfills.empty())
+            {
+                continue;
+            }
+
+            bf = m_backfills.front();
+        }
+
+        bool more = backfill_batch(&bf);
+
+        {
+            po6::threads::mutex::hold hold(&m_block_cleaner);
+
+            if (more)
+            {
+                m_backfills.front() = bf;
+            }
+            else
+            {
+                LOG(INFO) << "finished indexing attribute " << bf.attr << " of " << bf.ri
+                          << " (" << bf.indexed << " objects)";
+                m_backfills.pop_front();
+            }
+        }
     }
 
     LOG(INFO) << "cleanup thread shutting down";
@@ -1462,8 +2994,65 @@ datalayer :: shutdown()
     }
 }
 
+datalayer :: writer :: writer(leveldb::WriteBatch* u)
+    : updates(u)
+    , status()
+    , done(false)
+{
+}
+
+datalayer :: writer :: ~writer() throw ()
+{
+}
+
+datalayer :: backfill :: backfill()
+    : ri()
+    , attr()
+    , next()
+    , indexed(0)
+{
+}
+
+datalayer :: backfill :: backfill(const region_id& r, uint16_t a)
+    : ri(r)
+    , attr(a)
+    , next()
+    , indexed(0)
+{
+}
+
+datalayer :: backfill :: ~backfill() throw ()
+{
+}
+
+datalayer :: rehome :: rehome()
+    : from()
+    , via()
+    , ssid()
+    , next()
+    , moved(0)
+    , dropped(0)
+{
+}
+
+datalayer :: rehome :: rehome(const region_id& f, const region_id& v)
+    : from(f)
+    , via(v)
+    , ssid()
+    , next()
+    , moved(0)
+    , dropped(0)
+{
+}
+
+datalayer :: rehome :: ~rehome() throw ()
+{
+}
+
 datalayer :: reference :: reference()
     : m_backing()
+    , m_chunks()
+    , m_object()
 {
 }
 
@@ -1475,6 +3064,8 @@ void
 datalayer :: reference :: swap(reference* ref)
 {
     m_backing.swap(ref->m_backing);
+    m_chunks.swap(ref->m_chunks);
+    m_object.swap(ref->m_object);
 }
 
 std::ostream&
@@ -1539,7 +3130,9 @@ datalayer :: region_iterator :: unpack(e::slice* k,
     region_id ri;
     // XXX returncode
     decode_key(e::slice(m_iter->key().data(), m_iter->key().size()), &ri, k);
-    decode_value(e::slice(m_iter->value().data(), m_iter->value().size()), val, ver);
+    std::string row(m_iter->value().data(), m_iter->value().size());
+    std::vector<std::string> chunks;
+    m_dl->load_object(m_snap.get(), ri, *k, &row, &chunks, val, ver);
     size_t sz = k->size();
 
     for (size_t i = 0; i < val->size(); ++i)
@@ -1573,7 +3166,11 @@ datalayer :: region_iterator :: unpack(e::slice* k,
 e::slice
 datalayer :: region_iterator :: key()
 {
-    return e::slice(m_iter->key().data(), m_iter->key().size());
+    region_id ri;
+    e::slice k;
+    // XXX returncode
+    decode_key(e::slice(m_iter->key().data(), m_iter->key().size()), &ri, &k);
+    return k;
 }
 
 datalayer :: snapshot :: snapshot()
@@ -1581,8 +3178,14 @@ datalayer :: snapshot :: snapshot()
     , m_snap()
     , m_checks()
     , m_ri()
+    , m_from()
+    , m_rehoming(false)
+    , m_strays()
     , m_backing()
     , m_range()
+    , m_reverse(false)
+    , m_covered(false)
+    , m_keys_only(false)
     , m_parse()
     , m_iter()
     , m_error(SUCCESS)
@@ -1591,6 +3194,9 @@ datalayer :: snapshot :: snapshot()
     , m_value()
     , m_ostr()
     , m_num_gets(0)
+    , m_num_filtered(0)
+    , m_budget(0)
+    , m_filters()
     , m_ref()
 {
 }
@@ -1609,32 +3215,72 @@ datalayer :: snapshot :: valid()
 
     // Don't try to optimize by replacing m_ri with a const schema* because it
     // won't persist across reconfigurations
-    const schema* sc = m_dl->m_daemon->m_config.get_schema(m_ri);
+    const schema* sc = m_dl->m_daemon->m_config->get_schema(m_ri);
     assert(sc);
 
     // while the most selective iterator is valid and not past the end
-    while (m_iter->Valid())
+    while (m_iter->Valid() || !m_strays.empty())
     {
-        if (m_iter->key().compare(m_range.limit) >= 0)
+        if (m_budget > 0 && m_num_gets + m_num_filtered >= m_budget)
+        {
+            return false;
+        }
+
+        if (!m_iter->Valid() ||
+            (m_reverse ? m_iter->key().compare(m_range.start) < 0
+                       : m_iter->key().compare(m_range.limit) >= 0))
         {
-            if (m_ostr) *m_ostr << " iterator retrieved " << m_num_gets << " objects from disk\n";
+            if (!m_strays.empty())
+            {
+                stray();
+                continue;
+            }
+
+            if (m_ostr) *m_ostr << " iterator retrieved " << m_num_gets << " objects from disk"
+                                << " after filtering out " << m_num_filtered << "\n";
             return false;
         }
 
         (*m_parse)(m_iter->key(), &m_key);
+
+        if (!m_filters.empty())
+        {
+            bool filtered = false;
+
+            for (size_t i = 0; !filtered && i < m_filters.size(); ++i)
+            {
+                filtered = !m_filters[i].may_contain(m_key);
+            }
+
+            if (filtered)
+            {
+                ++m_num_filtered;
+                step();
+                continue;
+            }
+        }
+
+        // nothing needs the object, so don't read it
+        if (m_keys_only && m_covered)
+        {
+            m_value.clear();
+            m_version = 0;
+            return true;
+        }
+
         leveldb::ReadOptions opts;
         opts.fill_cache = true;
         opts.verify_checksums = true;
         std::vector<char> kbacking;
         leveldb::Slice lkey;
-        encode_key(m_ri, m_key, &kbacking, &lkey);
+        encode_key(m_from, m_key, &kbacking, &lkey);
 
         leveldb::Status st = m_dl->m_db->Get(opts, lkey, &m_ref.m_backing);
 
         if (st.ok())
         {
-            e::slice v(m_ref.m_backing.data(), m_ref.m_backing.size());
-            datalayer::returncode rc = decode_value(v, &m_value, &m_version);
+            datalayer::returncode rc = m_dl->load_object(NULL, m_from, m_key, &m_ref.m_backing,
+                                                         &m_ref.m_chunks, &m_value, &m_version);
 
             if (rc != SUCCESS)
             {
@@ -1652,14 +3298,14 @@ datalayer :: snapshot :: valid()
         }
         else if (st.IsCorruption())
         {
-            LOG(ERROR) << "corruption at the disk layer: region=" << m_ri
+            LOG(ERROR) << "corruption at the disk layer: region=" << m_from
                        << " key=0x" << m_key.hex() << " desc=" << st.ToString();
             m_error = CORRUPTION;
             return false;
         }
         else if (st.IsIOError())
         {
-            LOG(ERROR) << "IO error at the disk layer: region=" << m_ri
+            LOG(ERROR) << "IO error at the disk layer: region=" << m_from
                        << " key=0x" << m_key.hex() << " desc=" << st.ToString();
             m_error = IO_ERROR;
             return false;
@@ -1671,6 +3317,14 @@ datalayer :: snapshot :: valid()
             return false;
         }
 
+        if (m_rehoming &&
+            m_dl->home_of(*m_dl->m_daemon->m_config, m_ri, m_key, m_value) != m_ri)
+        {
+            ++m_num_filtered;
+            step();
+            continue;
+        }
+
         bool passes_checks = true;
 
         for (size_t i = 0; passes_checks && i < m_checks->size(); ++i)
@@ -1698,18 +3352,54 @@ datalayer :: snapshot :: valid()
         }
         else
         {
-            m_iter->Next();
+            step();
         }
     }
 
     return false;
 }
 
+void
+datalayer :: snapshot :: keys_only()
+{
+    m_keys_only = true;
+}
+
 void
 datalayer :: snapshot :: next()
 {
     assert(m_error == SUCCESS);
-    m_iter->Next();
+    step();
+}
+
+void
+datalayer :: snapshot :: step()
+{
+    if (m_reverse)
+    {
+        m_iter->Prev();
+    }
+    else
+    {
+        m_iter->Next();
+    }
+}
+
+void
+datalayer :: snapshot :: stray()
+{
+    m_from = m_strays.back();
+    m_strays.pop_back();
+    m_backing.push_back(std::vector<char>(sizeof(uint8_t) + sizeof(uint64_t)));
+    char* ptr = &m_backing.back()[0];
+    ptr = e::pack8be('o', ptr);
+    ptr = e::pack64be(m_from.get(), ptr);
+    m_range.start = leveldb::Slice(&m_backing.back()[0], m_backing.back().size());
+    m_backing.push_back(m_backing.back());
+    bump_index(&m_backing.back());
+    m_range.limit = leveldb::Slice(&m_backing.back()[0], m_backing.back().size());
+    m_parse = &parse_object_key;
+    m_iter->Seek(m_range.start);
 }
 
 void
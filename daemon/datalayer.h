@@ -53,7 +53,10 @@
 #include "common/counter_map.h"
 #include "common/ids.h"
 #include "common/schema.h"
+#include "daemon/acked_window.h"
+#include "daemon/index_filter.h"
 #include "daemon/leveldb.h"
+#include "daemon/object_cache.h"
 #include "daemon/reconfigure_returncode.h"
 
 namespace hyperdex
@@ -83,7 +86,11 @@ class datalayer
         ~datalayer() throw ();
 
     public:
+        // if durable, every write is synced to disk before it returns;
+        // cache_size bounds the bytes of hot objects kept in memory
         bool setup(const po6::pathname& path,
+                   bool durable,
+                   uint64_t cache_size,
                    bool* saved,
                    server_id* saved_us,
                    po6::net::location* saved_bind_to,
@@ -137,12 +144,36 @@ class datalayer
                                  const e::slice& key,
                                  const std::vector<e::slice>& new_value,
                                  uint64_t version);
+        // Load objects that the caller knows are not stored in ri: stage each
+        // into updates with bulk_put, which reads nothing from disk, then
+        // apply them all at once with bulk_write.
+        returncode bulk_put(const region_id& ri,
+                            const e::slice& key,
+                            const std::vector<e::slice>& new_value,
+                            uint64_t version,
+                            leveldb::WriteBatch* updates);
+        returncode bulk_write(leveldb::WriteBatch* updates);
         // create a snapshot for search
         returncode make_snapshot(const region_id& ri,
                                  const schema& sc,
                                  const std::vector<attribute_check>* checks,
                                  snapshot* snap,
                                  std::ostringstream* ostr);
+        // estimate how many objects pass the checks from the on-disk size
+        // of the range a search would scan and a sample of its entries
+        returncode approximate_count(const region_id& ri,
+                                     const schema& sc,
+                                     const std::vector<attribute_check>* checks,
+                                     uint64_t* count);
+        // create a snapshot that yields objects in ascending (or, if
+        // maximize, descending) order of sort_by by walking its index;
+        // NOT_FOUND if this region has no complete int64/float index on it
+        returncode make_sorted_snapshot(const region_id& ri,
+                                        const schema& sc,
+                                        const std::vector<attribute_check>* checks,
+                                        uint16_t sort_by,
+                                        bool maximize,
+                                        snapshot* snap);
         // leveldb provides no failure mechanism for this, neither do we
         leveldb_snapshot_ptr make_raw_snapshot();
         void make_region_iterator(region_iterator* riter,
@@ -171,12 +202,106 @@ class datalayer
         // the state_transfer_manager.  The state_transfer_manger will get a
         // call back on report_wiped after it is done.
         void request_wipe(const capture_id& cid);
+        // approximate bytes on disk for the objects in a region
+        uint64_t approximate_size(const region_id& ri);
+        // hit/miss counters for the object cache, and its current size
+        void cache_stats(uint64_t* hits, uint64_t* misses, uint64_t* bytes);
+        // true while objects are moved between regions of "ri"'s subspace;
+        // until then the subspace's state transfers must not go live
+        bool is_rehoming(const region_id& ri);
+
+    private:
+        class writer;
+        class backfill;
+        class rehome;
 
     private:
         datalayer(const datalayer&);
         datalayer& operator = (const datalayer&);
 
     private:
+        // write the batch as part of a group commit
+        leveldb::Status write(leveldb::WriteBatch* updates);
+        // as above, recording in the same write that we acked seq_id
+        leveldb::Status write(leveldb::WriteBatch* updates,
+                              const region_id& ri,
+                              const region_id& reg_id,
+                              uint64_t seq_id);
+        // stage "new_value" in "updates", writing out only those chunks of
+        // chunked attributes whose content "old_value" (if known) lacks
+        void put_object(const schema* sc,
+                        const region_id& ri,
+                        const e::slice& key,
+                        const std::vector<e::slice>* old_value,
+                        const std::vector<e::slice>& new_value,
+                        uint64_t version,
+                        leveldb::WriteBatch* updates);
+        // stage the removal of the object and every chunk of "old_value"
+        void del_object(const schema* sc,
+                        const region_id& ri,
+                        const e::slice& key,
+                        const std::vector<e::slice>& old_value,
+                        leveldb::WriteBatch* updates);
+        // decode the object stored in "row", reading back chunked attributes
+        // as of "snap" (or a fresh snapshot if NULL) into "chunks"; "value"
+        // points into both, and "row" may be reread
+        returncode load_object(const leveldb::Snapshot* snap,
+                               const region_id& ri,
+                               const e::slice& key,
+                               std::string* row,
+                               std::vector<std::string>* chunks,
+                               std::vector<e::slice>* value,
+                               uint64_t* version);
+        // The region of "ri"'s subspace that "value" now hashes to, if we hold
+        // it, else "ri".  Objects written through a region that has since
+        // been split or merged belong in their new region.
+        region_id home_of(const configuration& config,
+                          const region_id& ri,
+                          const e::slice& key,
+                          const std::vector<e::slice>& value);
+        // every region in which an object of "ri" stored as "value" may
+        // still be found: "ri", its home, and any region being rehomed
+        void locations(const configuration& config,
+                       const region_id& ri,
+                       const e::slice& key,
+                       const std::vector<e::slice>& value,
+                       std::vector<region_id>* locs);
+        // the regions in "ri"'s subspace whose objects are still being moved
+        void rehome_sources(const region_id& ri,
+                            std::vector<region_id>* sources);
+        // stage the removal of the object from "ri", along with every index
+        // entry it may have there, logging it if "ri" is captured
+        returncode stage_del(const configuration& config,
+                             const schema* sc,
+                             const region_id& ri,
+                             const e::slice& key,
+                             const std::vector<e::slice>& old_value,
+                             leveldb::WriteBatch* updates);
+        // queue a rehome of every region the new config splits or merges
+        void plan_rehomes(const configuration& old_config,
+                          const configuration& new_config,
+                          const server_id& us);
+        // persist (or erase) the record of a pending rehome
+        bool save_rehome(const rehome& rh, bool erase);
+        // move the next batch of objects for "rh"; false once it is done
+        bool rehome_batch(rehome* rh);
+        // queue a backfill for every index the new config adds to our regions
+        void plan_backfills(const configuration& old_config,
+                            const configuration& new_config,
+                            const server_id& us);
+        // index the next batch of objects for "bf"; false once it is done
+        bool backfill_batch(backfill* bf);
+        // searches must not use an index that is not yet filled in
+        bool is_backfilling(const region_id& ri, uint16_t attr);
+        // refresh the cached copy of a key that was just written
+        void update_cache(const region_id& ri,
+                          const e::slice& key,
+                          const std::vector<e::slice>& new_value,
+                          uint64_t version);
+        // load the acked windows, folding in any per-op acked records
+        bool restore_acked();
+        // write out (or erase) words of the acked windows
+        bool save_acked(const std::vector<acked_window::row>& rows, bool erase);
         void cleaner();
         void shutdown();
 
@@ -193,6 +318,66 @@ class datalayer
         bool m_need_pause;
         bool m_paused;
         std::set<capture_id> m_state_transfer_captures;
+        std::list<backfill> m_backfills;
+        std::list<rehome> m_rehomes;
+        // held across every write, and by a backfill from its reads through
+        // its write, so no write can slip between the two
+        po6::threads::mutex m_block_backfill;
+        po6::threads::mutex m_block_writers;
+        po6::threads::cond m_wakeup_writers;
+        std::list<writer*> m_writers;
+        bool m_durable;
+        object_cache m_cache;
+        acked_window m_acked;
+};
+
+class datalayer::writer
+{
+    public:
+        writer(leveldb::WriteBatch* updates);
+        ~writer() throw ();
+
+    public:
+        leveldb::WriteBatch* updates;
+        leveldb::Status status;
+        bool done;
+
+    private:
+        writer(const writer&);
+        writer& operator = (const writer&);
+};
+
+class datalayer::backfill
+{
+    public:
+        backfill();
+        backfill(const region_id& ri, uint16_t attr);
+        ~backfill() throw ();
+
+    public:
+        region_id ri;
+        uint16_t attr;
+        // the object row to resume from; empty before the first batch
+        std::string next;
+        uint64_t indexed;
+};
+
+class datalayer::rehome
+{
+    public:
+        rehome();
+        rehome(const region_id& from, const region_id& via);
+        ~rehome() throw ();
+
+    public:
+        region_id from;
+        // a region of ours in the same subspace, for when "from" is gone
+        region_id via;
+        subspace_id ssid;
+        // the object row to resume from; empty before the first batch
+        std::string next;
+        uint64_t moved;
+        uint64_t dropped;
 };
 
 class datalayer::reference
@@ -209,6 +394,8 @@ class datalayer::reference
 
     private:
         std::string m_backing;
+        std::vector<std::string> m_chunks;
+        object_cache::object_ptr m_object;
 };
 
 class datalayer::region_iterator
@@ -244,6 +431,9 @@ class datalayer::snapshot
     public:
         bool valid();
         void next();
+        // the caller will only look at keys; objects are then not read
+        // when the scanned range alone answers the checks
+        void keys_only();
         void unpack(e::slice* key, std::vector<e::slice>* val, uint64_t* ver);
         void unpack(e::slice* key, std::vector<e::slice>* val, uint64_t* ver, reference* ref);
 
@@ -251,14 +441,30 @@ class datalayer::snapshot
         friend class datalayer;
         snapshot(const snapshot&);
         snapshot& operator = (const snapshot&);
+        void step();
+        // move on to the objects of the next region in m_strays
+        void stray();
 
     private:
         datalayer* m_dl;
         leveldb_snapshot_ptr m_snap;
         const std::vector<attribute_check>* m_checks;
         region_id m_ri;
+        // the region whose rows m_range covers; not m_ri once m_strays
+        // are being scanned
+        region_id m_from;
+        // While the subspace is being rehomed, only objects that now belong
+        // in m_ri are returned, and the regions they are moved out of are
+        // scanned after m_ri.
+        bool m_rehoming;
+        std::vector<region_id> m_strays;
         std::list<std::vector<char> > m_backing;
         leveldb::Range m_range;
+        // walk m_range from its limit down to its start
+        bool m_reverse;
+        // every entry of m_range passes m_checks
+        bool m_covered;
+        bool m_keys_only;
         bool (*m_parse)(const leveldb::Slice& in, e::slice* out);
         leveldb_iterator_ptr m_iter;
         returncode m_error;
@@ -267,6 +473,11 @@ class datalayer::snapshot
         std::vector<e::slice> m_value;
         std::ostringstream* m_ostr;
         uint64_t m_num_gets;
+        uint64_t m_num_filtered;
+        // if non-zero, stop once this many candidates were examined
+        uint64_t m_budget;
+        // the keys found in the other low-cost secondary indices
+        std::vector<index_filter> m_filters;
         reference m_ref;
 };
 
@@ -25,6 +25,10 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+// STL
+#include <algorithm>
+#include <tr1/functional>
+
 // LevelDB
 #include <leveldb/write_batch.h>
 
@@ -34,6 +38,8 @@
 // HyperDex
 #include "daemon/datalayer_encodings.h"
 #include "daemon/index_encode.h"
+#include "datatypes/compare.h"
+#include "datatypes/elements.h"
 
 using hyperdex::datalayer;
 
@@ -93,8 +99,40 @@ hyperdex :: encode_value(const std::vector<e::slice>& attrs,
                          uint64_t version,
                          std::vector<char>* backing,
                          leveldb::Slice* out)
+{
+    encode_value(attrs, std::vector<bool>(attrs.size(), false), version, backing, out);
+}
+
+datalayer::returncode
+hyperdex :: decode_value(const e::slice& in,
+                         std::vector<e::slice>* attrs,
+                         uint64_t* version)
+{
+    std::vector<bool> chunked;
+    datalayer::returncode rc = decode_value(in, attrs, &chunked, version);
+
+    if (rc != datalayer::SUCCESS)
+    {
+        return rc;
+    }
+
+    if (std::find(chunked.begin(), chunked.end(), true) != chunked.end())
+    {
+        return datalayer::BAD_ENCODING;
+    }
+
+    return datalayer::SUCCESS;
+}
+
+void
+hyperdex :: encode_value(const std::vector<e::slice>& attrs,
+                         const std::vector<bool>& chunked,
+                         uint64_t version,
+                         std::vector<char>* backing,
+                         leveldb::Slice* out)
 {
     assert(attrs.size() < 65536);
+    assert(attrs.size() == chunked.size());
     size_t sz = sizeof(uint64_t) + sizeof(uint16_t);
 
     for (size_t i = 0; i < attrs.size(); ++i)
@@ -109,7 +147,9 @@ hyperdex :: encode_value(const std::vector<e::slice>& attrs,
 
     for (size_t i = 0; i < attrs.size(); ++i)
     {
-        ptr = e::pack32be(attrs[i].size(), ptr);
+        uint32_t attr_sz = attrs[i].size();
+        assert((attr_sz & CHUNKED_ATTR_FLAG) == 0);
+        ptr = e::pack32be(chunked[i] ? attr_sz | CHUNKED_ATTR_FLAG : attr_sz, ptr);
         memmove(ptr, attrs[i].data(), attrs[i].size());
         ptr += attrs[i].size();
     }
@@ -120,6 +160,7 @@ hyperdex :: encode_value(const std::vector<e::slice>& attrs,
 datalayer::returncode
 hyperdex :: decode_value(const e::slice& in,
                          std::vector<e::slice>* attrs,
+                         std::vector<bool>* chunked,
                          uint64_t* version)
 {
     const uint8_t* ptr = in.data();
@@ -146,6 +187,7 @@ hyperdex :: decode_value(const e::slice& in,
     }
 
     attrs->clear();
+    chunked->clear();
 
     for (size_t i = 0; i < num_attrs; ++i)
     {
@@ -160,6 +202,14 @@ hyperdex :: decode_value(const e::slice& in,
             return datalayer::BAD_ENCODING;
         }
 
+        chunked->push_back((sz & CHUNKED_ATTR_FLAG) != 0);
+        sz &= ~CHUNKED_ATTR_FLAG;
+
+        if (ptr + sz > end)
+        {
+            return datalayer::BAD_ENCODING;
+        }
+
         e::slice s(reinterpret_cast<const uint8_t*>(ptr), sz);
         ptr += sz;
         attrs->push_back(s);
@@ -168,6 +218,90 @@ hyperdex :: decode_value(const e::slice& in,
     return datalayer::SUCCESS;
 }
 
+bool
+hyperdex :: is_chunked_attr(hyperdatatype type, const e::slice& value)
+{
+    return !IS_PRIMITIVE(type) && value.size() > CHUNKED_ATTR_THRESHOLD;
+}
+
+void
+hyperdex :: encode_chunk_stub(uint32_t size,
+                              const std::vector<uint64_t>& hashes,
+                              std::vector<char>* out)
+{
+    out->resize(CHUNK_STUB_SIZE(hashes.size()));
+    char* ptr = &out->front();
+    ptr = e::pack32be(hashes.size(), ptr);
+    ptr = e::pack32be(size, ptr);
+
+    for (size_t i = 0; i < hashes.size(); ++i)
+    {
+        ptr = e::pack64be(hashes[i], ptr);
+    }
+}
+
+datalayer::returncode
+hyperdex :: decode_chunk_stub(const e::slice& in,
+                              uint32_t* size,
+                              std::vector<uint64_t>* hashes)
+{
+    if (in.size() < CHUNK_STUB_SIZE(0))
+    {
+        return datalayer::BAD_ENCODING;
+    }
+
+    uint32_t num_chunks;
+    const uint8_t* ptr = in.data();
+    ptr = e::unpack32be(ptr, &num_chunks);
+    ptr = e::unpack32be(ptr, size);
+
+    if (in.size() != CHUNK_STUB_SIZE(num_chunks))
+    {
+        return datalayer::BAD_ENCODING;
+    }
+
+    hashes->resize(num_chunks);
+
+    for (size_t i = 0; i < num_chunks; ++i)
+    {
+        ptr = e::unpack64be(ptr, &(*hashes)[i]);
+    }
+
+    return datalayer::SUCCESS;
+}
+
+void
+hyperdex :: encode_chunk_key(const region_id& ri,
+                             const e::slice& key,
+                             uint16_t attr,
+                             uint64_t hash,
+                             std::vector<char>* backing,
+                             leveldb::Slice* out)
+{
+    size_t sz = sizeof(uint8_t)
+              + sizeof(uint64_t)
+              + sizeof(uint32_t)
+              + key.size()
+              + sizeof(uint16_t)
+              + sizeof(uint64_t);
+
+    if (backing->size() < sz)
+    {
+        backing->clear();
+        backing->resize(sz);
+    }
+
+    char* ptr = &backing->front();
+    ptr = e::pack8be('c', ptr);
+    ptr = e::pack64be(ri.get(), ptr);
+    ptr = e::pack32be(key.size(), ptr);
+    memmove(ptr, key.data(), key.size());
+    ptr += key.size();
+    ptr = e::pack16be(attr, ptr);
+    ptr = e::pack64be(hash, ptr);
+    *out = leveldb::Slice(&backing->front(), sz);
+}
+
 void
 hyperdex :: encode_acked(const region_id& ri, /*region we saw an ack for*/
                          const region_id& reg_id, /*region of the point leader*/
@@ -205,6 +339,78 @@ hyperdex :: decode_acked(const e::slice& in,
     return _p == 'a' ? datalayer::SUCCESS : datalayer::BAD_ENCODING;
 }
 
+void
+hyperdex :: encode_acked_window(const acked_window::row& r,
+                                char* key, char* val)
+{
+    char* ptr = key;
+    ptr = e::pack8be('w', ptr);
+    ptr = e::pack64be(r.reg_id.get(), ptr);
+    ptr = e::pack64be(r.ri.get(), ptr);
+    ptr = e::pack64be(r.index, ptr);
+    e::pack64be(r.bits, val);
+}
+
+datalayer::returncode
+hyperdex :: decode_acked_window(const e::slice& key,
+                                const e::slice& val,
+                                acked_window::row* r)
+{
+    if (key.size() != ACKED_WINDOW_BUF_SIZE ||
+        val.size() != ACKED_WINDOW_VAL_SIZE)
+    {
+        return datalayer::BAD_ENCODING;
+    }
+
+    uint8_t _p;
+    uint64_t _ri;
+    uint64_t _reg_id;
+    const uint8_t* ptr = key.data();
+    ptr = e::unpack8be(ptr, &_p);
+    ptr = e::unpack64be(ptr, &_reg_id);
+    ptr = e::unpack64be(ptr, &_ri);
+    ptr = e::unpack64be(ptr, &r->index);
+    e::unpack64be(val.data(), &r->bits);
+    r->ri = region_id(_ri);
+    r->reg_id = region_id(_reg_id);
+    return _p == 'w' ? datalayer::SUCCESS : datalayer::BAD_ENCODING;
+}
+
+void
+hyperdex :: encode_rehome(const region_id& from,
+                          const region_id& via,
+                          char* key, char* val)
+{
+    char* ptr = key;
+    ptr = e::pack8be('r', ptr);
+    ptr = e::pack64be(from.get(), ptr);
+    e::pack64be(via.get(), val);
+}
+
+datalayer::returncode
+hyperdex :: decode_rehome(const e::slice& key,
+                          const e::slice& val,
+                          region_id* from,
+                          region_id* via)
+{
+    if (key.size() != REHOME_BUF_SIZE ||
+        val.size() != REHOME_VAL_SIZE)
+    {
+        return datalayer::BAD_ENCODING;
+    }
+
+    uint8_t _p;
+    uint64_t _from;
+    uint64_t _via;
+    const uint8_t* ptr = key.data();
+    ptr = e::unpack8be(ptr, &_p);
+    ptr = e::unpack64be(ptr, &_from);
+    e::unpack64be(val.data(), &_via);
+    *from = region_id(_from);
+    *via = region_id(_via);
+    return _p == 'r' ? datalayer::SUCCESS : datalayer::BAD_ENCODING;
+}
+
 void
 hyperdex :: encode_transfer(const capture_id& ci,
                             uint64_t count,
@@ -581,9 +787,108 @@ generate_index(const hyperdex::region_id& ri,
     }
 }
 
+static bool
+compare_elems_less(hyperdatatype type, const e::slice& lhs, const e::slice& rhs)
+{
+    return compare_as_type(lhs, rhs, type) < 0;
+}
+
+// Collect the distinct elements (or map keys) of a container in sorted order
+static void
+index_elements(hyperdatatype type,
+               const e::slice& value,
+               std::vector<e::slice>* elems)
+{
+    elems->clear();
+
+    if (!container_elements(value, type, elems))
+    {
+        elems->clear();
+        return;
+    }
+
+    // sets and maps are already sorted, so only lists pay for the sort
+    if (CONTAINER_TYPE(type) == HYPERDATATYPE_LIST_GENERIC)
+    {
+        std::sort(elems->begin(), elems->end(),
+                  std::tr1::bind(compare_elems_less, container_element_type(type),
+                                 std::tr1::placeholders::_1,
+                                 std::tr1::placeholders::_2));
+        elems->erase(std::unique(elems->begin(), elems->end()), elems->end());
+    }
+}
+
+// Containers get one index entry per distinct element, so only elements that
+// were added or removed touch the index.
+static void
+container_index_changes(const hyperdex::region_id& ri,
+                        uint16_t attr,
+                        hyperdatatype type,
+                        const e::slice& key,
+                        const e::slice* old_value,
+                        const e::slice* new_value,
+                        leveldb::WriteBatch* updates)
+{
+    hyperdatatype elem_type = container_element_type(type);
+    std::vector<e::slice> old_elems;
+    std::vector<e::slice> new_elems;
+    std::vector<char> backing;
+    leveldb::Slice slice;
+    leveldb::Slice empty("", 0);
+
+    if (old_value)
+    {
+        index_elements(type, *old_value, &old_elems);
+    }
+
+    if (new_value)
+    {
+        index_elements(type, *new_value, &new_elems);
+    }
+
+    size_t o = 0;
+    size_t n = 0;
+
+    while (o < old_elems.size() || n < new_elems.size())
+    {
+        int cmp = 0;
+
+        if (o >= old_elems.size())
+        {
+            cmp = 1;
+        }
+        else if (n >= new_elems.size())
+        {
+            cmp = -1;
+        }
+        else
+        {
+            cmp = compare_as_type(old_elems[o], new_elems[n], elem_type);
+        }
+
+        if (cmp < 0)
+        {
+            generate_index(ri, attr, elem_type, old_elems[o], key, &backing, &slice);
+            updates->Delete(slice);
+            ++o;
+        }
+        else if (cmp > 0)
+        {
+            generate_index(ri, attr, elem_type, new_elems[n], key, &backing, &slice);
+            updates->Put(slice, empty);
+            ++n;
+        }
+        else
+        {
+            ++o;
+            ++n;
+        }
+    }
+}
+
 datalayer::returncode
 hyperdex :: create_index_changes(const schema* sc,
-                                 const subspace* su,
+                                 const std::vector<uint16_t>& attrs,
                                  const region_id& ri,
                                  const e::slice& key,
                                  const std::vector<e::slice>* old_value,
@@ -599,12 +904,18 @@ hyperdex :: create_index_changes(const schema* sc,
         assert(old_value->size() + 1 == sc->attrs_sz);
         assert(old_value->size() == new_value->size());
 
-        for (size_t j = 0; j < su->attrs.size(); ++j)
+        for (size_t j = 0; j < attrs.size(); ++j)
         {
-            size_t attr = su->attrs[j];
+            size_t attr = attrs[j];
             assert(attr < sc->attrs_sz);
 
-            if (attr > 0 && (*old_value)[attr - 1] != (*new_value)[attr - 1])
+            if (attr > 0 && (*old_value)[attr - 1] != (*new_value)[attr - 1] &&
+                !IS_PRIMITIVE(sc->attrs[attr].type))
+            {
+                container_index_changes(ri, attr, sc->attrs[attr].type, key,
+                                        &(*old_value)[attr - 1], &(*new_value)[attr - 1], updates);
+            }
+            else if (attr > 0 && (*old_value)[attr - 1] != (*new_value)[attr - 1])
             {
                 generate_index(ri, attr, sc->attrs[attr].type, (*old_value)[attr - 1], key, &backing, &slice);
                 updates->Delete(slice);
@@ -617,12 +928,17 @@ hyperdex :: create_index_changes(const schema* sc,
     {
         assert(old_value->size() + 1 == sc->attrs_sz);
 
-        for (size_t j = 0; j < su->attrs.size(); ++j)
+        for (size_t j = 0; j < attrs.size(); ++j)
         {
-            size_t attr = su->attrs[j];
+            size_t attr = attrs[j];
             assert(attr < sc->attrs_sz);
 
-            if (attr > 0)
+            if (attr > 0 && !IS_PRIMITIVE(sc->attrs[attr].type))
+            {
+                container_index_changes(ri, attr, sc->attrs[attr].type, key,
+                                        &(*old_value)[attr - 1], NULL, updates);
+            }
+            else if (attr > 0)
             {
                 generate_index(ri, attr, sc->attrs[attr].type, (*old_value)[attr - 1], key, &backing, &slice);
                 updates->Delete(slice);
@@ -633,12 +949,17 @@ hyperdex :: create_index_changes(const schema* sc,
     {
         assert(new_value->size() + 1 == sc->attrs_sz);
 
-        for (size_t j = 0; j < su->attrs.size(); ++j)
+        for (size_t j = 0; j < attrs.size(); ++j)
         {
-            size_t attr = su->attrs[j];
+            size_t attr = attrs[j];
             assert(attr < sc->attrs_sz);
 
-            if (attr > 0)
+            if (attr > 0 && !IS_PRIMITIVE(sc->attrs[attr].type))
+            {
+                container_index_changes(ri, attr, sc->attrs[attr].type, key,
+                                        NULL, &(*new_value)[attr - 1], updates);
+            }
+            else if (attr > 0)
             {
                 generate_index(ri, attr, sc->attrs[attr].type, (*new_value)[attr - 1], key, &backing, &slice);
                 updates->Put(slice, empty);
@@ -61,6 +61,44 @@ decode_value(const e::slice& in,
              std::vector<e::slice>* attrs,
              uint64_t* version);
 
+// Large container attributes are split into chunks (see chunking.h), each in
+// its own row keyed by its content hash, so that small changes to them write
+// only the chunks they touch.  Within the object's value such an attribute is
+// replaced by a stub that records its size and the hash of each chunk in
+// order, and is flagged by the top bit of its length.
+#define CHUNKED_ATTR_THRESHOLD (64U * 1024U)
+#define CHUNKED_ATTR_FLAG 0x80000000U
+#define CHUNK_STUB_SIZE(N) (2 * sizeof(uint32_t) + (N) * sizeof(uint64_t))
+void
+encode_value(const std::vector<e::slice>& attrs,
+             const std::vector<bool>& chunked,
+             uint64_t version,
+             std::vector<char>* backing,
+             leveldb::Slice* out);
+datalayer::returncode
+decode_value(const e::slice& in,
+             std::vector<e::slice>* attrs,
+             std::vector<bool>* chunked,
+             uint64_t* version);
+// True if the attribute should be stored in chunk rows
+bool
+is_chunked_attr(hyperdatatype type, const e::slice& value);
+void
+encode_chunk_stub(uint32_t size,
+                  const std::vector<uint64_t>& hashes,
+                  std::vector<char>* out);
+datalayer::returncode
+decode_chunk_stub(const e::slice& in,
+                  uint32_t* size,
+                  std::vector<uint64_t>* hashes);
+void
+encode_chunk_key(const region_id& ri,
+                 const e::slice& key,
+                 uint16_t attr,
+                 uint64_t hash,
+                 std::vector<char>* backing,
+                 leveldb::Slice* out);
+
 // Encode the record of an operation for which we have sent an ACK
 #define ACKED_BUF_SIZE (sizeof(uint8_t) + 3 * sizeof(uint64_t))
 void
@@ -74,6 +112,30 @@ decode_acked(const e::slice& in,
              region_id* reg_id, /*region of the point leader*/
              uint64_t* seq_id);
 
+// Encode one word of an acked window
+#define ACKED_WINDOW_BUF_SIZE (sizeof(uint8_t) + 3 * sizeof(uint64_t))
+#define ACKED_WINDOW_VAL_SIZE (sizeof(uint64_t))
+void
+encode_acked_window(const acked_window::row& r,
+                    char* key, char* val);
+datalayer::returncode
+decode_acked_window(const e::slice& key,
+                    const e::slice& val,
+                    acked_window::row* r);
+
+// Encode a pending move of objects out of a split or merged region
+#define REHOME_BUF_SIZE (sizeof(uint8_t) + sizeof(uint64_t))
+#define REHOME_VAL_SIZE (sizeof(uint64_t))
+void
+encode_rehome(const region_id& from, /*region whose objects are moved*/
+              const region_id& via, /*a region of ours in the same subspace*/
+              char* key, char* val);
+datalayer::returncode
+decode_rehome(const e::slice& key,
+              const e::slice& val,
+              region_id* from,
+              region_id* via);
+
 // Encode the transfer
 #define TRANSFER_BUF_SIZE (sizeof(uint8_t) + 2 * sizeof(uint64_t))
 void
@@ -123,7 +185,7 @@ parse_object_key(const leveldb::Slice& s, e::slice* k);
 
 datalayer::returncode
 create_index_changes(const schema* sc,
-                     const subspace* su,
+                     const std::vector<uint16_t>& attrs,
                      const region_id& ri,
                      const e::slice& key,
                      const std::vector<e::slice>* old_value,
@@ -0,0 +1,131 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// C
+#include <cassert>
+
+// STL
+#include <algorithm>
+
+// CityHash
+#include <city.h>
+
+// e
+#include <e/endian.h>
+
+// HyperDex
+#include "daemon/hash_tree.h"
+
+#define HASH_TREE_FIRST_LEAF (HASH_TREE_LEAVES - 1)
+#define HASH_TREE_NODES (2 * HASH_TREE_LEAVES - 1)
+
+using hyperdex::hash_tree;
+
+hash_tree :: hash_tree()
+    : m_nodes(HASH_TREE_NODES, 0)
+{
+}
+
+hash_tree :: ~hash_tree() throw ()
+{
+}
+
+size_t
+hash_tree :: leaf_of(const e::slice& key)
+{
+    return CityHash64(reinterpret_cast<const char*>(key.data()), key.size())
+           & (HASH_TREE_LEAVES - 1);
+}
+
+void
+hash_tree :: insert(const e::slice& key, uint64_t version)
+{
+    uint64_t h = CityHash64WithSeed(reinterpret_cast<const char*>(key.data()),
+                                    key.size(), version);
+    m_nodes[HASH_TREE_FIRST_LEAF + leaf_of(key)] ^= h;
+}
+
+void
+hash_tree :: seal()
+{
+    for (size_t i = HASH_TREE_FIRST_LEAF; i > 0; --i)
+    {
+        char buf[2 * sizeof(uint64_t)];
+        e::pack64be(m_nodes[2 * i - 1], buf);
+        e::pack64be(m_nodes[2 * i], buf + sizeof(uint64_t));
+        m_nodes[i - 1] = CityHash64(buf, sizeof(buf));
+    }
+}
+
+void
+hash_tree :: leaves(std::vector<uint64_t>* ls) const
+{
+    ls->assign(m_nodes.begin() + HASH_TREE_FIRST_LEAF, m_nodes.end());
+}
+
+bool
+hash_tree :: adopt(const std::vector<uint64_t>& ls)
+{
+    if (ls.size() != HASH_TREE_LEAVES)
+    {
+        return false;
+    }
+
+    std::copy(ls.begin(), ls.end(), m_nodes.begin() + HASH_TREE_FIRST_LEAF);
+    seal();
+    return true;
+}
+
+void
+hash_tree :: diff(const hash_tree& other, std::vector<bool>* differ) const
+{
+    differ->assign(HASH_TREE_LEAVES, false);
+    std::vector<size_t> stack;
+    stack.push_back(0);
+
+    while (!stack.empty())
+    {
+        size_t n = stack.back();
+        stack.pop_back();
+
+        if (m_nodes[n] == other.m_nodes[n])
+        {
+            continue;
+        }
+
+        if (n >= HASH_TREE_FIRST_LEAF)
+        {
+            (*differ)[n - HASH_TREE_FIRST_LEAF] = true;
+        }
+        else
+        {
+            stack.push_back(2 * n + 1);
+            stack.push_back(2 * n + 2);
+        }
+    }
+}
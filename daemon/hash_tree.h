@@ -0,0 +1,76 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef hyperdex_daemon_hash_tree_h_
+#define hyperdex_daemon_hash_tree_h_
+
+// STL
+#include <vector>
+
+// e
+#include <e/slice.h>
+
+// A Merkle tree over the (key, version) pairs of one region.  Keys hash into
+// HASH_TREE_LEAVES leaves, each of which is the XOR of the hashes of its
+// objects, so a tree may be built by inserting objects in any order.  Inner
+// nodes hash their two children and are computed by "seal".
+#define HASH_TREE_LEAVES 4096
+
+namespace hyperdex
+{
+
+class hash_tree
+{
+    public:
+        hash_tree();
+        ~hash_tree() throw ();
+
+    public:
+        static size_t leaf_of(const e::slice& key);
+
+    public:
+        void insert(const e::slice& key, uint64_t version);
+        void seal();
+        void leaves(std::vector<uint64_t>* ls) const;
+        // replace this tree with another's leaves, as sent by leaves()
+        bool adopt(const std::vector<uint64_t>& ls);
+        // flag every leaf that differs between the two (sealed) trees
+        void diff(const hash_tree& other, std::vector<bool>* differ) const;
+
+    private:
+        hash_tree(const hash_tree&);
+        hash_tree& operator = (const hash_tree&);
+
+    private:
+        // node i has children 2i + 1 and 2i + 2; the leaves come last
+        std::vector<uint64_t> m_nodes;
+};
+
+} // namespace hyperdex
+
+#endif // hyperdex_daemon_hash_tree_h_
@@ -0,0 +1,69 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_index_filter_h_
+#define hyperdex_daemon_index_filter_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <vector>
+
+// e
+#include <e/slice.h>
+
+namespace hyperdex
+{
+
+// The keys found in one secondary index, kept as a sorted set of key hashes
+// so that candidates from another index may be rejected without a Get.  A
+// hash collision only lets an extra key through, which the full check
+// evaluation then rejects; a key that was inserted is never rejected.
+class index_filter
+{
+    public:
+        index_filter();
+        ~index_filter() throw ();
+
+    public:
+        void insert(const e::slice& key);
+        // call once every key is inserted and before may_contain
+        void seal();
+        bool may_contain(const e::slice& key) const;
+        size_t size() const { return m_hashes.size(); }
+
+    private:
+        static uint64_t hash(const e::slice& key);
+
+    private:
+        std::vector<uint64_t> m_hashes;
+};
+
+} // namespace hyperdex
+
+#endif // hyperdex_daemon_index_filter_h_
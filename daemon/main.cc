@@ -54,6 +54,8 @@ static const char* _coordinator_host = "127.0.0.1";
 static unsigned long _coordinator_port = 1982;
 static bool _coordinator = false;
 static long _threads = 0;
+static bool _durable = false;
+static long _cache_size = 64;
 
 extern "C"
 {
@@ -82,6 +84,11 @@ static struct poptOption popts[] = {
     {"threads", 't', POPT_ARG_LONG, &_threads, 't',
      "the number of threads which will handle network traffic",
      "N"},
+    {"durable", 0, POPT_ARG_NONE, NULL, 'S',
+     "sync each group of writes to disk before acknowledging it", 0},
+    {"cache-size", 0, POPT_ARG_LONG, &_cache_size, 'M',
+     "keep up to this many megabytes of hot objects in memory (default: 64)",
+     "MB"},
     POPT_TABLEEND
 };
 
@@ -160,6 +167,17 @@ main(int argc, const char* argv[])
                 _coordinator = true;
                 break;
             case 't':
+                break;
+            case 'S':
+                _durable = true;
+                break;
+            case 'M':
+                if (_cache_size < 0)
+                {
+                    std::cerr << "cache size must not be negative" << std::endl;
+                    return EXIT_FAILURE;
+                }
+
                 break;
             case POPT_ERROR_NOARG:
             case POPT_ERROR_BADOPT:
@@ -212,7 +230,8 @@ main(int argc, const char* argv[])
             return EXIT_FAILURE;
         }
 
-        return d.run(_daemonize, data, _listen, bind_to, _coordinator, coord, _threads);
+        return d.run(_daemonize, data, _listen, bind_to, _coordinator, coord, _threads, _durable,
+                     static_cast<uint64_t>(_cache_size) * 1024ULL * 1024ULL);
     }
     catch (po6::error& e)
     {
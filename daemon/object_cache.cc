@@ -0,0 +1,297 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Google CityHash
+#include <city.h>
+
+// HyperDex
+#include "daemon/object_cache.h"
+
+using hyperdex::object_cache;
+
+// Independent shards, each with its own lock and its own share of the budget
+#define OBJECT_CACHE_SHARDS 64
+// Approximate bookkeeping cost of one entry beyond its key and value
+#define OBJECT_CACHE_ENTRY_OVERHEAD 128
+
+class object_cache::shard
+{
+    public:
+        typedef std::list<std::pair<cache_key, object_ptr> > lru_t;
+        typedef std::map<cache_key, lru_t::iterator> index_t;
+
+    public:
+        shard();
+        ~shard() throw ();
+
+    public:
+        void touch(lru_t::iterator it);
+        void put(const cache_key& k, object_ptr obj);
+        void erase(index_t::iterator it);
+        void evict();
+
+    public:
+        po6::threads::mutex mtx;
+        uint64_t capacity;
+        uint64_t bytes;
+        uint64_t stamp;
+        uint64_t hits;
+        uint64_t misses;
+        // most recently used at the front
+        lru_t lru;
+        index_t index;
+
+    private:
+        shard(const shard&);
+        shard& operator = (const shard&);
+};
+
+static uint64_t
+entry_size(const std::string& key, const object_cache::object& obj)
+{
+    uint64_t sz = key.size() + obj.backing.size()
+                + obj.value.size() * sizeof(e::slice)
+                + OBJECT_CACHE_ENTRY_OVERHEAD;
+
+    for (size_t i = 0; i < obj.chunks.size(); ++i)
+    {
+        sz += obj.chunks[i].size();
+    }
+
+    return sz;
+}
+
+object_cache :: object_cache()
+    : m_shards()
+{
+    m_shards = new shard[OBJECT_CACHE_SHARDS];
+}
+
+object_cache :: ~object_cache() throw ()
+{
+}
+
+void
+object_cache :: set_capacity(uint64_t bytes)
+{
+    for (size_t i = 0; i < OBJECT_CACHE_SHARDS; ++i)
+    {
+        po6::threads::mutex::hold hold(&m_shards[i].mtx);
+        m_shards[i].capacity = bytes / OBJECT_CACHE_SHARDS;
+        m_shards[i].evict();
+    }
+}
+
+bool
+object_cache :: get(const region_id& ri, const e::slice& key,
+                    object_ptr* obj, uint64_t* stamp)
+{
+    shard* s = get_shard(ri, key);
+    po6::threads::mutex::hold hold(&s->mtx);
+    shard::index_t::iterator it;
+    it = s->index.find(make_key(ri, key));
+
+    if (it == s->index.end())
+    {
+        ++s->misses;
+        *stamp = s->stamp;
+        return false;
+    }
+
+    ++s->hits;
+    s->touch(it->second);
+    *obj = it->second->second;
+    return true;
+}
+
+void
+object_cache :: insert(const region_id& ri, const e::slice& key,
+                       uint64_t stamp, object_ptr obj)
+{
+    shard* s = get_shard(ri, key);
+    po6::threads::mutex::hold hold(&s->mtx);
+
+    // A write to this shard raced with the disk read that produced obj, so
+    // obj may already be stale.
+    if (s->stamp != stamp)
+    {
+        return;
+    }
+
+    s->put(make_key(ri, key), obj);
+}
+
+void
+object_cache :: update(const region_id& ri, const e::slice& key, object_ptr obj)
+{
+    shard* s = get_shard(ri, key);
+    po6::threads::mutex::hold hold(&s->mtx);
+    ++s->stamp;
+    cache_key k(make_key(ri, key));
+    shard::index_t::iterator it;
+    it = s->index.find(k);
+
+    // only keys that were read recently earn a place in the cache
+    if (it != s->index.end())
+    {
+        s->erase(it);
+        s->put(k, obj);
+    }
+}
+
+void
+object_cache :: invalidate(const region_id& ri, const e::slice& key)
+{
+    shard* s = get_shard(ri, key);
+    po6::threads::mutex::hold hold(&s->mtx);
+    ++s->stamp;
+    shard::index_t::iterator it;
+    it = s->index.find(make_key(ri, key));
+
+    if (it != s->index.end())
+    {
+        s->erase(it);
+    }
+}
+
+void
+object_cache :: clear()
+{
+    for (size_t i = 0; i < OBJECT_CACHE_SHARDS; ++i)
+    {
+        po6::threads::mutex::hold hold(&m_shards[i].mtx);
+        ++m_shards[i].stamp;
+        m_shards[i].lru.clear();
+        m_shards[i].index.clear();
+        m_shards[i].bytes = 0;
+    }
+}
+
+void
+object_cache :: stats(uint64_t* hits, uint64_t* misses, uint64_t* bytes)
+{
+    *hits = 0;
+    *misses = 0;
+    *bytes = 0;
+
+    for (size_t i = 0; i < OBJECT_CACHE_SHARDS; ++i)
+    {
+        po6::threads::mutex::hold hold(&m_shards[i].mtx);
+        *hits += m_shards[i].hits;
+        *misses += m_shards[i].misses;
+        *bytes += m_shards[i].bytes;
+    }
+}
+
+object_cache::shard*
+object_cache :: get_shard(const region_id& ri, const e::slice& key)
+{
+    uint64_t h = CityHash64WithSeed(reinterpret_cast<const char*>(key.data()),
+                                    key.size(), ri.get());
+    return &m_shards[h % OBJECT_CACHE_SHARDS];
+}
+
+object_cache::cache_key
+object_cache :: make_key(const region_id& ri, const e::slice& key)
+{
+    return cache_key(ri.get(), std::string(reinterpret_cast<const char*>(key.data()), key.size()));
+}
+
+object_cache :: object :: object()
+    : backing()
+    , chunks()
+    , value()
+    , version()
+{
+}
+
+object_cache :: object :: ~object() throw ()
+{
+}
+
+object_cache :: shard :: shard()
+    : mtx()
+    , capacity(0)
+    , bytes(0)
+    , stamp(0)
+    , hits(0)
+    , misses(0)
+    , lru()
+    , index()
+{
+}
+
+object_cache :: shard :: ~shard() throw ()
+{
+}
+
+void
+object_cache :: shard :: touch(lru_t::iterator it)
+{
+    lru.splice(lru.begin(), lru, it);
+}
+
+void
+object_cache :: shard :: put(const cache_key& k, object_ptr obj)
+{
+    uint64_t sz = entry_size(k.second, *obj);
+
+    if (sz > capacity)
+    {
+        return;
+    }
+
+    index_t::iterator it;
+    it = index.find(k);
+
+    if (it != index.end())
+    {
+        erase(it);
+    }
+
+    lru.push_front(std::make_pair(k, obj));
+    index.insert(std::make_pair(k, lru.begin()));
+    bytes += sz;
+    evict();
+}
+
+void
+object_cache :: shard :: erase(index_t::iterator it)
+{
+    bytes -= entry_size(it->first.second, *it->second->second);
+    lru.erase(it->second);
+    index.erase(it);
+}
+
+void
+object_cache :: shard :: evict()
+{
+    while (bytes > capacity && !lru.empty())
+    {
+        erase(index.find(lru.back().first));
+    }
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_object_cache_h_
+#define hyperdex_daemon_object_cache_h_
+
+// STL
+#include <list>
+#include <map>
+#include <string>
+#include <tr1/memory>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/array_ptr.h>
+#include <e/slice.h>
+
+// HyperDex
+#include "common/ids.h"
+
+namespace hyperdex
+{
+
+// A sharded, memory-bounded LRU cache of decoded objects keyed by
+// (region_id, key).  Entries are immutable once built, so readers may hold
+// on to them after the cache evicts or replaces them.
+class object_cache
+{
+    public:
+        class object;
+        typedef std::tr1::shared_ptr<const object> object_ptr;
+
+    public:
+        object_cache();
+        ~object_cache() throw ();
+
+    public:
+        // set the total number of bytes the cache may hold; zero disables it
+        void set_capacity(uint64_t bytes);
+        // On a hit, returns true and fills in obj.  On a miss, returns false
+        // and fills in stamp, which must be passed to "insert" to fill the
+        // cache from the disk.
+        bool get(const region_id& ri, const e::slice& key,
+                 object_ptr* obj, uint64_t* stamp);
+        // insert obj unless the key was written since "get" handed out stamp
+        void insert(const region_id& ri, const e::slice& key,
+                    uint64_t stamp, object_ptr obj);
+        // replace the cached copy of the key (if there is one) with obj
+        void update(const region_id& ri, const e::slice& key, object_ptr obj);
+        void invalidate(const region_id& ri, const e::slice& key);
+        void clear();
+        void stats(uint64_t* hits, uint64_t* misses, uint64_t* bytes);
+
+    private:
+        class shard;
+        typedef std::pair<uint64_t, std::string> cache_key;
+
+    private:
+        object_cache(const object_cache&);
+        object_cache& operator = (const object_cache&);
+
+    private:
+        shard* get_shard(const region_id& ri, const e::slice& key);
+        static cache_key make_key(const region_id& ri, const e::slice& key);
+
+    private:
+        e::array_ptr<shard> m_shards;
+};
+
+class object_cache::object
+{
+    public:
+        object();
+        ~object() throw ();
+
+    public:
+        // the encoded value as stored on disk and its chunked attributes
+        // reassembled; "value" points into them
+        std::string backing;
+        std::vector<std::string> chunks;
+        std::vector<e::slice> value;
+        uint64_t version;
+
+    private:
+        object(const object&);
+        object& operator = (const object&);
+};
+
+} // namespace hyperdex
+
+#endif // hyperdex_daemon_object_cache_h_
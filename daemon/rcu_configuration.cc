@@ -0,0 +1,74 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// e
+#include <e/atomic.h>
+
+// HyperDex
+#include "daemon/rcu_configuration.h"
+
+using hyperdex::configuration;
+using hyperdex::rcu_configuration;
+
+rcu_configuration :: rcu_configuration()
+    : m_current(new configuration())
+    , m_retired()
+{
+}
+
+rcu_configuration :: ~rcu_configuration() throw ()
+{
+    reclaim();
+    delete m_current;
+}
+
+const configuration*
+rcu_configuration :: get() const
+{
+    return e::atomic::load_ptr_acquire(&m_current);
+}
+
+void
+rcu_configuration :: publish(const configuration& config)
+{
+    const configuration* old_config = m_current;
+    const configuration* new_config = new configuration(config);
+    e::atomic::store_ptr_release(&m_current, new_config);
+    m_retired.push_back(old_config);
+}
+
+void
+rcu_configuration :: reclaim()
+{
+    for (size_t i = 0; i < m_retired.size(); ++i)
+    {
+        delete m_retired[i];
+    }
+
+    m_retired.clear();
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2012, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef hyperdex_daemon_rcu_configuration_h_
+#define hyperdex_daemon_rcu_configuration_h_
+
+// STL
+#include <vector>
+
+// HyperDex
+#include "common/configuration.h"
+
+// Readers call "get" (or dereference) without taking any lock and may use the
+// result until the next "reclaim".  "publish", "retired", and "reclaim" must
+// only be called from one thread, and "reclaim" additionally requires that no
+// reader still holds a configuration obtained before the last "publish".
+//
+// A handler should "get" once and use that pointer for the whole operation;
+// two calls may straddle a "publish" and answer from different configurations.
+// Do not hold the pointer across a pause point, since "reclaim" runs while
+// every thread is paused.
+
+namespace hyperdex
+{
+
+class rcu_configuration
+{
+    public:
+        rcu_configuration();
+        ~rcu_configuration() throw ();
+
+    public:
+        const configuration* get() const;
+        const configuration* operator -> () const { return get(); }
+        const configuration& operator * () const { return *get(); }
+
+    public:
+        void publish(const configuration& config);
+        size_t retired() const { return m_retired.size(); }
+        void reclaim();
+
+    private:
+        rcu_configuration(const rcu_configuration&);
+        rcu_configuration& operator = (const rcu_configuration&);
+
+    private:
+        const configuration* m_current;
+        std::vector<const configuration*> m_retired;
+};
+
+} // namespace hyperdex
+
+#endif // hyperdex_daemon_rcu_configuration_h_
@@ -42,6 +42,7 @@
 #include "common/serialization.h"
 #include "datatypes/apply.h"
 #include "datatypes/validate.h"
+#include "daemon/chain_delta.h"
 #include "daemon/daemon.h"
 #include "daemon/replication_manager.h"
 #include "daemon/replication_manager_keyholder.h"
@@ -51,6 +52,10 @@
 using hyperdex::reconfigure_returncode;
 using hyperdex::replication_manager;
 
+// How long a key's committable operations may sit unacknowledged before the
+// retransmitter revisits it.
+#define RETRANSMIT_TIMEOUT (1000ULL * 1000ULL * 1000ULL)
+
 #define _CONCAT(x, y) x ## y
 #define CONCAT(x, y) _CONCAT(x, y)
 
@@ -82,6 +87,8 @@ replication_manager :: replication_manager(daemon* d)
     , m_need_pause(false)
     , m_paused_retransmitter(false)
     , m_paused_garbage_collector(false)
+    , m_retransmit_lock()
+    , m_retransmit_queues()
 {
 }
 
@@ -164,7 +171,12 @@ replication_manager :: reconfigure(const configuration&,
         uint64_t max_seq_id = kh->max_seq_id();
         seq_ids[ri.get()] = std::max(seq_ids[ri.get()], max_seq_id);
 
-        if (std::binary_search(transfer_in_regions.begin(), transfer_in_regions.end(), ri))
+        // Keys that are transferred in, no longer ours, or left with nothing
+        // to do once their deferred operations are gone are dropped here, as
+        // the retransmitter only revisits keys with committable operations.
+        if (std::binary_search(transfer_in_regions.begin(), transfer_in_regions.end(), ri) ||
+            new_config.get_virtual(ri, m_daemon->m_us) == virtual_server_id() ||
+            kh->empty())
         {
             m_keyholders.remove(it.key());
         }
@@ -206,8 +218,9 @@ replication_manager :: client_atomic(const server_id& from,
                                      std::vector<attribute_check>* checks,
                                      std::vector<funcall>* funcs)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema* sc = m_daemon->m_config.get_schema(ri);
+    const configuration* config = m_daemon->m_config.get();
+    region_id ri(config->get_region_id(to));
+    const schema* sc = config->get_schema(ri);
 
     if (!validate_as_type(key, sc->attrs[0].type))
     {
@@ -216,12 +229,22 @@ replication_manager :: client_atomic(const server_id& from,
     }
 
     // Make sure this message is to the point-leader.
-    if (!m_daemon->m_config.is_point_leader(to))
+    if (!config->is_point_leader(to))
+    {
+        respond_to_client(to, from, nonce, NET_NOTUS);
+        return;
+    }
+
+    // ...and that the key has not moved to another region in a split
+    if (config->point_region(ri, key) != ri)
     {
         respond_to_client(to, from, nonce, NET_NOTUS);
         return;
     }
 
+    // count the write toward the region's load
+    m_daemon->m_region_ops.increment(ri);
+
     HOLD_LOCK_FOR_KEY(ri, key);
     e::intrusive_ptr<keyholder> kh = get_or_create_keyholder(ri, key);
     bool has_old_value = false;
@@ -317,7 +340,8 @@ replication_manager :: chain_op(const virtual_server_id& from,
                                 const e::slice& key,
                                 const std::vector<e::slice>& value)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
+    const configuration* config = m_daemon->m_config.get();
+    region_id ri(config->get_region_id(to));
 
     if (retransmission && m_daemon->m_data.check_acked(ri, reg_id, seq_id))
     {
@@ -326,7 +350,7 @@ replication_manager :: chain_op(const virtual_server_id& from,
         return;
     }
 
-    const schema* sc = m_daemon->m_config.get_schema(ri);
+    const schema* sc = config->get_schema(ri);
     HOLD_LOCK_FOR_KEY(ri, key);
     e::intrusive_ptr<keyholder> kh = get_or_create_keyholder(ri, key);
 
@@ -342,7 +366,7 @@ replication_manager :: chain_op(const virtual_server_id& from,
 
     if (new_op)
     {
-        new_op->recv_config_version = m_daemon->m_config.version();
+        new_op->recv_config_version = config->version();
         new_op->recv = from;
 
         if (new_op->acked)
@@ -362,12 +386,71 @@ replication_manager :: chain_op(const virtual_server_id& from,
     }
 
     std::tr1::shared_ptr<e::buffer> new_backing(backing.release());
-    e::intrusive_ptr<pending> new_defer(new pending(new_backing, reg_id, seq_id, fresh, has_value, value, m_daemon->m_config.version(), from));
+    e::intrusive_ptr<pending> new_defer(new pending(new_backing, reg_id, seq_id, fresh, has_value, value, config->version(), from));
     kh->insert_deferred(version, new_defer);
     move_operations_between_queues(to, ri, *sc, key, kh);
     CLEANUP_KEYHOLDER(ri, key, kh);
 }
 
+void
+replication_manager :: chain_delta(const virtual_server_id& from,
+                                   const virtual_server_id& to,
+                                   const region_id& reg_id,
+                                   uint64_t seq_id,
+                                   uint64_t version,
+                                   std::auto_ptr<e::buffer> backing,
+                                   const e::slice& key,
+                                   const std::vector<std::pair<uint16_t, e::slice> >& delta)
+{
+    const configuration* config = m_daemon->m_config.get();
+    region_id ri(config->get_region_id(to));
+    const schema* sc = config->get_schema(ri);
+    std::auto_ptr<e::buffer> full;
+    std::vector<e::slice> value;
+
+    {
+        HOLD_LOCK_FOR_KEY(ri, key);
+        e::intrusive_ptr<keyholder> kh = get_or_create_keyholder(ri, key);
+
+        if (!kh)
+        {
+            return;
+        }
+
+        e::intrusive_ptr<pending> prev = kh->get_by_version(version - 1);
+        const std::vector<e::slice>* base = NULL;
+
+        if (prev && prev->has_value)
+        {
+            base = &prev->value;
+        }
+        else if (!prev && kh->exists_on_disk() && kh->version_on_disk() + 1 == version)
+        {
+            base = &kh->value_on_disk();
+        }
+
+        // The sender falls back to the full value when it retransmits, so
+        // dropping what we cannot rebuild is safe.
+        if (!base || sc->attrs_sz != base->size() + 1)
+        {
+            LOG(INFO) << "dropping delta CHAIN_OP because we lack the version it applies to";
+            CLEANUP_KEYHOLDER(ri, key, kh);
+            return;
+        }
+
+        if (!chain_delta_apply(*base, delta, &full, &value))
+        {
+            LOG(INFO) << "dropping delta CHAIN_OP because the dimensions are incorrect";
+            CLEANUP_KEYHOLDER(ri, key, kh);
+            return;
+        }
+
+        CLEANUP_KEYHOLDER(ri, key, kh);
+    }
+
+    chain_op(from, to, false, reg_id, seq_id, version, false, true, full, key, value);
+}
+
 void
 replication_manager :: chain_subspace(const virtual_server_id& from,
                                       const virtual_server_id& to,
@@ -380,7 +463,8 @@ replication_manager :: chain_subspace(const virtual_server_id& from,
                                       const std::vector<e::slice>& value,
                                       const std::vector<uint64_t>& hashes)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
+    const configuration* config = m_daemon->m_config.get();
+    region_id ri(config->get_region_id(to));
 
     if (retransmission && m_daemon->m_data.check_acked(ri, reg_id, seq_id))
     {
@@ -389,7 +473,7 @@ replication_manager :: chain_subspace(const virtual_server_id& from,
         return;
     }
 
-    const schema* sc = m_daemon->m_config.get_schema(ri);
+    const schema* sc = config->get_schema(ri);
     HOLD_LOCK_FOR_KEY(ri, key);
     e::intrusive_ptr<keyholder> kh = get_or_create_keyholder(ri, key);
 
@@ -402,36 +486,36 @@ replication_manager :: chain_subspace(const virtual_server_id& from,
 
     // Create a new pending object to set as pending.
     std::tr1::shared_ptr<e::buffer> new_backing(backing.release());
-    e::intrusive_ptr<pending> new_pend(new pending(new_backing, reg_id, seq_id, false, true, value, m_daemon->m_config.version(), from));
+    e::intrusive_ptr<pending> new_pend(new pending(new_backing, reg_id, seq_id, false, true, value, config->version(), from));
     new_pend->old_hashes.resize(sc->attrs_sz);
     new_pend->new_hashes.resize(sc->attrs_sz);
     new_pend->this_old_region = region_id();
     new_pend->this_new_region = region_id();
     new_pend->prev_region = region_id();
     new_pend->next_region = region_id();
-    subspace_id subspace_this = m_daemon->m_config.subspace_of(ri);
-    subspace_id subspace_prev = m_daemon->m_config.subspace_prev(subspace_this);
-    subspace_id subspace_next = m_daemon->m_config.subspace_next(subspace_this);
+    subspace_id subspace_this = config->subspace_of(ri);
+    subspace_id subspace_prev = config->subspace_prev(subspace_this);
+    subspace_id subspace_next = config->subspace_next(subspace_this);
     hyperdex::hash(*sc, key, value, &new_pend->new_hashes.front());
     new_pend->old_hashes = hashes;
 
     if (subspace_prev != subspace_id())
     {
-        m_daemon->m_config.lookup_region(subspace_prev, new_pend->new_hashes, &new_pend->prev_region);
+        config->lookup_region(subspace_prev, new_pend->new_hashes, &new_pend->prev_region);
     }
 
-    m_daemon->m_config.lookup_region(subspace_this, new_pend->old_hashes, &new_pend->this_old_region);
-    m_daemon->m_config.lookup_region(subspace_this, new_pend->new_hashes, &new_pend->this_new_region);
+    config->lookup_region(subspace_this, new_pend->old_hashes, &new_pend->this_old_region);
+    config->lookup_region(subspace_this, new_pend->new_hashes, &new_pend->this_new_region);
 
     if (subspace_next != subspace_id())
     {
-        m_daemon->m_config.lookup_region(subspace_next, new_pend->old_hashes, &new_pend->next_region);
+        config->lookup_region(subspace_next, new_pend->old_hashes, &new_pend->next_region);
     }
 
-    if (!(new_pend->this_old_region == m_daemon->m_config.get_region_id(from) &&
-          m_daemon->m_config.tail_of_region(new_pend->this_old_region) == from) &&
-        !(new_pend->this_new_region == m_daemon->m_config.get_region_id(from) &&
-          m_daemon->m_config.next_in_region(from) == to))
+    if (!(new_pend->this_old_region == config->get_region_id(from) &&
+          config->tail_of_region(new_pend->this_old_region) == from) &&
+        !(new_pend->this_new_region == config->get_region_id(from) &&
+          config->next_in_region(from) == to))
     {
         LOG(INFO) << "dropping CHAIN_SUBSPACE which didn't obey chaining rules";
         CLEANUP_KEYHOLDER(ri, key, kh);
@@ -452,7 +536,8 @@ replication_manager :: chain_ack(const virtual_server_id& from,
                                  uint64_t version,
                                  const e::slice& key)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
+    const configuration* config = m_daemon->m_config.get();
+    region_id ri(config->get_region_id(to));
 
     if (retransmission && m_daemon->m_data.check_acked(ri, reg_id, seq_id))
     {
@@ -460,7 +545,7 @@ replication_manager :: chain_ack(const virtual_server_id& from,
         return;
     }
 
-    const schema* sc = m_daemon->m_config.get_schema(ri);
+    const schema* sc = config->get_schema(ri);
     HOLD_LOCK_FOR_KEY(ri, key);
     e::intrusive_ptr<keyholder> kh = get_keyholder(ri, key);
 
@@ -493,7 +578,7 @@ replication_manager :: chain_ack(const virtual_server_id& from,
         return;
     }
 
-    if (m_daemon->m_config.version() != pend->sent_config_version)
+    if (config->version() != pend->sent_config_version)
     {
         LOG(INFO) << "dropping CHAIN_ACK that was sent in a previous version and hasn't been retransmitted";
         CLEANUP_KEYHOLDER(ri, key, kh);
@@ -508,9 +593,9 @@ replication_manager :: chain_ack(const virtual_server_id& from,
     }
 
     pend->acked = true;
-    bool is_head = m_daemon->m_config.head_of_region(ri) == to;
+    bool is_head = config->head_of_region(ri) == to;
 
-    if (!is_head && m_daemon->m_config.version() == pend->recv_config_version)
+    if (!is_head && config->version() == pend->recv_config_version)
     {
         send_ack(to, pend->recv, false, reg_id, seq_id, version, key);
     }
@@ -575,12 +660,12 @@ replication_manager :: chain_ack(const virtual_server_id& from,
     kh->clear_committable_acked();
     move_operations_between_queues(to, ri, *sc, key, kh);
 
-    if (m_daemon->m_config.is_point_leader(to))
+    if (config->is_point_leader(to))
     {
         respond_to_client(to, pend->client, pend->nonce, NET_SUCCESS);
     }
 
-    if (is_head && m_daemon->m_config.version() == pend->recv_config_version)
+    if (is_head && config->version() == pend->recv_config_version)
     {
         send_ack(to, pend->recv, false, reg_id, seq_id, version, key);
     }
@@ -694,15 +779,16 @@ replication_manager :: hash_objects(const region_id& reg,
                                     const std::vector<e::slice>& old_value,
                                     e::intrusive_ptr<pending> pend)
 {
+    const configuration* config = m_daemon->m_config.get();
     pend->old_hashes.resize(sc.attrs_sz);
     pend->new_hashes.resize(sc.attrs_sz);
     pend->this_old_region = region_id();
     pend->this_new_region = region_id();
     pend->prev_region = region_id();
     pend->next_region = region_id();
-    subspace_id subspace_this = m_daemon->m_config.subspace_of(reg);
-    subspace_id subspace_prev = m_daemon->m_config.subspace_prev(subspace_this);
-    subspace_id subspace_next = m_daemon->m_config.subspace_next(subspace_this);
+    subspace_id subspace_this = config->subspace_of(reg);
+    subspace_id subspace_prev = config->subspace_prev(subspace_this);
+    subspace_id subspace_next = config->subspace_next(subspace_this);
 
     if (has_old_value && has_new_value)
     {
@@ -711,15 +797,15 @@ replication_manager :: hash_objects(const region_id& reg,
 
         if (subspace_prev != subspace_id())
         {
-            m_daemon->m_config.lookup_region(subspace_prev, pend->new_hashes, &pend->prev_region);
+            config->lookup_region(subspace_prev, pend->new_hashes, &pend->prev_region);
         }
 
-        m_daemon->m_config.lookup_region(subspace_this, pend->old_hashes, &pend->this_old_region);
-        m_daemon->m_config.lookup_region(subspace_this, pend->new_hashes, &pend->this_new_region);
+        config->lookup_region(subspace_this, pend->old_hashes, &pend->this_old_region);
+        config->lookup_region(subspace_this, pend->new_hashes, &pend->this_new_region);
 
         if (subspace_next != subspace_id())
         {
-            m_daemon->m_config.lookup_region(subspace_next, pend->old_hashes, &pend->next_region);
+            config->lookup_region(subspace_next, pend->old_hashes, &pend->next_region);
         }
     }
     else if (has_old_value)
@@ -733,15 +819,15 @@ replication_manager :: hash_objects(const region_id& reg,
 
         if (subspace_prev != subspace_id())
         {
-            m_daemon->m_config.lookup_region(subspace_prev, pend->old_hashes, &pend->prev_region);
+            config->lookup_region(subspace_prev, pend->old_hashes, &pend->prev_region);
         }
 
-        m_daemon->m_config.lookup_region(subspace_this, pend->old_hashes, &pend->this_old_region);
+        config->lookup_region(subspace_this, pend->old_hashes, &pend->this_old_region);
         pend->this_new_region = pend->this_old_region;
 
         if (subspace_next != subspace_id())
         {
-            m_daemon->m_config.lookup_region(subspace_next, pend->old_hashes, &pend->next_region);
+            config->lookup_region(subspace_next, pend->old_hashes, &pend->next_region);
         }
     }
     else if (has_new_value)
@@ -755,15 +841,15 @@ replication_manager :: hash_objects(const region_id& reg,
 
         if (subspace_prev != subspace_id())
         {
-            m_daemon->m_config.lookup_region(subspace_prev, pend->old_hashes, &pend->prev_region);
+            config->lookup_region(subspace_prev, pend->old_hashes, &pend->prev_region);
         }
 
-        m_daemon->m_config.lookup_region(subspace_this, pend->old_hashes, &pend->this_new_region);
+        config->lookup_region(subspace_this, pend->old_hashes, &pend->this_new_region);
         pend->this_old_region = pend->this_new_region;
 
         if (subspace_next != subspace_id())
         {
-            m_daemon->m_config.lookup_region(subspace_next, pend->old_hashes, &pend->next_region);
+            config->lookup_region(subspace_next, pend->old_hashes, &pend->next_region);
         }
     }
     else
@@ -779,6 +865,7 @@ replication_manager :: move_operations_between_queues(const virtual_server_id& u
                                                       const e::slice& key,
                                                       e::intrusive_ptr<keyholder> kh)
 {
+    const configuration* config = m_daemon->m_config.get();
     // See if we can re-use some of the deferred operations
     while (kh->has_deferred_ops())
     {
@@ -814,8 +901,8 @@ replication_manager :: move_operations_between_queues(const virtual_server_id& u
             }
 
             if (new_pend->recv != virtual_server_id() &&
-                m_daemon->m_config.next_in_region(new_pend->recv) != us &&
-                !m_daemon->m_config.subspace_adjacent(new_pend->recv, us))
+                config->next_in_region(new_pend->recv) != us &&
+                !config->subspace_adjacent(new_pend->recv, us))
             {
                 LOG(INFO) << "dropping deferred CHAIN_* which didn't come from the right host";
                 kh->pop_oldest_deferred();
@@ -839,8 +926,24 @@ replication_manager :: move_operations_between_queues(const virtual_server_id& u
             break;
         }
 
+        // With nothing ahead of it in flight, every earlier version has been
+        // acknowledged down the chain, so the next hop holds the one on disk.
+        const std::vector<e::slice>* base = NULL;
+
+        if (!kh->has_committable_ops() &&
+            kh->exists_on_disk() &&
+            kh->version_on_disk() + 1 == version)
+        {
+            base = &kh->value_on_disk();
+        }
+
         kh->shift_one_blocked_to_committable();
-        send_message(us, false, version, key, op);
+        send_message(us, false, version, key, op, base);
+    }
+
+    if (kh->has_committable_ops())
+    {
+        arm_retransmit(ri, key, kh);
     }
 }
 
@@ -849,16 +952,18 @@ replication_manager :: send_message(const virtual_server_id& us,
                                     bool retransmission,
                                     uint64_t version,
                                     const e::slice& key,
-                                    e::intrusive_ptr<pending> op)
+                                    e::intrusive_ptr<pending> op,
+                                    const std::vector<e::slice>* base)
 {
+    const configuration* config = m_daemon->m_config.get();
     // If we've sent it somewhere, we shouldn't resend.  If the sender intends a
     // resend, they should clear "sent" first.
     assert(op->sent == virtual_server_id());
-    region_id ri(m_daemon->m_config.get_region_id(us));
+    region_id ri(config->get_region_id(us));
 
     // facts we use to decide what to do
     assert(ri == op->this_old_region || ri == op->this_new_region);
-    bool last_in_chain = m_daemon->m_config.tail_of_region(ri) == us;
+    bool last_in_chain = config->tail_of_region(ri) == us;
     bool has_next_subspace = op->next_region != region_id();
 
     // variables we fill in to determine the message type/destination
@@ -871,7 +976,7 @@ replication_manager :: send_message(const virtual_server_id& us,
         {
             if (has_next_subspace)
             {
-                dest = m_daemon->m_config.head_of_region(op->next_region);
+                dest = config->head_of_region(op->next_region);
                 type = type; // it stays the same
             }
             else
@@ -882,7 +987,7 @@ replication_manager :: send_message(const virtual_server_id& us,
         }
         else
         {
-            dest = m_daemon->m_config.next_in_region(us);
+            dest = config->next_in_region(us);
             type = type; // it stays the same
         }
     }
@@ -891,12 +996,12 @@ replication_manager :: send_message(const virtual_server_id& us,
         if (last_in_chain)
         {
             assert(op->has_value);
-            dest = m_daemon->m_config.head_of_region(op->this_new_region);
+            dest = config->head_of_region(op->this_new_region);
             type = CHAIN_SUBSPACE;
         }
         else
         {
-            dest = m_daemon->m_config.next_in_region(us);
+            dest = config->next_in_region(us);
             type = type; // it stays the same
         }
     }
@@ -906,7 +1011,7 @@ replication_manager :: send_message(const virtual_server_id& us,
         {
             if (has_next_subspace)
             {
-                dest = m_daemon->m_config.head_of_region(op->next_region);
+                dest = config->head_of_region(op->next_region);
                 type = type; // it stays the same
             }
             else
@@ -918,7 +1023,7 @@ replication_manager :: send_message(const virtual_server_id& us,
         else
         {
             assert(op->has_value);
-            dest = m_daemon->m_config.next_in_region(us);
+            dest = config->next_in_region(us);
             type = CHAIN_SUBSPACE;
         }
     }
@@ -928,8 +1033,46 @@ replication_manager :: send_message(const virtual_server_id& us,
     }
 
     std::auto_ptr<e::buffer> msg;
+    std::vector<uint16_t> changed;
+    bool delta = false;
+
+    // Deltas only go to the next replica in our own region; other hops may
+    // not hold the previous version at all.
+    if (type == CHAIN_OP && base && !retransmission && !last_in_chain &&
+        op->this_old_region == op->this_new_region &&
+        op->has_value && !op->fresh)
+    {
+        delta = chain_delta_diff(*base, op->value, &changed);
+    }
 
-    if (type == CHAIN_OP)
+    if (type == CHAIN_OP && delta)
+    {
+        uint8_t flags = 4;
+        size_t sz = HYPERDEX_HEADER_SIZE_VV
+                  + sizeof(uint8_t)
+                  + sizeof(uint64_t)
+                  + sizeof(uint64_t)
+                  + sizeof(uint64_t)
+                  + sizeof(uint32_t)
+                  + key.size()
+                  + sizeof(uint16_t);
+
+        for (size_t i = 0; i < changed.size(); ++i)
+        {
+            sz += sizeof(uint16_t) + pack_size(op->value[changed[i]]);
+        }
+
+        msg.reset(e::buffer::create(sz));
+        uint16_t changed_sz = changed.size();
+        e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VV);
+        pa = pa << flags << op->reg_id.get() << op->seq_id << version << key << changed_sz;
+
+        for (size_t i = 0; i < changed.size(); ++i)
+        {
+            pa = pa << changed[i] << op->value[changed[i]];
+        }
+    }
+    else if (type == CHAIN_OP)
     {
         uint8_t flags = (op->fresh ? 1 : 0)
                       | (op->has_value ? 2 : 0)
@@ -978,9 +1121,10 @@ replication_manager :: send_message(const virtual_server_id& us,
         abort();
     }
 
-    op->sent_config_version = m_daemon->m_config.version();
+    op->sent_config_version = config->version();
     op->sent = dest;
-    m_daemon->m_comm.send_exact(us, dest, type, msg);
+    op->sent_delta = delta;
+    m_daemon->m_comm.send_batched(us, dest, type, msg);
 }
 
 bool
@@ -1002,7 +1146,7 @@ replication_manager :: send_ack(const virtual_server_id& us,
               + key.size();
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
     msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << flags << reg_id.get() << seq_id << version << key;
-    return m_daemon->m_comm.send_exact(us, to, CHAIN_ACK, msg);
+    return m_daemon->m_comm.send_batched(us, to, CHAIN_ACK, msg);
 }
 
 void
@@ -1020,6 +1164,61 @@ replication_manager :: respond_to_client(const virtual_server_id& us,
     m_daemon->m_comm.send_client(us, client, RESP_ATOMIC, msg);
 }
 
+void
+replication_manager :: arm_retransmit(const region_id& ri,
+                                      const e::slice& key,
+                                      e::intrusive_ptr<keyholder> kh)
+{
+    if (kh->get_retransmit_deadline() != 0)
+    {
+        return;
+    }
+
+    po6::threads::mutex::hold hold(&m_retransmit_lock);
+    // read the clock under the lock so each queue stays in deadline order
+    uint64_t deadline = e::time() + RETRANSMIT_TIMEOUT;
+    std::string k(reinterpret_cast<const char*>(key.data()), key.size());
+    m_retransmit_queues[ri].push_back(std::make_pair(deadline, k));
+    kh->get_retransmit_deadline() = deadline;
+}
+
+void
+replication_manager :: take_due_retransmits(const configuration* config,
+                                            bool all,
+                                            std::vector<std::pair<region_id, retransmit_t> >* due)
+{
+    po6::threads::mutex::hold hold(&m_retransmit_lock);
+    uint64_t now = e::time();
+    retransmit_map_t::iterator it = m_retransmit_queues.begin();
+
+    while (it != m_retransmit_queues.end())
+    {
+        retransmit_queue_t* q = &it->second;
+
+        if (config->is_server_blocked_by_live_transfer(m_daemon->m_us, it->first))
+        {
+            ++it;
+            continue;
+        }
+
+        while (!q->empty() && (all || q->front().first <= now))
+        {
+            due->push_back(std::make_pair(it->first, retransmit_t(q->front().first, std::string())));
+            due->back().second.second.swap(q->front().second);
+            q->pop_front();
+        }
+
+        if (q->empty())
+        {
+            m_retransmit_queues.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
 void
 replication_manager :: retransmitter()
 {
@@ -1039,6 +1238,7 @@ replication_manager :: retransmitter()
     }
 
     uint64_t then = e::time();
+    uint64_t config_version = 0;
 
     while (true)
     {
@@ -1066,71 +1266,49 @@ replication_manager :: retransmitter()
             m_need_retransmit = false;
         }
 
-        std::set<region_id> region_cache;
-        std::map<region_id, uint64_t> seq_id_lower_bounds;
-
-        {
-            m_counters.peek(&seq_id_lower_bounds);
-        }
-
-        for (keyholder_map_t::iterator it = m_keyholders.begin();
-                it != m_keyholders.end(); it.next())
+        // A new configuration may have changed the chain of any key with
+        // operations in flight, so revisit all of them rather than only
+        // those which are due.
+        // Fetched after the pause so it cannot be reclaimed under us
+        const configuration* config = m_daemon->m_config.get();
+        uint64_t version = config->version();
+        std::vector<std::pair<region_id, retransmit_t> > due;
+        take_due_retransmits(config, version != config_version, &due);
+        config_version = version;
+
+        for (size_t i = 0; i < due.size(); ++i)
         {
-            region_id ri(it.key().region);
-
-            if (region_cache.find(ri) != region_cache.end() ||
-                m_daemon->m_config.is_server_blocked_by_live_transfer(m_daemon->m_us, ri))
-            {
-                region_cache.insert(ri);
-                continue;
-            }
-
-            e::slice key(it.key().key.data(), it.key().key.size());
+            region_id ri(due[i].first);
+            const std::string& k(due[i].second.second);
+            e::slice key(k.data(), k.size());
             HOLD_LOCK_FOR_KEY(ri, key);
             e::intrusive_ptr<keyholder> kh = get_keyholder(ri, key);
 
-            if (!kh)
+            // skip entries left behind by a keyholder that has since been
+            // erased and recreated
+            if (!kh || kh->get_retransmit_deadline() != due[i].second.first)
             {
                 continue;
             }
 
-            virtual_server_id us = m_daemon->m_config.get_virtual(ri, m_daemon->m_us);
+            kh->get_retransmit_deadline() = 0;
+            virtual_server_id us = config->get_virtual(ri, m_daemon->m_us);
 
             if (us == virtual_server_id())
             {
-                m_keyholders.remove(it.key());
+                erase_keyholder(ri, key);
                 continue;
             }
 
-            const schema* sc = m_daemon->m_config.get_schema(ri);
+            const schema* sc = config->get_schema(ri);
             assert(sc);
-
-            if (kh->empty())
-            {
-                LOG(WARNING) << "leaking keyholders (this is harmless if you reconfigure enough)";
-                m_keyholders.remove(it.key());
-                continue;
-            }
-
             kh->resend_committable(this, us, key);
             move_operations_between_queues(us, ri, *sc, key, kh);
-
-            if (m_daemon->m_config.is_point_leader(us))
-            {
-                uint64_t min_id = kh->min_seq_id();
-                std::map<region_id, uint64_t>::iterator lb = seq_id_lower_bounds.find(ri);
-
-                if (lb == seq_id_lower_bounds.end())
-                {
-                    seq_id_lower_bounds.insert(std::make_pair(ri, min_id));
-                }
-                else
-                {
-                    lb->second = std::min(lb->second, min_id);
-                }
-            }
+            CLEANUP_KEYHOLDER(ri, key, kh);
         }
 
+        // this thread never returns to recv, so nothing else would send them
+        m_daemon->m_comm.flush_batches();
         m_daemon->m_comm.wake_one();
         uint64_t now = e::time();
 
@@ -1141,35 +1319,118 @@ replication_manager :: retransmitter()
         }
 
         then = now;
-        std::vector<std::pair<server_id, po6::net::location> > cluster_members;
-        m_daemon->m_config.get_all_addresses(&cluster_members);
+        std::map<region_id, uint64_t> seq_id_lower_bounds;
+        m_counters.peek(&seq_id_lower_bounds);
 
-        for (std::map<region_id, uint64_t>::iterator it = seq_id_lower_bounds.begin();
-                it != seq_id_lower_bounds.end(); ++it)
+        // Only the point leader's operations bound garbage collection, so this
+        // walk reads the oldest sequence number of each such key and nothing
+        // more.
+        for (keyholder_map_t::iterator it = m_keyholders.begin();
+                it != m_keyholders.end(); it.next())
         {
-            // lookup and check again since we lost/acquired the lock
-            virtual_server_id us = m_daemon->m_config.get_virtual(it->first, m_daemon->m_us);
+            region_id ri(it.key().region);
+            std::map<region_id, uint64_t>::iterator lb = seq_id_lower_bounds.find(ri);
 
-            if (us == virtual_server_id() || !m_daemon->m_config.is_point_leader(us))
+            if (lb == seq_id_lower_bounds.end())
             {
                 continue;
             }
 
-            size_t sz = HYPERDEX_HEADER_SIZE_VV
-                      + sizeof(uint64_t);
+            e::slice key(it.key().key.data(), it.key().key.size());
+            HOLD_LOCK_FOR_KEY(ri, key);
+            e::intrusive_ptr<keyholder> kh = get_keyholder(ri, key);
 
-            for (size_t i = 0; i < cluster_members.size(); ++i)
+            if (!kh || kh->empty())
             {
-                std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-                msg->pack_at(HYPERDEX_HEADER_SIZE_VS) << it->second;
-                m_daemon->m_comm.send(us, cluster_members[i].first, CHAIN_GC, msg);
+                continue;
             }
+
+            lb->second = std::min(lb->second, kh->min_seq_id());
         }
+
+        send_gc_digests(seq_id_lower_bounds);
     }
 
     LOG(INFO) << "retransmitter thread shutting down";
 }
 
+void
+replication_manager :: send_gc_digests(const std::map<region_id, uint64_t>& lower_bounds)
+{
+    const configuration* config = m_daemon->m_config.get();
+    // lookup and check again since we lost/acquired the lock
+    std::vector<std::pair<region_id, uint64_t> > bounds;
+    std::vector<const schema*> bound_spaces;
+    virtual_server_id us;
+
+    for (std::map<region_id, uint64_t>::const_iterator it = lower_bounds.begin();
+            it != lower_bounds.end(); ++it)
+    {
+        virtual_server_id vsi = config->get_virtual(it->first, m_daemon->m_us);
+
+        if (vsi == virtual_server_id() || !config->is_point_leader(vsi))
+        {
+            continue;
+        }
+
+        bounds.push_back(*it);
+        bound_spaces.push_back(config->get_schema(it->first));
+        us = vsi;
+    }
+
+    if (bounds.empty())
+    {
+        return;
+    }
+
+    std::vector<std::pair<server_id, po6::net::location> > cluster_members;
+    config->get_all_addresses(&cluster_members);
+
+    // Acked records for a point leader's ops live on every server with a
+    // region in the same space, and only there.
+    for (size_t i = 0; i < cluster_members.size(); ++i)
+    {
+        std::vector<region_id> regions;
+        config->regions_of(cluster_members[i].first, &regions);
+        std::vector<const schema*> spaces;
+
+        for (size_t j = 0; j < regions.size(); ++j)
+        {
+            spaces.push_back(config->get_schema(regions[j]));
+        }
+
+        std::sort(spaces.begin(), spaces.end());
+        std::vector<std::pair<region_id, uint64_t> > digest;
+
+        for (size_t j = 0; j < bounds.size(); ++j)
+        {
+            if (std::binary_search(spaces.begin(), spaces.end(), bound_spaces[j]))
+            {
+                digest.push_back(bounds[j]);
+            }
+        }
+
+        if (digest.empty())
+        {
+            continue;
+        }
+
+        uint32_t digest_sz = digest.size();
+        size_t sz = HYPERDEX_HEADER_SIZE_VS
+                  + sizeof(uint32_t)
+                  + digest.size() * 2 * sizeof(uint64_t);
+        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VS) << digest_sz;
+
+        for (size_t j = 0; j < digest.size(); ++j)
+        {
+            pa = pa << digest[j].first.get() << digest[j].second;
+        }
+
+        m_daemon->m_comm.send(us, cluster_members[i].first, CHAIN_GC, msg);
+    }
+}
+
 void
 replication_manager :: garbage_collector()
 {
@@ -1224,6 +1485,17 @@ replication_manager :: garbage_collector()
             region_id reg_id = lower_bounds.front().first;
             uint64_t seq_id = lower_bounds.front().second;
 
+            // bounds only grow, so a later digest for this region supersedes
+            // this one and a single pass over its records suffices
+            std::list<std::pair<region_id, uint64_t> >::iterator next = lower_bounds.begin();
+            ++next;
+
+            if (next != lower_bounds.end() && next->first == reg_id)
+            {
+                lower_bounds.pop_front();
+                continue;
+            }
+
             // I chose to use seq_id - 1 for clearing because i'm too tired to check for
             // an off by one.  At worst it'll leave a little extra state laying around,
             // and is guaranteed to be as correct as garbage collecting seq_id.
@@ -30,7 +30,9 @@
 
 // STL
 #include <list>
+#include <map>
 #include <memory>
+#include <string>
 #include <tr1/unordered_map>
 
 // po6
@@ -99,6 +101,16 @@ class replication_manager
                       std::auto_ptr<e::buffer> backing,
                       const e::slice& key,
                       const std::vector<e::slice>& value);
+        // A CHAIN_OP that carries only the attributes which changed since
+        // version - 1; the full value is rebuilt from our copy of that version.
+        void chain_delta(const virtual_server_id& from,
+                         const virtual_server_id& to,
+                         const region_id& reg_id,
+                         uint64_t seq_id,
+                         uint64_t version,
+                         std::auto_ptr<e::buffer> backing,
+                         const e::slice& key,
+                         const std::vector<std::pair<uint16_t, e::slice> >& delta);
         void chain_subspace(const virtual_server_id& from,
                             const virtual_server_id& to,
                             bool retransmission,
@@ -125,6 +137,12 @@ class replication_manager
         class keypair;
         static uint64_t hash(const keypair&);
         typedef e::lockfree_hash_map<keypair, e::intrusive_ptr<keyholder>, hash> keyholder_map_t;
+        // Keys with committable operations, oldest deadline first.  Every
+        // deadline is the same distance from the moment it was armed, so
+        // appending keeps each region's queue sorted.
+        typedef std::pair<uint64_t, std::string> retransmit_t;
+        typedef std::list<retransmit_t> retransmit_queue_t;
+        typedef std::map<region_id, retransmit_queue_t> retransmit_map_t;
 
     private:
         replication_manager(const replication_manager&);
@@ -158,11 +176,14 @@ class replication_manager
                                             const schema& sc,
                                             const e::slice& key,
                                             e::intrusive_ptr<keyholder> kh);
+        // If base is the value of version - 1 and the next hop is known to
+        // hold it, a CHAIN_OP may carry only the attributes that differ.
         void send_message(const virtual_server_id& us,
                           bool retransmission,
                           uint64_t version,
                           const e::slice& key,
-                          e::intrusive_ptr<pending> op);
+                          e::intrusive_ptr<pending> op,
+                          const std::vector<e::slice>* base);
         bool send_ack(const virtual_server_id& us,
                       const virtual_server_id& to,
                       bool retransmission,
@@ -174,6 +195,17 @@ class replication_manager
                                const server_id& client,
                                uint64_t nonce,
                                network_returncode ret);
+        // Queue the key for a retransmission check unless it already is.
+        // The caller must hold the key's lock.
+        void arm_retransmit(const region_id& ri,
+                            const e::slice& key,
+                            e::intrusive_ptr<keyholder> kh);
+        // Take the keys whose deadline has passed (or every key, if all is
+        // set), leaving alone regions blocked by a live transfer.
+        void take_due_retransmits(const configuration* config, bool all,
+                                  std::vector<std::pair<region_id, retransmit_t> >* due);
+        // send each server one CHAIN_GC with the bounds it cares about
+        void send_gc_digests(const std::map<region_id, uint64_t>& lower_bounds);
         // thread functions
         void retransmitter();
         void garbage_collector();
@@ -196,6 +228,8 @@ class replication_manager
         bool m_need_pause;
         bool m_paused_retransmitter;
         bool m_paused_garbage_collector;
+        po6::threads::mutex m_retransmit_lock;
+        retransmit_map_t m_retransmit_queues;
 };
 
 } // namespace hyperdex
@@ -42,6 +42,7 @@ replication_manager :: keyholder :: keyholder()
     , m_old_value()
     , m_old_disk_ref()
     , m_old_backing()
+    , m_retransmit_deadline(0)
 {
 }
 
@@ -332,14 +333,16 @@ replication_manager :: keyholder :: resend_committable(replication_manager* rm,
     for (committable_list_t::iterator it = m_committable.begin();
             it != m_committable.end(); ++it)
     {
-        // skip those messages already sent in this version
-        if (it->second->sent_config_version == rm->m_daemon->m_config.version())
+        // skip those messages already sent in this version, unless they went
+        // as a delta the next hop may not have been able to apply
+        if (it->second->sent_config_version == rm->m_daemon->m_config->version() &&
+            !it->second->sent_delta)
         {
             continue;
         }
 
         it->second->sent = virtual_server_id();
         it->second->sent_config_version = 0;
-        rm->send_message(us, true, it->first, key, it->second);
+        rm->send_message(us, true, it->first, key, it->second, NULL);
     }
 }
@@ -87,6 +87,9 @@ class hyperdex::replication_manager::keyholder
         uint64_t& get_old_version() { return m_old_version; }
         std::vector<e::slice>& get_old_value() { return m_old_value; }
         datalayer::reference& get_old_disk_ref() { return m_old_disk_ref; }
+        // deadline of the key's entry in the retransmission queue; zero when
+        // it has none (entries that don't match are stale)
+        uint64_t& get_retransmit_deadline() { return m_retransmit_deadline; }
 
     private:
         typedef std::list<std::pair<uint64_t, e::intrusive_ptr<pending> > >
@@ -111,6 +114,7 @@ class hyperdex::replication_manager::keyholder
         std::vector<e::slice> m_old_value;
         datalayer::reference m_old_disk_ref;
         std::tr1::shared_ptr<e::buffer> m_old_backing;
+        uint64_t m_retransmit_deadline;
 };
 
 #endif // hyperdex_daemon_replication_manager_keyholder_h_
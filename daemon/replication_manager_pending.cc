@@ -47,6 +47,7 @@ replication_manager :: pending :: pending(std::tr1::shared_ptr<e::buffer> _backi
     , recv(_recv)
     , sent_config_version(0)
     , sent()
+    , sent_delta(false)
     , fresh(_fresh)
     , acked(false)
     , client()
@@ -78,6 +79,7 @@ replication_manager :: pending :: pending(std::tr1::shared_ptr<e::buffer> _backi
     , recv()
     , sent_config_version(0)
     , sent()
+    , sent_delta(false)
     , fresh(_fresh)
     , acked(false)
     , client(_client)
@@ -65,6 +65,7 @@ class hyperdex::replication_manager::pending
         virtual_server_id recv; // we recv from here
         uint64_t sent_config_version;
         virtual_server_id sent; // we sent to here
+        bool sent_delta; // only the attributes that changed were sent
         bool fresh;
         bool acked;
         server_id client;
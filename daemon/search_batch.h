@@ -0,0 +1,63 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_search_batch_h_
+#define hyperdex_daemon_search_batch_h_
+
+// C
+#include <stdint.h>
+#include <stddef.h>
+
+namespace hyperdex
+{
+
+// Tracks how full one RESP_SEARCH_ITEM is.  Both limits are soft:  an empty
+// batch always takes an object, so that a search makes progress no matter
+// how small the client asked its batches to be, and the object that crosses
+// the byte limit stays in the batch.
+class search_batch
+{
+    public:
+        search_batch(uint64_t max_objects, uint64_t max_bytes, size_t header);
+        ~search_batch() throw ();
+
+    public:
+        bool has_room() const;
+        void add(size_t bytes);
+        uint64_t objects() const { return m_objects; }
+        size_t bytes() const { return m_bytes; }
+
+    private:
+        const uint64_t m_max_objects;
+        const uint64_t m_max_bytes;
+        uint64_t m_objects;
+        size_t m_bytes;
+};
+
+} // namespace hyperdex
+
+#endif // hyperdex_daemon_search_batch_h_
@@ -28,7 +28,15 @@
 #define __STDC_LIMIT_MACROS
 
 // STL
+#include <algorithm>
+#include <list>
+#include <map>
 #include <sstream>
+#include <string>
+#include <tr1/functional>
+
+// POSIX
+#include <signal.h>
 
 // Google Log
 #include <glog/logging.h>
@@ -37,15 +45,32 @@
 #include <e/time.h>
 
 // HyperDex
+#include "common/aggregate.h"
 #include "common/attribute_check.h"
 #include "common/serialization.h"
 #include "daemon/daemon.h"
+#include "daemon/search_batch.h"
 #include "daemon/search_manager.h"
 #include "datatypes/compare.h"
 
 using hyperdex::search_manager;
 using hyperdex::reconfigure_returncode;
 
+// Upper bounds on the size of a single RESP_SEARCH_ITEM batch.  Clients may
+// ask for less, but never for more.
+#define SEARCH_BATCH_MAX_OBJECTS 4096
+#define SEARCH_BATCH_MAX_BYTES (16 * 1024 * 1024)
+
+// Number of threads that run full-snapshot scans (sorted_search, group_keyop,
+// count, search_describe) off of the network threads.
+#define SEARCH_SCAN_THREADS 2
+
+// Scans waiting for a scan thread.  Each holds its request and checks until a
+// scan thread picks it up, so 256 keeps a burst of scans from growing the
+// queue without bound.  Beyond this, new scans are answered with SERVERBUSY,
+// which clients report as HYPERCLIENT_SERVERERROR so callers can back off.
+#define SEARCH_MAX_QUEUED_SCANS 256
+
 /////////////////////////////// Search Manager ID //////////////////////////////
 
 class search_manager::id
@@ -108,7 +133,10 @@ class search_manager::state
     public:
         state(const region_id& region,
               std::auto_ptr<e::buffer> msg,
-              std::vector<attribute_check>* checks);
+              std::vector<attribute_check>* checks,
+              uint64_t batch_objects,
+              uint64_t batch_bytes,
+              const projection& proj);
         ~state() throw ();
 
     public:
@@ -117,6 +145,9 @@ class search_manager::state
         const std::auto_ptr<e::buffer> backing;
         std::vector<attribute_check> checks;
         datalayer::snapshot snap;
+        const uint64_t batch_objects;
+        const uint64_t batch_bytes;
+        const projection proj;
 
     private:
         friend class e::intrusive_ptr<state>;
@@ -131,12 +162,18 @@ class search_manager::state
 
 search_manager :: state :: state(const region_id& r,
                                  std::auto_ptr<e::buffer> msg,
-                                 std::vector<attribute_check>* c)
+                                 std::vector<attribute_check>* c,
+                                 uint64_t bo,
+                                 uint64_t bb,
+                                 const projection& p)
     : lock()
     , region(r)
     , backing(msg)
     , checks()
     , snap()
+    , batch_objects(bo)
+    , batch_bytes(bb)
+    , proj(p)
     , m_ref(0)
 {
     checks.swap(*c);
@@ -146,27 +183,152 @@ search_manager :: state :: ~state() throw ()
 {
 }
 
+///////////////////////////// Search Manager Scan //////////////////////////////
+
+class search_manager::scan
+{
+    public:
+        enum scan_t { SORTED_SEARCH, GROUP_KEYOP, COUNT, SEARCH_DESCRIBE, AGGREGATE };
+
+    public:
+        scan(scan_t type,
+             const server_id& from,
+             const virtual_server_id& to,
+             std::auto_ptr<e::buffer> msg,
+             uint64_t nonce,
+             std::vector<attribute_check>* checks);
+        ~scan() throw ();
+
+    public:
+        const scan_t type;
+        const server_id from;
+        const virtual_server_id to;
+        const std::auto_ptr<e::buffer> backing;
+        const uint64_t nonce;
+        std::vector<attribute_check> checks;
+        // SORTED_SEARCH
+        uint64_t limit;
+        uint16_t sort_by;
+        bool maximize;
+        projection proj;
+        // GROUP_KEYOP
+        network_msgtype mt;
+        e::slice remain;
+        network_msgtype resp;
+        // COUNT
+        bool approximate;
+        // AGGREGATE
+        bool grouped;
+        uint16_t group_by;
+        std::vector<uint16_t> attrs;
+
+    private:
+        friend class e::intrusive_ptr<scan>;
+
+    private:
+        void inc() { __sync_add_and_fetch(&m_ref, 1); }
+        void dec() { if (__sync_sub_and_fetch(&m_ref, 1) == 0) delete this; }
+
+    private:
+        size_t m_ref;
+};
+
+search_manager :: scan :: scan(scan_t t,
+                               const server_id& f,
+                               const virtual_server_id& vt,
+                               std::auto_ptr<e::buffer> msg,
+                               uint64_t n,
+                               std::vector<attribute_check>* c)
+    : type(t)
+    , from(f)
+    , to(vt)
+    , backing(msg)
+    , nonce(n)
+    , checks()
+    , limit(0)
+    , sort_by(0)
+    , maximize(false)
+    , proj()
+    , mt(PACKET_NOP)
+    , remain()
+    , resp(PACKET_NOP)
+    , approximate(false)
+    , grouped(false)
+    , group_by(0)
+    , attrs()
+    , m_ref(0)
+{
+    checks.swap(*c);
+}
+
+search_manager :: scan :: ~scan() throw ()
+{
+}
+
 //////////////////////////////// Search Manager ////////////////////////////////
 
 search_manager :: search_manager(daemon* d)
     : m_daemon(d)
     , m_searches(10)
+    , m_scanners()
+    , m_block_scanners()
+    , m_wakeup_scanners(&m_block_scanners)
+    , m_wakeup_reconfigurer(&m_block_scanners)
+    , m_scans()
+    , m_scanning(0)
+    , m_shutdown(true)
+    , m_need_pause(false)
 {
 }
 
 search_manager :: ~search_manager() throw ()
 {
+    shutdown();
 }
 
 bool
 search_manager :: setup()
 {
+    po6::threads::mutex::hold hold(&m_block_scanners);
+
+    for (size_t i = 0; i < SEARCH_SCAN_THREADS; ++i)
+    {
+        std::tr1::shared_ptr<po6::threads::thread> t(new po6::threads::thread(std::tr1::bind(&search_manager::scanner, this)));
+        m_scanners.push_back(t);
+        t->start();
+    }
+
+    m_shutdown = false;
     return true;
 }
 
 void
 search_manager :: teardown()
 {
+    shutdown();
+    m_scans.clear();
+}
+
+void
+search_manager :: pause()
+{
+    po6::threads::mutex::hold hold(&m_block_scanners);
+    assert(!m_need_pause);
+    m_need_pause = true;
+
+    while (m_scanning > 0)
+    {
+        m_wakeup_reconfigurer.wait();
+    }
+}
+
+void
+search_manager :: unpause()
+{
+    po6::threads::mutex::hold hold(&m_block_scanners);
+    assert(m_need_pause);
+    m_wakeup_scanners.broadcast();
+    m_need_pause = false;
 }
 
 void
@@ -183,9 +345,13 @@ search_manager :: start(const server_id& from,
                         std::auto_ptr<e::buffer> msg,
                         uint64_t nonce,
                         uint64_t search_id,
-                        std::vector<attribute_check>* checks)
+                        std::vector<attribute_check>* checks,
+                        uint64_t batch_objects,
+                        uint64_t batch_bytes,
+                        const projection& proj)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
+    const configuration* config = m_daemon->m_config.get();
+    region_id ri(config->get_region_id(to));
     id sid(ri, from, search_id);
 
     if (m_searches.contains(sid))
@@ -195,9 +361,20 @@ search_manager :: start(const server_id& from,
         return;
     }
 
-    const schema* sc = m_daemon->m_config.get_schema(ri);
+    const schema* sc = config->get_schema(ri);
     assert(sc);
-    e::intrusive_ptr<state> st = new state(ri, msg, checks);
+
+    if (!proj.validate(*sc))
+    {
+        LOG(WARNING) << "received request for search " << search_id << " from client "
+                     << from << " with an invalid projection";
+        return;
+    }
+
+    batch_objects = std::max(static_cast<uint64_t>(1), batch_objects);
+    batch_objects = std::min(static_cast<uint64_t>(SEARCH_BATCH_MAX_OBJECTS), batch_objects);
+    batch_bytes = std::min(static_cast<uint64_t>(SEARCH_BATCH_MAX_BYTES), batch_bytes);
+    e::intrusive_ptr<state> st = new state(ri, msg, checks, batch_objects, batch_bytes, proj);
     datalayer::returncode rc;
     std::stable_sort(st->checks.begin(), st->checks.end());
     rc = m_daemon->m_data.make_snapshot(st->region, *sc, &st->checks, &st->snap, NULL);
@@ -218,6 +395,11 @@ search_manager :: start(const server_id& from,
             abort();
     }
 
+    if (proj.keys_only())
+    {
+        st->snap.keys_only();
+    }
+
     m_searches.insert(sid, st);
     next(from, to, nonce, search_id);
 }
@@ -228,7 +410,7 @@ search_manager :: next(const server_id& from,
                        uint64_t nonce,
                        uint64_t search_id)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
+    region_id ri(m_daemon->m_config->get_region_id(to));
     id sid(ri, from, search_id);
     e::intrusive_ptr<state> st;
 
@@ -242,28 +424,48 @@ search_manager :: next(const server_id& from,
 
     po6::threads::mutex::hold hold(&st->lock);
 
-    if (st->snap.valid())
+    if (!st->snap.valid())
+    {
+        std::auto_ptr<e::buffer> msg(e::buffer::create(HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t)));
+        msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce;
+        m_daemon->m_comm.send_client(to, from, RESP_SEARCH_DONE, msg);
+        stop(from, to, search_id);
+        return;
+    }
+
+    // Fill one batch
+    std::list<datalayer::reference> refs;
+    std::vector<e::slice> keys;
+    std::vector<std::vector<e::slice> > vals;
+    search_batch batch(st->batch_objects, st->batch_bytes,
+                       HYPERDEX_HEADER_SIZE_VC
+                       + sizeof(uint64_t)
+                       + sizeof(uint64_t));
+
+    while (st->snap.valid() && batch.has_room())
     {
         e::slice key;
         std::vector<e::slice> val;
         uint64_t ver;
-        st->snap.unpack(&key, &val, &ver);
-        size_t sz = HYPERDEX_HEADER_SIZE_VC
-                  + sizeof(uint64_t)
-                  + pack_size(key)
-                  + pack_size(val);
-        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-        msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << key << val;
-        m_daemon->m_comm.send_client(to, from, RESP_SEARCH_ITEM, msg);
+        refs.push_back(datalayer::reference());
+        st->snap.unpack(&key, &val, &ver, &refs.back());
+        keys.push_back(key);
+        vals.push_back(std::vector<e::slice>());
+        st->proj.apply(val, &vals.back());
+        batch.add(pack_size(key) + pack_size(vals.back()));
         st->snap.next();
     }
-    else
+
+    std::auto_ptr<e::buffer> msg(e::buffer::create(batch.bytes()));
+    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
+    pa = pa << nonce << static_cast<uint64_t>(keys.size());
+
+    for (size_t i = 0; i < keys.size(); ++i)
     {
-        std::auto_ptr<e::buffer> msg(e::buffer::create(HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t)));
-        msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce;
-        m_daemon->m_comm.send_client(to, from, RESP_SEARCH_DONE, msg);
-        stop(from, to, search_id);
+        pa = pa << keys[i] << vals[i];
     }
+
+    m_daemon->m_comm.send_client(to, from, RESP_SEARCH_ITEM, msg);
 }
 
 void
@@ -271,11 +473,88 @@ search_manager :: stop(const server_id& from,
                        const virtual_server_id& to,
                        uint64_t search_id)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
+    region_id ri(m_daemon->m_config->get_region_id(to));
     id sid(ri, from, search_id);
     m_searches.remove(sid);
 }
 
+void
+search_manager :: sorted_search(const server_id& from,
+                                const virtual_server_id& to,
+                                std::auto_ptr<e::buffer> msg,
+                                uint64_t nonce,
+                                std::vector<attribute_check>* checks,
+                                uint64_t limit,
+                                uint16_t sort_by,
+                                bool maximize,
+                                const projection& proj)
+{
+    e::intrusive_ptr<scan> s = new scan(scan::SORTED_SEARCH, from, to, msg, nonce, checks);
+    s->limit = limit;
+    s->sort_by = sort_by;
+    s->maximize = maximize;
+    s->proj = proj;
+    enqueue(s);
+}
+
+void
+search_manager :: group_keyop(const server_id& from,
+                              const virtual_server_id& to,
+                              std::auto_ptr<e::buffer> msg,
+                              uint64_t nonce,
+                              std::vector<attribute_check>* checks,
+                              network_msgtype mt,
+                              const e::slice& remain,
+                              network_msgtype resp)
+{
+    e::intrusive_ptr<scan> s = new scan(scan::GROUP_KEYOP, from, to, msg, nonce, checks);
+    s->mt = mt;
+    s->remain = remain;
+    s->resp = resp;
+    enqueue(s);
+}
+
+void
+search_manager :: count(const server_id& from,
+                        const virtual_server_id& to,
+                        std::auto_ptr<e::buffer> msg,
+                        uint64_t nonce,
+                        std::vector<attribute_check>* checks,
+                        bool approximate)
+{
+    e::intrusive_ptr<scan> s = new scan(scan::COUNT, from, to, msg, nonce, checks);
+    s->approximate = approximate;
+    enqueue(s);
+}
+
+void
+search_manager :: search_describe(const server_id& from,
+                                  const virtual_server_id& to,
+                                  std::auto_ptr<e::buffer> msg,
+                                  uint64_t nonce,
+                                  std::vector<attribute_check>* checks)
+{
+    e::intrusive_ptr<scan> s = new scan(scan::SEARCH_DESCRIBE, from, to, msg, nonce, checks);
+    enqueue(s);
+}
+
+void
+search_manager :: aggregate(const server_id& from,
+                            const virtual_server_id& to,
+                            std::auto_ptr<e::buffer> msg,
+                            uint64_t nonce,
+                            std::vector<attribute_check>* checks,
+                            bool grouped,
+                            uint16_t group_by,
+                            std::vector<uint16_t>* attrs)
+{
+    e::intrusive_ptr<scan> s = new scan(scan::AGGREGATE, from, to, msg, nonce, checks);
+    s->grouped = grouped;
+    s->group_by = group_by;
+    s->attrs.swap(*attrs);
+    enqueue(s);
+}
+
 namespace hyperdex
 {
 
@@ -400,21 +679,31 @@ operator > (const _sorted_search_item& lhs, const _sorted_search_item& rhs)
 } // namespace hyperdex
 
 void
-search_manager :: sorted_search(const server_id& from,
-                                const virtual_server_id& to,
-                                uint64_t nonce,
-                                std::vector<attribute_check>* checks,
-                                uint64_t limit,
-                                uint16_t sort_by,
-                                bool maximize)
+search_manager :: perform_sorted_search(scan* s)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema* sc = m_daemon->m_config.get_schema(ri);
+    const configuration* config = m_daemon->m_config.get();
+    const server_id& from(s->from);
+    const virtual_server_id& to(s->to);
+    uint64_t nonce = s->nonce;
+    std::vector<attribute_check>* checks = &s->checks;
+    uint64_t limit = s->limit;
+    uint16_t sort_by = s->sort_by;
+    bool maximize = s->maximize;
+    region_id ri(config->get_region_id(to));
+    const schema* sc = config->get_schema(ri);
     assert(sc);
     datalayer::snapshot snap;
     datalayer::returncode rc;
     std::stable_sort(checks->begin(), checks->end());
-    rc = m_daemon->m_data.make_snapshot(m_daemon->m_config.get_region_id(to), *sc, checks, &snap, NULL);
+    // When sort_by is indexed here, walk its index in the requested order so
+    // that the first "limit" matches are the answer.
+    rc = m_daemon->m_data.make_sorted_snapshot(ri, *sc, checks, sort_by, maximize, &snap);
+    bool ordered = rc == datalayer::SUCCESS;
+
+    if (!ordered)
+    {
+        rc = m_daemon->m_data.make_snapshot(ri, *sc, checks, &snap, NULL);
+    }
 
     switch (rc)
     {
@@ -436,11 +725,20 @@ search_manager :: sorted_search(const server_id& from,
     std::vector<_sorted_search_item> top_n;
     top_n.reserve(limit);
 
-    while (snap.valid())
+    while ((!ordered || top_n.size() < limit) && snap.valid())
     {
+        if (!checkpoint(ri, &config, &params.sc))
+        {
+            return;
+        }
+
         top_n.push_back(_sorted_search_item(&params));
         snap.unpack(&top_n.back().key, &top_n.back().value, &top_n.back().version, &top_n.back().ref);
-        std::push_heap(top_n.begin(), top_n.end());
+
+        if (!ordered)
+        {
+            std::push_heap(top_n.begin(), top_n.end());
+        }
 
         if (top_n.size() > limit)
         {
@@ -452,11 +750,20 @@ search_manager :: sorted_search(const server_id& from,
     }
 
     std::sort(top_n.begin(), top_n.end(), std::greater<_sorted_search_item>());
+
+    if (!s->proj.validate(*params.sc))
+    {
+        LOG(WARNING) << "sorted search from client " << from << " has an invalid projection";
+        top_n.clear();
+    }
+
+    std::vector<std::vector<e::slice> > vals(top_n.size());
     size_t sz = HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t) + sizeof(uint64_t);
 
     for (size_t i = 0; i < top_n.size(); ++i)
     {
-        sz += pack_size(top_n[i].key) + pack_size(top_n[i].value);
+        s->proj.apply(top_n[i].value, &vals[i]);
+        sz += pack_size(top_n[i].key) + pack_size(vals[i]);
     }
 
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
@@ -465,28 +772,30 @@ search_manager :: sorted_search(const server_id& from,
 
     for (size_t i = 0; i < top_n.size(); ++i)
     {
-        pa = pa << top_n[i].key << top_n[i].value;
+        pa = pa << top_n[i].key << vals[i];
     }
 
     m_daemon->m_comm.send_client(to, from, RESP_SORTED_SEARCH, msg);
 }
 
 void
-search_manager :: group_keyop(const server_id& from,
-                              const virtual_server_id& to,
-                              uint64_t nonce,
-                              std::vector<attribute_check>* checks,
-                              network_msgtype mt,
-                              const e::slice& remain,
-                              network_msgtype resp)
+search_manager :: perform_group_keyop(scan* s)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema* sc = m_daemon->m_config.get_schema(ri);
+    const configuration* config = m_daemon->m_config.get();
+    const server_id& from(s->from);
+    const virtual_server_id& to(s->to);
+    uint64_t nonce = s->nonce;
+    std::vector<attribute_check>* checks = &s->checks;
+    network_msgtype mt = s->mt;
+    const e::slice& remain(s->remain);
+    network_msgtype resp = s->resp;
+    region_id ri(config->get_region_id(to));
+    const schema* sc = config->get_schema(ri);
     assert(sc);
     datalayer::snapshot snap;
     datalayer::returncode rc;
     std::stable_sort(checks->begin(), checks->end());
-    rc = m_daemon->m_data.make_snapshot(m_daemon->m_config.get_region_id(to), *sc, checks, &snap, NULL);
+    rc = m_daemon->m_data.make_snapshot(config->get_region_id(to), *sc, checks, &snap, NULL);
     uint64_t result = 0;
 
     switch (rc)
@@ -508,6 +817,11 @@ search_manager :: group_keyop(const server_id& from,
 
     while (snap.valid() && result < UINT64_MAX)
     {
+        if (!checkpoint(ri, &config, &sc))
+        {
+            return;
+        }
+
         e::slice key;
         std::vector<e::slice> val;
         uint64_t ver;
@@ -520,7 +834,7 @@ search_manager :: group_keyop(const server_id& from,
         e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_SV);
         pa = pa << static_cast<uint64_t>(0) << key;
         pa = pa.copy(remain);
-        virtual_server_id vsi = m_daemon->m_config.point_leader(ri, key);
+        virtual_server_id vsi = config->point_leader(ri, key);
 
         if (vsi != virtual_server_id())
         {
@@ -543,20 +857,32 @@ search_manager :: group_keyop(const server_id& from,
 }
 
 void
-search_manager :: count(const server_id& from,
-                        const virtual_server_id& to,
-                        uint64_t nonce,
-                        std::vector<attribute_check>* checks)
+search_manager :: perform_count(scan* s)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema* sc = m_daemon->m_config.get_schema(ri);
+    const configuration* config = m_daemon->m_config.get();
+    const server_id& from(s->from);
+    const virtual_server_id& to(s->to);
+    uint64_t nonce = s->nonce;
+    std::vector<attribute_check>* checks = &s->checks;
+    region_id ri(config->get_region_id(to));
+    const schema* sc = config->get_schema(ri);
     assert(sc);
     datalayer::snapshot snap;
     datalayer::returncode rc;
     std::stable_sort(checks->begin(), checks->end());
-    rc = m_daemon->m_data.make_snapshot(m_daemon->m_config.get_region_id(to), *sc, checks, &snap, NULL);
     uint64_t result = 0;
 
+    if (s->approximate)
+    {
+        rc = m_daemon->m_data.approximate_count(ri, *sc, checks, &result);
+    }
+    else
+    {
+        rc = m_daemon->m_data.make_snapshot(ri, *sc, checks, &snap, NULL);
+        // only keys are counted, so covered ranges never touch the objects
+        snap.keys_only();
+    }
+
     switch (rc)
     {
         case datalayer::SUCCESS:
@@ -574,8 +900,13 @@ search_manager :: count(const server_id& from,
             abort();
     }
 
-    while (snap.valid() && result < UINT64_MAX)
+    while (!s->approximate && snap.valid() && result < UINT64_MAX)
     {
+        if (!checkpoint(ri, &config, &sc))
+        {
+            return;
+        }
+
         ++result;
         snap.next();
     }
@@ -589,13 +920,15 @@ search_manager :: count(const server_id& from,
 }
 
 void
-search_manager :: search_describe(const server_id& from,
-                                  const virtual_server_id& to,
-                                  uint64_t nonce,
-                                  std::vector<attribute_check>* checks)
+search_manager :: perform_search_describe(scan* s)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema* sc = m_daemon->m_config.get_schema(ri);
+    const configuration* config = m_daemon->m_config.get();
+    const server_id& from(s->from);
+    const virtual_server_id& to(s->to);
+    uint64_t nonce = s->nonce;
+    std::vector<attribute_check>* checks = &s->checks;
+    region_id ri(config->get_region_id(to));
+    const schema* sc = config->get_schema(ri);
     assert(sc);
     datalayer::snapshot snap;
     datalayer::returncode rc;
@@ -603,7 +936,7 @@ search_manager :: search_describe(const server_id& from,
     std::ostringstream ostr;
     ostr << "search\n";
     uint64_t t_start = e::time();
-    rc = m_daemon->m_data.make_snapshot(m_daemon->m_config.get_region_id(to), *sc, checks, &snap, &ostr);
+    rc = m_daemon->m_data.make_snapshot(config->get_region_id(to), *sc, checks, &snap, &ostr);
     uint64_t t_end = e::time();
     ostr << " snapshot took " << t_end - t_start << "ns\n";
 
@@ -628,6 +961,11 @@ search_manager :: search_describe(const server_id& from,
 
     while (snap.valid())
     {
+        if (!checkpoint(ri, &config, &sc))
+        {
+            return;
+        }
+
         ++num;
         snap.next();
     }
@@ -646,8 +984,280 @@ search_manager :: search_describe(const server_id& from,
     m_daemon->m_comm.send_client(to, from, RESP_SEARCH_DESCRIBE, msg);
 }
 
+void
+search_manager :: perform_aggregate(scan* s)
+{
+    const configuration* config = m_daemon->m_config.get();
+    const server_id& from(s->from);
+    const virtual_server_id& to(s->to);
+    uint64_t nonce = s->nonce;
+    std::vector<attribute_check>* checks = &s->checks;
+    const std::vector<uint16_t>& attrs(s->attrs);
+    region_id ri(config->get_region_id(to));
+    const schema* sc = config->get_schema(ri);
+    assert(sc);
+    datalayer::snapshot snap;
+    datalayer::returncode rc;
+    std::stable_sort(checks->begin(), checks->end());
+    rc = m_daemon->m_data.make_snapshot(ri, *sc, checks, &snap, NULL);
+    bool failed = false;
+
+    switch (rc)
+    {
+        case datalayer::SUCCESS:
+            break;
+        case datalayer::NOT_FOUND:
+        case datalayer::BAD_ENCODING:
+        case datalayer::BAD_SEARCH:
+        case datalayer::CORRUPTION:
+        case datalayer::IO_ERROR:
+        case datalayer::LEVELDB_ERROR:
+            LOG(ERROR) << "could not make snapshot for search:  " << rc;
+            failed = true;
+            break;
+        default:
+            abort();
+    }
+
+    failed = failed || (s->grouped && s->group_by >= sc->attrs_sz);
+
+    for (size_t i = 0; i < attrs.size(); ++i)
+    {
+        failed = failed || attrs[i] == 0 || attrs[i] >= sc->attrs_sz ||
+                 (sc->attrs[attrs[i]].type != HYPERDATATYPE_INT64 &&
+                  sc->attrs[attrs[i]].type != HYPERDATATYPE_FLOAT);
+    }
+
+    // group value -> (objects in the group, one stat per attribute)
+    typedef std::map<std::string, std::pair<uint64_t, std::vector<aggregate_stat> > > group_map_t;
+    group_map_t groups;
+
+    while (!failed && snap.valid())
+    {
+        if (!checkpoint(ri, &config, &sc))
+        {
+            return;
+        }
+
+        e::slice key;
+        std::vector<e::slice> val;
+        uint64_t ver;
+        snap.unpack(&key, &val, &ver);
+
+        if (val.size() + 1 != sc->attrs_sz)
+        {
+            snap.next();
+            continue;
+        }
+
+        std::string group;
+
+        if (s->grouped)
+        {
+            const e::slice& g(s->group_by == 0 ? key : val[s->group_by - 1]);
+            group.assign(reinterpret_cast<const char*>(g.data()), g.size());
+        }
+
+        std::pair<uint64_t, std::vector<aggregate_stat> >& grp(groups[group]);
+        grp.second.resize(attrs.size());
+        ++grp.first;
+
+        for (size_t i = 0; i < attrs.size(); ++i)
+        {
+            grp.second[i].add(sc->attrs[attrs[i]].type, val[attrs[i] - 1]);
+        }
+
+        snap.next();
+    }
+
+    // A region that cannot be aggregated reports UINT64_MAX groups, so the
+    // client fails the whole aggregate rather than return a partial answer.
+    uint64_t num_groups = failed ? UINT64_MAX : groups.size();
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t)
+              + sizeof(uint64_t);
+
+    for (group_map_t::iterator it = groups.begin(); it != groups.end(); ++it)
+    {
+        sz += sizeof(uint32_t) + it->first.size()
+            + sizeof(uint64_t)
+            + attrs.size() * pack_size(aggregate_stat());
+    }
+
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
+    pa = pa << nonce << num_groups;
+
+    for (group_map_t::iterator it = groups.begin(); it != groups.end(); ++it)
+    {
+        pa = pa << e::slice(it->first.data(), it->first.size()) << it->second.first;
+
+        for (size_t i = 0; i < it->second.second.size(); ++i)
+        {
+            pa = pa << it->second.second[i];
+        }
+    }
+
+    m_daemon->m_comm.send_client(to, from, RESP_AGGREGATE, msg);
+}
+
 uint64_t
 search_manager :: hash(const id& sid)
 {
     return sid.region.get() + sid.client.get() + sid.search_id;
 }
+
+void
+search_manager :: enqueue(e::intrusive_ptr<scan> s)
+{
+    {
+        po6::threads::mutex::hold hold(&m_block_scanners);
+
+        if (m_scans.size() < SEARCH_MAX_QUEUED_SCANS)
+        {
+            m_scans.push_back(s);
+            m_wakeup_scanners.signal();
+            return;
+        }
+    }
+
+    LOG(WARNING) << "rejecting scan from client " << s->from
+                 << " because " << SEARCH_MAX_QUEUED_SCANS
+                 << " scans are already queued";
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << s->nonce;
+    m_daemon->m_comm.send_client(s->to, s->from, SERVERBUSY, msg);
+}
+
+void
+search_manager :: scanner()
+{
+    LOG(INFO) << "search scan thread started";
+    sigset_t ss;
+
+    if (sigfillset(&ss) < 0)
+    {
+        PLOG(ERROR) << "sigfillset";
+        return;
+    }
+
+    if (pthread_sigmask(SIG_BLOCK, &ss, NULL) < 0)
+    {
+        PLOG(ERROR) << "could not block signals";
+        return;
+    }
+
+    while (true)
+    {
+        e::intrusive_ptr<scan> s;
+
+        {
+            po6::threads::mutex::hold hold(&m_block_scanners);
+
+            while (!m_shutdown && (m_scans.empty() || m_need_pause))
+            {
+                m_wakeup_scanners.wait();
+            }
+
+            if (m_shutdown)
+            {
+                break;
+            }
+
+            s = m_scans.front();
+            m_scans.pop_front();
+            ++m_scanning;
+        }
+
+        switch (s->type)
+        {
+            case scan::SORTED_SEARCH:
+                perform_sorted_search(s.get());
+                break;
+            case scan::GROUP_KEYOP:
+                perform_group_keyop(s.get());
+                break;
+            case scan::COUNT:
+                perform_count(s.get());
+                break;
+            case scan::SEARCH_DESCRIBE:
+                perform_search_describe(s.get());
+                break;
+            case scan::AGGREGATE:
+                perform_aggregate(s.get());
+                break;
+            default:
+                abort();
+        }
+
+        {
+            po6::threads::mutex::hold hold(&m_block_scanners);
+            --m_scanning;
+
+            if (m_need_pause)
+            {
+                m_wakeup_reconfigurer.signal();
+            }
+        }
+    }
+
+    LOG(INFO) << "search scan thread shutting down";
+}
+
+void
+search_manager :: shutdown()
+{
+    bool is_shutdown;
+
+    {
+        po6::threads::mutex::hold hold(&m_block_scanners);
+        m_wakeup_scanners.broadcast();
+        is_shutdown = m_shutdown;
+        m_shutdown = true;
+    }
+
+    if (!is_shutdown)
+    {
+        for (size_t i = 0; i < m_scanners.size(); ++i)
+        {
+            m_scanners[i]->join();
+        }
+    }
+}
+
+bool
+search_manager :: checkpoint(const region_id& ri,
+                             const configuration** config,
+                             const schema** sc)
+{
+    po6::threads::mutex::hold hold(&m_block_scanners);
+
+    if (!m_need_pause && !m_shutdown)
+    {
+        return true;
+    }
+
+    --m_scanning;
+    m_wakeup_reconfigurer.signal();
+
+    while (m_need_pause && !m_shutdown)
+    {
+        m_wakeup_scanners.wait();
+    }
+
+    ++m_scanning;
+
+    if (m_shutdown)
+    {
+        return false;
+    }
+
+    // The configuration changed underneath us, and the one the caller held
+    // may have been reclaimed.  If the region is gone, the client will see
+    // the reconfiguration and fail the operation itself.
+    *config = m_daemon->m_config.get();
+    *sc = (*config)->get_schema(ri);
+    return *sc != NULL;
+}
@@ -28,6 +28,16 @@
 #ifndef hyperdex_daemon_search_manager_h_
 #define hyperdex_daemon_search_manager_h_
 
+// STL
+#include <list>
+#include <tr1/memory>
+#include <vector>
+
+// po6
+#include <po6/threads/cond.h>
+#include <po6/threads/mutex.h>
+#include <po6/threads/thread.h>
+
 // e
 #include <e/intrusive_ptr.h>
 #include <e/lockfree_hash_map.h>
@@ -35,6 +45,7 @@
 // HyperDex
 #include "common/ids.h"
 #include "common/network_msgtype.h"
+#include "common/projection.h"
 #include "daemon/datalayer.h"
 #include "daemon/reconfigure_returncode.h"
 
@@ -52,6 +63,9 @@ class search_manager
     public:
         bool setup();
         void teardown();
+        // pause blocks until no scan is in progress
+        void pause();
+        void unpause();
         void reconfigure(const configuration& old_config,
                          const configuration& new_config,
                          const server_id& us);
@@ -62,7 +76,10 @@ class search_manager
                    std::auto_ptr<e::buffer> msg,
                    uint64_t nonce,
                    uint64_t search_id,
-                   std::vector<attribute_check>* checks);
+                   std::vector<attribute_check>* checks,
+                   uint64_t batch_objects,
+                   uint64_t batch_bytes,
+                   const projection& proj);
         void next(const server_id& from,
                   const virtual_server_id& to,
                   uint64_t nonce,
@@ -70,32 +87,53 @@ class search_manager
         void stop(const server_id& from,
                   const virtual_server_id& to,
                   uint64_t search_id);
+    // These scan the whole snapshot, so they are queued for the scan threads
+    // rather than run on the network thread that received them.
+    public:
         void sorted_search(const server_id& from,
                            const virtual_server_id& to,
+                           std::auto_ptr<e::buffer> msg,
                            uint64_t nonce,
                            std::vector<attribute_check>* checks,
                            uint64_t limit,
                            uint16_t sort_by,
-                           bool maximize);
+                           bool maximize,
+                           const projection& proj);
         void group_keyop(const server_id& from,
                          const virtual_server_id& to,
+                         std::auto_ptr<e::buffer> msg,
                          uint64_t nonce,
                          std::vector<attribute_check>* checks,
                          network_msgtype mt,
                          const e::slice& remain,
                          network_msgtype resp);
+        // if approximate, estimate the count from a sample of the region
         void count(const server_id& from,
                    const virtual_server_id& to,
+                   std::auto_ptr<e::buffer> msg,
                    uint64_t nonce,
-                   std::vector<attribute_check>* checks);
+                   std::vector<attribute_check>* checks,
+                   bool approximate);
         void search_describe(const server_id& from,
                              const virtual_server_id& to,
+                             std::auto_ptr<e::buffer> msg,
                              uint64_t nonce,
                              std::vector<attribute_check>* checks);
+        // count, sum, min and max of attrs over the matching objects, split
+        // by the value of group_by if grouped
+        void aggregate(const server_id& from,
+                       const virtual_server_id& to,
+                       std::auto_ptr<e::buffer> msg,
+                       uint64_t nonce,
+                       std::vector<attribute_check>* checks,
+                       bool grouped,
+                       uint16_t group_by,
+                       std::vector<uint16_t>* attrs);
 
     private:
         class id;
         class state;
+        class scan;
 
     private:
         search_manager(const search_manager&);
@@ -103,10 +141,31 @@ class search_manager
 
     private:
         static uint64_t hash(const id&);
+        void enqueue(e::intrusive_ptr<scan> s);
+        void scanner();
+        void shutdown();
+        // call between objects of a scan; may block for a reconfiguration.
+        // returns false if the scan must be abandoned, and otherwise
+        // refreshes config and sc for the current configuration.
+        bool checkpoint(const region_id& ri, const configuration** config, const schema** sc);
+        void perform_sorted_search(scan* s);
+        void perform_group_keyop(scan* s);
+        void perform_count(scan* s);
+        void perform_search_describe(scan* s);
+        void perform_aggregate(scan* s);
 
     private:
         daemon* m_daemon;
         e::lockfree_hash_map<id, e::intrusive_ptr<state>, hash> m_searches;
+        std::vector<std::tr1::shared_ptr<po6::threads::thread> > m_scanners;
+        po6::threads::mutex m_block_scanners;
+        po6::threads::cond m_wakeup_scanners;
+        po6::threads::cond m_wakeup_reconfigurer;
+        std::list<e::intrusive_ptr<scan> > m_scans;
+        // number of scanners between checkpoints
+        size_t m_scanning;
+        bool m_shutdown;
+        bool m_need_pause;
 };
 
 } // namespace hyperdex
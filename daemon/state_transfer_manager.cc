@@ -28,9 +28,15 @@
 // POSIX
 #include <signal.h>
 
+// STL
+#include <algorithm>
+
 // Google Log
 #include <glog/logging.h>
 
+// LevelDB
+#include <leveldb/write_batch.h>
+
 // HyperDex
 #include "common/serialization.h"
 #include "daemon/daemon.h"
@@ -40,6 +46,13 @@
 #include "daemon/state_transfer_manager_transfer_in_state.h"
 #include "daemon/state_transfer_manager_transfer_out_state.h"
 
+// the receiver applies snapshot objects in WriteBatches of about this size
+#define XFER_WRITE_BATCH_BYTES (8ULL << 20)
+// objects hashed into a transfer's tree per pass of the kickstarter
+#define HASH_TREE_STEP 65536
+
+using hyperdex::datalayer;
+using hyperdex::hash_tree;
 using hyperdex::reconfigure_returncode;
 using hyperdex::state_transfer_manager;
 using hyperdex::transfer_id;
@@ -184,12 +197,9 @@ state_transfer_manager :: reconfigure(const configuration&,
 void
 state_transfer_manager :: xfer_op(const virtual_server_id& from,
                                   const transfer_id& xid,
-                                  uint64_t seq_no,
-                                  bool has_value,
-                                  uint64_t version,
-                                  std::auto_ptr<e::buffer> msg,
-                                  const e::slice& key,
-                                  const std::vector<e::slice>& value)
+                                  uint64_t count,
+                                  std::auto_ptr<e::buffer> _msg,
+                                  e::unpacker up)
 {
     std::vector<std::pair<transfer_id, e::intrusive_ptr<transfer_in_state> > >::iterator it;
     it = std::lower_bound(m_transfers_in.begin(),
@@ -217,40 +227,57 @@ state_transfer_manager :: xfer_op(const virtual_server_id& from,
         return;
     }
 
-    if (seq_no < tis->upper_bound_acked)
+    std::tr1::shared_ptr<e::buffer> msg(_msg.release());
+    bool duplicate = false;
+
+    for (uint64_t i = 0; i < count; ++i)
     {
-        return send_ack(tis->xfer, seq_no);
-    }
+        e::intrusive_ptr<pending> op(new pending());
+        uint8_t flags;
 
-    std::list<e::intrusive_ptr<pending> >::iterator where_to_put_it;
+        if ((up >> flags >> op->seq_no >> op->version >> op->key >> op->value).error())
+        {
+            LOG(WARNING) << "unpack of XFER_OP failed; here's some hex:  " << msg->hex();
+            break;
+        }
 
-    for (where_to_put_it = tis->queued.begin();
-            where_to_put_it != tis->queued.end(); ++where_to_put_it)
-    {
-        if ((*where_to_put_it)->seq_no == seq_no)
+        op->has_value = flags & 1;
+        op->from_snapshot = flags & 2;
+        op->msg = msg;
+
+        if (op->seq_no < tis->upper_bound_acked)
         {
-            // silently drop it
-            return;
+            duplicate = true;
+            continue;
         }
 
-        if ((*where_to_put_it)->seq_no > seq_no)
+        std::list<e::intrusive_ptr<pending> >::iterator where_to_put_it;
+
+        for (where_to_put_it = tis->queued.begin();
+                where_to_put_it != tis->queued.end(); ++where_to_put_it)
         {
-            break;
+            if ((*where_to_put_it)->seq_no >= op->seq_no)
+            {
+                break;
+            }
+        }
+
+        // silently drop it if we already have it
+        if (where_to_put_it == tis->queued.end() ||
+            (*where_to_put_it)->seq_no != op->seq_no)
+        {
+            tis->queued.insert(where_to_put_it, op);
         }
     }
 
-    e::intrusive_ptr<pending> op(new pending());
-    op->seq_no = seq_no;
-    op->has_value = has_value;
-    op->version = version;
-    op->key = key;
-    op->value = value;
-    op->msg = msg;
-    tis->queued.insert(where_to_put_it, op);
+    if (duplicate)
+    {
+        send_ack(tis->xfer, tis->upper_bound_acked - 1);
+    }
 
     if (!tis->cleared_capture)
     {
-        capture_id cid = m_daemon->m_config.capture_for(tis->xfer.rid);
+        capture_id cid = m_daemon->m_config->capture_for(tis->xfer.rid);
         m_daemon->m_data.request_wipe(cid);
         return;
     }
@@ -290,32 +317,105 @@ state_transfer_manager :: xfer_ack(const server_id& from,
         return;
     }
 
-    std::list<e::intrusive_ptr<pending> >::iterator it;
+    uint64_t acked = 0;
 
-    for (it = tos->window.begin(); it != tos->window.end(); ++it)
+    while (!tos->window.empty() && tos->window.front()->seq_no <= seq_no)
     {
-        if ((*it)->seq_no == seq_no)
-        {
-            break;
-        }
+        acked += tos->window.front()->bytes;
+        tos->window.pop_front();
     }
 
-    if (it != tos->window.end())
+    tos->window_bytes -= acked;
+    tos->window_limit += acked;
+
+    if (tos->window_limit > XFER_WINDOW_BYTES)
     {
-        (*it)->acked = true;
+        tos->window_limit = XFER_WINDOW_BYTES;
+    }
+    transfer_more_state(tos);
+}
 
-        if (tos->window_sz < 1024)
+void
+state_transfer_manager :: xfer_tree(const virtual_server_id& from,
+                                    const transfer_id& xid,
+                                    const std::vector<uint64_t>& leaves)
+{
+    std::vector<std::pair<transfer_id, e::intrusive_ptr<transfer_out_state> > >::iterator oit;
+    oit = std::lower_bound(m_transfers_out.begin(),
+                           m_transfers_out.end(),
+                           std::make_pair(xid, e::intrusive_ptr<transfer_out_state>()));
+
+    if (oit != m_transfers_out.end() && oit->first == xid && oit->second)
+    {
+        transfer_out_state* tos = oit->second.get();
+        po6::threads::mutex::hold hold(&tos->mtx);
+
+        if (tos->xfer.vdst != from)
         {
-            ++tos->window_sz;
+            LOG(INFO) << "dropping XFER_TREE that came from the wrong host";
+            return;
         }
+
+        if (!tos->have_remote_tree)
+        {
+            if (!tos->remote_tree.adopt(leaves))
+            {
+                LOG(WARNING) << "dropping XFER_TREE with the wrong number of leaves";
+                return;
+            }
+
+            tos->have_remote_tree = true;
+        }
+
+        if (tos->state == transfer_out_state::HASH_TREE)
+        {
+            transfer_more_state(tos);
+        }
+        else
+        {
+            // the receiver lost our reply
+            send_tree(tos->xfer.vsrc, tos->xfer.vdst, tos->xfer.id, tos->tree);
+        }
+
+        return;
     }
 
-    while (!tos->window.empty() && (*tos->window.begin())->acked)
+    std::vector<std::pair<transfer_id, e::intrusive_ptr<transfer_in_state> > >::iterator iit;
+    iit = std::lower_bound(m_transfers_in.begin(),
+                           m_transfers_in.end(),
+                           std::make_pair(xid, e::intrusive_ptr<transfer_in_state>()));
+
+    if (iit != m_transfers_in.end() && iit->first == xid && iit->second)
     {
-        tos->window.pop_front();
+        transfer_in_state* tis = iit->second.get();
+        po6::threads::mutex::hold hold(&tis->mtx);
+
+        if (tis->xfer.vsrc != from)
+        {
+            LOG(INFO) << "dropping XFER_TREE that came from the wrong host";
+            return;
+        }
+
+        if (tis->have_differ || !tis->tree_built)
+        {
+            return;
+        }
+
+        hash_tree remote;
+
+        if (!remote.adopt(leaves))
+        {
+            LOG(WARNING) << "dropping XFER_TREE with the wrong number of leaves";
+            return;
+        }
+
+        tis->tree.diff(remote, &tis->differ);
+        tis->have_differ = true;
+        put_to_disk_and_send_acks(tis);
+        return;
     }
 
-    transfer_more_state(tos);
+    LOG(INFO) << "dropping XFER_TREE for transfer we don't know about";
 }
 
 void
@@ -342,6 +442,14 @@ state_transfer_manager :: retransmit(const server_id& id)
     }
 }
 
+void
+state_transfer_manager :: report_rehomed()
+{
+    po6::threads::mutex::hold hold(&m_block_kickstarter);
+    m_need_kickstart = true;
+    m_wakeup_kickstarter.broadcast();
+}
+
 void
 state_transfer_manager :: report_wiped(const capture_id& cid)
 {
@@ -359,7 +467,7 @@ state_transfer_manager :: report_wiped(const capture_id& cid)
         transfer_in_state* tis = m_transfers_in[idx].second.get();
 
         if (!tis->cleared_capture &&
-            m_daemon->m_config.capture_for(tis->xfer.rid) == cid)
+            m_daemon->m_config->capture_for(tis->xfer.rid) == cid)
         {
             tis->cleared_capture = true;
             put_to_disk_and_send_acks(tis);
@@ -372,29 +480,51 @@ state_transfer_manager :: report_wiped(const capture_id& cid)
 void
 state_transfer_manager :: transfer_more_state(transfer_out_state* tos)
 {
-    while (tos->window.size() < tos->window_sz)
+    if (tos->state == transfer_out_state::HASH_TREE)
+    {
+        if (!tos->tree_built || !tos->have_remote_tree)
+        {
+            return;
+        }
+
+        tos->tree.diff(tos->remote_tree, &tos->differ);
+        size_t differing = std::count(tos->differ.begin(), tos->differ.end(), true);
+        LOG(INFO) << "transfer " << tos->xfer.id << " differs in " << differing
+                  << " of " << tos->differ.size() << " hash tree leaves";
+        send_tree(tos->xfer.vsrc, tos->xfer.vdst, tos->xfer.id, tos->tree);
+        tos->state = transfer_out_state::SNAPSHOT_TRANSFER;
+    }
+
+    std::vector<pending*> run;
+    uint64_t run_bytes = 0;
+
+    while (tos->window_bytes < tos->window_limit)
     {
+        e::intrusive_ptr<pending> op(new pending());
+
         if (tos->state == transfer_out_state::SNAPSHOT_TRANSFER)
         {
             if (tos->snap_iter.valid())
             {
-                e::intrusive_ptr<pending> op(new pending());
-                op->seq_no = tos->next_seq_no;
-                ++tos->next_seq_no;
                 op->has_value = true;
+                op->from_snapshot = true;
                 tos->snap_iter.unpack(&op->key, &op->value, &op->version, &op->ref);
-                tos->window.push_back(op);
-                send_object(tos->xfer, op.get());
                 tos->snap_iter.next();
+
+                // the receiver already has every object in this leaf
+                if (!tos->differ[hash_tree::leaf_of(op->key)])
+                {
+                    continue;
+                }
             }
             else
             {
                 tos->state = transfer_out_state::LOG_TRANSFER;
+                continue;
             }
         }
         else if (tos->state == transfer_out_state::LOG_TRANSFER)
         {
-            e::intrusive_ptr<pending> op(new pending());
             datalayer::returncode rc;
             rc = m_daemon->m_data.get_transfer(tos->xfer.rid, tos->log_seq_no,
                                                &op->has_value,
@@ -423,25 +553,56 @@ state_transfer_manager :: transfer_more_state(transfer_out_state* tos)
                     break;
             }
 
-            if (done)
+            // objects still moving between the subspace's regions would
+            // miss a transfer that went live now; report_rehomed restarts us
+            if (done && m_daemon->m_data.is_rehoming(tos->xfer.rid))
+            {
+                break;
+            }
+            else if (done)
             {
                 m_daemon->m_coord.transfer_go_live(tos->xfer.id);
                 break;
             }
 
-            op->seq_no = tos->next_seq_no;
-            ++tos->next_seq_no;
-            tos->window.push_back(op);
-            send_object(tos->xfer, op.get());
             ++tos->log_seq_no;
         }
         else
         {
             abort();
         }
+
+        op->seq_no = tos->next_seq_no;
+        ++tos->next_seq_no;
+        op->bytes = sizeof(uint8_t)
+                  + sizeof(uint64_t)
+                  + sizeof(uint64_t)
+                  + sizeof(uint32_t) + op->key.size()
+                  + pack_size(op->value);
+        tos->window.push_back(op);
+        tos->window_bytes += op->bytes;
+        run.push_back(op.get());
+        run_bytes += op->bytes;
+
+        if (run_bytes >= XFER_RUN_BYTES)
+        {
+            send_objects(tos->xfer, run);
+            run.clear();
+            run_bytes = 0;
+        }
+    }
+
+    if (!run.empty())
+    {
+        send_objects(tos->xfer, run);
     }
 
-    if (tos->window.empty() && m_daemon->m_config.is_transfer_live(tos->xfer.id))
+    if (m_daemon->m_data.is_rehoming(tos->xfer.rid))
+    {
+        return;
+    }
+
+    if (tos->window.empty() && m_daemon->m_config->is_transfer_live(tos->xfer.id))
     {
         m_daemon->m_coord.transfer_complete(tos->xfer.id);
     }
@@ -454,34 +615,117 @@ state_transfer_manager :: transfer_more_state(transfer_out_state* tos)
 void
 state_transfer_manager :: retransmit(transfer_out_state* tos)
 {
+    std::vector<pending*> run;
+    uint64_t run_bytes = 0;
+
     for (std::list<e::intrusive_ptr<pending> >::iterator it = tos->window.begin();
             it != tos->window.end(); ++it)
     {
-        send_object(tos->xfer, it->get());
+        run.push_back(it->get());
+        run_bytes += (*it)->bytes;
+
+        if (run_bytes >= XFER_RUN_BYTES)
+        {
+            send_objects(tos->xfer, run);
+            run.clear();
+            run_bytes = 0;
+        }
+    }
+
+    if (!run.empty())
+    {
+        send_objects(tos->xfer, run);
+    }
+}
+
+// Hash up to HASH_TREE_STEP more objects into tree; true once all are in
+static bool
+build_tree(hash_tree* tree, datalayer::region_iterator* iter)
+{
+    for (size_t i = 0; i < HASH_TREE_STEP && iter->valid(); ++i)
+    {
+        e::slice key;
+        std::vector<e::slice> value;
+        uint64_t version;
+        datalayer::reference ref;
+        iter->unpack(&key, &value, &version, &ref);
+        tree->insert(key, version);
+        iter->next();
+    }
+
+    if (iter->valid())
+    {
+        return false;
+    }
+
+    tree->seal();
+    return true;
+}
+
+// Apply the staged snapshot objects, if any
+static void
+write_bulk(datalayer* data, leveldb::WriteBatch* bulk, uint64_t* bulk_bytes)
+{
+    if (*bulk_bytes == 0)
+    {
+        return;
+    }
+
+    datalayer::returncode rc = data->bulk_write(bulk);
+
+    switch (rc)
+    {
+        case datalayer::SUCCESS:
+            break;
+        case datalayer::NOT_FOUND:
+        case datalayer::BAD_ENCODING:
+        case datalayer::BAD_SEARCH:
+        case datalayer::CORRUPTION:
+        case datalayer::IO_ERROR:
+        case datalayer::LEVELDB_ERROR:
+            LOG(ERROR) << "state transfer caused error " << rc;
+            break;
+        default:
+            LOG(ERROR) << "state transfer caused unknown error";
+            break;
     }
+
+    bulk->Clear();
+    *bulk_bytes = 0;
 }
 
 void
 state_transfer_manager :: put_to_disk_and_send_acks(transfer_in_state* tis)
 {
-    if (!tis->cleared_capture)
+    if (!tis->cleared_capture || !tis->have_differ)
     {
         return;
     }
 
+    uint64_t prev_upper_bound_acked = tis->upper_bound_acked;
+    leveldb::WriteBatch bulk;
+    uint64_t bulk_bytes = 0;
+
     while (!tis->queued.empty() &&
            tis->queued.front()->seq_no == tis->upper_bound_acked)
     {
         e::intrusive_ptr<pending> op = tis->queued.front();
 
+        bool sorted = tis->need_del &&
+                      (!tis->prev || tis->prev->key < op->key);
+
         // if we are still processing keys in sorted order, then delete
         // everything less than op->key
-        if (tis->need_del &&
-            (!tis->prev || tis->prev->key < op->key))
+        if (sorted)
         {
             while (tis->del_iter.valid() && tis->del_iter.key() < op->key)
             {
-                m_daemon->m_data.uncertain_del(tis->xfer.rid, tis->del_iter.key());
+                // keys in matching leaves are not resent, so keep them
+                if (tis->differ[hash_tree::leaf_of(tis->del_iter.key())])
+                {
+                    m_daemon->m_data.uncertain_del(tis->xfer.rid, tis->del_iter.key());
+                }
+
                 tis->del_iter.next();
             }
         }
@@ -494,6 +738,12 @@ state_transfer_manager :: put_to_disk_and_send_acks(transfer_in_state* tis)
 
             while (tis->del_iter.valid())
             {
+                if (!tis->differ[hash_tree::leaf_of(tis->del_iter.key())])
+                {
+                    tis->del_iter.next();
+                    continue;
+                }
+
                 datalayer::returncode rc = m_daemon->m_data.uncertain_del(tis->xfer.rid, tis->del_iter.key());
                 tis->del_iter.next();
 
@@ -516,8 +766,42 @@ state_transfer_manager :: put_to_disk_and_send_acks(transfer_in_state* tis)
             }
         }
 
-        if (op->has_value)
+        // A snapshot object that arrives in order and sorts before everything
+        // left in del_iter was not here when the transfer began, and nothing
+        // but this transfer writes the region until it goes live; it cannot
+        // be on disk, so stage it without reading.
+        if (sorted && op->has_value && op->from_snapshot &&
+            (!tis->del_iter.valid() || op->key < tis->del_iter.key()))
+        {
+            datalayer::returncode rc = m_daemon->m_data.bulk_put(tis->xfer.rid, op->key, op->value, op->version, &bulk);
+
+            switch (rc)
+            {
+                case datalayer::SUCCESS:
+                    break;
+                case datalayer::NOT_FOUND:
+                case datalayer::BAD_ENCODING:
+                case datalayer::BAD_SEARCH:
+                case datalayer::CORRUPTION:
+                case datalayer::IO_ERROR:
+                case datalayer::LEVELDB_ERROR:
+                    LOG(ERROR) << "state transfer caused error " << rc;
+                    break;
+                default:
+                    LOG(ERROR) << "state transfer caused unknown error";
+                    break;
+            }
+
+            bulk_bytes += op->key.size() + pack_size(op->value);
+
+            if (bulk_bytes >= XFER_WRITE_BATCH_BYTES)
+            {
+                write_bulk(&m_daemon->m_data, &bulk, &bulk_bytes);
+            }
+        }
+        else if (op->has_value)
         {
+            write_bulk(&m_daemon->m_data, &bulk, &bulk_bytes);
             datalayer::returncode rc = m_daemon->m_data.uncertain_put(tis->xfer.rid, op->key, op->value, op->version);
 
             switch (rc)
@@ -539,6 +823,7 @@ state_transfer_manager :: put_to_disk_and_send_acks(transfer_in_state* tis)
         }
         else
         {
+            write_bulk(&m_daemon->m_data, &bulk, &bulk_bytes);
             datalayer::returncode rc = m_daemon->m_data.uncertain_del(tis->xfer.rid, op->key);
 
             switch (rc)
@@ -559,29 +844,47 @@ state_transfer_manager :: put_to_disk_and_send_acks(transfer_in_state* tis)
             }
         }
 
-        send_ack(tis->xfer, op->seq_no);
         tis->upper_bound_acked = std::max(tis->upper_bound_acked, op->seq_no + 1);
-
         tis->prev = tis->queued.front();
         tis->queued.pop_front();
     }
+
+    write_bulk(&m_daemon->m_data, &bulk, &bulk_bytes);
+
+    if (tis->upper_bound_acked > prev_upper_bound_acked)
+    {
+        send_ack(tis->xfer, tis->upper_bound_acked - 1);
+    }
 }
 
 void
-state_transfer_manager :: send_object(const transfer& xfer,
-                                      pending* op)
+state_transfer_manager :: send_objects(const transfer& xfer,
+                                       const std::vector<pending*>& ops)
 {
-    uint8_t flags = (op->has_value ? 1 : 0);
+    uint8_t flags = 0;
+    uint64_t count = ops.size();
     size_t sz = HYPERDEX_HEADER_SIZE_VV
               + sizeof(uint8_t)
               + sizeof(uint64_t)
-              + sizeof(uint64_t)
-              + sizeof(uint64_t)
-              + sizeof(uint32_t) + op->key.size()
-              + pack_size(op->value);
+              + sizeof(uint64_t);
+
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+        sz += ops[i]->bytes;
+    }
+
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << flags << xfer.id.get() << op->seq_no
-                                          << op->version << op->key << op->value;
+    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VV);
+    pa = pa << flags << xfer.id.get() << count;
+
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+        uint8_t op_flags = (ops[i]->has_value ? 1 : 0)
+                         | (ops[i]->from_snapshot ? 2 : 0);
+        pa = pa << op_flags << ops[i]->seq_no << ops[i]->version
+                << ops[i]->key << ops[i]->value;
+    }
+
     m_daemon->m_comm.send(xfer.vsrc, xfer.vdst, XFER_OP, msg);
 }
 
@@ -598,6 +901,24 @@ state_transfer_manager :: send_ack(const transfer& xfer, uint64_t seq_no)
     m_daemon->m_comm.send(xfer.vdst, xfer.vsrc, XFER_ACK, msg);
 }
 
+void
+state_transfer_manager :: send_tree(const virtual_server_id& from,
+                                    const virtual_server_id& to,
+                                    const transfer_id& xid,
+                                    const hash_tree& tree)
+{
+    uint8_t flags = 0;
+    std::vector<uint64_t> leaves;
+    tree.leaves(&leaves);
+    size_t sz = HYPERDEX_HEADER_SIZE_VV
+              + sizeof(uint8_t)
+              + sizeof(uint64_t)
+              + pack_size(leaves);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << flags << xid.get() << leaves;
+    m_daemon->m_comm.send(from, to, XFER_TREE, msg);
+}
+
 void
 state_transfer_manager :: kickstarter()
 {
@@ -653,8 +974,16 @@ state_transfer_manager :: kickstarter()
                 break;
             }
 
-            po6::threads::mutex::hold hold2(&m_transfers_out[idx].second->mtx);
-            transfer_more_state(m_transfers_out[idx].second.get());
+            transfer_out_state* tos = m_transfers_out[idx].second.get();
+            po6::threads::mutex::hold hold2(&tos->mtx);
+
+            if (!tos->tree_built)
+            {
+                tos->tree_built = build_tree(&tos->tree, &tos->tree_iter);
+                m_need_kickstart = m_need_kickstart || !tos->tree_built;
+            }
+
+            transfer_more_state(tos);
             ++idx;
         }
 
@@ -669,8 +998,22 @@ state_transfer_manager :: kickstarter()
                 break;
             }
 
-            po6::threads::mutex::hold hold2(&m_transfers_in[idx].second->mtx);
-            put_to_disk_and_send_acks(m_transfers_in[idx].second.get());
+            transfer_in_state* tis = m_transfers_in[idx].second.get();
+            po6::threads::mutex::hold hold2(&tis->mtx);
+
+            if (!tis->tree_built)
+            {
+                tis->tree_built = build_tree(&tis->tree, &tis->tree_iter);
+                m_need_kickstart = m_need_kickstart || !tis->tree_built;
+            }
+
+            // (re)send our tree until the sender answers with its own
+            if (tis->tree_built && !tis->have_differ)
+            {
+                send_tree(tis->xfer.vdst, tis->xfer.vsrc, tis->xfer.id, tis->tree);
+            }
+
+            put_to_disk_and_send_acks(tis);
             ++idx;
         }
     }
@@ -30,6 +30,7 @@
 
 // STL
 #include <memory>
+#include <vector>
 
 // po6
 #include <po6/threads/cond.h>
@@ -37,10 +38,12 @@
 #include <po6/threads/thread.h>
 
 // e
+#include <e/buffer.h>
 #include <e/intrusive_ptr.h>
 
 // HyperDex
 #include "common/configuration.h"
+#include "daemon/hash_tree.h"
 #include "daemon/reconfigure_returncode.h"
 
 namespace hyperdex
@@ -64,20 +67,25 @@ class state_transfer_manager
                          const server_id& us);
 
     public:
+        // up holds count objects, each packed as
+        // (flags, seq_no, version, key, value)
         void xfer_op(const virtual_server_id& from,
                      const transfer_id& xid,
-                     uint64_t seq_no,
-                     bool has_value,
-                     uint64_t version,
+                     uint64_t count,
                      std::auto_ptr<e::buffer> msg,
-                     const e::slice& key,
-                     const std::vector<e::slice>& value);
+                     e::unpacker up);
         void xfer_ack(const server_id& from,
                       const virtual_server_id& to,
                       const transfer_id& xid,
                       uint64_t seq_no);
+        // the leaves of the other side's hash tree for the transfer
+        void xfer_tree(const virtual_server_id& from,
+                       const transfer_id& xid,
+                       const std::vector<uint64_t>& leaves);
         void retransmit(const server_id& id);
         void report_wiped(const capture_id& cid);
+        // the datalayer moved objects between split or merged regions
+        void report_rehomed();
 
     private:
         class pending;
@@ -91,9 +99,14 @@ class state_transfer_manager
         // caller must hold mtx on tis
         void put_to_disk_and_send_acks(transfer_in_state* tis);
         // caller must hold mtx on tos
-        // send the last object in tos
-        void send_object(const transfer& xfer, pending* op);
-        void send_ack(const transfer& xfer, uint64_t seq_id);
+        // send a run of objects in one XFER_OP
+        void send_objects(const transfer& xfer, const std::vector<pending*>& ops);
+        // acknowledge every object up to and including seq_no
+        void send_ack(const transfer& xfer, uint64_t seq_no);
+        void send_tree(const virtual_server_id& from,
+                       const virtual_server_id& to,
+                       const transfer_id& xid,
+                       const hash_tree& tree);
         void kickstarter();
         void shutdown();
 
@@ -28,6 +28,9 @@
 #ifndef hyperdex_daemon_state_transfer_manager_pending_h_
 #define hyperdex_daemon_state_transfer_manager_pending_h_
 
+// STL
+#include <tr1/memory>
+
 // HyperDex
 #include "daemon/datalayer.h"
 #include "daemon/state_transfer_manager.h"
@@ -41,11 +44,15 @@ class hyperdex::state_transfer_manager::pending
     public:
         uint64_t seq_no;
         bool has_value;
+        // read from the sender's snapshot rather than its transfer log
+        bool from_snapshot;
         uint64_t version;
         e::slice key;
         std::vector<e::slice> value;
-        bool acked;
-        std::auto_ptr<e::buffer> msg;
+        // bytes this object occupies within an XFER_OP
+        size_t bytes;
+        // shared by every object unpacked from the same message
+        std::tr1::shared_ptr<e::buffer> msg;
         datalayer::reference ref;
 
     private:
@@ -43,9 +43,15 @@ state_transfer_manager :: transfer_in_state :: transfer_in_state(const transfer&
     , need_del(true)
     , prev()
     , del_iter()
+    , tree()
+    , tree_iter()
+    , tree_built(false)
+    , have_differ(false)
+    , differ()
     , m_ref(0)
 {
     data->make_region_iterator(&del_iter, snap, xfer.rid);
+    data->make_region_iterator(&tree_iter, snap, xfer.rid);
 }
 
 state_transfer_manager :: transfer_in_state :: ~transfer_in_state() throw ()
@@ -38,6 +38,7 @@
 #include <e/intrusive_ptr.h>
 
 // HyperDex
+#include "daemon/hash_tree.h"
 #include "daemon/leveldb.h"
 #include "daemon/state_transfer_manager.h"
 
@@ -58,6 +59,14 @@ class hyperdex::state_transfer_manager::transfer_in_state
         bool need_del;
         e::intrusive_ptr<pending> prev;
         datalayer::region_iterator del_iter;
+        // our hash tree as of the snapshot, built a step at a time
+        hash_tree tree;
+        datalayer::region_iterator tree_iter;
+        bool tree_built;
+        // leaves where the sender's tree differs; nothing is written or
+        // deleted until we know them
+        bool have_differ;
+        std::vector<bool> differ;
 
     private:
         friend class e::intrusive_ptr<transfer_in_state>;
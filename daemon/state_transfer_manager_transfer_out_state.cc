@@ -36,15 +36,23 @@ state_transfer_manager :: transfer_out_state :: transfer_out_state(const transfe
                                                                    leveldb_snapshot_ptr snap)
     : xfer(_xfer)
     , mtx()
-    , state(SNAPSHOT_TRANSFER)
+    , state(HASH_TREE)
     , next_seq_no(1)
     , window()
-    , window_sz(1)
+    , window_bytes(0)
+    , window_limit(XFER_RUN_BYTES)
     , snap_iter()
     , log_seq_no(1)
+    , tree()
+    , tree_iter()
+    , tree_built(false)
+    , remote_tree()
+    , have_remote_tree(false)
+    , differ()
     , m_ref(0)
 {
     data->make_region_iterator(&snap_iter, snap, xfer.rid);
+    data->make_region_iterator(&tree_iter, snap, xfer.rid);
 }
 
 state_transfer_manager :: transfer_out_state :: ~transfer_out_state() throw ()
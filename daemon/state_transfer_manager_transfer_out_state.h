@@ -43,9 +43,15 @@
 
 // HyperDex
 #include "daemon/datalayer.h"
+#include "daemon/hash_tree.h"
 #include "daemon/leveldb.h"
 #include "daemon/state_transfer_manager.h"
 
+// objects are sent in runs of roughly this many bytes per XFER_OP
+#define XFER_RUN_BYTES (1ULL << 20)
+// the window starts at one run and grows by every byte acked up to this
+#define XFER_WINDOW_BYTES (64ULL << 20)
+
 using hyperdex::state_transfer_manager;
 
 class state_transfer_manager::transfer_out_state
@@ -59,14 +65,25 @@ class state_transfer_manager::transfer_out_state
     public:
         transfer xfer;
         po6::threads::mutex mtx;
-        enum { SNAPSHOT_TRANSFER, LOG_TRANSFER } state;
+        enum { HASH_TREE, SNAPSHOT_TRANSFER, LOG_TRANSFER } state;
         uint64_t next_seq_no;
         std::list<e::intrusive_ptr<pending> > window;
-        size_t window_sz;
+        // bytes sent but not yet acked, and how many we may have in flight
+        uint64_t window_bytes;
+        uint64_t window_limit;
         // transfer from the snapshot
         datalayer::region_iterator snap_iter;
         // transfer from the log of new operations
         uint64_t log_seq_no;
+        // our hash tree as of the snapshot, built a step at a time
+        hash_tree tree;
+        datalayer::region_iterator tree_iter;
+        bool tree_built;
+        // the receiver's tree, and the leaves where it differs from ours;
+        // only objects in those leaves are sent from the snapshot
+        hash_tree remote_tree;
+        bool have_remote_tree;
+        std::vector<bool> differ;
 
     private:
         friend class e::intrusive_ptr<transfer_out_state>;
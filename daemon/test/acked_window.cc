@@ -0,0 +1,157 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Google Test
+#include <gtest/gtest.h>
+
+// HyperDex
+#include "daemon/acked_window.h"
+
+#pragma GCC diagnostic ignored "-Wswitch-default"
+
+using hyperdex::acked_window;
+using hyperdex::region_id;
+
+namespace
+{
+
+TEST(AckedWindow, StageThenCommit)
+{
+    acked_window aw;
+    acked_window::row r;
+    region_id ri(1);
+    region_id reg_id(2);
+    ASSERT_FALSE(aw.check(ri, reg_id, 5));
+    ASSERT_TRUE(aw.stage(ri, reg_id, 5, &r));
+    ASSERT_EQ(0U, r.index);
+    ASSERT_EQ(1ULL << 5, r.bits);
+    // not acked until the write carrying the row succeeds
+    ASSERT_FALSE(aw.check(ri, reg_id, 5));
+    aw.commit(ri, reg_id, 5);
+    ASSERT_TRUE(aw.check(ri, reg_id, 5));
+    ASSERT_FALSE(aw.check(ri, reg_id, 4));
+    ASSERT_FALSE(aw.check(region_id(3), reg_id, 5));
+}
+
+TEST(AckedWindow, AbortForgets)
+{
+    acked_window aw;
+    acked_window::row r;
+    region_id ri(1);
+    region_id reg_id(2);
+    ASSERT_TRUE(aw.stage(ri, reg_id, 70, &r));
+    aw.abort(ri, reg_id, 70);
+    ASSERT_FALSE(aw.check(ri, reg_id, 70));
+    ASSERT_TRUE(aw.stage(ri, reg_id, 71, &r));
+    ASSERT_EQ(1U, r.index);
+    ASSERT_EQ(1ULL << 7, r.bits);
+}
+
+TEST(AckedWindow, RowsCarryEarlierAcks)
+{
+    acked_window aw;
+    acked_window::row r;
+    region_id ri(1);
+    region_id reg_id(2);
+    ASSERT_TRUE(aw.stage(ri, reg_id, 1, &r));
+    aw.commit(ri, reg_id, 1);
+    ASSERT_TRUE(aw.stage(ri, reg_id, 2, &r));
+    ASSERT_TRUE(aw.stage(ri, reg_id, 3, &r));
+    // 2 is still in flight, but reaches the disk no later than 3
+    ASSERT_EQ((1ULL << 1) | (1ULL << 2) | (1ULL << 3), r.bits);
+}
+
+TEST(AckedWindow, AdvanceDropsWholeWords)
+{
+    acked_window aw;
+    acked_window::row r;
+    region_id ri(1);
+    region_id reg_id(2);
+
+    for (uint64_t s = 1; s < 200; ++s)
+    {
+        ASSERT_TRUE(aw.stage(ri, reg_id, s, &r));
+        aw.commit(ri, reg_id, s);
+    }
+
+    std::vector<acked_window::row> dropped;
+    aw.advance(reg_id, 130, &dropped);
+    ASSERT_EQ(2U, dropped.size());
+    ASSERT_EQ(0U, dropped[0].index);
+    ASSERT_EQ(1U, dropped[1].index);
+    ASSERT_EQ(ri, dropped[0].ri);
+    ASSERT_TRUE(aw.check(ri, reg_id, 10));
+    ASSERT_TRUE(aw.check(ri, reg_id, 150));
+    ASSERT_FALSE(aw.stage(ri, reg_id, 129, &r));
+    dropped.clear();
+    aw.advance(reg_id, 100, &dropped);
+    ASSERT_TRUE(dropped.empty());
+}
+
+TEST(AckedWindow, AdvanceKeepsInFlightWords)
+{
+    acked_window aw;
+    acked_window::row r;
+    region_id ri(1);
+    region_id reg_id(2);
+    ASSERT_TRUE(aw.stage(ri, reg_id, 10, &r));
+    std::vector<acked_window::row> dropped;
+    aw.advance(reg_id, 64, &dropped);
+    ASSERT_TRUE(dropped.empty());
+    aw.commit(ri, reg_id, 10);
+    aw.advance(reg_id, 65, &dropped);
+    ASSERT_EQ(1U, dropped.size());
+}
+
+TEST(AckedWindow, RestoreFromRows)
+{
+    acked_window aw;
+    acked_window::row r;
+    region_id reg_id(2);
+    ASSERT_TRUE(aw.stage(reg_id, reg_id, 100, &r));
+    aw.commit(reg_id, reg_id, 100);
+    ASSERT_TRUE(aw.stage(reg_id, reg_id, 300, &r));
+    aw.commit(reg_id, reg_id, 300);
+    ASSERT_EQ(300U, aw.max_seq_id(reg_id));
+    std::vector<acked_window::row> rows;
+    aw.all_rows(&rows);
+    ASSERT_EQ(2U, rows.size());
+
+    acked_window restored;
+
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        restored.restore(rows[i]);
+    }
+
+    ASSERT_EQ(300U, restored.max_seq_id(reg_id));
+    ASSERT_TRUE(restored.check(reg_id, reg_id, 100));
+    ASSERT_TRUE(restored.check(reg_id, reg_id, 300));
+    ASSERT_FALSE(restored.check(reg_id, reg_id, 200));
+}
+
+} // namespace
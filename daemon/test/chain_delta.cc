@@ -0,0 +1,188 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// HyperDex
+#include "daemon/chain_delta.h"
+
+#pragma GCC diagnostic ignored "-Wswitch-default"
+
+using hyperdex::chain_delta_apply;
+using hyperdex::chain_delta_diff;
+
+namespace
+{
+
+std::vector<e::slice>
+attrs(const std::vector<std::string>& strs)
+{
+    std::vector<e::slice> out;
+
+    for (size_t i = 0; i < strs.size(); ++i)
+    {
+        out.push_back(e::slice(strs[i].data(), strs[i].size()));
+    }
+
+    return out;
+}
+
+std::string
+str(const e::slice& s)
+{
+    return std::string(reinterpret_cast<const char*>(s.data()), s.size());
+}
+
+TEST(ChainDelta, DiffOneChanged)
+{
+    std::vector<std::string> old_strs;
+    old_strs.push_back(std::string(100, 'a'));
+    old_strs.push_back(std::string(100, 'b'));
+    old_strs.push_back("c");
+    std::vector<std::string> new_strs(old_strs);
+    new_strs[2] = "C";
+    std::vector<uint16_t> changed;
+    ASSERT_TRUE(chain_delta_diff(attrs(old_strs), attrs(new_strs), &changed));
+    ASSERT_EQ(1U, changed.size());
+    ASSERT_EQ(2U, changed[0]);
+}
+
+TEST(ChainDelta, DiffUnchanged)
+{
+    std::vector<std::string> strs;
+    strs.push_back("a");
+    strs.push_back("b");
+    std::vector<uint16_t> changed;
+    ASSERT_TRUE(chain_delta_diff(attrs(strs), attrs(strs), &changed));
+    ASSERT_TRUE(changed.empty());
+}
+
+// a delta that is no smaller than the full value is not worth sending
+TEST(ChainDelta, DiffAllChanged)
+{
+    std::vector<std::string> old_strs;
+    old_strs.push_back("a");
+    old_strs.push_back("b");
+    std::vector<std::string> new_strs;
+    new_strs.push_back("x");
+    new_strs.push_back("y");
+    std::vector<uint16_t> changed;
+    ASSERT_FALSE(chain_delta_diff(attrs(old_strs), attrs(new_strs), &changed));
+    ASSERT_EQ(2U, changed.size());
+}
+
+TEST(ChainDelta, DiffMismatchedDimensions)
+{
+    std::vector<std::string> old_strs(2, std::string(100, 'a'));
+    std::vector<std::string> new_strs(3, std::string(100, 'a'));
+    std::vector<uint16_t> changed;
+    ASSERT_FALSE(chain_delta_diff(attrs(old_strs), attrs(new_strs), &changed));
+    ASSERT_TRUE(changed.empty());
+}
+
+TEST(ChainDelta, Apply)
+{
+    std::vector<std::string> base_strs;
+    base_strs.push_back("one");
+    base_strs.push_back("two");
+    base_strs.push_back("three");
+    std::vector<e::slice> base(attrs(base_strs));
+    std::string replacement("TWO!");
+    std::vector<std::pair<uint16_t, e::slice> > delta;
+    delta.push_back(std::make_pair(1, e::slice(replacement.data(), replacement.size())));
+    std::auto_ptr<e::buffer> backing;
+    std::vector<e::slice> value;
+    ASSERT_TRUE(chain_delta_apply(base, delta, &backing, &value));
+    ASSERT_EQ(3U, value.size());
+    ASSERT_EQ("one", str(value[0]));
+    ASSERT_EQ("TWO!", str(value[1]));
+    ASSERT_EQ("three", str(value[2]));
+
+    // the rebuilt value must not point into the base or the message
+    base_strs[0] = "xxx";
+    replacement = "yyyy";
+    ASSERT_EQ("one", str(value[0]));
+    ASSERT_EQ("TWO!", str(value[1]));
+
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        ASSERT_TRUE(value[i].data() >= backing->data());
+        ASSERT_TRUE(value[i].data() + value[i].size() <= backing->data() + backing->size());
+    }
+}
+
+// diffing and then applying the delta rebuilds the new value
+TEST(ChainDelta, RoundTrip)
+{
+    std::vector<std::string> old_strs;
+    old_strs.push_back(std::string(50, 'a'));
+    old_strs.push_back("");
+    old_strs.push_back(std::string(50, 'c'));
+    old_strs.push_back("d");
+    std::vector<std::string> new_strs(old_strs);
+    new_strs[1] = "now set";
+    new_strs[3] = "";
+    std::vector<e::slice> old_value(attrs(old_strs));
+    std::vector<e::slice> new_value(attrs(new_strs));
+    std::vector<uint16_t> changed;
+    ASSERT_TRUE(chain_delta_diff(old_value, new_value, &changed));
+    std::vector<std::pair<uint16_t, e::slice> > delta;
+
+    for (size_t i = 0; i < changed.size(); ++i)
+    {
+        delta.push_back(std::make_pair(changed[i], new_value[changed[i]]));
+    }
+
+    std::auto_ptr<e::buffer> backing;
+    std::vector<e::slice> value;
+    ASSERT_TRUE(chain_delta_apply(old_value, delta, &backing, &value));
+    ASSERT_EQ(new_strs.size(), value.size());
+
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        ASSERT_EQ(new_strs[i], str(value[i]));
+    }
+}
+
+TEST(ChainDelta, ApplyOutOfRange)
+{
+    std::vector<std::string> base_strs(2, "a");
+    std::vector<std::pair<uint16_t, e::slice> > delta;
+    delta.push_back(std::make_pair(2, e::slice("b", 1)));
+    std::auto_ptr<e::buffer> backing;
+    std::vector<e::slice> value;
+    ASSERT_FALSE(chain_delta_apply(attrs(base_strs), delta, &backing, &value));
+}
+
+} // namespace
@@ -0,0 +1,215 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <string>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// HyperDex
+#include "daemon/chunking.h"
+
+#pragma GCC diagnostic ignored "-Wswitch-default"
+
+using hyperdex::chunk_boundaries;
+using hyperdex::chunk_diff;
+using hyperdex::chunk_hashes;
+
+namespace
+{
+
+std::string
+random_bytes(size_t sz, uint64_t seed)
+{
+    std::string out(sz, '\0');
+
+    for (size_t i = 0; i < sz; ++i)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        out[i] = static_cast<char>(seed >> 56);
+    }
+
+    return out;
+}
+
+e::slice
+slice(const std::string& s)
+{
+    return e::slice(s.data(), s.size());
+}
+
+void
+chunk(const std::string& value,
+      std::vector<size_t>* ends,
+      std::vector<uint64_t>* hashes)
+{
+    chunk_boundaries(slice(value), ends);
+    chunk_hashes(slice(value), *ends, hashes);
+}
+
+TEST(Chunking, Boundaries)
+{
+    std::string value(random_bytes(1024 * 1024, 1));
+    std::vector<size_t> ends;
+    chunk_boundaries(slice(value), &ends);
+    ASSERT_LT(1U, ends.size());
+    ASSERT_EQ(value.size(), ends.back());
+    size_t start = 0;
+
+    for (size_t i = 0; i + 1 < ends.size(); ++i)
+    {
+        ASSERT_LE(start + 4 * 1024, ends[i]);
+        ASSERT_GE(start + 64 * 1024, ends[i]);
+        start = ends[i];
+    }
+}
+
+TEST(Chunking, Unchanged)
+{
+    std::string value(random_bytes(256 * 1024, 2));
+    std::vector<size_t> ends;
+    std::vector<uint64_t> hashes;
+    chunk(value, &ends, &hashes);
+    std::vector<size_t> put;
+    std::vector<uint64_t> del;
+    chunk_diff(hashes, hashes, &put, &del);
+    ASSERT_TRUE(put.empty());
+    ASSERT_TRUE(del.empty());
+}
+
+// An insert that adds a cut point shifts every later chunk's position, but
+// not its content, so only the chunks around the insert are written.
+TEST(Chunking, InsertNewBoundary)
+{
+    std::string old_value(random_bytes(1024 * 1024, 3));
+    std::vector<size_t> old_ends;
+    std::vector<uint64_t> old_hashes;
+    chunk(old_value, &old_ends, &old_hashes);
+    std::string new_value;
+    std::vector<size_t> new_ends;
+    std::vector<uint64_t> new_hashes;
+
+    // find a small insert that adds a cut point
+    for (uint64_t seed = 4; new_ends.size() <= old_ends.size(); ++seed)
+    {
+        ASSERT_GT(1000U, seed);
+        new_value = old_value;
+        new_value.insert(old_value.size() / 2, random_bytes(256, seed));
+        chunk(new_value, &new_ends, &new_hashes);
+    }
+
+    // compared by position, every chunk after the insert would be rewritten
+    size_t moved = 0;
+
+    for (size_t i = 0; i < old_hashes.size(); ++i)
+    {
+        if (old_hashes[i] != new_hashes[i])
+        {
+            ++moved;
+        }
+    }
+
+    ASSERT_LT(10U, moved);
+
+    std::vector<size_t> put;
+    std::vector<uint64_t> del;
+    chunk_diff(old_hashes, new_hashes, &put, &del);
+    ASSERT_LE(2U, put.size());
+    ASSERT_GE(3U, put.size());
+    ASSERT_LE(1U, del.size());
+    ASSERT_GE(2U, del.size());
+}
+
+TEST(Chunking, Append)
+{
+    std::string old_value(random_bytes(512 * 1024, 5));
+    std::string new_value(old_value + random_bytes(1024, 6));
+    std::vector<size_t> ends;
+    std::vector<uint64_t> old_hashes;
+    std::vector<uint64_t> new_hashes;
+    chunk(old_value, &ends, &old_hashes);
+    chunk(new_value, &ends, &new_hashes);
+    std::vector<size_t> put;
+    std::vector<uint64_t> del;
+    chunk_diff(old_hashes, new_hashes, &put, &del);
+    ASSERT_EQ(1U, put.size());
+    ASSERT_EQ(new_hashes.size() - 1, put[0]);
+    ASSERT_EQ(1U, del.size());
+    ASSERT_EQ(old_hashes.back(), del[0]);
+}
+
+// repeated content is written once, and a chunk is deleted only when no
+// chunk of the new value has its content
+TEST(Chunking, Duplicates)
+{
+    std::vector<uint64_t> old_hashes;
+    old_hashes.push_back(1);
+    old_hashes.push_back(2);
+    old_hashes.push_back(2);
+    old_hashes.push_back(3);
+    old_hashes.push_back(3);
+    std::vector<uint64_t> new_hashes;
+    new_hashes.push_back(2);
+    new_hashes.push_back(4);
+    new_hashes.push_back(4);
+    new_hashes.push_back(5);
+    new_hashes.push_back(1);
+    std::vector<size_t> put;
+    std::vector<uint64_t> del;
+    chunk_diff(old_hashes, new_hashes, &put, &del);
+    ASSERT_EQ(2U, put.size());
+    ASSERT_EQ(1U, put[0]);
+    ASSERT_EQ(3U, put[1]);
+    ASSERT_EQ(1U, del.size());
+    ASSERT_EQ(3U, del[0]);
+}
+
+TEST(Chunking, CreateAndRemove)
+{
+    std::string value(random_bytes(256 * 1024, 7));
+    value += value;
+    std::vector<size_t> ends;
+    std::vector<uint64_t> hashes;
+    chunk(value, &ends, &hashes);
+    std::vector<uint64_t> none;
+    std::vector<size_t> put;
+    std::vector<uint64_t> del;
+
+    chunk_diff(none, hashes, &put, &del);
+    ASSERT_LT(0U, put.size());
+    ASSERT_GT(hashes.size(), put.size());
+    ASSERT_TRUE(del.empty());
+
+    chunk_diff(hashes, none, &put, &del);
+    ASSERT_TRUE(put.empty());
+    ASSERT_LT(0U, del.size());
+    ASSERT_GT(hashes.size(), del.size());
+}
+
+} // namespace
@@ -0,0 +1,130 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <string.h>
+
+// STL
+#include <algorithm>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// HyperDex
+#include "daemon/hash_tree.h"
+
+#pragma GCC diagnostic ignored "-Wswitch-default"
+
+using hyperdex::hash_tree;
+
+namespace
+{
+
+e::slice
+key(const char* k)
+{
+    return e::slice(k, strlen(k));
+}
+
+size_t
+count_differ(const std::vector<bool>& differ)
+{
+    return std::count(differ.begin(), differ.end(), true);
+}
+
+TEST(HashTree, InsertOrderDoesNotMatter)
+{
+    hash_tree a;
+    a.insert(key("alice"), 1);
+    a.insert(key("bob"), 2);
+    a.insert(key("carol"), 3);
+    a.seal();
+    hash_tree b;
+    b.insert(key("carol"), 3);
+    b.insert(key("alice"), 1);
+    b.insert(key("bob"), 2);
+    b.seal();
+    std::vector<bool> differ;
+    a.diff(b, &differ);
+    ASSERT_EQ(static_cast<size_t>(HASH_TREE_LEAVES), differ.size());
+    ASSERT_EQ(0U, count_differ(differ));
+}
+
+TEST(HashTree, NewerVersionDiffersInItsLeaf)
+{
+    hash_tree a;
+    a.insert(key("alice"), 1);
+    a.insert(key("bob"), 2);
+    a.seal();
+    hash_tree b;
+    b.insert(key("alice"), 1);
+    b.insert(key("bob"), 5);
+    b.seal();
+    std::vector<bool> differ;
+    a.diff(b, &differ);
+    ASSERT_EQ(1U, count_differ(differ));
+    ASSERT_TRUE(differ[hash_tree::leaf_of(key("bob"))]);
+}
+
+TEST(HashTree, MissingObjectDiffersInItsLeaf)
+{
+    hash_tree a;
+    a.insert(key("alice"), 1);
+    a.insert(key("bob"), 2);
+    a.seal();
+    hash_tree b;
+    b.insert(key("alice"), 1);
+    b.seal();
+    std::vector<bool> differ;
+    a.diff(b, &differ);
+    ASSERT_EQ(1U, count_differ(differ));
+    ASSERT_TRUE(differ[hash_tree::leaf_of(key("bob"))]);
+    // and the diff is symmetric
+    b.diff(a, &differ);
+    ASSERT_EQ(1U, count_differ(differ));
+    ASSERT_TRUE(differ[hash_tree::leaf_of(key("bob"))]);
+}
+
+TEST(HashTree, AdoptLeaves)
+{
+    hash_tree a;
+    a.insert(key("alice"), 1);
+    a.insert(key("bob"), 2);
+    a.seal();
+    std::vector<uint64_t> ls;
+    a.leaves(&ls);
+    ASSERT_EQ(static_cast<size_t>(HASH_TREE_LEAVES), ls.size());
+    hash_tree b;
+    ASSERT_TRUE(b.adopt(ls));
+    std::vector<bool> differ;
+    a.diff(b, &differ);
+    ASSERT_EQ(0U, count_differ(differ));
+    ls.pop_back();
+    ASSERT_FALSE(b.adopt(ls));
+}
+
+} // namespace
@@ -0,0 +1,145 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdio.h>
+
+// STL
+#include <set>
+#include <string>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// HyperDex
+#include "daemon/index_filter.h"
+
+#pragma GCC diagnostic ignored "-Wswitch-default"
+
+using hyperdex::index_filter;
+
+namespace
+{
+
+std::string
+make_key(size_t i)
+{
+    char buf[32];
+    sprintf(buf, "key%lu", static_cast<unsigned long>(i));
+    return buf;
+}
+
+e::slice
+slice(const std::string& s)
+{
+    return e::slice(s.data(), s.size());
+}
+
+TEST(IndexFilter, Empty)
+{
+    index_filter f;
+    f.seal();
+    ASSERT_EQ(0U, f.size());
+    ASSERT_FALSE(f.may_contain(slice("key")));
+}
+
+TEST(IndexFilter, DuplicatesCollapse)
+{
+    index_filter f;
+    f.insert(slice("b"));
+    f.insert(slice("a"));
+    f.insert(slice("b"));
+    f.seal();
+    ASSERT_EQ(2U, f.size());
+    ASSERT_TRUE(f.may_contain(slice("a")));
+    ASSERT_TRUE(f.may_contain(slice("b")));
+}
+
+// Plan a search over two indices the way make_snapshot does:  candidates come
+// from one index, and the other becomes a filter.  Every key in both must
+// survive, and in practice nothing else does.
+TEST(IndexFilter, Intersection)
+{
+    std::vector<std::string> primary;
+    index_filter multiples_of_3;
+    index_filter multiples_of_5;
+
+    for (size_t i = 0; i < 10000; ++i)
+    {
+        if (i % 2 == 0)
+        {
+            primary.push_back(make_key(i));
+        }
+
+        if (i % 3 == 0)
+        {
+            multiples_of_3.insert(slice(make_key(i)));
+        }
+
+        // insert in descending order; the filter must not care
+        size_t j = 9999 - i;
+
+        if (j % 5 == 0)
+        {
+            multiples_of_5.insert(slice(make_key(j)));
+        }
+    }
+
+    multiples_of_3.seal();
+    multiples_of_5.seal();
+    std::vector<index_filter> filters;
+    filters.push_back(multiples_of_3);
+    filters.push_back(multiples_of_5);
+    std::set<std::string> survivors;
+
+    for (size_t i = 0; i < primary.size(); ++i)
+    {
+        bool filtered = false;
+
+        for (size_t f = 0; !filtered && f < filters.size(); ++f)
+        {
+            filtered = !filters[f].may_contain(slice(primary[i]));
+        }
+
+        if (!filtered)
+        {
+            survivors.insert(primary[i]);
+        }
+    }
+
+    std::set<std::string> expected;
+
+    for (size_t i = 0; i < 10000; i += 30)
+    {
+        expected.insert(make_key(i));
+    }
+
+    ASSERT_EQ(expected, survivors);
+}
+
+} // namespace
@@ -0,0 +1,174 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdio.h>
+#include <string.h>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// HyperDex
+#include "daemon/object_cache.h"
+
+#pragma GCC diagnostic ignored "-Wswitch-default"
+
+using hyperdex::object_cache;
+using hyperdex::region_id;
+
+namespace
+{
+
+object_cache::object_ptr
+make_object(const char* value, uint64_t version)
+{
+    object_cache::object* obj = new object_cache::object();
+    obj->backing = value;
+    obj->value.push_back(e::slice(obj->backing.data(), obj->backing.size()));
+    obj->version = version;
+    return object_cache::object_ptr(obj);
+}
+
+e::slice
+key(const char* k)
+{
+    return e::slice(k, strlen(k));
+}
+
+TEST(ObjectCache, DisabledByDefault)
+{
+    object_cache oc;
+    object_cache::object_ptr obj;
+    uint64_t stamp;
+    ASSERT_FALSE(oc.get(region_id(1), key("k"), &obj, &stamp));
+    oc.insert(region_id(1), key("k"), stamp, make_object("v", 1));
+    ASSERT_FALSE(oc.get(region_id(1), key("k"), &obj, &stamp));
+}
+
+TEST(ObjectCache, MissThenInsertThenHit)
+{
+    object_cache oc;
+    oc.set_capacity(1 << 20);
+    object_cache::object_ptr obj;
+    uint64_t stamp;
+    ASSERT_FALSE(oc.get(region_id(1), key("k"), &obj, &stamp));
+    object_cache::object_ptr v(make_object("v", 7));
+    oc.insert(region_id(1), key("k"), stamp, v);
+    ASSERT_TRUE(oc.get(region_id(1), key("k"), &obj, &stamp));
+    ASSERT_EQ(v.get(), obj.get());
+    ASSERT_EQ(7U, obj->version);
+    // the same key in another region is a different object
+    ASSERT_FALSE(oc.get(region_id(2), key("k"), &obj, &stamp));
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t bytes;
+    oc.stats(&hits, &misses, &bytes);
+    ASSERT_EQ(1U, hits);
+    ASSERT_EQ(2U, misses);
+    ASSERT_LT(0U, bytes);
+}
+
+TEST(ObjectCache, WriteAfterMissDropsStaleInsert)
+{
+    object_cache oc;
+    oc.set_capacity(1 << 20);
+    object_cache::object_ptr obj;
+    uint64_t stamp;
+
+    // a write lands between the miss and the insert of what the disk held
+    ASSERT_FALSE(oc.get(region_id(1), key("k"), &obj, &stamp));
+    oc.invalidate(region_id(1), key("k"));
+    oc.insert(region_id(1), key("k"), stamp, make_object("old", 1));
+    ASSERT_FALSE(oc.get(region_id(1), key("k"), &obj, &stamp));
+
+    // likewise for an update, which must not insert on its own
+    ASSERT_FALSE(oc.get(region_id(1), key("k"), &obj, &stamp));
+    oc.update(region_id(1), key("k"), make_object("new", 2));
+    oc.insert(region_id(1), key("k"), stamp, make_object("old", 1));
+    ASSERT_FALSE(oc.get(region_id(1), key("k"), &obj, &stamp));
+
+    // and for clear
+    oc.clear();
+    oc.insert(region_id(1), key("k"), stamp, make_object("old", 1));
+    ASSERT_FALSE(oc.get(region_id(1), key("k"), &obj, &stamp));
+
+    // with no intervening write the insert sticks
+    oc.insert(region_id(1), key("k"), stamp, make_object("old", 1));
+    ASSERT_TRUE(oc.get(region_id(1), key("k"), &obj, &stamp));
+}
+
+TEST(ObjectCache, UpdateAndInvalidate)
+{
+    object_cache oc;
+    oc.set_capacity(1 << 20);
+    object_cache::object_ptr obj;
+    uint64_t stamp;
+    ASSERT_FALSE(oc.get(region_id(1), key("k"), &obj, &stamp));
+    oc.insert(region_id(1), key("k"), stamp, make_object("v1", 1));
+    object_cache::object_ptr held;
+    ASSERT_TRUE(oc.get(region_id(1), key("k"), &held, &stamp));
+    oc.update(region_id(1), key("k"), make_object("v2", 2));
+    ASSERT_TRUE(oc.get(region_id(1), key("k"), &obj, &stamp));
+    ASSERT_EQ(2U, obj->version);
+    ASSERT_EQ("v2", obj->backing);
+    // readers keep what they were handed
+    ASSERT_EQ(1U, held->version);
+    ASSERT_EQ("v1", held->backing);
+    oc.invalidate(region_id(1), key("k"));
+    ASSERT_FALSE(oc.get(region_id(1), key("k"), &obj, &stamp));
+}
+
+TEST(ObjectCache, StaysWithinCapacity)
+{
+    object_cache oc;
+    const uint64_t capacity = 64 * 1024;
+    oc.set_capacity(capacity);
+    std::string value(200, 'x');
+
+    for (size_t i = 0; i < 10000; ++i)
+    {
+        char k[32];
+        sprintf(k, "key%lu", static_cast<unsigned long>(i));
+        object_cache::object_ptr obj;
+        uint64_t stamp;
+        ASSERT_FALSE(oc.get(region_id(1), key(k), &obj, &stamp));
+        oc.insert(region_id(1), key(k), stamp, make_object(value.c_str(), i));
+    }
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t bytes;
+    oc.stats(&hits, &misses, &bytes);
+    ASSERT_LE(bytes, capacity);
+    ASSERT_LT(0U, bytes);
+    // shrinking the cache evicts down to the new budget
+    oc.set_capacity(capacity / 4);
+    oc.stats(&hits, &misses, &bytes);
+    ASSERT_LE(bytes, capacity / 4);
+}
+
+} // namespace
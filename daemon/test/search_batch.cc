@@ -0,0 +1,86 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Google Test
+#include <gtest/gtest.h>
+
+// HyperDex
+#include "daemon/search_batch.h"
+
+#pragma GCC diagnostic ignored "-Wswitch-default"
+
+using hyperdex::search_batch;
+
+namespace
+{
+
+TEST(SearchBatch, TinyByteLimitStillTakesOne)
+{
+    // a limit below the header alone must not stall the search
+    search_batch b(100, 1, 24);
+    ASSERT_TRUE(b.has_room());
+    b.add(10);
+    ASSERT_FALSE(b.has_room());
+    ASSERT_EQ(1U, b.objects());
+    ASSERT_EQ(34U, b.bytes());
+}
+
+TEST(SearchBatch, ZeroByteLimitStillTakesOne)
+{
+    search_batch b(100, 0, 24);
+    ASSERT_TRUE(b.has_room());
+    b.add(1);
+    ASSERT_FALSE(b.has_room());
+}
+
+TEST(SearchBatch, ObjectLimit)
+{
+    search_batch b(3, 1 << 20, 24);
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        ASSERT_TRUE(b.has_room());
+        b.add(8);
+    }
+
+    ASSERT_FALSE(b.has_room());
+    ASSERT_EQ(3U, b.objects());
+}
+
+TEST(SearchBatch, ByteLimitIsSoft)
+{
+    search_batch b(100, 64, 24);
+    b.add(30);
+    ASSERT_TRUE(b.has_room());
+    // this object crosses the limit, and stays in the batch
+    b.add(30);
+    ASSERT_FALSE(b.has_room());
+    ASSERT_EQ(2U, b.objects());
+    ASSERT_EQ(84U, b.bytes());
+}
+
+} // namespace
@@ -32,6 +32,7 @@
 #include "datatypes/alltypes.h"
 #include "datatypes/apply.h"
 #include "datatypes/compare.h"
+#include "datatypes/elements.h"
 #include "datatypes/sizeof.h"
 #include "datatypes/validate.h"
 
@@ -79,6 +80,12 @@ passes_attribute_check(hyperdatatype type,
                     CONTAINER_TYPE(type) == HYPERDATATYPE_SET_GENERIC ||
                     CONTAINER_TYPE(type) == HYPERDATATYPE_MAP_GENERIC) &&
                    valid && static_cast<int64_t>(tmp_u) < tmp_i;
+        case HYPERPREDICATE_CONTAINS:
+            *error = MICROERR_CMPFAIL;
+            return validate_as_type(check.value, check.datatype) &&
+                   !IS_PRIMITIVE(type) &&
+                   container_element_type(type) == check.datatype &&
+                   container_contains(value, type, check.value);
         default:
             return false;
     }
@@ -0,0 +1,140 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// HyperDex
+#include "datatypes/elements.h"
+#include "datatypes/step.h"
+
+typedef bool (*step_func)(const uint8_t** ptr, const uint8_t* end, e::slice* elem);
+
+static step_func
+step_for(hyperdatatype type)
+{
+    switch (type)
+    {
+        case HYPERDATATYPE_STRING:
+            return step_string;
+        case HYPERDATATYPE_INT64:
+            return step_int64;
+        case HYPERDATATYPE_FLOAT:
+            return step_float;
+        default:
+            return NULL;
+    }
+}
+
+static bool
+steps_for(hyperdatatype type, step_func* step_elem, step_func* step_val)
+{
+    switch (CONTAINER_TYPE(type))
+    {
+        case HYPERDATATYPE_LIST_GENERIC:
+        case HYPERDATATYPE_SET_GENERIC:
+            *step_elem = step_for(static_cast<hyperdatatype>(CONTAINER_ELEM(type)));
+            *step_val = NULL;
+            return *step_elem != NULL;
+        case HYPERDATATYPE_MAP_GENERIC:
+            *step_elem = step_for(static_cast<hyperdatatype>(CONTAINER_KEY(type)));
+            *step_val = step_for(static_cast<hyperdatatype>(CONTAINER_VAL(type)));
+            return *step_elem != NULL && *step_val != NULL;
+        default:
+            return false;
+    }
+}
+
+static bool
+step_element(step_func step_elem, step_func step_val,
+             const uint8_t** ptr, const uint8_t* end,
+             e::slice* elem)
+{
+    e::slice val;
+    return step_elem(ptr, end, elem) &&
+           (!step_val || step_val(ptr, end, &val));
+}
+
+bool
+container_elements(const e::slice& value,
+                   hyperdatatype type,
+                   std::vector<e::slice>* elems)
+{
+    step_func step_elem;
+    step_func step_val;
+
+    if (!steps_for(type, &step_elem, &step_val))
+    {
+        return false;
+    }
+
+    const uint8_t* ptr = value.data();
+    const uint8_t* end = value.data() + value.size();
+    e::slice elem;
+
+    while (ptr < end)
+    {
+        if (!step_element(step_elem, step_val, &ptr, end, &elem))
+        {
+            return false;
+        }
+
+        elems->push_back(elem);
+    }
+
+    return ptr == end;
+}
+
+bool
+container_contains(const e::slice& value,
+                   hyperdatatype type,
+                   const e::slice& elem)
+{
+    step_func step_elem;
+    step_func step_val;
+
+    if (!steps_for(type, &step_elem, &step_val))
+    {
+        return false;
+    }
+
+    const uint8_t* ptr = value.data();
+    const uint8_t* end = value.data() + value.size();
+    e::slice tmp;
+
+    while (ptr < end)
+    {
+        if (!step_element(step_elem, step_val, &ptr, end, &tmp))
+        {
+            return false;
+        }
+
+        if (tmp == elem)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
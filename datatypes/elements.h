@@ -0,0 +1,64 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef datatypes_elements_h_
+#define datatypes_elements_h_
+
+// STL
+#include <vector>
+
+// e
+#include <e/slice.h>
+
+// HyperDex
+#include "hyperdex.h"
+
+// The primitive type of a list or set's elements, or of a map's keys
+inline hyperdatatype
+container_element_type(hyperdatatype type)
+{
+    if (CONTAINER_TYPE(type) == HYPERDATATYPE_MAP_GENERIC)
+    {
+        return static_cast<hyperdatatype>(CONTAINER_KEY(type));
+    }
+
+    return static_cast<hyperdatatype>(CONTAINER_ELEM(type));
+}
+
+// Append the elements of a list or set, or the keys of a map, to "elems"
+bool
+container_elements(const e::slice& value,
+                   hyperdatatype type,
+                   std::vector<e::slice>* elems);
+
+// True if "elem" is an element of the list or set, or a key of the map
+bool
+container_contains(const e::slice& value,
+                   hyperdatatype type,
+                   const e::slice& elem);
+
+#endif // datatypes_elements_h_
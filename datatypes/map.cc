@@ -27,12 +27,11 @@
 
 #define __STDC_LIMIT_MACROS
 
-// e
-#include <e/array_ptr.h>
-#include <e/endian.h>
+// STL
+#include <vector>
 
 // e
-#include <map>
+#include <e/endian.h>
 
 // HyperDex
 #include "datatypes/alltypes.h"
@@ -113,35 +112,39 @@ VALIDATE_MAP(float, string)
 VALIDATE_MAP(float, int64)
 VALIDATE_MAP(float, float)
 
-static bool
-apply_map_funcall(uint8_t* (*apply_pod)(const e::slice& old_value,
-                                        const funcall* funcs, size_t num_funcs,
-                                        uint8_t* writeto, microerror* error),
-                  std::map<e::slice, e::slice>* map,
-                  e::array_ptr<uint8_t>* scratch,
-                  const funcall* funcs, microerror* error)
+// A single change to one key of the map.  "func" is the funcall that produced
+// the edit; for a FUNC_SET whose argument had to be decoded pair-by-pair, "val"
+// holds the value from that argument.  Edits are stable-sorted by key, so all
+// edits to one key are adjacent and in funcall order.
+class map_edit
 {
-    std::map<e::slice, e::slice>::iterator it = map->find(funcs->arg2);
-    e::slice old_value("", 0);
+    public:
+        map_edit() : key(), val(), func(NULL) {}
+        map_edit(const e::slice& k, const e::slice& v, const funcall* f)
+            : key(k), val(v), func(f) {}
 
-    if (it != map->end())
-    {
-        old_value = it->second;
-    }
+    public:
+        e::slice key;
+        e::slice val;
+        const funcall* func;
+};
 
-    *scratch = new uint8_t[old_value.size() + sizeof(uint32_t) + funcs->arg1.size()];
-    uint8_t* write_to = apply_pod(old_value, funcs, 1, scratch->get(), error);
-    (*map)[funcs->arg2] = e::slice(scratch->get(), write_to - scratch->get());
-    return write_to != NULL;
+static bool
+compare_map_edit(int (*compare_key)(const e::slice& lhs, const e::slice& rhs),
+                 const map_edit& lhs, const map_edit& rhs)
+{
+    return compare_key(lhs.key, rhs.key) < 0;
 }
 
+// Rather than decoding the whole map, the funcalls are turned into a short list
+// of edits sorted by key that is merged with the encoded value in one pass,
+// writing each surviving pair straight to "writeto".
 static uint8_t*
 apply_map(bool (*step_key)(const uint8_t** ptr, const uint8_t* end, e::slice* elem),
           bool (*step_val)(const uint8_t** ptr, const uint8_t* end, e::slice* elem),
           bool (*validate_key)(const e::slice& elem),
           bool (*validate_val)(const e::slice& elem),
-          bool (*compare_pair_less)(const std::pair<e::slice, e::slice>& lhs,
-                                    const std::pair<e::slice, e::slice>& rhs),
+          int (*compare_key)(const e::slice& lhs, const e::slice& rhs),
           uint8_t* (*write_key)(uint8_t* writeto, const e::slice& elem),
           uint8_t* (*write_val)(uint8_t* writeto, const e::slice& elem),
           uint8_t* (*apply_pod)(const e::slice& old_value,
@@ -152,32 +155,13 @@ apply_map(bool (*step_key)(const uint8_t** ptr, const uint8_t* end, e::slice* el
           const funcall* funcs, size_t num_funcs,
           uint8_t* writeto, microerror* error)
 {
-    std::map<e::slice, e::slice> map;
-    const uint8_t* ptr = old_value.data();
-    const uint8_t* end = old_value.data() + old_value.size();
+    std::vector<map_edit> edits;
+    e::slice base = old_value;
+    const uint8_t* ptr;
+    const uint8_t* end;
     e::slice key;
     e::slice val;
 
-    while (ptr < end)
-    {
-        if (!step_key(&ptr, end, &key))
-        {
-            *error = MICROERR_MALFORMED;
-            return NULL;
-        }
-
-        if (!step_val(&ptr, end, &val))
-        {
-            *error = MICROERR_MALFORMED;
-            return NULL;
-        }
-
-        map.insert(std::make_pair(key, val));
-    }
-
-    e::array_ptr<e::array_ptr<uint8_t> > scratch;
-    scratch = new e::array_ptr<uint8_t>[num_funcs];
-
     for (size_t i = 0; i < num_funcs; ++i)
     {
         switch (funcs[i].name)
@@ -186,7 +170,8 @@ apply_map(bool (*step_key)(const uint8_t** ptr, const uint8_t* end, e::slice* el
                 if (funcs[i].arg1_datatype == HYPERDATATYPE_MAP_GENERIC &&
                     funcs[i].arg1.size() == 0)
                 {
-                    map.clear();
+                    base = e::slice();
+                    edits.clear();
                     continue;
                 }
                 else if (funcs[i].arg1_datatype == HYPERDATATYPE_MAP_GENERIC)
@@ -201,7 +186,16 @@ apply_map(bool (*step_key)(const uint8_t** ptr, const uint8_t* end, e::slice* el
                     return NULL;
                 }
 
-                map.clear();
+                edits.clear();
+
+                // A well-formed map can be used as the base as-is
+                if (validate_map(step_key, step_val, compare_key, funcs[i].arg1, NULL))
+                {
+                    base = funcs[i].arg1;
+                    continue;
+                }
+
+                base = e::slice();
                 ptr = funcs[i].arg1.data();
                 end = funcs[i].arg1.data() + funcs[i].arg1.size();
 
@@ -219,7 +213,7 @@ apply_map(bool (*step_key)(const uint8_t** ptr, const uint8_t* end, e::slice* el
                         return NULL;
                     }
 
-                    map.insert(std::make_pair(key, val));
+                    edits.push_back(map_edit(key, val, funcs + i));
                 }
 
                 break;
@@ -248,23 +242,9 @@ apply_map(bool (*step_key)(const uint8_t** ptr, const uint8_t* end, e::slice* el
                     return NULL;
                 }
 
-                map[funcs[i].arg2] = funcs[i].arg1;
+                edits.push_back(map_edit(funcs[i].arg2, funcs[i].arg1, funcs + i));
                 break;
             case hyperdex::FUNC_MAP_REMOVE:
-                if (keyt != funcs[i].arg2_datatype)
-                {
-                    *error = MICROERR_WRONGTYPE;
-                    return NULL;
-                }
-
-                if (!validate_key(funcs[i].arg2))
-                {
-                    *error = MICROERR_MALFORMED;
-                    return NULL;
-                }
-
-                map.erase(funcs[i].arg2);
-                break;
             case hyperdex::FUNC_STRING_APPEND:
             case hyperdex::FUNC_STRING_PREPEND:
             case hyperdex::FUNC_NUM_ADD:
@@ -287,11 +267,7 @@ apply_map(bool (*step_key)(const uint8_t** ptr, const uint8_t* end, e::slice* el
                     return NULL;
                 }
 
-                if (!apply_map_funcall(apply_pod, &map, &scratch[i], funcs + i, error))
-                {
-                    return NULL;
-                }
-
+                edits.push_back(map_edit(funcs[i].arg2, e::slice(), funcs + i));
                 break;
             case hyperdex::FUNC_FAIL:
             case hyperdex::FUNC_LIST_LPUSH:
@@ -306,13 +282,116 @@ apply_map(bool (*step_key)(const uint8_t** ptr, const uint8_t* end, e::slice* el
         }
     }
 
-    std::vector<std::pair<e::slice, e::slice> > v(map.begin(), map.end());
-    std::sort(v.begin(), v.end(), compare_pair_less);
+    std::stable_sort(edits.begin(), edits.end(),
+                     std::tr1::bind(compare_map_edit, compare_key,
+                                    std::tr1::placeholders::_1,
+                                    std::tr1::placeholders::_2));
+
+    // Values produced by string/numeric funcalls alternate between these two
+    // buffers, which are reused across keys.
+    std::vector<uint8_t> scratch[2];
+    size_t which = 0;
+    ptr = base.data();
+    end = base.data() + base.size();
+    bool has_pair = false;
+    size_t edit_idx = 0;
+
+    if (ptr < end)
+    {
+        if (!step_key(&ptr, end, &key) || !step_val(&ptr, end, &val))
+        {
+            *error = MICROERR_MALFORMED;
+            return NULL;
+        }
 
-    for (size_t i = 0; i < v.size(); ++i)
+        has_pair = true;
+    }
+
+    while (has_pair || edit_idx < edits.size())
     {
-        writeto = write_key(writeto, v[i].first);
-        writeto = write_val(writeto, v[i].second);
+        e::slice next_key;
+        e::slice next_val;
+        bool present = false;
+
+        if (has_pair &&
+            (edit_idx >= edits.size() ||
+             compare_key(key, edits[edit_idx].key) <= 0))
+        {
+            next_key = key;
+            next_val = val;
+            present = true;
+            has_pair = false;
+
+            if (ptr < end)
+            {
+                if (!step_key(&ptr, end, &key) || !step_val(&ptr, end, &val))
+                {
+                    *error = MICROERR_MALFORMED;
+                    return NULL;
+                }
+
+                has_pair = true;
+            }
+        }
+        else
+        {
+            next_key = edits[edit_idx].key;
+        }
+
+        const funcall* prev = NULL;
+
+        while (edit_idx < edits.size() &&
+               compare_key(edits[edit_idx].key, next_key) == 0)
+        {
+            const map_edit& edit(edits[edit_idx]);
+            ++edit_idx;
+
+            switch (edit.func->name)
+            {
+                case hyperdex::FUNC_SET:
+                    // the first pair for a key within one FUNC_SET wins
+                    if (edit.func != prev)
+                    {
+                        next_val = edit.val;
+                        present = true;
+                    }
+
+                    break;
+                case hyperdex::FUNC_MAP_ADD:
+                    next_val = edit.val;
+                    present = true;
+                    break;
+                case hyperdex::FUNC_MAP_REMOVE:
+                    present = false;
+                    break;
+                default:
+                    {
+                        e::slice old = present ? next_val : e::slice("", 0);
+                        scratch[which].resize(old.size() + sizeof(uint32_t) + edit.func->arg1.size());
+                        uint8_t* out = &scratch[which][0];
+                        uint8_t* out_end = apply_pod(old, edit.func, 1, out, error);
+
+                        if (!out_end)
+                        {
+                            return NULL;
+                        }
+
+                        next_val = e::slice(out, out_end - out);
+                        present = true;
+                        which = 1 - which;
+                    }
+
+                    break;
+            }
+
+            prev = edit.func;
+        }
+
+        if (present)
+        {
+            writeto = write_key(writeto, next_key);
+            writeto = write_val(writeto, next_val);
+        }
     }
 
     return writeto;
@@ -333,14 +412,6 @@ wrap_apply_string(const e::slice& old_value,
     return writeto;
 }
 
-template<int (*compare)(const e::slice& lhs, const e::slice& rhs)>
-static bool
-cmp_pair_first(const std::pair<e::slice, e::slice>& lhs,
-               const std::pair<e::slice, e::slice>& rhs)
-{
-    return compare(lhs.first, rhs.first) < 0;
-}
-
 #define APPLY_MAP(KEY_T, VAL_T, KEY_TC, VAL_TC, WRAP_PREFIX) \
     uint8_t* \
     apply_map_ ## KEY_T ## _ ## VAL_T(const e::slice& old_value, \
@@ -349,7 +420,7 @@ cmp_pair_first(const std::pair<e::slice, e::slice>& lhs,
     { \
         return apply_map(step_ ## KEY_T, step_ ## VAL_T, \
                          validate_as_ ## KEY_T, validate_as_ ## VAL_T, \
-                         cmp_pair_first<compare_ ## KEY_T>, \
+                         compare_ ## KEY_T, \
                          write_ ## KEY_T, write_ ## VAL_T, \
                          apply_ ## VAL_T, \
                          HYPERDATATYPE_MAP_ ## KEY_TC ## _ ## VAL_TC, \
@@ -29,7 +29,12 @@
 
 // STL
 #include <algorithm>
-#include <set>
+#include <vector>
+#ifdef _MSC_VER
+#include <functional>
+#else
+#include <tr1/functional>
+#endif
 
 // HyperDex
 #include "datatypes/alltypes.h"
@@ -96,30 +101,54 @@ VALIDATE_SET(string)
 VALIDATE_SET(int64)
 VALIDATE_SET(float)
 
-template<int (*compare)(const e::slice& lhs, const e::slice& rhs)>
+// A single membership change produced by one funcall.  Edits are collected in
+// funcall order and stable-sorted by element, so the last edit for an element
+// decides whether it survives the merge.
+class set_edit
+{
+    public:
+        set_edit() : elem(), add(false) {}
+        set_edit(const e::slice& e, bool a) : elem(e), add(a) {}
+
+    public:
+        e::slice elem;
+        bool add;
+};
+
+static bool
+compare_elem_less(int (*compare_elem)(const e::slice& lhs, const e::slice& rhs),
+                  const e::slice& lhs, const e::slice& rhs)
+{
+    return compare_elem(lhs, rhs) < 0;
+}
+
 static bool
-compare_less(const e::slice& lhs, const e::slice& rhs)
+compare_set_edit(int (*compare_elem)(const e::slice& lhs, const e::slice& rhs),
+                 const set_edit& lhs, const set_edit& rhs)
 {
-    return compare(lhs, rhs) < 0;
+    return compare_elem(lhs.elem, rhs.elem) < 0;
 }
 
+// Merge the encoded, sorted set "base" with the sorted "edits" and write the
+// result directly to "writeto".  If "filter" is non-NULL, only elements that
+// also appear in the (sorted) filter are kept.
 static uint8_t*
-apply_set(bool (*step_elem)(const uint8_t** ptr, const uint8_t* end, e::slice* elem),
-          bool (*validate_elem)(const e::slice& elem),
-          bool (*compare_elem_less)(const e::slice& lhs, const e::slice& rhs),
+merge_set(bool (*step_elem)(const uint8_t** ptr, const uint8_t* end, e::slice* elem),
+          int (*compare_elem)(const e::slice& lhs, const e::slice& rhs),
           uint8_t* (*write_elem)(uint8_t* writeto, const e::slice& elem),
-          hyperdatatype container, hyperdatatype element,
-          const e::slice& old_value,
-          const funcall* funcs, size_t num_funcs,
+          const e::slice& base,
+          const std::vector<set_edit>& edits,
+          const std::vector<e::slice>* filter,
           uint8_t* writeto, microerror* error)
 {
-    std::set<e::slice> set;
-    std::set<e::slice> tmp;
-    const uint8_t* ptr = old_value.data();
-    const uint8_t* end = old_value.data() + old_value.size();
+    const uint8_t* ptr = base.data();
+    const uint8_t* end = base.data() + base.size();
     e::slice elem;
+    bool has_elem = false;
+    size_t edit_idx = 0;
+    size_t filter_idx = 0;
 
-    while (ptr < end)
+    if (ptr < end)
     {
         if (!step_elem(&ptr, end, &elem))
         {
@@ -127,19 +156,106 @@ apply_set(bool (*step_elem)(const uint8_t** ptr, const uint8_t* end, e::slice* e
             return NULL;
         }
 
-        set.insert(elem);
+        has_elem = true;
     }
 
+    while (has_elem || edit_idx < edits.size())
+    {
+        e::slice next;
+        bool member = false;
+
+        if (has_elem &&
+            (edit_idx >= edits.size() ||
+             compare_elem(elem, edits[edit_idx].elem) <= 0))
+        {
+            next = elem;
+            member = true;
+            has_elem = false;
+
+            if (ptr < end)
+            {
+                if (!step_elem(&ptr, end, &elem))
+                {
+                    *error = MICROERR_MALFORMED;
+                    return NULL;
+                }
+
+                has_elem = true;
+            }
+        }
+        else
+        {
+            next = edits[edit_idx].elem;
+        }
+
+        while (edit_idx < edits.size() &&
+               compare_elem(edits[edit_idx].elem, next) == 0)
+        {
+            member = edits[edit_idx].add;
+            ++edit_idx;
+        }
+
+        if (member && filter)
+        {
+            while (filter_idx < filter->size() &&
+                   compare_elem((*filter)[filter_idx], next) < 0)
+            {
+                ++filter_idx;
+            }
+
+            member = filter_idx < filter->size() &&
+                     compare_elem((*filter)[filter_idx], next) == 0;
+        }
+
+        if (member)
+        {
+            writeto = write_elem(writeto, next);
+        }
+    }
+
+    return writeto;
+}
+
+// Rather than decoding the whole set, the funcalls are turned into a short
+// list of sorted edits that are merged with the encoded value in one pass.
+// An intersection has to see everything before it, so each one closes a
+// segment that is merged into scratch space and becomes the next base.
+static uint8_t*
+apply_set(bool (*step_elem)(const uint8_t** ptr, const uint8_t* end, e::slice* elem),
+          bool (*validate_elem)(const e::slice& elem),
+          int (*compare_elem)(const e::slice& lhs, const e::slice& rhs),
+          uint8_t* (*write_elem)(uint8_t* writeto, const e::slice& elem),
+          hyperdatatype container, hyperdatatype element,
+          const e::slice& old_value,
+          const funcall* funcs, size_t num_funcs,
+          uint8_t* writeto, microerror* error)
+{
+    std::vector<set_edit> edits;
+    std::vector<e::slice> filter;
+    std::vector<uint8_t> scratch[2];
+    size_t which = 0;
+    size_t edit_bytes = 0;
+    e::slice base = old_value;
+    const uint8_t* ptr;
+    const uint8_t* end;
+    e::slice elem;
+
     for (size_t i = 0; i < num_funcs; ++i)
     {
         switch (funcs[i].name)
         {
             case hyperdex::FUNC_SET:
-                set.clear();
             case hyperdex::FUNC_SET_UNION:
                 if (funcs[i].arg1_datatype == HYPERDATATYPE_SET_GENERIC &&
                     funcs[i].arg1.size() == 0)
                 {
+                    if (funcs[i].name == hyperdex::FUNC_SET)
+                    {
+                        base = e::slice();
+                        edits.clear();
+                        edit_bytes = 0;
+                    }
+
                     continue;
                 }
                 else if (funcs[i].arg1_datatype == HYPERDATATYPE_SET_GENERIC)
@@ -154,6 +270,21 @@ apply_set(bool (*step_elem)(const uint8_t** ptr, const uint8_t* end, e::slice* e
                     return NULL;
                 }
 
+                if (funcs[i].name == hyperdex::FUNC_SET)
+                {
+                    edits.clear();
+                    edit_bytes = 0;
+
+                    // A well-formed set can be used as the base as-is
+                    if (validate_set(step_elem, compare_elem, funcs[i].arg1, NULL))
+                    {
+                        base = funcs[i].arg1;
+                        continue;
+                    }
+
+                    base = e::slice();
+                }
+
                 ptr = funcs[i].arg1.data();
                 end = funcs[i].arg1.data() + funcs[i].arg1.size();
 
@@ -165,25 +296,12 @@ apply_set(bool (*step_elem)(const uint8_t** ptr, const uint8_t* end, e::slice* e
                         return NULL;
                     }
 
-                    set.insert(elem);
+                    edits.push_back(set_edit(elem, true));
+                    edit_bytes += sizeof(uint32_t) + elem.size();
                 }
 
                 break;
             case hyperdex::FUNC_SET_ADD:
-                if (element != funcs[i].arg1_datatype)
-                {
-                    *error = MICROERR_WRONGTYPE;
-                    return NULL;
-                }
-
-                if (!validate_elem(funcs[i].arg1))
-                {
-                    *error = MICROERR_MALFORMED;
-                    return NULL;
-                }
-
-                set.insert(funcs[i].arg1);
-                break;
             case hyperdex::FUNC_SET_REMOVE:
                 if (element != funcs[i].arg1_datatype)
                 {
@@ -197,46 +315,76 @@ apply_set(bool (*step_elem)(const uint8_t** ptr, const uint8_t* end, e::slice* e
                     return NULL;
                 }
 
-                set.erase(funcs[i].arg1);
+                edits.push_back(set_edit(funcs[i].arg1, funcs[i].name == hyperdex::FUNC_SET_ADD));
+                edit_bytes += sizeof(uint32_t) + funcs[i].arg1.size();
                 break;
             case hyperdex::FUNC_SET_INTERSECT:
+                filter.clear();
+
                 if (funcs[i].arg1_datatype == HYPERDATATYPE_SET_GENERIC &&
                     funcs[i].arg1.size() == 0)
                 {
-                    set.clear();
-                    continue;
+                    // intersect with the empty set
                 }
                 else if (funcs[i].arg1_datatype == HYPERDATATYPE_SET_GENERIC)
                 {
                     *error = MICROERR_MALFORMED;
                     return NULL;
                 }
-
-                if (container != funcs[i].arg1_datatype)
+                else if (container != funcs[i].arg1_datatype)
                 {
                     *error = MICROERR_WRONGTYPE;
                     return NULL;
                 }
+                else
+                {
+                    ptr = funcs[i].arg1.data();
+                    end = funcs[i].arg1.data() + funcs[i].arg1.size();
 
-                tmp.clear();
-                ptr = funcs[i].arg1.data();
-                end = funcs[i].arg1.data() + funcs[i].arg1.size();
+                    while (ptr < end)
+                    {
+                        if (!step_elem(&ptr, end, &elem))
+                        {
+                            *error = MICROERR_MALFORMED;
+                            return NULL;
+                        }
 
-                while (ptr < end)
+                        filter.push_back(elem);
+                    }
+
+                    std::sort(filter.begin(), filter.end(),
+                              std::tr1::bind(compare_elem_less, compare_elem,
+                                             std::tr1::placeholders::_1,
+                                             std::tr1::placeholders::_2));
+                }
+
+                if (base.size() + edit_bytes == 0)
                 {
-                    if (!step_elem(&ptr, end, &elem))
+                    continue;
+                }
+
+                std::stable_sort(edits.begin(), edits.end(),
+                                 std::tr1::bind(compare_set_edit, compare_elem,
+                                                std::tr1::placeholders::_1,
+                                                std::tr1::placeholders::_2));
+                scratch[which].resize(base.size() + edit_bytes);
+
+                {
+                    uint8_t* out = &scratch[which][0];
+                    uint8_t* out_end = merge_set(step_elem, compare_elem, write_elem,
+                                                 base, edits, &filter, out, error);
+
+                    if (!out_end)
                     {
-                        *error = MICROERR_MALFORMED;
                         return NULL;
                     }
 
-                    if (set.find(elem) != set.end())
-                    {
-                        tmp.insert(elem);
-                    }
+                    base = e::slice(out, out_end - out);
                 }
 
-                set.swap(tmp);
+                which = 1 - which;
+                edits.clear();
+                edit_bytes = 0;
                 break;
             case hyperdex::FUNC_FAIL:
             case hyperdex::FUNC_STRING_APPEND:
@@ -259,15 +407,12 @@ apply_set(bool (*step_elem)(const uint8_t** ptr, const uint8_t* end, e::slice* e
         }
     }
 
-    std::vector<e::slice> v(set.begin(), set.end());
-    std::sort(v.begin(), v.end(), compare_elem_less);
-
-    for (size_t i = 0; i < v.size(); ++i)
-    {
-        writeto = write_elem(writeto, v[i]);
-    }
-
-    return writeto;
+    std::stable_sort(edits.begin(), edits.end(),
+                     std::tr1::bind(compare_set_edit, compare_elem,
+                                    std::tr1::placeholders::_1,
+                                    std::tr1::placeholders::_2));
+    return merge_set(step_elem, compare_elem, write_elem,
+                     base, edits, NULL, writeto, error);
 }
 
 #define APPLY_SET(TYPE, TYPECAPS) \
@@ -277,7 +422,7 @@ apply_set(bool (*step_elem)(const uint8_t** ptr, const uint8_t* end, e::slice* e
                        uint8_t* writeto, microerror* error) \
     { \
         return apply_set(step_ ## TYPE, validate_as_ ## TYPE, \
-                         compare_less<compare_ ## TYPE>, write_ ## TYPE, \
+                         compare_ ## TYPE, write_ ## TYPE, \
                          HYPERDATATYPE_SET_ ## TYPECAPS, HYPERDATATYPE_ ## TYPECAPS, \
                          old_value, funcs, num_funcs, writeto, error); \
     }
@@ -0,0 +1,273 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <string.h>
+
+// STL
+#include <string>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// e
+#include <e/endian.h>
+
+// HyperDex
+#include "datatypes/map.h"
+#include "datatypes/set.h"
+
+#pragma GCC diagnostic ignored "-Wswitch-default"
+
+using hyperdex::funcall;
+
+namespace
+{
+
+// encode strings the way a set<string> or map<string, string> stores them
+std::string
+encode(const char* const* strs, size_t strs_sz)
+{
+    std::string out;
+
+    for (size_t i = 0; i < strs_sz; ++i)
+    {
+        uint8_t buf[sizeof(uint32_t)];
+        e::pack32le(static_cast<uint32_t>(strlen(strs[i])), buf);
+        out.append(reinterpret_cast<const char*>(buf), sizeof(buf));
+        out.append(strs[i]);
+    }
+
+    return out;
+}
+
+std::string
+encode_int64(const int64_t* nums, size_t nums_sz)
+{
+    std::string out;
+
+    for (size_t i = 0; i < nums_sz; ++i)
+    {
+        uint8_t buf[sizeof(int64_t)];
+        e::pack64le(nums[i], buf);
+        out.append(reinterpret_cast<const char*>(buf), sizeof(buf));
+    }
+
+    return out;
+}
+
+e::slice
+slice(const std::string& s)
+{
+    return e::slice(s.data(), s.size());
+}
+
+funcall
+set_func(hyperdex::funcall_t name, const std::string& arg, hyperdatatype type)
+{
+    funcall f;
+    f.attr = 1;
+    f.name = name;
+    f.arg1 = slice(arg);
+    f.arg1_datatype = type;
+    return f;
+}
+
+funcall
+map_func(hyperdex::funcall_t name, const std::string& key, const std::string& val)
+{
+    funcall f;
+    f.attr = 1;
+    f.name = name;
+    f.arg1 = slice(val);
+    f.arg1_datatype = HYPERDATATYPE_STRING;
+    f.arg2 = slice(key);
+    f.arg2_datatype = HYPERDATATYPE_STRING;
+    return f;
+}
+
+// apply to a set<string>, returning the encoded result or "ERROR"
+std::string
+apply_strings(const std::string& old_value, const std::vector<funcall>& funcs)
+{
+    size_t sz = old_value.size();
+
+    for (size_t i = 0; i < funcs.size(); ++i)
+    {
+        sz += funcs[i].arg1.size() + funcs[i].arg2.size() + 2 * sizeof(uint32_t);
+    }
+
+    std::vector<uint8_t> buf(sz + 1);
+    microerror err;
+    uint8_t* end = apply_set_string(slice(old_value), &funcs[0], funcs.size(), &buf[0], &err);
+
+    if (!end)
+    {
+        return "ERROR";
+    }
+
+    return std::string(reinterpret_cast<const char*>(&buf[0]), end - &buf[0]);
+}
+
+TEST(ApplySet, AddAndRemove)
+{
+    const char* base[] = {"b", "d"};
+    std::string a("a");
+    std::string c("c");
+    std::string d("d");
+    std::vector<funcall> funcs;
+    funcs.push_back(set_func(hyperdex::FUNC_SET_ADD, c, HYPERDATATYPE_STRING));
+    funcs.push_back(set_func(hyperdex::FUNC_SET_REMOVE, d, HYPERDATATYPE_STRING));
+    funcs.push_back(set_func(hyperdex::FUNC_SET_ADD, a, HYPERDATATYPE_STRING));
+    const char* expect[] = {"a", "b", "c"};
+    ASSERT_EQ(encode(expect, 3), apply_strings(encode(base, 2), funcs));
+}
+
+TEST(ApplySet, FuncallOrderWithinAnElement)
+{
+    const char* base[] = {"m"};
+    std::string x("x");
+    std::string m("m");
+    std::vector<funcall> funcs;
+    // the last edit to an element wins
+    funcs.push_back(set_func(hyperdex::FUNC_SET_ADD, x, HYPERDATATYPE_STRING));
+    funcs.push_back(set_func(hyperdex::FUNC_SET_REMOVE, x, HYPERDATATYPE_STRING));
+    funcs.push_back(set_func(hyperdex::FUNC_SET_REMOVE, m, HYPERDATATYPE_STRING));
+    funcs.push_back(set_func(hyperdex::FUNC_SET_ADD, m, HYPERDATATYPE_STRING));
+    const char* expect[] = {"m"};
+    ASSERT_EQ(encode(expect, 1), apply_strings(encode(base, 1), funcs));
+}
+
+TEST(ApplySet, SetWithUnsortedArgument)
+{
+    const char* base[] = {"q"};
+    const char* arg[] = {"c", "a", "c"};
+    std::string argv(encode(arg, 3));
+    std::vector<funcall> funcs;
+    funcs.push_back(set_func(hyperdex::FUNC_SET, argv, HYPERDATATYPE_SET_STRING));
+    const char* expect[] = {"a", "c"};
+    ASSERT_EQ(encode(expect, 2), apply_strings(encode(base, 1), funcs));
+}
+
+TEST(ApplySet, IntersectClosesASegment)
+{
+    const char* base[] = {"a", "b", "c"};
+    const char* filter[] = {"e", "b", "d"};
+    std::string filterv(encode(filter, 3));
+    std::string d("d");
+    std::string z("z");
+    std::vector<funcall> funcs;
+    funcs.push_back(set_func(hyperdex::FUNC_SET_ADD, d, HYPERDATATYPE_STRING));
+    funcs.push_back(set_func(hyperdex::FUNC_SET_INTERSECT, filterv, HYPERDATATYPE_SET_STRING));
+    // added after the intersect, so it survives it
+    funcs.push_back(set_func(hyperdex::FUNC_SET_ADD, z, HYPERDATATYPE_STRING));
+    const char* expect[] = {"b", "d", "z"};
+    ASSERT_EQ(encode(expect, 3), apply_strings(encode(base, 3), funcs));
+}
+
+TEST(ApplySet, Errors)
+{
+    const char* base[] = {"a"};
+    std::string bad("\xff\xff\xff\xff", 4);
+    std::string a("a");
+    std::vector<funcall> funcs;
+    funcs.push_back(set_func(hyperdex::FUNC_SET_ADD, a, HYPERDATATYPE_INT64));
+    ASSERT_EQ("ERROR", apply_strings(encode(base, 1), funcs));
+    funcs.clear();
+    funcs.push_back(set_func(hyperdex::FUNC_SET_ADD, a, HYPERDATATYPE_STRING));
+    ASSERT_EQ("ERROR", apply_strings(bad, funcs));
+}
+
+TEST(ApplySet, Int64SortsNumerically)
+{
+    const int64_t base[] = {-5, 3};
+    const int64_t add[] = {-7, 1, 300};
+    std::string basev(encode_int64(base, 2));
+    std::string addv[3];
+    std::vector<funcall> funcs;
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        addv[i] = encode_int64(add + i, 1);
+        funcs.push_back(set_func(hyperdex::FUNC_SET_ADD, addv[i], HYPERDATATYPE_INT64));
+    }
+
+    std::vector<uint8_t> buf(basev.size() + 3 * sizeof(int64_t));
+    microerror err;
+    uint8_t* end = apply_set_int64(slice(basev), &funcs[0], funcs.size(), &buf[0], &err);
+    ASSERT_TRUE(end != NULL);
+    const int64_t expect[] = {-7, -5, 1, 3, 300};
+    ASSERT_EQ(encode_int64(expect, 5),
+              std::string(reinterpret_cast<const char*>(&buf[0]), end - &buf[0]));
+}
+
+TEST(ApplyMap, AddReplaceAndRemove)
+{
+    const char* base[] = {"a", "1", "c", "3"};
+    std::string a("a");
+    std::string b("b");
+    std::string c("c");
+    std::string two("2");
+    std::string nine("9");
+    std::string empty;
+    std::vector<funcall> funcs;
+    funcs.push_back(map_func(hyperdex::FUNC_MAP_ADD, b, two));
+    funcs.push_back(map_func(hyperdex::FUNC_MAP_ADD, a, nine));
+    funcs.push_back(map_func(hyperdex::FUNC_MAP_REMOVE, c, empty));
+    std::string basev(encode(base, 4));
+    std::vector<uint8_t> buf(basev.size() + 64);
+    microerror err;
+    uint8_t* end = apply_map_string_string(slice(basev), &funcs[0], funcs.size(), &buf[0], &err);
+    ASSERT_TRUE(end != NULL);
+    const char* expect[] = {"a", "9", "b", "2"};
+    ASSERT_EQ(encode(expect, 4),
+              std::string(reinterpret_cast<const char*>(&buf[0]), end - &buf[0]));
+}
+
+TEST(ApplyMap, StringFuncallsApplyInOrder)
+{
+    const char* base[] = {"k", "mid"};
+    std::string k("k");
+    std::string pre("pre-");
+    std::string post("-post");
+    std::vector<funcall> funcs;
+    funcs.push_back(map_func(hyperdex::FUNC_STRING_APPEND, k, post));
+    funcs.push_back(map_func(hyperdex::FUNC_STRING_PREPEND, k, pre));
+    std::string basev(encode(base, 2));
+    std::vector<uint8_t> buf(basev.size() + 64);
+    microerror err;
+    uint8_t* end = apply_map_string_string(slice(basev), &funcs[0], funcs.size(), &buf[0], &err);
+    ASSERT_TRUE(end != NULL);
+    const char* expect[] = {"k", "pre-mid-post"};
+    ASSERT_EQ(encode(expect, 2),
+              std::string(reinterpret_cast<const char*>(&buf[0]), end - &buf[0]));
+}
+
+} // namespace
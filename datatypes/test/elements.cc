@@ -0,0 +1,172 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <string.h>
+
+// STL
+#include <string>
+#include <vector>
+
+// Google Test
+#include <gtest/gtest.h>
+
+// e
+#include <e/endian.h>
+
+// HyperDex
+#include "datatypes/elements.h"
+
+#pragma GCC diagnostic ignored "-Wswitch-default"
+
+namespace
+{
+
+void
+append_string(std::string* out, const char* str)
+{
+    uint8_t buf[sizeof(uint32_t)];
+    e::pack32le(static_cast<uint32_t>(strlen(str)), buf);
+    out->append(reinterpret_cast<const char*>(buf), sizeof(buf));
+    out->append(str);
+}
+
+void
+append_int64(std::string* out, int64_t num)
+{
+    uint8_t buf[sizeof(int64_t)];
+    e::pack64le(num, buf);
+    out->append(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+e::slice
+slice(const std::string& s)
+{
+    return e::slice(s.data(), s.size());
+}
+
+std::vector<std::string>
+elements(const std::string& value, hyperdatatype type)
+{
+    std::vector<e::slice> elems;
+    std::vector<std::string> out;
+    EXPECT_TRUE(container_elements(slice(value), type, &elems));
+
+    for (size_t i = 0; i < elems.size(); ++i)
+    {
+        out.push_back(std::string(reinterpret_cast<const char*>(elems[i].data()), elems[i].size()));
+    }
+
+    return out;
+}
+
+TEST(Elements, ElementType)
+{
+    ASSERT_EQ(HYPERDATATYPE_STRING, container_element_type(HYPERDATATYPE_LIST_STRING));
+    ASSERT_EQ(HYPERDATATYPE_INT64, container_element_type(HYPERDATATYPE_SET_INT64));
+    ASSERT_EQ(HYPERDATATYPE_FLOAT, container_element_type(HYPERDATATYPE_MAP_FLOAT_STRING));
+    ASSERT_EQ(HYPERDATATYPE_STRING, container_element_type(HYPERDATATYPE_MAP_STRING_INT64));
+}
+
+TEST(Elements, ListOfStrings)
+{
+    std::string value;
+    append_string(&value, "b");
+    append_string(&value, "a");
+    append_string(&value, "b");
+    std::vector<std::string> elems = elements(value, HYPERDATATYPE_LIST_STRING);
+    ASSERT_EQ(3U, elems.size());
+    ASSERT_EQ("b", elems[0]);
+    ASSERT_EQ("a", elems[1]);
+    ASSERT_EQ("b", elems[2]);
+    ASSERT_TRUE(container_contains(slice(value), HYPERDATATYPE_LIST_STRING, e::slice("a", 1)));
+    ASSERT_FALSE(container_contains(slice(value), HYPERDATATYPE_LIST_STRING, e::slice("c", 1)));
+}
+
+TEST(Elements, SetOfInt64)
+{
+    std::string value;
+    append_int64(&value, -1);
+    append_int64(&value, 7);
+    std::vector<std::string> elems = elements(value, HYPERDATATYPE_SET_INT64);
+    ASSERT_EQ(2U, elems.size());
+    std::string seven;
+    append_int64(&seven, 7);
+    ASSERT_EQ(seven, elems[1]);
+    ASSERT_TRUE(container_contains(slice(value), HYPERDATATYPE_SET_INT64, slice(seven)));
+    std::string eight;
+    append_int64(&eight, 8);
+    ASSERT_FALSE(container_contains(slice(value), HYPERDATATYPE_SET_INT64, slice(eight)));
+}
+
+// maps yield their keys, never their values
+TEST(Elements, MapKeys)
+{
+    std::string value;
+    append_string(&value, "k1");
+    append_int64(&value, 1);
+    append_string(&value, "k2");
+    append_int64(&value, 2);
+    std::vector<std::string> elems = elements(value, HYPERDATATYPE_MAP_STRING_INT64);
+    ASSERT_EQ(2U, elems.size());
+    ASSERT_EQ("k1", elems[0]);
+    ASSERT_EQ("k2", elems[1]);
+    ASSERT_TRUE(container_contains(slice(value), HYPERDATATYPE_MAP_STRING_INT64, e::slice("k2", 2)));
+    std::string one;
+    append_int64(&one, 1);
+    ASSERT_FALSE(container_contains(slice(value), HYPERDATATYPE_MAP_STRING_INT64, slice(one)));
+}
+
+TEST(Elements, Empty)
+{
+    ASSERT_TRUE(elements("", HYPERDATATYPE_SET_STRING).empty());
+    ASSERT_FALSE(container_contains(e::slice(), HYPERDATATYPE_SET_STRING, e::slice("a", 1)));
+}
+
+TEST(Elements, Truncated)
+{
+    std::string value;
+    append_string(&value, "abc");
+    value.resize(value.size() - 1);
+    std::vector<e::slice> elems;
+    ASSERT_FALSE(container_elements(slice(value), HYPERDATATYPE_LIST_STRING, &elems));
+
+    std::string map;
+    append_string(&map, "k");
+    ASSERT_FALSE(container_elements(slice(map), HYPERDATATYPE_MAP_STRING_STRING, &elems));
+}
+
+TEST(Elements, NotAContainer)
+{
+    std::vector<e::slice> elems;
+    ASSERT_FALSE(container_elements(e::slice("abc", 3), HYPERDATATYPE_STRING, &elems));
+    ASSERT_FALSE(container_contains(e::slice("abc", 3), HYPERDATATYPE_STRING, e::slice("a", 1)));
+}
+
+} // namespace
@@ -84,6 +84,7 @@ static subcommand subcommands[] = {
     subcommand("daemon",                "Start a new HyperDex daemon"),
     subcommand("add-space",             "Create a new space"),
     subcommand("rm-space",              "Remove an existing space"),
+    subcommand("add-index",             "Index an attribute of an existing space"),
     subcommand("initialize-cluster",    "One time initialization of a HyperDex coordinator"),
     subcommand("initiate-transfer",     "Manually start a data transfer to repair a failure"),
     subcommand("show-config",           "Output a human-readable version of the cluster configuration"),
@@ -91,7 +91,8 @@ enum hyperpredicate
     HYPERPREDICATE_EQUALS        = 9729,
     HYPERPREDICATE_LESS_EQUAL    = 9730,
     HYPERPREDICATE_GREATER_EQUAL = 9731,
-    HYPERPREDICATE_CONTAINS_LESS_THAN = 9732
+    HYPERPREDICATE_CONTAINS_LESS_THAN = 9732,
+    HYPERPREDICATE_CONTAINS      = 9733
 };
 
 #ifdef __cplusplus
@@ -0,0 +1,289 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Replicant nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <cstdio>
+#include <cstdlib>
+
+// STL
+#include <memory>
+#include <vector>
+
+// Popt
+#include <popt.h>
+
+// e
+#include <e/buffer.h>
+#include <e/guard.h>
+#include <e/time.h>
+
+// HyperDex
+#include "client/partition.h"
+#include "common/configuration.h"
+#include "common/hyperspace.h"
+#include "common/serialization.h"
+
+using hyperdex::configuration;
+using hyperdex::region;
+using hyperdex::region_id;
+using hyperdex::replica;
+using hyperdex::schema;
+using hyperdex::server_id;
+using hyperdex::space;
+using hyperdex::subspace;
+using hyperdex::subspace_id;
+using hyperdex::virtual_server_id;
+using hyperdex::operator <<;
+using hyperdex::pack_size;
+
+static long _lookups = 1000000;
+static long _servers = 64;
+
+static struct poptOption popts[] = {
+    POPT_AUTOHELP
+    {"lookups", 'n', POPT_ARG_LONG, &_lookups, 'n',
+     "number of lookups to time for each operation (default: 1000000)",
+     "N"},
+    {"servers", 's', POPT_ARG_LONG, &_servers, 's',
+     "number of servers to spread replicas across (default: 64)",
+     "N"},
+    POPT_TABLEEND
+};
+
+// Build a configuration with one space of three attributes.  The key subspace
+// has num_regions regions along the key, and the second subspace is a 2-D grid
+// over the other two attributes, just as the client partitioner would make it.
+static bool
+build_configuration(uint32_t num_regions, configuration* config, region_id* grid)
+{
+    hyperdex::attribute attrs[3];
+    attrs[0] = hyperdex::attribute("k", HYPERDATATYPE_STRING);
+    attrs[1] = hyperdex::attribute("a", HYPERDATATYPE_STRING);
+    attrs[2] = hyperdex::attribute("b", HYPERDATATYPE_STRING);
+    schema sc;
+    sc.attrs_sz = 3;
+    sc.attrs = attrs;
+    space s("bench", sc);
+    s.id = hyperdex::space_id(1);
+    s.fault_tolerance = 1;
+    s.subspaces.resize(2);
+    s.subspaces[0].id = subspace_id(2);
+    s.subspaces[0].attrs.push_back(0);
+    hyperdex::partition(1, num_regions, &s.subspaces[0].regions);
+    s.subspaces[1].id = subspace_id(3);
+    s.subspaces[1].attrs.push_back(1);
+    s.subspaces[1].attrs.push_back(2);
+    hyperdex::partition(2, num_regions, &s.subspaces[1].regions);
+    uint64_t next_id = 4;
+    *grid = region_id();
+
+    for (size_t x = 0; x < s.subspaces.size(); ++x)
+    {
+        for (size_t y = 0; y < s.subspaces[x].regions.size(); ++y)
+        {
+            region& r(s.subspaces[x].regions[y]);
+            r.id = region_id(next_id);
+            ++next_id;
+
+            if (x == 1 && *grid == region_id())
+            {
+                *grid = r.id;
+            }
+
+            for (size_t z = 0; z < 2; ++z)
+            {
+                server_id si(1 + (y + z) % _servers);
+                r.replicas.push_back(replica(si, virtual_server_id(next_id)));
+                ++next_id;
+            }
+        }
+    }
+
+    size_t sz = 6 * sizeof(uint64_t)
+              + _servers * (sizeof(uint64_t) + pack_size(po6::net::location()))
+              + pack_size(s);
+    std::auto_ptr<e::buffer> buf(e::buffer::create(sz));
+    e::buffer::packer pa = buf->pack_at(0);
+    pa = pa << uint64_t(1) << uint64_t(1)
+            << uint64_t(_servers) << uint64_t(1)
+            << uint64_t(0) << uint64_t(0);
+
+    for (long i = 0; i < _servers; ++i)
+    {
+        pa = pa << uint64_t(1 + i) << po6::net::location();
+    }
+
+    pa = pa << s;
+    e::unpacker up = buf->unpack_from(0);
+    up = up >> *config;
+    return !up.error();
+}
+
+static uint64_t
+next_random(uint64_t* state)
+{
+    // xorshift64*; good enough to scatter lookups over the hyperspace
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+static void
+report(const char* what, uint32_t num_regions, uint64_t start, uint64_t end, uint64_t sink)
+{
+    double ns = end - start;
+    fprintf(stdout, "%-16s regions=%-6u %10.1f ns/op (%lu)\n",
+            what, num_regions, ns / _lookups, sink);
+}
+
+static int
+benchmark(uint32_t num_regions)
+{
+    configuration config;
+    region_id grid;
+
+    if (!build_configuration(num_regions, &config, &grid))
+    {
+        fprintf(stderr, "could not build configuration with %u regions\n", num_regions);
+        return EXIT_FAILURE;
+    }
+
+    const subspace* ss1 = config.get_subspace(grid);
+
+    if (!ss1 || ss1->regions.empty())
+    {
+        fprintf(stderr, "configuration with %u regions is malformed\n", num_regions);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    uint64_t sink = 0;
+    uint64_t start;
+    uint64_t end;
+
+    // point_leader
+    start = e::time();
+
+    for (long i = 0; i < _lookups; ++i)
+    {
+        uint64_t k = next_random(&state);
+        sink += config.point_leader("bench", e::slice(reinterpret_cast<const char*>(&k), sizeof(k))).get();
+    }
+
+    end = e::time();
+    report("point_leader", num_regions, start, end, sink);
+
+    // lookup_region
+    std::vector<uint64_t> hashes(3);
+    sink = 0;
+    start = e::time();
+
+    for (long i = 0; i < _lookups; ++i)
+    {
+        hashes[0] = next_random(&state);
+        hashes[1] = next_random(&state);
+        hashes[2] = next_random(&state);
+        region_id ri;
+        config.lookup_region(subspace_id(3), hashes, &ri);
+        sink += ri.get();
+    }
+
+    end = e::time();
+    report("lookup_region", num_regions, start, end, sink);
+
+    // get_virtual
+    sink = 0;
+    start = e::time();
+
+    for (long i = 0; i < _lookups; ++i)
+    {
+        const region& r(ss1->regions[next_random(&state) % ss1->regions.size()]);
+        sink += config.get_virtual(r.id, r.replicas[1].si).get();
+    }
+
+    end = e::time();
+    report("get_virtual", num_regions, start, end, sink);
+    return EXIT_SUCCESS;
+}
+
+int
+main(int argc, const char* argv[])
+{
+    poptContext poptcon;
+    poptcon = poptGetContext(NULL, argc, argv, popts, POPT_CONTEXT_POSIXMEHARDER);
+    e::guard g = e::makeguard(poptFreeContext, poptcon); g.use_variable();
+    poptSetOtherOptionHelp(poptcon, "[OPTIONS]");
+    int rc;
+
+    while ((rc = poptGetNextOpt(poptcon)) != -1)
+    {
+        switch (rc)
+        {
+            case 'n':
+                if (_lookups <= 0)
+                {
+                    fprintf(stderr, "number of lookups must be positive\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 's':
+                if (_servers <= 0)
+                {
+                    fprintf(stderr, "number of servers must be positive\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case POPT_ERROR_NOARG:
+            case POPT_ERROR_BADOPT:
+            case POPT_ERROR_BADNUMBER:
+            case POPT_ERROR_OVERFLOW:
+                fprintf(stderr, "%s %s\n", poptStrerror(rc), poptBadOption(poptcon, 0));
+                return EXIT_FAILURE;
+            case POPT_ERROR_OPTSTOODEEP:
+            case POPT_ERROR_BADQUOTE:
+            case POPT_ERROR_ERRNO:
+            default:
+                fprintf(stderr, "logic error in argument parsing\n");
+                return EXIT_FAILURE;
+        }
+    }
+
+    const uint32_t sizes[] = {256, 4096, 65536};
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+        if (benchmark(sizes[i]) != EXIT_SUCCESS)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}